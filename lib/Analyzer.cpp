@@ -23,30 +23,34 @@ void DumpAnalyzer::AnalyzeTrace(const Trace *trace) {
   if (!trace) {
     return;
   }
-  trace_buf += "!PID: ";
-  trace_buf += to_string(trace->GetThreadId());
-  trace_buf += "\n";
-
-  trace_buf += "!Working Directory: ";
-  trace_buf += trace->GetCwd();
-  trace_buf += "\n";
+  AnalyzeHeader(trace);
   vector<const ExecOp*> exec_ops = trace->GetExecOps();
-  operation_count = exec_ops.size();
   for (auto const &exec_op : exec_ops) {
     AnalyzeExecOp(exec_op);
   }
   vector<const Block*> blocks = trace->GetBlocks();
-  block_count = blocks.size();
   for (auto const &block : blocks) {
     AnalyzeBlock(block);
   }
 }
 
 
+void DumpAnalyzer::AnalyzeHeader(const Trace *trace) {
+  trace_buf += "!PID: ";
+  trace_buf += to_string(trace->GetThreadId());
+  trace_buf += "\n";
+
+  trace_buf += "!Working Directory: ";
+  trace_buf += trace->GetCwd();
+  trace_buf += "\n";
+}
+
+
 void DumpAnalyzer::AnalyzeBlock(const Block *block) {
   if (!block) {
     return;
   }
+  block_count++;
   vector<const Expr*> exprs = block->GetExprs();
   size_t block_id = block->GetBlockId();
 
@@ -85,6 +89,7 @@ void DumpAnalyzer::AnalyzeExecOp(const ExecOp *exec_op) {
   if (!exec_op) {
     return;
   }
+  operation_count++;
   trace_count += exec_op->GetOperations().size();
   trace_buf += exec_op->ToString();
   trace_buf += "\n";
@@ -66,6 +66,10 @@ class Analyzer {
     virtual void AnalyzeRename(const Rename *rename) = 0;
     /** Analyze the 'symlink' construct. */
     virtual void AnalyzeSymlink(const Symlink *symlink) = 0;
+    /** Analyze the 'newProc' construct. */
+    virtual void AnalyzeNewProc(const NewProc *new_proc) = 0;
+    /** Analyze the 'waitProc' construct. */
+    virtual void AnalyzeWaitProc(const WaitProc *wait_proc) = 0;
 
     /**
      * This method dumps the analysis output using the given
@@ -115,6 +119,15 @@ class DumpAnalyzer : public Analyzer {
     void AnalyzeLink(const LinkExpr *link_expr);
     void AnalyzeTrigger(const Trigger *nested_ev_expr);
 
+    /**
+     * Dumps the header of the given trace, i.e., the id and the working
+     * directory of its process.
+     *
+     * This is used when the `execOp`s and blocks of the trace are
+     * analyzed one by one as they are generated.
+     */
+    void AnalyzeHeader(const Trace *trace);
+
     void AnalyzeOperation(const Operation *operation);
     void AnalyzeNewFd(const NewFd *new_fd) { trace_count++; }
     void AnalyzeDelFd(const DelFd *del_fd) { trace_count++; }
@@ -123,12 +136,19 @@ class DumpAnalyzer : public Analyzer {
     void AnalyzeLink(const Link *link) { trace_count++; }
     void AnalyzeRename(const Rename *rename) { trace_count++; }
     void AnalyzeSymlink(const Symlink *symlink) { trace_count++; }
+    void AnalyzeNewProc(const NewProc *new_proc) { trace_count++; }
+    void AnalyzeWaitProc(const WaitProc *wait_proc) { trace_count++; }
 
     /** Gets the number of trace entries. */
     size_t GetTraceCount() const {
       return trace_count;
     }
 
+    /** Gets the trace entries generated so far (without the preamble). */
+    const string &GetTraceBuffer() const {
+      return trace_buf;
+    }
+
     void DumpOutput(writer::OutWriter *out) const;
 
   private:
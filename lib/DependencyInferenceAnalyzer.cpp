@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <fstream>
+#include <map>
 #include <set>
+#include <stack>
 #include <tuple>
 
 #include "DependencyInferenceAnalyzer.h"
@@ -19,16 +22,283 @@ void DependencyInferenceAnalyzer::Analyze(const TraceNode *trace_node) {
   if (trace_node) {
     analysis_time.Start();
     trace_node->Accept(this);
+    Seal();
+    // The graph is not modified anymore, so we switch to its
+    // compact representation for the read-only phases that follow.
+    dep_graph.Freeze();
     analysis_time.Stop();
   }
 }
 
 
+void DependencyInferenceAnalyzer::Seal() {
+  PruneEdges();
+  epochs = ComputeEpochs(dep_graph, barriers);
+}
+
+
+set<string> DependencyInferenceAnalyzer::GetCollectableEvents() const {
+  // The events that reach a sink of the main process, and hence
+  // the next MAIN block.
+  set<string> sinks;
+  for (auto const &sink : dep_graph.GetSinks()) {
+    if (!GetEventProcess(sink).has_value()) {
+      sinks.insert(sink);
+    }
+  }
+  set<string> collectable;
+  for (auto const &event_id : dep_graph.Ancestors(sinks)) {
+    if (dep_graph.HasNodeAttr(event_id, EXECUTED_ATTR)) {
+      collectable.insert(event_id);
+    }
+  }
+  // Every alive event must be reachable from the collectable events.
+  for (auto const &alive_ev_id : alive_events) {
+    if (collectable.empty()) {
+      return collectable;
+    }
+    set<string> ancestors = dep_graph.Ancestors({ alive_ev_id });
+    for (auto it = collectable.begin(); it != collectable.end(); ) {
+      it = ancestors.find(*it) == ancestors.end() ?
+        collectable.erase(it) : next(it);
+    }
+  }
+  // The nodes that are reachable from the given node.
+  auto descendants = [this](const string &node_id) {
+    set<string> visited;
+    stack<string> pool;
+    pool.push(node_id);
+    while (!pool.empty()) {
+      string node = pool.top();
+      pool.pop();
+      if (!visited.insert(node).second) {
+        continue;
+      }
+      optional<EventInfo> info = dep_graph.GetNodeInfo(node);
+      for (auto const &succ : info.value().before) {
+        pool.push(succ);
+      }
+    }
+    return visited;
+  };
+  // An executed W event may be executed again, so the collectable events
+  // must be ordered with it. Otherwise, they may race with its next
+  // execution.
+  vector<string> w_events;
+  for (auto const &entry : dep_graph) {
+    if (entry.second.node_obj.GetEventType() == Event::W &&
+        entry.second.HasAttribute(EXECUTED_ATTR)) {
+      w_events.push_back(entry.first);
+    }
+  }
+  for (auto const &w_ev_id : w_events) {
+    if (collectable.empty()) {
+      return collectable;
+    }
+    set<string> ancestors = dep_graph.Ancestors({ w_ev_id });
+    set<string> successors = descendants(w_ev_id);
+    for (auto it = collectable.begin(); it != collectable.end(); ) {
+      it = ancestors.find(*it) == ancestors.end() &&
+        successors.find(*it) == successors.end() ?
+        collectable.erase(it) : next(it);
+    }
+  }
+  while (true) {
+    // The events that are reachable from events which are not
+    // collectable (i.e., alive events) are kept.
+    stack<string> pool;
+    for (auto const &entry : dep_graph) {
+      if (collectable.find(entry.first) == collectable.end()) {
+        for (auto const &succ : entry.second.before) {
+          pool.push(succ);
+        }
+      }
+    }
+    while (!pool.empty()) {
+      string node = pool.top();
+      pool.pop();
+      if (!collectable.erase(node)) {
+        continue;
+      }
+      optional<EventInfo> info = dep_graph.GetNodeInfo(node);
+      for (auto const &succ : info.value().before) {
+        pool.push(succ);
+      }
+    }
+    // Similarly, a collected W event is not compared with the remaining
+    // events when it is executed again, so it must reach all of them.
+    bool changed = false;
+    for (auto const &w_ev_id : w_events) {
+      if (collectable.find(w_ev_id) == collectable.end()) {
+        continue;
+      }
+      set<string> successors = descendants(w_ev_id);
+      for (auto const &entry : dep_graph) {
+        if (collectable.find(entry.first) == collectable.end() &&
+            successors.find(entry.first) == successors.end()) {
+          collectable.erase(w_ev_id);
+          changed = true;
+          break;
+        }
+      }
+    }
+    if (!changed) {
+      return collectable;
+    }
+  }
+}
+
+
+void DependencyInferenceAnalyzer::Collect(const set<string> &events,
+                                          const string &next_barrier) {
+  // The remaining events that are reached directly by collected ones,
+  // along with those collected events. The sinks of the main process
+  // are followed by the next MAIN block, as they would be if they were
+  // not collected.
+  unordered_map<string, vector<string>> preds;
+  map<string, vector<string>> frontier;
+  for (auto const &entry : dep_graph) {
+    if (events.find(entry.first) == events.end()) {
+      continue;
+    }
+    if (entry.second.dependents.empty() &&
+        !GetEventProcess(entry.first).has_value()) {
+      frontier[next_barrier].push_back(entry.first);
+    }
+    for (auto const &dependent : entry.second.dependents) {
+      if (events.find(dependent.first) == events.end()) {
+        frontier[dependent.first].push_back(entry.first);
+      } else {
+        preds[dependent.first].push_back(entry.first);
+      }
+    }
+  }
+  // Collected W events may be executed and restored again, so they
+  // are also successors of the collected events that reach them.
+  for (auto const &event_id : events) {
+    optional<Event> event = dep_graph.GetNodeObj(event_id);
+    if (event.has_value() && event.value().GetEventType() == Event::W) {
+      frontier[event_id] = preds[event_id];
+    }
+  }
+  // Every event of the frontier is a successor of all the collected
+  // events that reach it.
+  unordered_map<string, vector<string>> successors;
+  for (auto const &entry : frontier) {
+    set<string> visited;
+    stack<string> pool;
+    for (auto const &pred : entry.second) {
+      pool.push(pred);
+    }
+    while (!pool.empty()) {
+      string node = pool.top();
+      pool.pop();
+      if (!visited.insert(node).second) {
+        continue;
+      }
+      successors[node].push_back(entry.first);
+      for (auto const &pred : preds[node]) {
+        pool.push(pred);
+      }
+    }
+  }
+  for (auto const &event_id : events) {
+    optional<Event> event = dep_graph.GetNodeObj(event_id);
+    if (event.has_value()) {
+      vector<string> &succs = successors[event_id];
+      auto it = collected_events.find(event_id);
+      if (it == collected_events.end()) {
+        collection_order.push_back(event_id);
+      } else {
+        // The event has been restored, so it still reaches the collected
+        // events that it reached before.
+        for (auto const &succ : it->second.successors) {
+          if (events.find(succ) == events.end() &&
+              !dep_graph.HasNode(succ)) {
+            succs.push_back(succ);
+          }
+        }
+      }
+      collected_events[event_id] = { event.value(), move(succs) };
+    }
+    dep_graph.RemoveNode(event_id);
+    event_procs.erase(event_id);
+    if (pending_ev == event_id) {
+      pending_ev = "";
+    }
+  }
+  // We forget the events that were collected first.
+  while (collection_order.size() > MAX_COLLECTED_EVENTS) {
+    collected_events.erase(collection_order.front());
+    collection_order.pop_front();
+  }
+  barriers.erase(remove_if(barriers.begin(), barriers.end(),
+                           [&events](const string &barrier) {
+                             return events.find(barrier) != events.end();
+                           }),
+                 barriers.end());
+  epochs.clear();
+}
+
+
+optional<DependencyInferenceAnalyzer::EventInfo>
+DependencyInferenceAnalyzer::RestoreEvent(const string &event_id) {
+  auto it = collected_events.find(event_id);
+  if (it == collected_events.end()) {
+    return {};
+  }
+  dep_graph.AddNode(event_id, it->second.event);
+  dep_graph.AddNodeAttr(event_id, EXECUTED_ATTR);
+  for (auto const &pred : it->second.restored_preds) {
+    dep_graph.AddEdge(pred, event_id, graph::HAPPENS_BEFORE);
+  }
+  it->second.restored_preds.clear();
+  // Before the collection, this event reached its successors. Those
+  // that have been collected since then are replaced by their own
+  // successors.
+  set<string> visited = { event_id };
+  stack<string> pool;
+  for (auto const &succ : it->second.successors) {
+    pool.push(succ);
+  }
+  while (!pool.empty()) {
+    string node = pool.top();
+    pool.pop();
+    if (!visited.insert(node).second) {
+      continue;
+    }
+    auto collected = collected_events.find(node);
+    if (dep_graph.HasNode(node) || collected == collected_events.end()) {
+      dep_graph.AddEdge(event_id, node, graph::HAPPENS_BEFORE);
+      continue;
+    }
+    if (collected->second.event.GetEventType() == Event::W) {
+      // This event may be restored later on.
+      collected->second.restored_preds.insert(event_id);
+    }
+    for (auto const &succ : collected->second.successors) {
+      pool.push(succ);
+    }
+  }
+  // We keep the event in the collected ones, so that it is restored
+  // again if it is collected and executed once more.
+  return dep_graph.GetNodeInfo(event_id);
+}
+
+
 void DependencyInferenceAnalyzer::AnalyzeTrace(const Trace *trace) {
   if (!trace) {
     return;
   }
 
+  for (auto const &process : trace->GetProcesses()) {
+    if (process.creator.has_value()) {
+      process_creators[process.pid] = process.creator.value();
+    }
+    if (process.joiner.has_value()) {
+      process_joiners[process.pid] = process.joiner.value();
+    }
+  }
   vector<const Block*> blocks = trace->GetBlocks();
   for (auto const &block : blocks) {
     AnalyzeBlock(block);
@@ -49,6 +319,9 @@ void DependencyInferenceAnalyzer::AnalyzeBlock(const Block *block) {
   current_context = block_id;
   if (!block->IsMain()) {
     optional<EventInfo> event_info = dep_graph.GetNodeInfo(block_id);
+    if (!event_info.has_value()) {
+      event_info = RestoreEvent(block_id);
+    }
     if (!event_info.has_value()) {
       return;
     }
@@ -57,41 +330,111 @@ void DependencyInferenceAnalyzer::AnalyzeBlock(const Block *block) {
     // since now know when it's executed.
     ConnectWithWEvents(event_info.value());
 
-    // We also prune any redundant edges.
-    PruneEdges(block_id);
-
     // If the current event is active, we can infer that
     // it has been previously executed. Therefore, we have
     // to associate the previous block with the first event
     // that is created inside the current one.
     if (event_info.value().HasAttribute(EXECUTED_ATTR)) {
-      if (current_block) {
-        pending_ev = current_block->GetPrettyBlockId();
+      if (!last_block_id.empty() &&
+          last_block_process == block->GetProcess()) {
+        pending_ev = last_block_id;
       }
     }
   }
   if (block->IsMain()) {
-    // This is the MAIN block, so we add it to the dependency graph
-    // since there is not any preceding "newEvent" construct associated with
-    // the ID of the current block.
-    dep_graph.AddNode(block_id, Event(Event::MAIN, 0));
+    AddMainBlock(block);
+  }
+  if (block->GetProcess().has_value()) {
+    // The process terminates before the block that waits for it.
+    auto joiner = process_joiners.find(block->GetProcess().value());
+    if (joiner != process_joiners.end()) {
+      auto collected = collected_events.find(joiner->second);
+      if (dep_graph.HasNode(joiner->second) ||
+          collected == collected_events.end()) {
+        dep_graph.AddEdge(block_id, joiner->second, graph::HAPPENS_BEFORE);
+      } else {
+        // The block that waits for the process has been collected, so
+        // the block happens before the events that follow it.
+        for (auto const &succ : collected->second.successors) {
+          dep_graph.AddEdge(block_id, succ, graph::HAPPENS_BEFORE);
+        }
+      }
+    }
+  }
+
+  current_block = block;
+  // The block may be deallocated once it is analyzed, so we only keep
+  // its id and process.
+  last_block_id = block_id;
+  last_block_process = block->GetProcess();
+  for (auto const &expr : exprs) {
+    AnalyzeExpr(expr);
+  }
+  RemoveAliveEvent(block->GetPrettyBlockId());
+  dep_graph.AddNodeAttr(block->GetPrettyBlockId(), EXECUTED_ATTR);
+}
+
+
+void DependencyInferenceAnalyzer::AddMainBlock(const Block *block) {
+  string block_id = block->GetPrettyBlockId();
+  optional<size_t> process = block->GetProcess();
+  // This is the MAIN block, so we add it to the dependency graph
+  // since there is not any preceding "newEvent" construct associated with
+  // the ID of the current block.
+  dep_graph.AddNode(block_id, Event(Event::MAIN, 0));
+  if (!process.has_value()) {
     if (prev_main_block) {
       // If there was a previous main block, we get the sink nodes of the
       // current dep graph and we add dependencies with the current main
       // block.
       for (auto const &sink : dep_graph.GetSinks()) {
-        dep_graph.AddEdge(sink, block_id, graph::HAPPENS_BEFORE);
+        if (!GetEventProcess(sink).has_value()) {
+          dep_graph.AddEdge(sink, block_id, graph::HAPPENS_BEFORE);
+        }
       }
     }
     prev_main_block = block;
+    // Only the MAIN blocks of the main process are totally ordered,
+    // so they are the only barriers.
+    barriers.push_back(block_id);
+    return;
   }
 
-  current_block = block;
-  for (auto const &expr : exprs) {
-    AnalyzeExpr(expr);
+  // Every other process runs concurrently with its parent, so its
+  // MAIN blocks only follow the events of the same process.
+  event_procs[block_id] = process.value();
+  auto it = process_mains.find(process.value());
+  if (it != process_mains.end()) {
+    // The events of the process also happen before the block that
+    // waits for it, so the last ones are those without successors
+    // in the process, rather than the sinks.
+    vector<string> last_events;
+    for (auto const &entry : dep_graph) {
+      if (entry.first == block_id ||
+          GetEventProcess(entry.first) != process) {
+        continue;
+      }
+      bool is_last = none_of(
+          entry.second.before.begin(), entry.second.before.end(),
+          [this, &process](const string &succ) {
+            return GetEventProcess(succ) == process;
+          });
+      if (is_last) {
+        last_events.push_back(entry.first);
+      }
+    }
+    for (auto const &event_id : last_events) {
+      dep_graph.AddEdge(event_id, block_id, graph::HAPPENS_BEFORE);
+    }
+  } else {
+    // This is the first block of the process, so it follows the block
+    // that creates the process.
+    auto creator = process_creators.find(process.value());
+    if (creator != process_creators.end()) {
+      dep_graph.AddEdge(creator->second, block_id, graph::CREATES);
+    }
   }
-  RemoveAliveEvent(block->GetPrettyBlockId());
-  dep_graph.AddNodeAttr(block->GetPrettyBlockId(), EXECUTED_ATTR);
+  process_mains[process.value()] = block_id;
 }
 
 
@@ -112,6 +455,10 @@ DependencyInferenceAnalyzer::AnalyzeNewEvent(const NewEventExpr *new_event) {
 
   string event_id = to_string(new_event->GetEventId());
   dep_graph.AddNode(event_id, new_event->GetEvent());
+  optional<size_t> process = current_block->GetProcess();
+  if (process.has_value()) {
+    event_procs[event_id] = process.value();
+  }
 
   // There is a pending event that we need to connect with the newly-created
   // event.
@@ -252,13 +599,16 @@ void DependencyInferenceAnalyzer::ProceedEXTEvent(const EventInfo &new_event,
 
 void DependencyInferenceAnalyzer::AddDependencies(string event_id,
                                                   const Event &event) {
+  optional<size_t> process = GetEventProcess(event_id);
   for (auto alive_ev_id : alive_events) {
     optional<EventInfo> event_info_opt = dep_graph.GetNodeInfo(alive_ev_id);
     // We ignore events that are not present to the dependency graph.
     // events identical to the current block,
+    // events of other processes (which have their own event loop),
     // as well as inactive events.
     if (!event_info_opt.has_value() ||
-        current_block->GetPrettyBlockId() == event_info_opt.value().node_id) {
+        current_block->GetPrettyBlockId() == event_info_opt.value().node_id ||
+        GetEventProcess(alive_ev_id) != process) {
       continue;
     }
     EventInfo event_info = event_info_opt.value();
@@ -293,7 +643,9 @@ void DependencyInferenceAnalyzer::ConnectWithWEvents(const EventInfo &event_info
     case Event::W:
       for (auto alive_ev_id : alive_events) {
         optional<EventInfo> node_info_opt = dep_graph.GetNodeInfo(alive_ev_id);
-        if (!node_info_opt.has_value()) {
+        if (!node_info_opt.has_value() ||
+            GetEventProcess(alive_ev_id) !=
+              GetEventProcess(event_info.node_id)) {
           continue;
         }
         // In this loop, we get the list of all the alive events
@@ -323,30 +675,107 @@ void DependencyInferenceAnalyzer::ConnectWithWEvents(const EventInfo &event_info
 }
 
 
-void DependencyInferenceAnalyzer::PruneEdges(string event_id) {
-  optional<EventInfo> event_info_opt = dep_graph.GetNodeInfo(event_id);
-  if (!event_info_opt.has_value()) {
-    return;
+void DependencyInferenceAnalyzer::PruneEdges() {
+  // A happens-before edge is redundant if its target is reachable
+  // through other executed events. Creation edges are always kept,
+  // since they carry information about the origin of every event.
+  dep_graph.TransitiveReduction(
+      [](const enum graph::EdgeLabel &label) { return label == graph::HAPPENS_BEFORE; },
+      [this](const string &node_id) {
+        return dep_graph.HasNodeAttr(node_id, EXECUTED_ATTR);
+      });
+}
+
+
+DependencyInferenceAnalyzer::epochs_t
+DependencyInferenceAnalyzer::ComputeEpochs(const dep_graph_t &dep_graph,
+                                           const vector<string> &barriers) {
+  epochs_t epochs;
+  if (barriers.empty()) {
+    return epochs;
   }
-  EventInfo event_info = event_info_opt.value();
-  for (auto next : event_info.before) {
-    optional<EventInfo> nextev_info_opt = dep_graph.GetNodeInfo(next);
-    if (!nextev_info_opt.has_value()) {
-      continue;
+  unordered_map<string, vector<string>> succs, preds;
+  for (auto const &entry : dep_graph) {
+    epochs[entry.first] = { 0, NO_EPOCH };
+    for (auto const &dependent : entry.second.dependents) {
+      succs[entry.first].push_back(dependent.first);
+      preds[dependent.first].push_back(entry.first);
     }
+  }
+  // Visits the nodes reachable from the given source through the edges
+  // of `adj`. A node is expanded only if `visit` accepts it.
+  auto traverse = [&epochs](const string &source,
+                            unordered_map<string, vector<string>> &adj,
+                            auto visit) {
+    stack<string> pool;
+    pool.push(source);
+    while (!pool.empty()) {
+      string node = pool.top();
+      pool.pop();
+      auto it = epochs.find(node);
+      if (it == epochs.end() || !visit(node, it->second)) {
+        continue;
+      }
+      for (auto const &n : adj[node]) {
+        pool.push(n);
+      }
+    }
+  };
+
+  // The `in` epoch of an event is the last barrier that reaches it.
+  // We start from the last barrier, so every event is assigned by
+  // the last barrier that reaches it, and every traversal stops at
+  // events that have been already assigned.
+  for (size_t k = barriers.size(); k >= 1; k--) {
+    traverse(barriers[k - 1], succs, [k](const string &, Epoch &epoch) {
+      if (epoch.in != 0) {
+        return false;
+      }
+      epoch.in = k;
+      return true;
+    });
+  }
+  // Symmetrically, the `out` epoch of an event is the first barrier
+  // that is reachable from it.
+  for (size_t k = 1; k <= barriers.size(); k++) {
+    traverse(barriers[k - 1], preds, [k](const string &, Epoch &epoch) {
+      if (epoch.out != NO_EPOCH) {
+        return false;
+      }
+      epoch.out = k;
+      return true;
+    });
+  }
 
-    EventInfo nextev_info = nextev_info_opt.value();
-    // Iterate over the previous nodes of the the given event.
-    //
-    // If prev is included in the set of previous nodes of next,
-    // we remove the corresponding edge, because `prev` is connected with
-    // `next` via the given event.
-    for (auto prev : event_info.after) {
-      if (nextev_info.after.find(prev) != nextev_info.after.end()) {
-        dep_graph.RemoveEdge(prev, next, graph::HAPPENS_BEFORE);
+  // Epochs are meaningful only if every barrier reaches the next one.
+  // All the nodes of a path from barrier k to barrier k + 1 have
+  // an out epoch not greater than `k + 1` and an in epoch not smaller
+  // than k. So the traversal is restricted to those nodes. Unless
+  // the graph contains cycles, this means that every node is examined
+  // by at most one traversal.
+  for (size_t k = 1; k < barriers.size(); k++) {
+    const string &barrier = barriers[k - 1];
+    const string &next_barrier = barriers[k];
+    bool reached = false;
+    set<string> visited;
+    traverse(barrier, succs, [&](const string &node, Epoch &epoch) {
+      if (reached || visited.find(node) != visited.end()) {
+        return false;
+      }
+      visited.insert(node);
+      if (node == next_barrier) {
+        reached = true;
+        return false;
       }
+      return epoch.out <= k + 1;
+    });
+    if (!reached) {
+      // Barriers are not totally ordered, so we do not use epochs.
+      epochs.clear();
+      return epochs;
     }
   }
+  return epochs;
 }
 
 
@@ -1,10 +1,13 @@
 #ifndef DEPENDENCY_INFERENCE_ANALYZER_H
 #define DEPENDENCY_INFERENCE_ANALYZER_H 
 
+#include <deque>
 #include <iostream>
+#include <limits>
 #include <unordered_map>
 #include <utility>
 #include <set>
+#include <vector>
 
 #include "Analyzer.h"
 #include "Graph.h"
@@ -44,7 +47,7 @@ enum EdgeLabel {
 template<>
 struct GraphPrinter<Event, enum EdgeLabel> : public GraphPrinterDefault {
   public:
-    using NodeInfo = Node<Event, enum EdgeLabel>;
+    using NodeInfo = FrozenNode<Event>;
     static string PrintNodeDot(string node_id, const NodeInfo &node_info) {
       // If the given node (i.e., event) has not been executed,
       // then omit printing it.
@@ -134,6 +137,29 @@ class DependencyInferenceAnalyzer : public Analyzer {
      */
     using EventInfo = dep_graph_t::NodeInfo;
 
+    /// Indicates that an event does not happen before any barrier.
+    static constexpr size_t NO_EPOCH = numeric_limits<size_t>::max();
+    /// The maximum number of collected events that are remembered.
+    static constexpr size_t MAX_COLLECTED_EVENTS = 1 << 16;
+
+    /**
+     * The epochs of an event.
+     *
+     * Every non-empty MAIN block acts as a barrier, since all the sinks
+     * of the dependency graph are connected to it. The barriers are
+     * numbered (starting from 1) in the order of their execution.
+     */
+    struct Epoch {
+      /// The last barrier that happens before the event (0 if none).
+      size_t in;
+      /// The first barrier that the event happens before
+      /// (`NO_EPOCH` if none).
+      size_t out;
+    };
+
+    /// The epochs of every event.
+    using epochs_t = unordered_map<string, Epoch>;
+
     /** Default Constructor of the analyzer. */
     DependencyInferenceAnalyzer(enum graph::GraphFormat graph_format_):
       current_block(nullptr),
@@ -168,6 +194,8 @@ class DependencyInferenceAnalyzer : public Analyzer {
     void AnalyzeLink(const Link *link) {  }
     void AnalyzeRename(const Rename *rename) {  }
     void AnalyzeSymlink(const Symlink *symlink) {  }
+    void AnalyzeNewProc(const NewProc *new_proc) {  }
+    void AnalyzeWaitProc(const WaitProc *wait_proc) {  }
 
     void DumpOutput(writer::OutWriter *out) const;
 
@@ -175,17 +203,109 @@ class DependencyInferenceAnalyzer : public Analyzer {
       return dep_graph;
     }
 
+    /**
+     * Gets the epochs of events.
+     *
+     * If `out(u) <= in(v)`, then the event `u` happens before `v`.
+     * The result is empty when barriers are not totally ordered
+     * in the dependency graph (e.g., due to cycles).
+     */
+    const epochs_t &GetEpochs() const {
+      return epochs;
+    }
+
+    /**
+     * Completes the dependency graph of the analyzed blocks by pruning
+     * redundant edges and computing epochs.
+     */
+    void Seal();
+
+    /**
+     * Computes the epochs of all the events of the given dependency
+     * graph, where the given MAIN blocks are the barriers in the order
+     * of their execution. The graph must not be frozen.
+     */
+    static epochs_t ComputeEpochs(const dep_graph_t &dep_graph,
+                                  const vector<string> &barriers);
+
+    /** Gets the number of events in the dependency graph. */
+    size_t Size() const {
+      return dep_graph.Size();
+    }
+
+    /**
+     * Gets the events that can be collected before the next MAIN block
+     * of the main process.
+     *
+     * An event is collectable if it has been executed, and it happens
+     * before every alive event and a sink of the main process. Since
+     * sinks are connected to the next MAIN block, the event happens
+     * before all the events that follow. Also, all the predecessors of
+     * the event must be collectable, so that the removal of the collected
+     * events does not affect the paths among the remaining ones.
+     *
+     * An executed W event may be executed again. So, a collectable event
+     * must be ordered with every executed W event that remains, and
+     * a collectable W event must happen before every remaining event.
+     */
+    set<string> GetCollectableEvents() const;
+
+    /**
+     * Removes the given events from the dependency graph. They must be
+     * collectable before the MAIN block `next_barrier`.
+     *
+     * The last `MAX_COLLECTED_EVENTS` collected events are remembered
+     * along with the remaining events and the collected W events that
+     * they reach. If one of them is executed again, it is restored with
+     * edges to those events, so that it is ordered as if it had never
+     * been collected. Older events are treated as unknown ones.
+     */
+    void Collect(const set<string> &events, const string &next_barrier);
+
   private:
     /// The dependency graph of events.
     dep_graph_t dep_graph;
+    /// The MAIN blocks (barriers) in the order of their execution.
+    vector<string> barriers;
+    /// The epochs of every event.
+    epochs_t epochs;
+    /** An event that has been removed from the dependency graph. */
+    struct CollectedEvent {
+      /// The type information of the event.
+      Event event;
+      /// The events that were reachable from the event when it was
+      /// collected, and were either not collected along with it or
+      /// W events (which may be restored).
+      vector<string> successors;
+      /// The restored events that reach the event (if it is a W event).
+      set<string> restored_preds;
+    };
+
+    /// The events that have been collected.
+    unordered_map<string, CollectedEvent> collected_events;
+    /// The collected events in the order of their collection.
+    deque<string> collection_order;
 
     /**
      * The set of alive events (i.e., events whose corresponding callbacks)
      * have not been executed yet.
      */
     set<string> alive_events;
+    /// The process of every event that is not executed by the main
+    /// process.
+    unordered_map<string, size_t> event_procs;
+    /// The last MAIN block of every process other than the main one.
+    unordered_map<size_t, string> process_mains;
+    /// The block that creates every process other than the main one.
+    unordered_map<size_t, string> process_creators;
+    /// The block that waits for the termination of every process
+    /// other than the main one (if any).
+    unordered_map<size_t, string> process_joiners;
     // The block that is currently being processed by the analyzer.
     const Block *current_block;
+    /// The id and the process of the last analyzed block.
+    string last_block_id;
+    optional<size_t> last_block_process;
 
     const Block *prev_main_block;
     /**
@@ -210,6 +330,21 @@ class DependencyInferenceAnalyzer : public Analyzer {
     /** Removes the given event from the set of alive events. */
     void RemoveAliveEvent(string event_id);
 
+    /**
+     * Gets the process of the given event. This is absent when
+     * the event belongs to the main process.
+     */
+    optional<size_t> GetEventProcess(const string &event_id) const {
+      auto it = event_procs.find(event_id);
+      if (it == event_procs.end()) {
+        return {};
+      }
+      return it->second;
+    }
+
+    /** Connects a MAIN block with the preceding events of its process. */
+    void AddMainBlock(const Block *block);
+
     // Methods for constructing the dependency graph based on
     // the type of events.
     
@@ -254,15 +389,22 @@ class DependencyInferenceAnalyzer : public Analyzer {
     void AddDependencies(string event_id, const Event &event);
 
     /**
-     * This method prunes redundant edges between the previous nodes
-     * of the given event and its next nodes.
+     * This method prunes the redundant happens-before edges of
+     * the dependency graph once it is built, i.e., the edges that are
+     * implied by other paths of executed events.
      */
-    void PruneEdges(string event_id);
+    void PruneEdges();
 
     /** Make all the event whose type is W dependent on the given event. */
     void ConnectWithWEvents(const EventInfo &event_info);
 
     void ConnectSubGraph();
+
+    /**
+     * Adds a collected event back to the dependency graph,
+     * because its block is executed again.
+     */
+    optional<EventInfo> RestoreEvent(const string &event_id);
 };
 
 
@@ -0,0 +1,131 @@
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FOOTPRINTS_X86
+#endif
+
+#include <cstdlib>
+#include <string>
+
+#include "EventFootprints.h"
+
+
+namespace detector {
+
+
+static bool
+conflict_scalar(const uint64_t *ra, const uint64_t *wa,
+                const uint64_t *rb, const uint64_t *wb,
+                uint64_t *out, size_t words)
+{
+  uint64_t any = 0;
+  for (size_t i = 0; i < words; i++) {
+    out[i] = (wa[i] & (rb[i] | wb[i])) | (wb[i] & ra[i]);
+    any |= out[i];
+  }
+  return any != 0;
+}
+
+
+#ifdef FOOTPRINTS_X86
+static bool
+conflict_sse2(const uint64_t *ra, const uint64_t *wa,
+              const uint64_t *rb, const uint64_t *wb,
+              uint64_t *out, size_t words)
+{
+  __m128i any = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 2 <= words; i += 2) {
+    __m128i vra = _mm_loadu_si128((const __m128i *) (ra + i));
+    __m128i vwa = _mm_loadu_si128((const __m128i *) (wa + i));
+    __m128i vrb = _mm_loadu_si128((const __m128i *) (rb + i));
+    __m128i vwb = _mm_loadu_si128((const __m128i *) (wb + i));
+    __m128i mask = _mm_or_si128(
+        _mm_and_si128(vwa, _mm_or_si128(vrb, vwb)),
+        _mm_and_si128(vwb, vra));
+    _mm_storeu_si128((__m128i *) (out + i), mask);
+    any = _mm_or_si128(any, mask);
+  }
+  uint64_t lanes[2];
+  _mm_storeu_si128((__m128i *) lanes, any);
+  bool found = (lanes[0] | lanes[1]) != 0;
+  // Handle the remaining word (if any).
+  return conflict_scalar(ra + i, wa + i, rb + i, wb + i, out + i,
+                         words - i) || found;
+}
+
+
+__attribute__((target("avx2")))
+static bool
+conflict_avx2(const uint64_t *ra, const uint64_t *wa,
+              const uint64_t *rb, const uint64_t *wb,
+              uint64_t *out, size_t words)
+{
+  __m256i any = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 4 <= words; i += 4) {
+    __m256i vra = _mm256_loadu_si256((const __m256i *) (ra + i));
+    __m256i vwa = _mm256_loadu_si256((const __m256i *) (wa + i));
+    __m256i vrb = _mm256_loadu_si256((const __m256i *) (rb + i));
+    __m256i vwb = _mm256_loadu_si256((const __m256i *) (wb + i));
+    __m256i mask = _mm256_or_si256(
+        _mm256_and_si256(vwa, _mm256_or_si256(vrb, vwb)),
+        _mm256_and_si256(vwb, vra));
+    _mm256_storeu_si256((__m256i *) (out + i), mask);
+    any = _mm256_or_si256(any, mask);
+  }
+  bool found = !_mm256_testz_si256(any, any);
+  // Handle the remaining words (if any).
+  return conflict_sse2(ra + i, wa + i, rb + i, wb + i, out + i,
+                       words - i) || found;
+}
+#endif
+
+
+static EventFootprints::conflict_fn_t
+select_conflict_fn()
+{
+  // A routine other than the fastest one can be requested, so that
+  // all of them can be tested on the same CPU.
+  const char *kernel_env = getenv(EventFootprints::KERNEL_ENV);
+  std::string kernel = kernel_env ? kernel_env : "";
+  if (kernel == "scalar") {
+    return conflict_scalar;
+  }
+#ifdef FOOTPRINTS_X86
+  if (kernel == "sse2") {
+    return conflict_sse2;
+  }
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return conflict_avx2;
+  }
+  return conflict_sse2;
+#else
+  return conflict_scalar;
+#endif
+}
+
+
+EventFootprints::EventFootprints(
+    const analyzer::FSAccessStore &fs_accesses):
+  words((fs_accesses.NumPaths() + 63) / 64),
+  conflict_fn(select_conflict_fn()) {
+  size_t nevents = fs_accesses.NumEvents();
+  reads.assign(nevents * words, 0);
+  writes.assign(nevents * words, 0);
+  has_writes.assign(nevents, 0);
+  for (size_t i = 0; i < fs_accesses.Size(); i++) {
+    id_t event_id = fs_accesses.GetEventId(i);
+    id_t path_id = fs_accesses.GetPathId(i);
+    uint64_t bit = (uint64_t) 1 << (path_id & 63);
+    if (Hpath::Consumes(fs_accesses.GetEffect(i))) {
+      reads[event_id * words + (path_id >> 6)] |= bit;
+    } else {
+      writes[event_id * words + (path_id >> 6)] |= bit;
+      has_writes[event_id] = 1;
+    }
+  }
+}
+
+
+} // namespace detector
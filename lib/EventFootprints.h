@@ -0,0 +1,81 @@
+#ifndef EVENT_FOOTPRINTS_H
+#define EVENT_FOOTPRINTS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "FSAccessStore.h"
+
+
+namespace detector {
+
+
+/**
+ * The file system footprints of events.
+ *
+ * Every event of the access store is associated with a read bitmap
+ * and a write bitmap over the interned path ids. A path is "read" by
+ * an event when the event consumes it, and it is "written" when
+ * the event either produces or expunges it.
+ */
+class EventFootprints {
+public:
+  using id_t = analyzer::FSAccessStore::id_t;
+
+  /**
+   * The environment variable that selects the routine used to compute
+   * conflict masks ("scalar", "sse2", or "avx2"). By default, the
+   * fastest routine that the CPU supports is used.
+   */
+  static constexpr const char *KERNEL_ENV = "FSRACER_CONFLICT_KERNEL";
+
+  /** Builds the footprints of all the events found in the store. */
+  EventFootprints(const analyzer::FSAccessStore &fs_accesses);
+
+  /** Gets the number of 64-bit words of every bitmap. */
+  size_t GetWords() const {
+    return words;
+  }
+
+  /** Checks whether the given event writes at least one path. */
+  bool HasWrites(id_t event_id) const {
+    return has_writes[event_id];
+  }
+
+  /**
+   * Computes the paths where the accesses of the two events conflict,
+   * i.e., (W_A & (R_B | W_B)) | (W_B & R_A).
+   *
+   * The resulting mask is stored in `out`, which must have room for
+   * `GetWords()` words. Returns false if the events do not conflict
+   * on any path.
+   */
+  bool ConflictMask(id_t event1, id_t event2, uint64_t *out) const {
+    return conflict_fn(&reads[event1 * words], &writes[event1 * words],
+                       &reads[event2 * words], &writes[event2 * words],
+                       out, words);
+  }
+
+  /** The signature of the routines that compute conflict masks. */
+  using conflict_fn_t = bool (*)(const uint64_t *ra, const uint64_t *wa,
+                                 const uint64_t *rb, const uint64_t *wb,
+                                 uint64_t *out, size_t words);
+
+private:
+  /// Number of 64-bit words of every bitmap.
+  size_t words;
+  /// The read bitmaps of all events, stored row by row.
+  std::vector<uint64_t> reads;
+  /// The write bitmaps of all events, stored row by row.
+  std::vector<uint64_t> writes;
+  /// Indicates whether every event writes at least one path.
+  std::vector<uint8_t> has_writes;
+  /// The routine used to compute conflict masks. This is chosen
+  /// according to the vector instructions supported by the CPU.
+  conflict_fn_t conflict_fn;
+};
+
+
+} // namespace detector
+
+#endif
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <experimental/filesystem>
+#include <numeric>
+
+#include "FSAccessStore.h"
+
+
+namespace fs = experimental::filesystem;
+
+
+namespace analyzer {
+
+
+void FSAccessStore::Clear() {
+  path_ids.clear();
+  event_ids.clear();
+  effects.clear();
+  op_name_ids.clear();
+  path_offsets.clear();
+  paths.clear();
+  events.clear();
+  op_names.clear();
+  event_debug_info.clear();
+  path_index.clear();
+  event_index.clear();
+  op_name_index.clear();
+}
+
+
+FSAccessStore::id_t FSAccessStore::Intern(const string &value,
+                                          vector<string> &values,
+                                          unordered_map<string, id_t> &index) {
+  auto it = index.find(value);
+  if (it != index.end()) {
+    return it->second;
+  }
+  id_t id = values.size();
+  values.push_back(value);
+  index[value] = id;
+  return id;
+}
+
+
+void FSAccessStore::SetEffect(size_t i, enum Hpath::EffectType effect) {
+  size_t shift = (i & 3) << 1;
+  effects[i >> 2] &= ~(3 << shift);
+  effects[i >> 2] |= ((uint8_t) effect & 3) << shift;
+}
+
+
+void FSAccessStore::AddAccess(const string &p, const string &event_id,
+                              enum Hpath::EffectType effect,
+                              const string &op_name,
+                              const DebugInfo &debug_info) {
+  size_t i = path_ids.size();
+  path_ids.push_back(Intern(p, paths, path_index));
+  id_t ev = Intern(event_id, events, event_index);
+  if (ev == event_debug_info.size()) {
+    event_debug_info.push_back(debug_info);
+  }
+  event_ids.push_back(ev);
+  op_name_ids.push_back(Intern(op_name, op_names, op_name_index));
+  if ((i & 3) == 0) {
+    effects.push_back(0);
+  }
+  SetEffect(i, effect);
+}
+
+
+optional<size_t> FSAccessStore::FindAccess(id_t path_id,
+                                           id_t event_id) const {
+  // The accesses of a path are sorted by event, so we perform
+  // a binary search in the range of the path.
+  auto range = GetPathRange(path_id);
+  auto begin = event_ids.begin() + range.first;
+  auto end = event_ids.begin() + range.second;
+  auto it = lower_bound(begin, end, event_id);
+  if (it == end || *it != event_id) {
+    return {};
+  }
+  return it - event_ids.begin();
+}
+
+
+vector<uint8_t> FSAccessStore::GetConflictCandidates() const {
+  vector<uint8_t> candidates(NumEvents(), 0);
+  for (size_t p = 0; p < NumPaths(); p++) {
+    auto range = GetPathRange(p);
+    if (range.second - range.first < 2) {
+      // Every event accesses a path at most once, so a single access
+      // does not conflict with anything.
+      continue;
+    }
+    bool has_writes = false;
+    for (size_t i = range.first; i < range.second && !has_writes; i++) {
+      has_writes = !Hpath::Consumes(GetEffect(i));
+    }
+    if (!has_writes) {
+      continue;
+    }
+    // The writer conflicts with every other access of this path,
+    // so all the events of this path are candidates.
+    for (size_t i = range.first; i < range.second; i++) {
+      candidates[GetEventId(i)] = 1;
+    }
+  }
+  return candidates;
+}
+
+
+void FSAccessStore::Seal() {
+  // First, we renumber paths and events so that their ids follow
+  // the order of their values.
+  vector<id_t> path_order(paths.size());
+  iota(path_order.begin(), path_order.end(), 0);
+  sort(path_order.begin(), path_order.end(), [this](id_t a, id_t b) {
+    return fs::path(paths[a]) < fs::path(paths[b]);
+  });
+  vector<id_t> event_order(events.size());
+  iota(event_order.begin(), event_order.end(), 0);
+  sort(event_order.begin(), event_order.end(), [this](id_t a, id_t b) {
+    return events[a] < events[b];
+  });
+
+  vector<id_t> path_rank(paths.size());
+  vector<string> sorted_paths(paths.size());
+  for (size_t i = 0; i < path_order.size(); i++) {
+    path_rank[path_order[i]] = i;
+    sorted_paths[i] = move(paths[path_order[i]]);
+  }
+  vector<id_t> event_rank(events.size());
+  vector<string> sorted_events(events.size());
+  vector<DebugInfo> sorted_debug_info(events.size());
+  for (size_t i = 0; i < event_order.size(); i++) {
+    event_rank[event_order[i]] = i;
+    sorted_events[i] = move(events[event_order[i]]);
+    sorted_debug_info[i] = move(event_debug_info[event_order[i]]);
+  }
+  paths = move(sorted_paths);
+  events = move(sorted_events);
+  event_debug_info = move(sorted_debug_info);
+  path_index.clear();
+  for (size_t i = 0; i < paths.size(); i++) {
+    path_index[paths[i]] = i;
+  }
+  event_index.clear();
+  for (size_t i = 0; i < events.size(); i++) {
+    event_index[events[i]] = i;
+  }
+
+  // Second, we sort the accesses by (path, event).
+  size_t size = Size();
+  vector<size_t> order(size);
+  iota(order.begin(), order.end(), 0);
+  stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    id_t path_a = path_rank[path_ids[a]], path_b = path_rank[path_ids[b]];
+    if (path_a != path_b) {
+      return path_a < path_b;
+    }
+    return event_rank[event_ids[a]] < event_rank[event_ids[b]];
+  });
+  vector<id_t> new_path_ids(size), new_event_ids(size), new_op_name_ids(size);
+  vector<enum Hpath::EffectType> old_effects(size);
+  for (size_t i = 0; i < size; i++) {
+    old_effects[i] = GetEffect(i);
+  }
+  for (size_t i = 0; i < size; i++) {
+    new_path_ids[i] = path_rank[path_ids[order[i]]];
+    new_event_ids[i] = event_rank[event_ids[order[i]]];
+    new_op_name_ids[i] = op_name_ids[order[i]];
+    SetEffect(i, old_effects[order[i]]);
+  }
+  path_ids = move(new_path_ids);
+  event_ids = move(new_event_ids);
+  op_name_ids = move(new_op_name_ids);
+
+  // Finally, we compute the range of accesses of every path.
+  path_offsets.assign(paths.size() + 1, 0);
+  for (size_t i = 0; i < size; i++) {
+    path_offsets[path_ids[i] + 1]++;
+  }
+  for (size_t i = 0; i < paths.size(); i++) {
+    path_offsets[i + 1] += path_offsets[i];
+  }
+}
+
+
+} // namespace analyzer
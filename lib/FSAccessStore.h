@@ -0,0 +1,187 @@
+#ifndef FS_ACCESS_STORE_H
+#define FS_ACCESS_STORE_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Operation.h"
+#include "Trace.h"
+
+
+using namespace std;
+using namespace operation;
+using namespace trace;
+
+
+namespace analyzer {
+
+
+/**
+ * A columnar (structure-of-arrays) store of file accesses.
+ *
+ * Every access is described by four parallel arrays: the id of the
+ * accessed path, the id of the event that performs the access,
+ * the effect of the access (packed in two bits), and the id of the
+ * name of the corresponding operation. Paths, events and operation names
+ * are interned into dictionaries, so iterating over the accesses
+ * does not touch any per-element heap object.
+ *
+ * After the store is sealed, the accesses are sorted by (path, event),
+ * and the accesses of every path lie in a contiguous range.
+ */
+class FSAccessStore {
+public:
+  using id_t = uint32_t;
+
+  /** Removes all the accesses and dictionaries of the store. */
+  void Clear();
+
+  /**
+   * Appends a new file access to the store.
+   *
+   * Note that the store must be sealed before querying it.
+   */
+  void AddAccess(const string &p, const string &event_id,
+                 enum Hpath::EffectType effect, const string &op_name,
+                 const DebugInfo &debug_info);
+
+  /**
+   * Sorts the accesses by (path, event) and computes the range of
+   * accesses corresponding to every path.
+   *
+   * Path ids follow the order of filesystem paths, while event ids
+   * follow the lexicographic order of the event names.
+   */
+  void Seal();
+
+  /** Gets the number of the stored accesses. */
+  size_t Size() const {
+    return path_ids.size();
+  }
+
+  /** Gets the number of distinct paths. */
+  size_t NumPaths() const {
+    return paths.size();
+  }
+
+  /** Gets the number of distinct events. */
+  size_t NumEvents() const {
+    return events.size();
+  }
+
+  /** Gets the id of the path accessed by the i-th access. */
+  id_t GetPathId(size_t i) const {
+    return path_ids[i];
+  }
+
+  /** Gets the id of the event performing the i-th access. */
+  id_t GetEventId(size_t i) const {
+    return event_ids[i];
+  }
+
+  /** Gets the effect of the i-th access. */
+  enum Hpath::EffectType GetEffect(size_t i) const {
+    return (enum Hpath::EffectType) (
+        (effects[i >> 2] >> ((i & 3) << 1)) & 3);
+  }
+
+  /** Gets the id of the operation name of the i-th access. */
+  id_t GetOpNameId(size_t i) const {
+    return op_name_ids[i];
+  }
+
+  /**
+   * Gets the range [begin, end) of the accesses corresponding to
+   * the given path id.
+   */
+  pair<size_t, size_t> GetPathRange(id_t path_id) const {
+    return { path_offsets[path_id], path_offsets[path_id + 1] };
+  }
+
+  /**
+   * Gets the index of the access that the given event performs on
+   * the given path (if any).
+   */
+  optional<size_t> FindAccess(id_t path_id, id_t event_id) const;
+
+  /**
+   * Finds the events that take part in at least one pair of conflicting
+   * accesses, i.e., the events that access a path which is also accessed
+   * by another event, given that at least one of the two accesses
+   * produces or expunges the path.
+   *
+   * The i-th element of the result is non-zero if the i-th event is
+   * such a candidate.
+   */
+  vector<uint8_t> GetConflictCandidates() const;
+
+  /** Gets the path that corresponds to the given id. */
+  const string &GetPath(id_t path_id) const {
+    return paths[path_id];
+  }
+
+  /** Gets the name of the event that corresponds to the given id. */
+  const string &GetEvent(id_t event_id) const {
+    return events[event_id];
+  }
+
+  /** Gets the operation name that corresponds to the given id. */
+  const string &GetOpName(id_t op_name_id) const {
+    return op_names[op_name_id];
+  }
+
+  /** Gets the id of the given event (if it has accessed any path). */
+  optional<id_t> FindEvent(const string &event_id) const {
+    auto it = event_index.find(event_id);
+    if (it == event_index.end()) {
+      return {};
+    }
+    return it->second;
+  }
+
+  /** Gets the debug information of the given event. */
+  const DebugInfo &GetEventDebugInfo(id_t event_id) const {
+    return event_debug_info[event_id];
+  }
+
+private:
+  /// The id of the path accessed by every access.
+  vector<id_t> path_ids;
+  /// The id of the event performing every access.
+  vector<id_t> event_ids;
+  /// The effects of accesses; every byte holds four effects.
+  vector<uint8_t> effects;
+  /// The id of the operation name of every access.
+  vector<id_t> op_name_ids;
+  /// The i-th path owns the accesses in
+  /// [path_offsets[i], path_offsets[i + 1]).
+  vector<size_t> path_offsets;
+
+  /// Dictionaries mapping ids to the interned values.
+  vector<string> paths;
+  vector<string> events;
+  vector<string> op_names;
+  /// Debug information of every event.
+  vector<DebugInfo> event_debug_info;
+
+  /// Reverse dictionaries mapping the interned values to their ids.
+  unordered_map<string, id_t> path_index;
+  unordered_map<string, id_t> event_index;
+  unordered_map<string, id_t> op_name_index;
+
+  /** Interns a value into the given dictionary and returns its id. */
+  static id_t Intern(const string &value, vector<string> &values,
+                     unordered_map<string, id_t> &index);
+
+  /** Stores the effect of the i-th access. */
+  void SetEffect(size_t i, enum Hpath::EffectType effect);
+};
+
+
+} // namespace analyzer
+
+#endif
@@ -16,45 +16,113 @@ void FSAnalyzer::Analyze(const TraceNode *trace_node) {
   if (trace_node) {
     analysis_time.Start();
     trace_node->Accept(this);
-    for (const auto &elem : block_accesses) {
-      auto p = elem.first.first;
-      auto fs_access = elem.second;
-
-      optional<vector<FSAccess>> fs_accesses = effect_table.GetValue(p);
-      vector<FSAccess> v_fs_acc;
-      if (fs_accesses.has_value()) {
-        v_fs_acc = fs_accesses.value();
-        v_fs_acc.push_back(fs_access);
-      } else {
-        v_fs_acc.push_back(fs_access);
-      }
-      effect_table.AddEntry(p, v_fs_acc);
-    }
+    Seal();
     analysis_time.Stop();
   }
 }
 
 
+void FSAnalyzer::Seal() {
+  access_store.Clear();
+  for (const auto &elem : block_accesses) {
+    const FSAccess &fs_access = elem.second;
+    access_store.AddAccess(elem.first.first.native(), fs_access.event_id,
+                           fs_access.effect_type, fs_access.operation_name,
+                           fs_access.debug_info);
+  }
+  access_store.Seal();
+}
+
+
+void FSAnalyzer::Collect(const set<string> &events) {
+  unordered_map<string, vector<pair<fs::path, FSAccess>>> accesses;
+  vector<pair<fs::path, string>> collected;
+  for (const auto &elem : block_accesses) {
+    if (events.find(elem.first.second) != events.end()) {
+      accesses[elem.first.second].push_back({ elem.first.first,
+                                              elem.second });
+      collected.push_back(elem.first);
+    }
+  }
+  for (const auto &key : collected) {
+    block_accesses.RemoveEntry(key);
+  }
+  for (auto &entry : accesses) {
+    if (collected_accesses.find(entry.first) == collected_accesses.end()) {
+      collection_order.push_back(entry.first);
+    }
+    // If the event was restored, its current accesses already include
+    // those before its previous collection.
+    collected_accesses[entry.first] = move(entry.second);
+  }
+  // We forget the events that were collected first.
+  while (!keep_collected && collection_order.size() > MAX_COLLECTED_EVENTS) {
+    collected_accesses.erase(collection_order.front());
+    collection_order.pop_front();
+  }
+  for (const auto &event_id : events) {
+    event_info.RemoveEntry(event_id);
+  }
+  access_store.Clear();
+  TrimInodes();
+}
+
+
+void FSAnalyzer::TrimInodes() {
+  // The inodes that the analysis refers to, i.e., working directories,
+  // symbolic links, and resources of file descriptors.
+  set<inode_t> pinned;
+  for (const auto &elem : cwd_table) {
+    pinned.insert(elem.second);
+  }
+  for (const auto &elem : symlink_table) {
+    pinned.insert(elem.first);
+  }
+  for (const auto &elem : fd_table) {
+    pinned.insert(elem.second.first);
+    optional<inode_t> inode = inode_table.GetInode(elem.second.first,
+                                                   elem.second.second);
+    if (inode.has_value()) {
+      pinned.insert(inode.value());
+    }
+  }
+  inode_table.Trim(pinned);
+}
+
+
 void FSAnalyzer::AnalyzeTrace(const Trace *trace) {
   if (!trace) {
     return;
   }
 
+  Initialize(trace);
+
+  vector<const Block*> blocks = trace->GetBlocks();
+  for (auto const &block : blocks) {
+    AnalyzeBlock(block);
+  }
+  
+}
+
+
+void FSAnalyzer::Initialize(const Trace *trace) {
+  if (!trace) {
+    return;
+  }
+
   main_process = trace->GetThreadId();
+  current_process = main_process;
   cwd = trace->GetCwd();
 
   cwd_table.AddEntry(main_process, inode_table.ToInode(cwd));
+  for (auto const &process : trace->GetProcesses()) {
+    cwd_table.AddEntry(process.pid, inode_table.ToInode(process.cwd));
+  }
 
   vector<const ExecOp*> exec_ops = trace->GetExecOps();
   for (auto const &exec_op : exec_ops) {
     AnalyzeExecOp(exec_op);
   }
-
-  vector<const Block*> blocks = trace->GetBlocks();
-  for (auto const &block : blocks) {
-    AnalyzeBlock(block);
-  }
-  
 }
 
 
@@ -71,6 +139,10 @@ void FSAnalyzer::AnalyzeBlock(const Block *block) {
     return;
   }
   current_block = block;
+  current_process = block->GetProcess().value_or(main_process);
+  if (!block->IsMain()) {
+    RestoreAccesses(block->GetPrettyBlockId());
+  }
   vector<const Expr*> exprs = block->GetExprs();
   for (auto const &expr : exprs) {
     AnalyzeExpr(expr);
@@ -89,7 +161,8 @@ void FSAnalyzer::AnalyzeNewEvent(const NewEventExpr *new_ev_expr) {
   if (!new_ev_expr) {
     return;
   }
-  event_info.AddEntry(to_string(new_ev_expr->GetEventId()), new_ev_expr);
+  event_info.AddEntry(to_string(new_ev_expr->GetEventId()),
+                      new_ev_expr->GetDebugInfo());
 }
 
 
@@ -115,7 +188,8 @@ void FSAnalyzer::AnalyzeSubmitOp(const SubmitOp *submit_op) {
   for (auto const &op : ops) {
     AnalyzeOperation(op);
   }
-
+  // Every operation is submitted once.
+  op_table.RemoveEntry(op_id);
 
 }
 
@@ -151,7 +225,8 @@ void FSAnalyzer::AnalyzeNewFd(const NewFd *new_fd) {
   inode_table.AddEntry(inode_p, basename, abs_path.value());
   // Mark the inode as open.
   inode_table.OpenInode(inode_p, basename);
-  fd_table.AddEntry({ main_process, new_fd->GetFd() }, { inode_p, basename });
+  fd_table.AddEntry({ GetFdOwner(current_process), new_fd->GetFd() },
+                    { inode_p, basename });
 }
 
 
@@ -160,7 +235,7 @@ void FSAnalyzer::AnalyzeDelFd(const DelFd *del_fd) {
     return;
   }
   optional<inode_key_t> key = fd_table.PopEntry(
-      { main_process, del_fd->GetFd() });
+      { GetFdOwner(current_process), del_fd->GetFd() });
   if (key.has_value()) {
     // It's time to close the inode.
     inode_table.CloseInode(key.value().first, key.value().second);
@@ -276,8 +351,9 @@ void FSAnalyzer::ProcessPathEffect(fs::path p,
   if (utils::StartsWith(block_id, "MAIN_")) {
     debug_info.AddDebugInfo("main");
   } else {
-    auto expr = event_info.GetValue(block_id);
-    debug_info = expr.value()->GetDebugInfo();
+    // The event may have been collected, or created before the trace
+    // starts, so its debug information is not available.
+    debug_info = event_info.GetValue(block_id).value_or(DebugInfo());
   }
   switch (effect) {
     case Hpath::CONSUMED:
@@ -295,6 +371,53 @@ void FSAnalyzer::ProcessPathEffect(fs::path p,
 }
 
 
+void FSAnalyzer::AnalyzeNewProc(const NewProc *new_proc) {
+  if (!new_proc || new_proc->isFailed()) {
+    return;
+  }
+  proc_t process = new_proc->GetPID();
+  proc_t cwd_owner = GetCwdOwner(current_process);
+  switch (new_proc->GetCloneMode()) {
+    case NewProc::SHARE_FS:
+    case NewProc::SHARE_BOTH:
+      // Both processes have the same working directory, so a change
+      // made by either of them is seen by the other.
+      cwd_owners.AddEntry(process, cwd_owner);
+      break;
+    default: {
+      // The new process starts from a copy of the working directory
+      // of its parent.
+      optional<inode_t> cwd_inode = cwd_table.GetValue(cwd_owner);
+      if (cwd_inode.has_value()) {
+        cwd_table.AddEntry(process, cwd_inode.value());
+      }
+    }
+  }
+  proc_t owner = GetFdOwner(current_process);
+  switch (new_proc->GetCloneMode()) {
+    case NewProc::SHARE_FD:
+    case NewProc::SHARE_BOTH:
+      // Both processes operate on the same file descriptor table.
+      fd_owners.AddEntry(process, owner);
+      break;
+    default: {
+      // The new process gets a copy of the file descriptors of its
+      // parent, so every inode gets one more open handler.
+      vector<pair<fd_t, inode_key_t>> fds;
+      for (auto const &entry : fd_table) {
+        if (entry.first.first == owner) {
+          fds.push_back({ entry.first.second, entry.second });
+        }
+      }
+      for (auto const &fd : fds) {
+        fd_table.AddEntry({ process, fd.first }, fd.second);
+        inode_table.OpenInode(fd.second.first, fd.second.second);
+      }
+    }
+  }
+}
+
+
 optional<fs::path> FSAnalyzer::GetParentDir(size_t dirfd) const {
   optional<fs::path> cwd;
   optional<inode_t> inode;
@@ -303,12 +426,13 @@ optional<fs::path> FSAnalyzer::GetParentDir(size_t dirfd) const {
       // The dir file descriptor is the `AT_FDCWD` flag.
       // So we get the inode corresponding to the current
       // working directory of the process.
-      inode = cwd_table.GetValue(main_process);
+      inode = cwd_table.GetValue(GetCwdOwner(current_process));
       break;
     default:
       // Otherwise, we inspect the file descriptor table to
       // get the inode corresponding to the given file descriptor.
-      optional<inode_key_t> key = fd_table.GetValue({ main_process, dirfd });
+      optional<inode_key_t> key = fd_table.GetValue(
+          { GetFdOwner(current_process), dirfd });
       if (key.has_value()) {
         inode = inode_table.GetInode(key.value().first,
                                      key.value().second);
@@ -353,36 +477,56 @@ void FSAnalyzer::DumpOutput(writer::OutWriter *out) const {
   if (!out) {
     return;
   }
+  const FSAccessStore *store = &access_store;
+  FSAccessStore all_accesses;
+  if (keep_collected && !collected_accesses.empty()) {
+    // We also report the accesses of collected events.
+    Table<pair<fs::path, string>, FSAccess> accesses = block_accesses;
+    for (const auto &entry : collected_accesses) {
+      for (const auto &access : entry.second) {
+        accesses.AddEntry({ access.first, entry.first }, access.second);
+      }
+    }
+    for (const auto &elem : accesses) {
+      const FSAccess &fs_access = elem.second;
+      all_accesses.AddAccess(elem.first.first.native(), fs_access.event_id,
+                             fs_access.effect_type, fs_access.operation_name,
+                             fs_access.debug_info);
+    }
+    all_accesses.Seal();
+    store = &all_accesses;
+  }
   switch (out_format) {
     case JSON:
-      DumpJSON(out->OutStream());
+      DumpJSON(*store, out->OutStream());
       break;
     case CSV:
-      DumpCSV(out->OutStream());
+      DumpCSV(*store, out->OutStream());
       break;
   }
   delete out;
 }
 
 
-void FSAnalyzer::DumpJSON(ostream &os) const {
+void FSAnalyzer::DumpJSON(const FSAccessStore &store, ostream &os) const {
   os << "{" << endl;
-  for (auto map_it = effect_table.begin(); map_it != effect_table.end(); map_it++) {
-    auto entry = *map_it;
-    os << "  \"" << entry.first.native() << "\": [" << endl;
-    for (auto it = entry.second.begin(); it != entry.second.end(); it++) {
+  for (size_t p = 0; p < store.NumPaths(); p++) {
+    auto range = store.GetPathRange(p);
+    os << "  \"" << store.GetPath(p) << "\": [" << endl;
+    for (size_t i = range.first; i < range.second; i++) {
       os << "    {" << endl;
-      os << "      \"block\": " << "\"" << (*it).event_id
+      os << "      \"block\": " << "\""
+        << store.GetEvent(store.GetEventId(i))
         << "\"," << endl;
       os << "      \"effect\": " << "\""
-        << Hpath::EffToString((*it).effect_type) << "\"" << endl;
-      if (it != entry.second.end() - 1) {
+        << Hpath::EffToString(store.GetEffect(i)) << "\"" << endl;
+      if (i != range.second - 1) {
         os << "    }," << endl;
       } else {
         os << "    }" << endl;
       }
     }
-    if (map_it != --effect_table.end()) {
+    if (p != store.NumPaths() - 1) {
       os << "  ]," << endl;
     } else {
       os << "  ]" << endl;
@@ -392,14 +536,26 @@ void FSAnalyzer::DumpJSON(ostream &os) const {
 }
 
 
-void FSAnalyzer::DumpCSV(ostream &os) const {
-  for (auto const &entry : effect_table) {
-    for (auto const &fs_access : entry.second) {
-      os << entry.first.native() << ","
-        << fs_access.event_id << ","
-        << Hpath::EffToString(fs_access.effect_type) << "\n";
-    }
+void FSAnalyzer::DumpCSV(const FSAccessStore &store, ostream &os) const {
+  for (size_t i = 0; i < store.Size(); i++) {
+    os << store.GetPath(store.GetPathId(i)) << ","
+      << store.GetEvent(store.GetEventId(i)) << ","
+      << Hpath::EffToString(store.GetEffect(i)) << "\n";
+  }
+}
+
+
+void FSAnalyzer::RestoreAccesses(const string &event_id) {
+  auto it = collected_accesses.find(event_id);
+  if (it == collected_accesses.end()) {
+    return;
+  }
+  for (const auto &access : it->second) {
+    block_accesses.AddEntry({ access.first, event_id }, access.second);
   }
+  // We keep the event in the collected ones, so that its accesses are
+  // not restored twice.
+  it->second.clear();
 }
 
 
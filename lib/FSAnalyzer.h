@@ -1,13 +1,16 @@
 #ifndef FS_ANALYZER_H
 #define FS_ANALYZER_H
 
+#include <deque>
 #include <experimental/filesystem>
 #include <iostream>
+#include <set>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "Analyzer.h"
+#include "FSAccessStore.h"
 #include "InodeTable.h"
 #include "Operation.h"
 #include "Table.h"
@@ -54,11 +57,11 @@ class FSAnalyzer : public Analyzer {
         operation_name(operation_name_) {  }
     };
 
-    using fs_accesses_table_t = Table<fs::path, vector<FSAccess>>;
-
     FSAnalyzer(enum OutFormat out_format_):
+      keep_collected(false),
       current_block(nullptr),
       main_process(0),
+      current_process(0),
       out_format(out_format_)
   {  }
 
@@ -68,6 +71,11 @@ class FSAnalyzer : public Analyzer {
 
     void Analyze(const TraceNode *trace_node);
     void AnalyzeTrace(const Trace *trace);
+    /**
+     * Sets up the process and the operations of the given trace,
+     * without analyzing its blocks.
+     */
+    void Initialize(const Trace *trace);
     void AnalyzeBlock(const Block *block);
     void AnalyzeExpr(const Expr *expr);
     void AnalyzeSubmitOp(const SubmitOp *submit_op);
@@ -84,28 +92,78 @@ class FSAnalyzer : public Analyzer {
     void AnalyzeLink(const Link *link);
     void AnalyzeRename(const Rename *rename);
     void AnalyzeSymlink(const Symlink *symlink);
+    void AnalyzeNewProc(const NewProc *new_proc);
+    void AnalyzeWaitProc(const WaitProc *wait_proc) {  }
 
     void DumpOutput(writer::OutWriter *out) const;
 
-    const fs_accesses_table_t &GetFSAccesses() const {
-      return effect_table;
+    const FSAccessStore &GetFSAccesses() const {
+      return access_store;
+    }
+
+    /** Builds the store of file accesses from the analyzed blocks. */
+    void Seal();
+
+    /**
+     * Drops the accesses of the given events, along with the entries
+     * of the inode table that the analysis no longer refers to.
+     *
+     * The accesses of the last `MAX_COLLECTED_EVENTS` collected events
+     * are remembered, and they are restored if an event is executed
+     * again (e.g., a W event). The accesses of all collected events
+     * are remembered (and dumped), if they are kept.
+     *
+     * This must be called only when the given events happen before
+     * all the remaining events and the events that follow.
+     */
+    void Collect(const set<string> &events);
+
+    /**
+     * Keeps the accesses of all collected events, so that the output
+     * of the analysis is the same as without collecting events.
+     */
+    void KeepCollectedAccesses() {
+      keep_collected = true;
     }
 
+    /// The maximum number of collected events whose accesses are
+    /// remembered (unless all of them are kept).
+    static constexpr size_t MAX_COLLECTED_EVENTS = 1 << 16;
+
   private:
     Table<proc_t, inode_t> cwd_table;
     Table<pair<proc_t, fd_t>, inode_key_t> fd_table;
+    /// The processes that share the file descriptor table of another
+    /// process (i.e., they are created with `CLONE_FILES`).
+    Table<proc_t, proc_t> fd_owners;
+    /// The processes that share the working directory of another
+    /// process (i.e., they are created with `CLONE_FS`).
+    Table<proc_t, proc_t> cwd_owners;
     Table<inode_t, fs::path> symlink_table;
     Table<proc_t, pair<addr_t, addr_t>> proc_table;
     InodeTable inode_table;
 
-    fs_accesses_table_t effect_table;
+    FSAccessStore access_store;
     Table<pair<fs::path, string>, FSAccess> block_accesses;
+    /// The accesses performed by every remembered collected event.
+    /// The accesses of a restored event are moved back to
+    /// `block_accesses`.
+    unordered_map<string, vector<pair<fs::path, FSAccess>>>
+      collected_accesses;
+    /// The remembered collected events in the order of their collection.
+    deque<string> collection_order;
+    /// Indicates whether the accesses of all collected events are kept.
+    bool keep_collected;
 
     Table<string, const ExecOp*> op_table;
-    Table<string, const NewEventExpr*> event_info;
+    /// The debug information of every event. It is copied, so that
+    /// the blocks that create the events can be deallocated.
+    Table<string, DebugInfo> event_info;
 
     const Block *current_block;
     size_t main_process;
+    /// The process that executes the current block.
+    size_t current_process;
     fs::path cwd;
     string block_id;
 
@@ -116,10 +174,35 @@ class FSAnalyzer : public Analyzer {
     optional<fs::path> GetParentDir(size_t dirfd) const;
     optional<fs::path> GetAbsolutePath(size_t dirfd, fs::path p) const;
     void UnlinkResource(inode_t inode_p, string basename);
+    /**
+     * Drops the entries of the inode table that can be recreated from
+     * their paths, i.e., those that are not referred to by working
+     * directories, symbolic links, or file descriptors.
+     */
+    void TrimInodes();
+    /**
+     * Gets the process whose file descriptor table is used by
+     * the given process.
+     */
+    proc_t GetFdOwner(proc_t process) const {
+      return fd_owners.GetValue(process).value_or(process);
+    }
+    /**
+     * Gets the process whose working directory is used by the given
+     * process.
+     */
+    proc_t GetCwdOwner(proc_t process) const {
+      return cwd_owners.GetValue(process).value_or(process);
+    }
 
-    void DumpJSON(ostream &os) const;
-    void DumpCSV(ostream &os) const;
+    void DumpJSON(const FSAccessStore &store, ostream &os) const;
+    void DumpCSV(const FSAccessStore &store, ostream &os) const;
     void AddPathEffect(const fs::path &p, FSAccess fs_access);
+    /**
+     * Moves the accesses that the given event performed before its
+     * collection back to the accesses of blocks.
+     */
+    void RestoreAccesses(const string &event_id);
 };
 
 
@@ -2,13 +2,22 @@
 #define GRAPH_H
 
 #include "assert.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
 #include <optional>
 #include <ostream>
 #include <set>
 #include <stack>
 #include <string>
 #include <unordered_map>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 
 using namespace std;
@@ -135,12 +144,49 @@ enum GraphFormat {
 };
 
 
+/**
+ * A read-only view of a node that is used for printing.
+ *
+ * It exposes the same members as `Node` that are used for printing,
+ * and it is built from both representations of a graph, so that
+ * graph printers do not depend on whether the graph is frozen.
+ */
+template<typename T>
+struct FrozenNode {
+  /// The ID of the node.
+  const string &node_id;
+  /// Type information of the node.
+  const T &node_obj;
+  /// The bitmask of node attributes.
+  uint64_t attr_mask;
+  /// The registry of attribute names; the i-th name corresponds
+  /// to the i-th bit of the mask.
+  const vector<string> &attr_names;
+
+  /** Checks whether this node has the given attribute. */
+  bool HasAttribute(const string &attr) const {
+    for (size_t i = 0; i < attr_names.size(); i++) {
+      if (attr_names[i] == attr) {
+        return (attr_mask >> i) & 1;
+      }
+    }
+    return false;
+  }
+};
+
+
 /**
  * Template class used to represent a graph.
  *
  * This template is parameterized with the type `T` used to
  * describe a node, and the type L that represents the edge
  * labels of the graph.
+ *
+ * Once a graph is built, it can be frozen. A frozen graph is stored in
+ * an immutable compressed sparse row (CSR) layout, where the edges of
+ * every node are stored contiguously, and the attributes of every node
+ * are represented by a bitmask. Calling a mutating method on a frozen
+ * graph aborts the program.
  */
 template<typename T, typename L>
 class Graph {
@@ -152,9 +198,12 @@ class Graph {
     using NodeInfo = Node<T, L>;
     /// Representation of the underlying graph.
     using graph_t = unordered_map<string, NodeInfo>;
+    /// A view of a node of a frozen graph.
+    using FrozenNodeInfo = FrozenNode<T>;
 
     /** Adds a new node to the graph. */
     void AddNode(string node_id, T node_obj) {
+      CheckNotFrozen("AddNode");
       NodeInfo node_info = NodeInfo(node_id, node_obj);
       graph.emplace(node_id, node_info);
 
@@ -162,6 +211,7 @@ class Graph {
 
     /** Adds a new attribute to the given node. */
     void AddNodeAttr(string node_id, string attr) {
+      CheckNotFrozen("AddNodeAttr");
       typename graph_t::iterator it = graph.find(node_id);
       if (it != graph.end()) {
         it->second.AddAttribute(attr);
@@ -170,7 +220,12 @@ class Graph {
 
     /** Checks whether the given node has the given attribute. */
     bool HasNodeAttr(string node_id, const string &attr) const {
-      typename graph_t::iterator it = graph.find(node_id);
+      if (frozen) {
+        optional<size_t> index = GetNodeIndex(node_id);
+        return index.has_value() &&
+          GetFrozenNode(index.value()).HasAttribute(attr);
+      }
+      typename graph_t::const_iterator it = graph.find(node_id);
       if (it != graph.end()) {
         return it->second.HasAttribute(attr);
       }
@@ -179,15 +234,66 @@ class Graph {
 
     /** Remove the specified attribute from the given node. */
     void RemoveNodeAttr(string node_id, const string &attr) {
+      CheckNotFrozen("RemoveNodeAttr");
       typename graph_t::iterator it = graph.find(node_id);
       if (it != graph.end()) {
         it->second.RemoveAttribute(attr);
       }
     }
 
-    /** Gets the information associated with the given node. */
+    /** Checks whether the given node is part of the graph. */
+    bool HasNode(const string &node_id) const {
+      if (frozen) {
+        return node_index.find(node_id) != node_index.end();
+      }
+      return graph.find(node_id) != graph.end();
+    }
+
+    /** Gets the object associated with the given node. */
+    optional<T> GetNodeObj(const string &node_id) const {
+      if (frozen) {
+        optional<size_t> index = GetNodeIndex(node_id);
+        if (!index.has_value()) {
+          return {};
+        }
+        return node_objs[index.value()];
+      }
+      typename graph_t::const_iterator it = graph.find(node_id);
+      if (it == graph.end()) {
+        return {};
+      }
+      return it->second.node_obj;
+    }
+
+    /**
+     * Gets the information associated with the given node.
+     *
+     * For frozen graphs, this information is reconstructed from
+     * the compact representation, so prefer more specific queries.
+     */
     optional<NodeInfo> GetNodeInfo(string node_id) const {
       optional<NodeInfo> node_info;
+      if (frozen) {
+        optional<size_t> index = GetNodeIndex(node_id);
+        if (!index.has_value()) {
+          return node_info;
+        }
+        size_t i = index.value();
+        NodeInfo info(node_ids[i], node_objs[i]);
+        for (size_t e = offsets[i]; e < offsets[i + 1]; e++) {
+          info.dependents.insert({ node_ids[targets[e]], labels[e] });
+          info.before.insert(node_ids[targets[e]]);
+        }
+        for (size_t e = pred_offsets[i]; e < pred_offsets[i + 1]; e++) {
+          info.after.insert(node_ids[preds[e]]);
+        }
+        for (size_t a = 0; a < attr_names.size(); a++) {
+          if ((attr_masks[i] >> a) & 1) {
+            info.AddAttribute(attr_names[a]);
+          }
+        }
+        return info;
+      }
       typename graph_t::const_iterator it = graph.find(node_id);
       if (it != graph.end()) {
         return it->second;
@@ -202,6 +308,7 @@ class Graph {
      * a label.
      */
     void AddEdge(string source, string target, L label) {
+      CheckNotFrozen("AddEdge");
       if (source == target) {
         return;
       }
@@ -219,10 +326,328 @@ class Graph {
 
     /** Remove an edge from the graph. */
     void RemoveEdge(string source, string target, L label) {
+      CheckNotFrozen("RemoveEdge");
       typename graph_t::iterator it = graph.find(source);
-      if (it != graph.end()) {
-        it->second.dependents.erase({ target, label });
+      if (it == graph.end() || !it->second.dependents.erase({ target, label })) {
+        return;
+      }
+      for (auto const &dependent : it->second.dependents) {
+        if (dependent.first == target) {
+          // There is still an edge with a different label.
+          return;
+        }
+      }
+      it->second.before.erase(target);
+      typename graph_t::iterator target_it = graph.find(target);
+      if (target_it != graph.end()) {
+        target_it->second.after.erase(source);
+      }
+    }
+
+    /**
+     * Removes the edges that are implied by other paths of the graph
+     * (transitive reduction), and returns the number of removed edges.
+     *
+     * An edge u -> v is removed if its label is accepted by `removable`,
+     * and v is also reachable through another successor of u. All
+     * the intermediate nodes of that path must be accepted by `through`.
+     * Therefore, the reduction preserves reachability both in the whole
+     * graph and among the nodes accepted by `through`.
+     *
+     * Cycles are handled by computing the strongly connected components
+     * of the accepted nodes. The edges between components are reduced
+     * as in a DAG: the set of nodes that every component reaches is
+     * stored as a bitset, which is computed once all the successor
+     * components are complete. The edges inside every component are
+     * pruned one by one.
+     */
+    size_t TransitiveReduction(const function<bool(const L&)> &removable,
+                               const function<bool(const string&)> &through) {
+      CheckNotFrozen("TransitiveReduction");
+      size_t n = graph.size();
+      vector<const NodeInfo*> nodes;
+      unordered_map<string, size_t> index;
+      nodes.reserve(n);
+      for (auto const &entry : graph) {
+        index[entry.first] = nodes.size();
+        nodes.push_back(&entry.second);
+      }
+      vector<uint8_t> accepted(n);
+      vector<vector<size_t>> succs(n);
+      for (size_t i = 0; i < n; i++) {
+        accepted[i] = through(nodes[i]->node_id);
+        for (auto const &dependent : nodes[i]->dependents) {
+          auto it = index.find(dependent.first);
+          if (it != index.end() && it->second != i) {
+            succs[i].push_back(it->second);
+          }
+        }
+        sort(succs[i].begin(), succs[i].end());
+        succs[i].erase(unique(succs[i].begin(), succs[i].end()),
+                       succs[i].end());
+      }
+
+      // We find the components of the accepted nodes with Tarjan's
+      // algorithm, which completes every component after all
+      // the components reachable from it.
+      const size_t none = SIZE_MAX;
+      size_t words = (n + 63) / 64;
+      vector<size_t> order(n, none), lowlink(n, 0), components(n, none);
+      vector<uint8_t> on_stack(n, 0);
+      vector<size_t> scc_stack;
+      vector<vector<uint64_t>> reach;
+      size_t next_index = 0;
+      for (size_t root = 0; root < n; root++) {
+        if (!accepted[root] || order[root] != none) {
+          continue;
+        }
+        // Each frame is a node and the position of its next successor.
+        vector<pair<size_t, size_t>> frames = { { root, 0 } };
+        order[root] = lowlink[root] = next_index++;
+        scc_stack.push_back(root);
+        on_stack[root] = 1;
+        while (!frames.empty()) {
+          size_t node = frames.back().first;
+          size_t &pos = frames.back().second;
+          if (pos < succs[node].size()) {
+            size_t succ = succs[node][pos++];
+            if (!accepted[succ]) {
+              continue;
+            }
+            if (order[succ] == none) {
+              order[succ] = lowlink[succ] = next_index++;
+              scc_stack.push_back(succ);
+              on_stack[succ] = 1;
+              frames.push_back({ succ, 0 });
+            } else if (on_stack[succ]) {
+              lowlink[node] = min(lowlink[node], order[succ]);
+            }
+            continue;
+          }
+          frames.pop_back();
+          if (!frames.empty()) {
+            size_t parent = frames.back().first;
+            lowlink[parent] = min(lowlink[parent], lowlink[node]);
+          }
+          if (lowlink[node] != order[node]) {
+            continue;
+          }
+          // The node is the root of a component, so we pop its members.
+          size_t comp = reach.size();
+          reach.emplace_back(words, 0);
+          vector<uint64_t> &row = reach.back();
+          vector<size_t> members;
+          size_t member;
+          do {
+            member = scc_stack.back();
+            scc_stack.pop_back();
+            on_stack[member] = 0;
+            components[member] = comp;
+            members.push_back(member);
+            row[member >> 6] |= (uint64_t) 1 << (member & 63);
+          } while (member != node);
+          for (auto const &m : members) {
+            for (auto const &succ : succs[m]) {
+              row[succ >> 6] |= (uint64_t) 1 << (succ & 63);
+              if (!accepted[succ] || components[succ] == comp) {
+                continue;
+              }
+              const vector<uint64_t> &succ_row = reach[components[succ]];
+              for (size_t w = 0; w < words; w++) {
+                row[w] |= succ_row[w];
+              }
+            }
+          }
+        }
+      }
+
+      // Nodes that are not accepted form components on their own.
+      for (size_t i = 0; i < n; i++) {
+        if (components[i] == none) {
+          components[i] = reach.size() + i;
+        }
+      }
+      auto get_row = [&](size_t comp) -> const vector<uint64_t>* {
+        return comp < reach.size() ? &reach[comp] : nullptr;
+      };
+      // The successor components of every component.
+      unordered_map<size_t, set<size_t>> comp_succs;
+      for (size_t i = 0; i < n; i++) {
+        for (auto const &succ : succs[i]) {
+          if (components[succ] != components[i]) {
+            comp_succs[components[i]].insert(components[succ]);
+          }
+        }
+      }
+
+      // The edges from component A to component B are redundant if B is
+      // reachable from another successor component of A, because
+      // components form a DAG. Otherwise, only one edge from A to B is
+      // needed, since every node of a component reaches all its members.
+      // We keep a non-removable edge if one exists, and the smallest
+      // edge otherwise.
+      map<pair<size_t, size_t>, tuple<bool, string, string, L>> kept;
+      vector<tuple<string, string, L>> redundant;
+      // The edges inside components, which are examined afterwards.
+      vector<tuple<string, string, L>> inner;
+      for (size_t i = 0; i < n; i++) {
+        for (auto const &dependent : nodes[i]->dependents) {
+          auto it = index.find(dependent.first);
+          if (it == index.end()) {
+            continue;
+          }
+          size_t source_comp = components[i];
+          size_t target = it->second;
+          size_t target_comp = components[target];
+          tuple<string, string, L> edge = { nodes[i]->node_id,
+                                            dependent.first,
+                                            dependent.second };
+          if (source_comp == target_comp) {
+            inner.push_back(edge);
+            continue;
+          }
+          bool is_removable = removable(dependent.second);
+          if (is_removable) {
+            bool implied = false;
+            for (auto const &succ_comp : comp_succs[source_comp]) {
+              const vector<uint64_t> *row = get_row(succ_comp);
+              if (succ_comp != target_comp && row &&
+                  ((*row)[target >> 6] >> (target & 63)) & 1) {
+                implied = true;
+                break;
+              }
+            }
+            if (implied) {
+              redundant.push_back(edge);
+              continue;
+            }
+          }
+          auto candidate = tuple_cat(make_tuple(is_removable), edge);
+          auto kept_it = kept.find({ source_comp, target_comp });
+          if (kept_it == kept.end()) {
+            kept[{ source_comp, target_comp }] = candidate;
+            continue;
+          }
+          // Keep the smaller edge; non-removable edges come first.
+          if (candidate < kept_it->second) {
+            swap(candidate, kept_it->second);
+          }
+          if (get<0>(candidate)) {
+            redundant.push_back({ get<1>(candidate), get<2>(candidate),
+                                  get<3>(candidate) });
+          }
+        }
+      }
+
+      // Inside a component, edges are examined one by one: a removable
+      // edge is dropped if its target is still reachable from its source
+      // through the remaining edges of the component. Components are
+      // typically small, so we simply search them.
+      sort(inner.begin(), inner.end());
+      map<pair<size_t, size_t>, size_t> inner_edges;
+      unordered_map<size_t, vector<size_t>> inner_succs;
+      for (auto const &edge : inner) {
+        size_t source = index[get<0>(edge)], target = index[get<1>(edge)];
+        if (inner_edges[{ source, target }]++ == 0) {
+          inner_succs[source].push_back(target);
+        }
+      }
+      for (auto const &edge : inner) {
+        if (!removable(get<2>(edge))) {
+          continue;
+        }
+        size_t source = index[get<0>(edge)], target = index[get<1>(edge)];
+        size_t &count = inner_edges[{ source, target }];
+        count--;
+        bool reached = count > 0;
+        set<size_t> visited = { source };
+        stack<size_t> pool;
+        pool.push(source);
+        while (!reached && !pool.empty()) {
+          size_t node = pool.top();
+          pool.pop();
+          for (auto const &succ : inner_succs[node]) {
+            if (inner_edges[{ node, succ }] == 0 ||
+                !visited.insert(succ).second) {
+              continue;
+            }
+            if (succ == target) {
+              reached = true;
+              break;
+            }
+            pool.push(succ);
+          }
+        }
+        if (reached) {
+          redundant.push_back(edge);
+        } else {
+          count++;
+        }
+      }
+
+      for (auto const &edge : redundant) {
+        RemoveEdge(get<0>(edge), get<1>(edge), get<2>(edge));
       }
+      return redundant.size();
+    }
+
+    /**
+     * Compacts the graph into its immutable CSR representation.
+     *
+     * Note that edges pointing to nodes that are not part of the graph
+     * are dropped.
+     */
+    void Freeze() {
+      if (frozen) {
+        return;
+      }
+      size_t n = graph.size();
+      node_ids.reserve(n);
+      node_objs.reserve(n);
+      attr_masks.assign(n, 0);
+      for (auto const &entry : graph) {
+        node_index[entry.first] = node_ids.size();
+        node_ids.push_back(entry.first);
+        node_objs.push_back(entry.second.node_obj);
+      }
+      offsets.assign(n + 1, 0);
+      pred_offsets.assign(n + 1, 0);
+      size_t i = 0;
+      for (auto const &entry : graph) {
+        for (auto const &dependent : entry.second.dependents) {
+          auto target_it = node_index.find(dependent.first);
+          if (target_it == node_index.end()) {
+            continue;
+          }
+          targets.push_back(target_it->second);
+          labels.push_back(dependent.second);
+          pred_offsets[target_it->second + 1]++;
+        }
+        offsets[i + 1] = targets.size();
+        for (auto const &attr : entry.second.attributes) {
+          attr_masks[i] |= (uint64_t) 1 << RegisterAttr(attr_names, attr);
+        }
+        i++;
+      }
+      // Compute the reversed edges by counting the predecessors
+      // of every node.
+      for (size_t j = 0; j < n; j++) {
+        pred_offsets[j + 1] += pred_offsets[j];
+      }
+      preds.resize(targets.size());
+      vector<size_t> pos(pred_offsets.begin(), pred_offsets.end() - 1);
+      for (size_t j = 0; j < n; j++) {
+        for (size_t e = offsets[j]; e < offsets[j + 1]; e++) {
+          preds[pos[targets[e]]++] = j;
+        }
+      }
+      graph.clear();
+      frozen = true;
+    }
+
+    /** Checks whether the graph has been frozen. */
+    bool IsFrozen() const {
+      return frozen;
     }
 
     /**
@@ -230,12 +655,48 @@ class Graph {
      * and in the specified format.
      */
     void PrintGraph(enum GraphFormat graph_format, ostream &os) const {
+      // Printers operate on views of the nodes, and on a list of edges
+      // grouped by their source.
+      vector<FrozenNodeInfo> nodes;
+      vector<print_edge_t> edges;
+      // The registry of attributes of an unfrozen graph.
+      vector<string> names;
+      if (frozen) {
+        for (size_t i = 0; i < node_ids.size(); i++) {
+          nodes.push_back(GetFrozenNode(i));
+          for (size_t e = offsets[i]; e < offsets[i + 1]; e++) {
+            edges.emplace_back(i, targets[e], labels[e]);
+          }
+        }
+      } else {
+        // We print the adjacency map as is. Edges pointing to nodes that
+        // are not part of the graph are omitted, as in a frozen graph.
+        unordered_map<string, uint32_t> positions;
+        for (auto const &entry : graph) {
+          uint64_t attr_mask = 0;
+          for (auto const &attr : entry.second.attributes) {
+            attr_mask |= (uint64_t) 1 << RegisterAttr(names, attr);
+          }
+          positions[entry.first] = nodes.size();
+          nodes.push_back(FrozenNodeInfo { entry.first, entry.second.node_obj,
+                                           attr_mask, names });
+        }
+        for (auto const &entry : graph) {
+          uint32_t source = positions[entry.first];
+          for (auto const &dependent : entry.second.dependents) {
+            auto target_it = positions.find(dependent.first);
+            if (target_it != positions.end()) {
+              edges.emplace_back(source, target_it->second, dependent.second);
+            }
+          }
+        }
+      }
       switch (graph_format) {
         case DOT:
-          PrintDot(os);
+          PrintDot(os, nodes, edges);
           break;
         case CSV:
-          PrintCSV(os);
+          PrintCSV(os, nodes, edges);
       }
     }
 
@@ -252,6 +713,21 @@ class Graph {
      * Gets the set of nodes that are reachable from the given node.
      */
     set<string> DFS(string source) const {
+      return DFS(source, [](const string &) { return true; });
+    }
+
+    /**
+     * Gets the set of nodes that are reachable from the given node
+     * without going through the nodes rejected by `visit`.
+     *
+     * The rejected nodes are neither included in the result nor
+     * expanded. Note that the source node is always visited.
+     */
+    set<string> DFS(string source,
+                    const function<bool(const string&)> &visit) const {
+      if (frozen) {
+        return FrozenDFS(source, visit);
+      }
       set<string> visited;
       stack<string> pool;
       pool.push(source);
@@ -264,10 +740,16 @@ class Graph {
           continue;
         }
 
+        typename graph_t::const_iterator it = graph.find(node);
+        assert(it != graph.end());
+        if (it == graph.end()) {
+          continue;
+        }
+        const NodeInfo &node_info = it->second;
+        if (node != source && !visit(node)) {
+          continue;
+        }
         visited.insert(node);
-        optional<NodeInfo> node_info_opt = GetNodeInfo(node);
-        assert(node_info_opt.has_value());
-        NodeInfo node_info = node_info_opt.value();
         for (auto &n : node_info.dependents) {
           if (visited.find(n.first) == visited.end()) {
             // We have not visited this node, so we add it
@@ -281,11 +763,130 @@ class Graph {
     }
 
     size_t Empty() const {
-      return graph.empty(); 
+      return frozen ? node_ids.empty() : graph.empty(); 
+    }
+
+    /** Gets the number of nodes in the graph. */
+    size_t Size() const {
+      return frozen ? node_ids.size() : graph.size();
+    }
+
+    /**
+     * Removes all the nodes and edges of the graph.
+     *
+     * The graph can be modified again after clearing it, even if it
+     * has been frozen.
+     */
+    void Clear() {
+      graph.clear();
+      node_ids.clear();
+      node_objs.clear();
+      attr_masks.clear();
+      attr_names.clear();
+      node_index.clear();
+      offsets.clear();
+      targets.clear();
+      labels.clear();
+      pred_offsets.clear();
+      preds.clear();
+      frozen = false;
+    }
+
+    /**
+     * Iterators over the nodes of the graph.
+     *
+     * Note that they are only available before freezing the graph.
+     */
+    typename graph_t::const_iterator begin() const {
+      CheckNotFrozen("begin");
+      return graph.begin();
+    }
+
+    typename graph_t::const_iterator end() const {
+      CheckNotFrozen("end");
+      return graph.end();
+    }
+
+    /**
+     * Gets the set of nodes that reach at least one of the given nodes
+     * (including the given nodes that are part of the graph).
+     */
+    set<string> Ancestors(const set<string> &targets) const {
+      set<string> visited;
+      stack<string> pool;
+      for (auto const &target : targets) {
+        pool.push(target);
+      }
+      while (!pool.empty()) {
+        string node = pool.top();
+        pool.pop();
+        if (visited.find(node) != visited.end()) {
+          continue;
+        }
+        if (frozen) {
+          optional<size_t> index = GetNodeIndex(node);
+          if (!index.has_value()) {
+            continue;
+          }
+          visited.insert(node);
+          size_t i = index.value();
+          for (size_t e = pred_offsets[i]; e < pred_offsets[i + 1]; e++) {
+            pool.push(node_ids[preds[e]]);
+          }
+          continue;
+        }
+        typename graph_t::const_iterator it = graph.find(node);
+        if (it == graph.end()) {
+          continue;
+        }
+        visited.insert(node);
+        for (auto const &pred : it->second.after) {
+          if (visited.find(pred) == visited.end()) {
+            pool.push(pred);
+          }
+        }
+      }
+      return visited;
+    }
+
+    /** Removes the given node along with its incoming and outgoing edges. */
+    void RemoveNode(const string &node_id) {
+      CheckNotFrozen("RemoveNode");
+      typename graph_t::iterator it = graph.find(node_id);
+      if (it == graph.end()) {
+        return;
+      }
+      for (auto const &pred : it->second.after) {
+        typename graph_t::iterator pred_it = graph.find(pred);
+        if (pred_it == graph.end()) {
+          continue;
+        }
+        auto &dependents = pred_it->second.dependents;
+        for (auto dep_it = dependents.begin(); dep_it != dependents.end(); ) {
+          dep_it = dep_it->first == node_id ? dependents.erase(dep_it) :
+            next(dep_it);
+        }
+        pred_it->second.before.erase(node_id);
+      }
+      for (auto const &succ : it->second.before) {
+        typename graph_t::iterator succ_it = graph.find(succ);
+        if (succ_it != graph.end()) {
+          succ_it->second.after.erase(node_id);
+        }
+      }
+      graph.erase(it);
     }
 
     set<string> GetSinks() const {
       set<string> sinks;
+      if (frozen) {
+        for (size_t i = 0; i < node_ids.size(); i++) {
+          if (offsets[i] == offsets[i + 1]) {
+            sinks.insert(node_ids[i]);
+          }
+        }
+        return sinks;
+      }
       for (auto const &elem : graph) {
         if (elem.second.dependents.empty()) {
           sinks.insert(elem.first);
@@ -294,30 +895,176 @@ class Graph {
       return sinks;
     }
 
+    /**
+     * Gets the IDs of all nodes, and the positions of the successors
+     * of every node in that list. Both frozen and non-frozen graphs
+     * are supported.
+     *
+     * Edges pointing to nodes that are not part of the graph are dropped,
+     * and so are self-loops and duplicate edges.
+     */
+    void GetAdjacency(vector<string> &ids,
+                      vector<vector<uint32_t>> &succs) const {
+      ids.clear();
+      succs.clear();
+      if (frozen) {
+        ids = node_ids;
+        succs.resize(node_ids.size());
+        for (size_t i = 0; i < node_ids.size(); i++) {
+          for (size_t e = offsets[i]; e < offsets[i + 1]; e++) {
+            if (targets[e] != i) {
+              succs[i].push_back(targets[e]);
+            }
+          }
+        }
+      } else {
+        unordered_map<string, uint32_t> positions;
+        ids.reserve(graph.size());
+        for (auto const &entry : graph) {
+          positions[entry.first] = ids.size();
+          ids.push_back(entry.first);
+        }
+        succs.resize(ids.size());
+        for (auto const &entry : graph) {
+          uint32_t source = positions[entry.first];
+          for (auto const &dependent : entry.second.dependents) {
+            auto it = positions.find(dependent.first);
+            if (it != positions.end() && it->second != source) {
+              succs[source].push_back(it->second);
+            }
+          }
+        }
+      }
+      for (auto &node_succs : succs) {
+        sort(node_succs.begin(), node_succs.end());
+        node_succs.erase(unique(node_succs.begin(), node_succs.end()),
+                         node_succs.end());
+      }
+    }
+
   private:
     /// Instantiate a new graph printer using the parameters of the template.
     using GPrinter = GraphPrinter<T, L>;
+    /// An edge to print: the positions of its source and target nodes,
+    /// and its label.
+    using print_edge_t = tuple<uint32_t, uint32_t, L>;
     /// Underlying graph.
     graph_t graph;
     /// Obj used to print the nodes and edges of the graph. */
     GPrinter printer;
 
-    /** Prints the current graph in DOT format. */
-    void PrintDot(ostream &os) const {
+    /// Indicates whether the graph has been frozen.
+    bool frozen = false;
+    /// The IDs of nodes in the frozen graph.
+    vector<string> node_ids;
+    /// The objects of nodes in the frozen graph.
+    vector<T> node_objs;
+    /// The attributes of every node as a bitmask.
+    vector<uint64_t> attr_masks;
+    /// The names of attributes; the i-th name is the i-th bit.
+    vector<string> attr_names;
+    /// Maps the ID of a node to its position in the frozen graph.
+    unordered_map<string, size_t> node_index;
+    /// The edges of the i-th node are in [offsets[i], offsets[i + 1]).
+    vector<size_t> offsets;
+    /// The target node of every edge.
+    vector<uint32_t> targets;
+    /// The label of every edge.
+    vector<L> labels;
+    /// The predecessors of the i-th node are in
+    /// [pred_offsets[i], pred_offsets[i + 1]).
+    vector<size_t> pred_offsets;
+    /// The source node of every reversed edge.
+    vector<uint32_t> preds;
+
+    /** Gets the position of the given node in the frozen graph. */
+    optional<size_t> GetNodeIndex(const string &node_id) const {
+      auto it = node_index.find(node_id);
+      if (it == node_index.end()) {
+        return {};
+      }
+      return it->second;
+    }
+
+    /** Gets a view of the i-th node of the frozen graph. */
+    FrozenNodeInfo GetFrozenNode(size_t i) const {
+      return FrozenNodeInfo { node_ids[i], node_objs[i], attr_masks[i],
+                              attr_names };
+    }
+
+    /**
+     * Aborts the program if the graph is frozen, because the given
+     * method operates on the adjacency map, which is dropped once
+     * the graph is frozen.
+     */
+    void CheckNotFrozen(const char *method) const {
+      if (frozen) {
+        cerr << "Graph::" << method << " called on a frozen graph" << endl;
+        abort();
+      }
+    }
+
+    /**
+     * Registers an attribute name to the given registry and returns
+     * its bit.
+     */
+    static size_t RegisterAttr(vector<string> &names, const string &attr) {
+      for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == attr) {
+          return i;
+        }
+      }
+      assert(names.size() < 64);
+      names.push_back(attr);
+      return names.size() - 1;
+    }
+
+    /** Performs a DFS on the frozen graph. */
+    set<string> FrozenDFS(const string &source,
+                          const function<bool(const string&)> &visit) const {
+      set<string> visited_ids;
+      optional<size_t> source_index = GetNodeIndex(source);
+      assert(source_index.has_value());
+      if (!source_index.has_value()) {
+        return visited_ids;
+      }
+      vector<uint8_t> visited(node_ids.size(), 0);
+      vector<uint32_t> pool = { (uint32_t) source_index.value() };
+      while (!pool.empty()) {
+        uint32_t node = pool.back();
+        pool.pop_back();
+        if (visited[node]) {
+          // We have already visited this node.
+          continue;
+        }
+        if (node != source_index.value() && !visit(node_ids[node])) {
+          continue;
+        }
+        visited[node] = 1;
+        visited_ids.insert(node_ids[node]);
+        for (size_t e = offsets[node]; e < offsets[node + 1]; e++) {
+          if (!visited[targets[e]]) {
+            pool.push_back(targets[e]);
+          }
+        }
+      }
+      return visited_ids;
+    }
+
+    /** Prints the given nodes and edges in DOT format. */
+    void PrintDot(ostream &os, const vector<FrozenNodeInfo> &nodes,
+                  const vector<print_edge_t> &edges) const {
       os << "digraph {\n";
-      for (auto const &entry : graph) {
-        NodeInfo node_info = entry.second;
+      size_t e = 0;
+      for (size_t i = 0; i < nodes.size(); i++) {
+        const FrozenNodeInfo &node_info = nodes[i];
         string node_str = printer.PrintNodeDot(node_info.node_id, node_info);
         // if node str is empty, then we omit printing this node.
         if (node_str != "") {
           os << node_str << ";" << endl;
         }
-        for (auto const &dependent : node_info.dependents) {
-          optional<NodeInfo> target_info_opt = GetNodeInfo(dependent.first);
-          if (!target_info_opt.has_value()) {
-            continue;
-          }
-          NodeInfo target_info = target_info_opt.value();
+        for (; e < edges.size() && get<0>(edges[e]) == i; e++) {
+          const FrozenNodeInfo &target_info = nodes[get<1>(edges[e])];
           string edge_str = printer.PrintEdgeDot(node_info, target_info);
           // if this edge string is empty, we omit printing this edge.
           if (edge_str == "") {
@@ -325,7 +1072,7 @@ class Graph {
           }
 
           os << edge_str << "[label=\""
-            << printer.PrintEdgeLabel(dependent.second)
+            << printer.PrintEdgeLabel(get<2>(edges[e]))
             << "\"];"
             << endl;
         }
@@ -333,28 +1080,24 @@ class Graph {
       os << "}" << endl;
     }
 
-    /** Prints the current graph in CSV format. */
-    void PrintCSV(ostream &os) const {
+    /** Prints the given nodes and edges in CSV format. */
+    void PrintCSV(ostream &os, const vector<FrozenNodeInfo> &nodes,
+                  vector<print_edge_t> &edges) const {
       // We store the graph in uniform form,
       // the edge list is sorted by on the value of
       // each source and target.
       //
       // The order is ascending.
-      set<tuple<NodeInfo, NodeInfo, L>> edges;
-      for (auto const &entry : graph) {
-        NodeInfo node_info = entry.second;
-        for (auto const &dependent: node_info.dependents) {
-          optional<NodeInfo> target_info_opt = GetNodeInfo(dependent.first);
-          if (!target_info_opt.has_value()) {
-            continue;
-          }
-          NodeInfo target_info = target_info_opt.value();
-          edges.insert(make_tuple(node_info, target_info,
-                                  dependent.second));
-        }
-      }
+      sort(edges.begin(), edges.end(), [&](const print_edge_t &a,
+                                           const print_edge_t &b) {
+        return make_tuple(cref(nodes[get<0>(a)].node_id),
+                          cref(nodes[get<1>(a)].node_id), get<2>(a)) <
+          make_tuple(cref(nodes[get<0>(b)].node_id),
+                     cref(nodes[get<1>(b)].node_id), get<2>(b));
+      });
       for (auto const &edge : edges) {
-        string edge_str = printer.PrintEdgeCSV(get<0>(edge), get<1>(edge));
+        string edge_str = printer.PrintEdgeCSV(nodes[get<0>(edge)],
+                                               nodes[get<1>(edge)]);
         // If edge string is empty, we omit printing this edge.
         if (edge_str != "") {
           os << edge_str << "," << printer.PrintEdgeLabel(get<2>(edge))
@@ -1,4 +1,7 @@
-#include<set>
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <vector>
 
 #include "InodeTable.h"
 
@@ -40,8 +43,12 @@ void InodeTable::RemoveEntry(inode_t inode_p, const string &basename) {
   if (!val.has_value()) {
     // The inode is not open, so we just remove it from the corresponding
     // inode table.
-    inode_t inode = Table<inode_key_t, inode_t>::PopEntry(key);
-    map<inode_t, set<fs::path>>::iterator it = rev_table.find(inode);
+    optional<inode_t> inode = Table<inode_key_t, inode_t>::PopEntry(key);
+    if (!inode.has_value()) {
+      return;
+    }
+    map<inode_t, set<fs::path>>::iterator it = rev_table.find(
+        inode.value());
     if (it != rev_table.end()) {
       // Now remove the entry from the reversed inode table.
       // In other words, the inode will not be pointed to by
@@ -183,4 +190,35 @@ set<fs::path> InodeTable::ToPaths(inode_t inode) const {
 }
 
 
+
+void InodeTable::Trim(const set<inode_t> &pinned) {
+  map<inode_t, size_t> children;
+  vector<pair<size_t, inode_key_t>> entries;
+  for (const auto &elem : table) {
+    children[elem.first.first]++;
+    optional<fs::path> p = ToPath(elem.second);
+    if (p.has_value()) {
+      entries.push_back({ distance(p.value().begin(), p.value().end()),
+                          elem.first });
+    }
+  }
+  // We go through the deepest entries first, so that a directory
+  // is removed after its children.
+  sort(entries.begin(), entries.end(),
+       [](const auto &a, const auto &b) { return a.first > b.first; });
+  for (const auto &entry : entries) {
+    const inode_key_t &key = entry.second;
+    optional<inode_t> inode = GetInode(key.first, key.second);
+    if (!inode.has_value() || inode.value() == ROOT_INODE + 1 ||
+        pinned.find(inode.value()) != pinned.end() ||
+        children[inode.value()] > 0 ||
+        open_inodes.GetValue(key).has_value()) {
+      continue;
+    }
+    Table<inode_key_t, inode_t>::RemoveEntry(key);
+    rev_table.erase(inode.value());
+    children[key.first]--;
+  }
+}
+
 }
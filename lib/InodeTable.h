@@ -41,6 +41,12 @@ class InodeTable : public Table<inode_key_t, inode_t> {
     inode_t ToInode(const fs::path &path_val);
     optional<fs::path> ToPath(inode_t inode) const;
     set<fs::path> ToPaths(inode_t inode) const;
+    /**
+     * Removes the entries that can be recreated from their paths, i.e.,
+     * the entries whose inodes are not pinned, are pointed to by a single
+     * path, and have neither open handlers nor children.
+     */
+    void Trim(const set<inode_t> &pinned);
 
   private:
     enum INodeType {
@@ -61,6 +61,20 @@ void Link::Accept(analyzer::Analyzer *analyzer) const {
 };
 
 
+void NewProc::Accept(analyzer::Analyzer *analyzer) const {
+  if (analyzer) {
+    analyzer->AnalyzeNewProc(this);
+  }
+};
+
+
+void WaitProc::Accept(analyzer::Analyzer *analyzer) const {
+  if (analyzer) {
+    analyzer->AnalyzeWaitProc(this);
+  }
+};
+
+
 void Rename::Accept(analyzer::Analyzer *analyzer) const {
   if (analyzer) {
     analyzer->AnalyzeRename(this);
@@ -318,12 +318,43 @@ class NewProc : public Operation {
       }
     }
 
+    void Accept(analyzer::Analyzer *analyzer) const;
+
   private:
     enum CloneMode clone_mode;
     size_t pid;
 };
 
 
+/**
+ * The wait for the termination of a process, e.g., through `waitpid`.
+ * What the process does happens before what follows the wait.
+ */
+class WaitProc : public Operation {
+  public:
+    WaitProc(size_t pid_):
+      pid(pid_) {  }
+    ~WaitProc() {  }
+
+    size_t GetPID() const {
+      return pid;
+    }
+
+    string GetOpName() const  {
+      return "waitProc";
+    }
+
+    string ToString() const {
+      return GetOpName() + " " + to_string(pid) + ACTUAL_NAME + FAILED;
+    }
+
+    void Accept(analyzer::Analyzer *analyzer) const;
+
+  private:
+    size_t pid;
+};
+
+
 class Rename : public Link {
   public:
     Rename(size_t old_dirfd_, string old_path_, size_t new_dirfd_,
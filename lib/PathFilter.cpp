@@ -0,0 +1,225 @@
+#include <algorithm>
+
+#include "PathFilter.h"
+
+
+namespace path_filter {
+
+
+/**
+ * Adds the given node to the set of states, along with the nodes
+ * reached from it through '**' without consuming any component.
+ */
+template<typename Node>
+static void add_state(vector<const Node*> &states, const Node *node) {
+  while (node) {
+    if (find(states.begin(), states.end(), node) != states.end()) {
+      return;
+    }
+    states.push_back(node);
+    node = node->any.get();
+  }
+}
+
+
+/** Splits the given string into its non-empty '/'-separated parts. */
+static void split_path(const string &path, vector<string> &parts) {
+  size_t start = 0;
+  while (start <= path.size()) {
+    size_t end = path.find('/', start);
+    if (end == string::npos) {
+      end = path.size();
+    }
+    if (end > start) {
+      parts.push_back(path.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+}
+
+
+void PathFilter::AddInclude(const string &glob) {
+  AddGlob(includes.get(), glob);
+  has_includes = true;
+}
+
+
+void PathFilter::AddExclude(const string &glob) {
+  AddGlob(excludes.get(), glob);
+  has_excludes = true;
+}
+
+
+void PathFilter::AddGlob(Node *root, const string &glob) {
+  vector<string> components;
+  if (glob.empty() || glob[0] != '/') {
+    // Relative globs match at any depth.
+    components.push_back("**");
+  }
+  split_path(glob, components);
+  Node *node = root;
+  for (const string &component : components) {
+    if (component == ".") {
+      continue;
+    }
+    if (component == "**") {
+      if (node->is_any) {
+        // Consecutive '**' are equivalent to a single one.
+        continue;
+      }
+      if (!node->any) {
+        node->any.reset(new Node());
+        node->any->is_any = true;
+      }
+      node = node->any.get();
+    } else if (component.find_first_of("*?") == string::npos) {
+      unique_ptr<Node> &child = node->literals[component];
+      if (!child) {
+        child.reset(new Node());
+      }
+      node = child.get();
+    } else {
+      auto it = find_if(node->patterns.begin(), node->patterns.end(),
+                        [&component](const pair<string, unique_ptr<Node>> &p) {
+                          return p.first == component;
+                        });
+      if (it == node->patterns.end()) {
+        node->patterns.emplace_back(component, unique_ptr<Node>(new Node()));
+        it = node->patterns.end() - 1;
+      }
+      node = it->second.get();
+    }
+  }
+  node->is_final = true;
+}
+
+
+bool PathFilter::MatchesPattern(const string &pattern,
+                                const string &component) {
+  // The usual greedy matching with backtracking to the last '*'.
+  size_t p = 0, c = 0;
+  size_t star = string::npos, mark = 0;
+  while (c < component.size()) {
+    if (p < pattern.size() &&
+        (pattern[p] == '?' || pattern[p] == component[c])) {
+      p++;
+      c++;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      mark = c;
+    } else if (star != string::npos) {
+      p = star + 1;
+      c = ++mark;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    p++;
+  }
+  return p == pattern.size();
+}
+
+
+bool PathFilter::Matches(const Node *root,
+                         const vector<string> &components) {
+  // We simulate the trie as a non-deterministic automaton, whose
+  // states are the nodes that match the components seen so far.
+  vector<const Node*> states, next;
+  add_state(states, root);
+  for (const string &component : components) {
+    for (const Node *node : states) {
+      if (node->is_final) {
+        // A glob matches a prefix of the path.
+        return true;
+      }
+    }
+    next.clear();
+    for (const Node *node : states) {
+      if (node->is_any) {
+        add_state(next, node);
+      }
+      auto it = node->literals.find(component);
+      if (it != node->literals.end()) {
+        add_state(next, it->second.get());
+      }
+      for (const auto &pattern : node->patterns) {
+        if (MatchesPattern(pattern.first, component)) {
+          add_state(next, pattern.second.get());
+        }
+      }
+    }
+    if (next.empty()) {
+      return false;
+    }
+    states.swap(next);
+  }
+  for (const Node *node : states) {
+    if (node->is_final) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+vector<string> PathFilter::GetComponents(const string &path,
+                                         const string &cwd) {
+  vector<string> parts;
+  if (path.empty() || path[0] != '/') {
+    split_path(cwd, parts);
+  }
+  split_path(path, parts);
+  vector<string> components;
+  for (string &part : parts) {
+    if (part == ".") {
+      continue;
+    }
+    if (part == "..") {
+      if (!components.empty()) {
+        components.pop_back();
+      }
+      continue;
+    }
+    components.push_back(move(part));
+  }
+  return components;
+}
+
+
+bool PathFilter::IsTraced(const string &path, const string &cwd) const {
+  if (IsEmpty()) {
+    return true;
+  }
+  vector<string> components = GetComponents(path, cwd);
+  if (has_excludes && Matches(excludes.get(), components)) {
+    return false;
+  }
+  return !has_includes || Matches(includes.get(), components);
+}
+
+
+bool PathFilter::IsTraced(const Operation *op, const string &cwd) const {
+  if (IsEmpty() || !op) {
+    return true;
+  }
+  // Note that `hpathsym` is a subclass of `hpath`, and `rename`
+  // is a subclass of `link`.
+  if (const Hpath *hpath = dynamic_cast<const Hpath*>(op)) {
+    return IsTraced(hpath->GetDirFd(), hpath->GetPath(), cwd);
+  }
+  if (const NewFd *new_fd = dynamic_cast<const NewFd*>(op)) {
+    return IsTraced(new_fd->GetDirFd(), new_fd->GetPath(), cwd);
+  }
+  if (const Link *link = dynamic_cast<const Link*>(op)) {
+    return IsTraced(link->GetOldDirfd(), link->GetOldPath(), cwd) ||
+      IsTraced(link->GetNewDirfd(), link->GetNewPath(), cwd);
+  }
+  if (const Symlink *symlink = dynamic_cast<const Symlink*>(op)) {
+    return IsTraced(symlink->GetDirFd(), symlink->GetPath(), cwd);
+  }
+  return true;
+}
+
+
+} // namespace path_filter
@@ -0,0 +1,131 @@
+#ifndef PATH_FILTER_H
+#define PATH_FILTER_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Operation.h"
+
+
+using namespace std;
+using namespace operation;
+
+
+namespace path_filter {
+
+
+/**
+ * A filter that decides which paths are traced, according to
+ * include and exclude path globs.
+ *
+ * A glob is a sequence of path components separated by '/'. Every
+ * component is either a literal, a pattern with the wildcards '*'
+ * (any sequence of characters) and '?' (any single character), or '**',
+ * which matches any number of components. Globs that do not start
+ * with '/' may match at any depth (e.g., "node_modules" matches every
+ * directory named "node_modules"). A glob that matches a path also
+ * matches everything under that path.
+ *
+ * All globs are compiled once into a trie of path components, so
+ * checking a path walks the trie along the components of the path,
+ * and does not depend on the number of globs.
+ *
+ * A path is traced if it matches no exclude glob, and either there
+ * are no include globs or it matches one of them.
+ */
+class PathFilter {
+public:
+  /** Creates a filter that traces every path. */
+  PathFilter():
+    includes(new Node()),
+    excludes(new Node()),
+    has_includes(false),
+    has_excludes(false) {  }
+
+  /** Adds a glob to the paths that are traced. */
+  void AddInclude(const string &glob);
+
+  /** Adds a glob to the paths that are not traced. */
+  void AddExclude(const string &glob);
+
+  /** Checks whether the filter traces every path. */
+  bool IsEmpty() const {
+    return !has_includes && !has_excludes;
+  }
+
+  /**
+   * Checks whether the given path is traced. Relative paths are
+   * resolved against the given working directory.
+   */
+  bool IsTraced(const string &path, const string &cwd) const;
+
+  /**
+   * Checks whether the given path is traced, when it is relative to
+   * the given dir file descriptor.
+   *
+   * The path of a dir file descriptor other than `AT_FDCWD` is not
+   * known while the trace is being collected, so such paths are always
+   * traced.
+   */
+  bool IsTraced(size_t dirfd, const string &path, const string &cwd) const {
+    return dirfd != AT_FDCWD || IsTraced(path, cwd);
+  }
+
+  /**
+   * Checks whether the given operation is kept in the trace.
+   *
+   * Operations that access many paths (e.g., `link`) are kept if any
+   * of their paths is traced. Operations that do not access any path
+   * (e.g., `delFd`) are always kept.
+   */
+  bool IsTraced(const Operation *op, const string &cwd) const;
+
+private:
+  /** A node of the trie, which corresponds to a prefix of globs. */
+  struct Node {
+    /// The children reached through literal components.
+    unordered_map<string, unique_ptr<Node>> literals;
+    /// The children reached through components with wildcards.
+    vector<pair<string, unique_ptr<Node>>> patterns;
+    /// The child reached through '**' (if any).
+    unique_ptr<Node> any;
+    /// Whether this node matches any number of components (i.e.,
+    /// it was reached through '**').
+    bool is_any = false;
+    /// Whether a glob ends at this node.
+    bool is_final = false;
+  };
+
+  /// The tries of include and exclude globs.
+  unique_ptr<Node> includes;
+  unique_ptr<Node> excludes;
+  /// Whether any include and exclude globs have been added.
+  bool has_includes;
+  bool has_excludes;
+
+  /** Adds the given glob to the given trie. */
+  static void AddGlob(Node *root, const string &glob);
+
+  /**
+   * Checks whether the given trie matches a prefix of the given
+   * path components.
+   */
+  static bool Matches(const Node *root, const vector<string> &components);
+
+  /**
+   * Splits the given path into its components, after resolving it
+   * against the given working directory, and removing '.' and '..'.
+   */
+  static vector<string> GetComponents(const string &path, const string &cwd);
+
+  /** Checks whether the given component matches a wildcard pattern. */
+  static bool MatchesPattern(const string &pattern, const string &component);
+};
+
+
+} // namespace path_filter
+
+#endif
@@ -1,3 +1,4 @@
+#include <map>
 #include <optional>
 
 #include "Debug.h"
@@ -61,12 +62,63 @@ get_fs_out_format(const CLIArgs &cli_args)
 }
 
 
+static size_t
+get_detector_threads(const CLIArgs &cli_args)
+{
+  std::optional<std::string> val = cli_args.cli_options.GetValue(
+      "detector_threads");
+  if (!val.has_value()) {
+    return 1;
+  }
+  return std::stoul(val.value());
+}
+
+
+static detector::RaceDetector::Strategy
+get_race_strategy(const CLIArgs &cli_args)
+{
+  std::optional<std::string> val = cli_args.cli_options.GetValue(
+      "race_strategy");
+  if (val.has_value() && val.value() == "event") {
+    return detector::RaceDetector::EVENT_CENTRIC;
+  }
+  return detector::RaceDetector::PATH_CENTRIC;
+}
+
+
+static std::optional<size_t>
+get_gc_threshold(const CLIArgs &cli_args)
+{
+  std::optional<std::string> val = cli_args.cli_options.GetValue(
+      "gc_threshold");
+  if (!val.has_value()) {
+    return {};
+  }
+  return std::stoul(val.value());
+}
+
+
 Processor::Processor():
-  fault_detector(nullptr) {  }
+  fault_detector(nullptr),
+  dep_analyzer(nullptr),
+  fs_analyzer(nullptr),
+  online(false),
+  collections(0),
+  next_collection(0),
+  snapshots(0),
+  owns_records(false) {  }
 
 
 Processor::Processor(CLIArgs args):
-  cli_args(args) {  }
+  cli_args(args),
+  fault_detector(nullptr),
+  dep_analyzer(nullptr),
+  fs_analyzer(nullptr),
+  online(false),
+  collections(0),
+  next_collection(0),
+  snapshots(0),
+  owns_records(false) {  }
 
 
 Processor::~Processor() {
@@ -83,7 +135,8 @@ Processor::~Processor() {
 }
 
 
-void Processor::Setup(std::optional<size_t> pid) {
+void Processor::Setup(std::optional<size_t> pid_) {
+  pid = pid_;
   InitAnalyzers(pid);
   InitFaultDetector();
 }
@@ -127,39 +180,154 @@ void Processor::InitAnalyzers(std::optional<size_t> pid) {
 }
 
 
+analyzer::Analyzer *Processor::FindAnalyzer(const std::string &name) const {
+  for (auto const &pair_analyzer : analyzers) {
+    if (pair_analyzer.first && pair_analyzer.first->GetName() == name) {
+      return pair_analyzer.first;
+    }
+  }
+  return nullptr;
+}
+
+
 void Processor::InitFaultDetector()
 {
-  int offset = 0;
-  if (cli_args.dump_trace || cli_args.output_trace.has_value()) {
-    offset = 1;
-  }
   if (cli_args.fault_detector.has_value()) {
     string fault_detector_str = cli_args.fault_detector.value();
     if (fault_detector_str == "race") {
-      // We know the first analyzer corresponds to the `dep-infer` analyzer,
-      // while the second one is the `fs` analyzer.
       analyzer::DependencyInferenceAnalyzer *dep_analyzer =
         static_cast<analyzer::DependencyInferenceAnalyzer*>(
-            analyzers[offset + 0].first);
+            FindAnalyzer("DependencyInferenceAnalyzer"));
       analyzer::FSAnalyzer *fs_analyzer = static_cast<analyzer::FSAnalyzer*>(
-          analyzers[offset + 1].first);
+          FindAnalyzer("FSAnalyzer"));
       fault_detector = new detector::RaceDetector(
           fs_analyzer->GetFSAccesses(),
-          dep_analyzer->GetDependencyGraph());
+          dep_analyzer->GetDependencyGraph(),
+          dep_analyzer->GetEpochs(),
+          get_detector_threads(cli_args),
+          get_race_strategy(cli_args));
     }
   }
 }
 
 
-void Processor::AnalyzeTraces(const trace::Trace *trace) {
+writer::OutWriter *Processor::InitSnapshotOut(const std::string &key) const {
+  std::string suffix = ".snapshot" + std::to_string(snapshots);
+  std::optional<std::string> val = cli_args.cli_options.GetValue(
+      "output-" + key);
+  if (val.has_value()) {
+    std::string filename = val.value();
+    if (pid.has_value()) {
+      filename += std::to_string(pid.value());
+    }
+    return new writer::OutWriter(writer::OutWriter::WRITE_FILE,
+                                 filename + suffix);
+  }
+  if (cli_args.cli_options.GetValue("stdout-" + key).has_value()) {
+    return new writer::OutWriter(writer::OutWriter::WRITE_STDOUT, "");
+  }
+  return nullptr;
+}
+
+
+void Processor::RunAnalyzer(analyzer::Analyzer *analyzer_ptr,
+                            writer::OutWriter *out,
+                            const trace::Trace *trace) {
+  debug::info(analyzer_ptr->GetName()) << "Start analyzing traces...";
+  analyzer_ptr->Analyze(trace);
+  debug::info(analyzer_ptr->GetName()) << "Analysis is done in "
+    << analyzer_ptr->GetAnalysisTime() << "ms";
+  if (out) {
+    debug::info(analyzer_ptr->GetName())
+      << "Dumping analysis output to "
+      << out->ToString();
+    analyzer_ptr->DumpOutput(out);
+  }
+}
+
+
+void Processor::RunRemainingAnalyzers(const trace::Trace *trace) {
+  for (auto const &pair_analyzer : analyzers) {
+    if (pair_analyzer.first != dep_analyzer &&
+        pair_analyzer.first != fs_analyzer) {
+      RunAnalyzer(pair_analyzer.first, pair_analyzer.second, trace);
+    }
+  }
+}
+
+
+void Processor::StreamExecOp(const trace::ExecOp *exec_op) {
+  for (auto const &pair_analyzer : analyzers) {
+    if (pair_analyzer.first != dep_analyzer &&
+        pair_analyzer.first != fs_analyzer) {
+      pair_analyzer.first->AnalyzeExecOp(exec_op);
+    }
+  }
+}
+
+
+void Processor::StreamBlock(const trace::Block *block) {
+  for (auto const &pair_analyzer : analyzers) {
+    if (pair_analyzer.first != dep_analyzer &&
+        pair_analyzer.first != fs_analyzer) {
+      pair_analyzer.first->AnalyzeBlock(block);
+    }
+  }
+}
+
+
+void Processor::StartIncrementalAnalysis(const trace::Trace *trace) {
+  dep_analyzer = static_cast<analyzer::DependencyInferenceAnalyzer*>(
+      FindAnalyzer("DependencyInferenceAnalyzer"));
+  fs_analyzer = static_cast<analyzer::FSAnalyzer*>(
+      FindAnalyzer("FSAnalyzer"));
+  collections = 0;
+  next_collection = 0;
+  for (auto const &pair_analyzer : analyzers) {
+    if (pair_analyzer.first == fs_analyzer && pair_analyzer.second) {
+      // The dumped accesses must include those of collected events.
+      fs_analyzer->KeepCollectedAccesses();
+    }
+  }
+  fs_analyzer->Initialize(trace);
+}
+
+
+void Processor::AnalyzeBlockIncrementally(const trace::Block *block,
+                                          size_t threshold) {
+  if (block->IsMain() &&
+      dep_analyzer->Size() >= std::max(threshold, next_collection)) {
+    // The collectable events happen before all the remaining events,
+    // and thus before this MAIN block, so they cannot race with any of
+    // the following events. We detect their races and drop them.
+    std::set<std::string> events = dep_analyzer->GetCollectableEvents();
+    if (!events.empty()) {
+      fs_analyzer->Seal();
+      dep_analyzer->Seal();
+      static_cast<detector::RaceDetector*>(fault_detector)->CollectFaults(
+          events, online);
+      fs_analyzer->Collect(events);
+      dep_analyzer->Collect(events, block->GetPrettyBlockId());
+      collections++;
+    }
+    // The events that are not collected are examined again only when
+    // the graph doubles in size, so that the cost is amortized.
+    next_collection = 2 * dep_analyzer->Size();
+  }
+  fs_analyzer->AnalyzeBlock(block);
+  dep_analyzer->AnalyzeBlock(block);
+}
+
+
+void Processor::StopIncrementalAnalysis() {
+  fs_analyzer->Seal();
+  dep_analyzer->Seal();
   for (auto const &pair_analyzer : analyzers) {
     analyzer::Analyzer *analyzer_ptr = pair_analyzer.first;
     writer::OutWriter *out = pair_analyzer.second;
-    debug::info(analyzer_ptr->GetName()) << "Start analyzing traces...";
-    analyzer_ptr->Analyze(trace);
-    debug::info(analyzer_ptr->GetName()) << "Analysis is done in "
-      << analyzer_ptr->GetAnalysisTime() << "ms";
-    if (out) {
+    // During online analysis, every analyzer is fed incrementally.
+    if (out && (online || analyzer_ptr == dep_analyzer ||
+                analyzer_ptr == fs_analyzer)) {
       debug::info(analyzer_ptr->GetName())
         << "Dumping analysis output to "
         << out->ToString();
@@ -169,6 +337,191 @@ void Processor::AnalyzeTraces(const trace::Trace *trace) {
 }
 
 
+void Processor::AnalyzeIncrementally(const trace::Trace *trace,
+                                     size_t threshold) {
+  StartIncrementalAnalysis(trace);
+  // Analyzers that do not take part in race detection
+  // operate on the whole trace.
+  RunRemainingAnalyzers(trace);
+
+  debug::info("Processor") << "Start analyzing traces incrementally...";
+  utils::timer analysis_time;
+  analysis_time.Start();
+  for (auto const &block : trace->GetBlocks()) {
+    AnalyzeBlockIncrementally(block, threshold);
+  }
+  fs_analyzer->Seal();
+  dep_analyzer->Seal();
+  analysis_time.Stop();
+  debug::info("Processor") << "Analysis is done in "
+    << analysis_time.GetTimeMillis() << "ms (" << collections
+    << " collections)";
+  StopIncrementalAnalysis();
+}
+
+
+bool Processor::IsOnline() const {
+  return cli_args.cli_options.GetValue("online").has_value() &&
+    fault_detector && fault_detector->SupportOnlineAnalysis() &&
+    FindAnalyzer("DependencyInferenceAnalyzer") &&
+    FindAnalyzer("FSAnalyzer");
+}
+
+
+void Processor::StartOnlineAnalysis(const trace::Trace *trace,
+                                    bool owns_records_) {
+  debug::info("Processor") << "Start analyzing traces online...";
+  online = true;
+  owns_records = owns_records_;
+  StartIncrementalAnalysis(trace);
+  for (auto const &pair_analyzer : analyzers) {
+    if (pair_analyzer.first->GetName() == "DumpAnalyzer") {
+      // The header precedes the streamed parts of the trace.
+      static_cast<analyzer::DumpAnalyzer*>(
+          pair_analyzer.first)->AnalyzeHeader(trace);
+    }
+  }
+}
+
+
+void Processor::AnalyzeExecOp(const trace::ExecOp *exec_op) {
+  fs_analyzer->AnalyzeExecOp(exec_op);
+  StreamExecOp(exec_op);
+  auto it = analyzed_exec_ops.find(exec_op->GetId());
+  if (it != analyzed_exec_ops.end() && owns_records) {
+    // The id of an operation is reused before its block is analyzed.
+    delete it->second;
+  }
+  analyzed_exec_ops[exec_op->GetId()] = exec_op;
+  AnalyzePendingBlocks(false);
+}
+
+
+void Processor::AnalyzeBlock(const trace::Block *block) {
+  pending_blocks.push_back(block);
+  AnalyzePendingBlocks(false);
+}
+
+
+void Processor::AnalyzePendingBlocks(bool force) {
+  size_t threshold = get_gc_threshold(cli_args).value_or(0);
+  while (!pending_blocks.empty()) {
+    const trace::Block *block = pending_blocks.front();
+    std::vector<std::string> op_ids;
+    bool ready = true;
+    for (auto const &expr : block->GetExprs()) {
+      const trace::SubmitOp *submit_op =
+        dynamic_cast<const trace::SubmitOp*>(expr);
+      if (!submit_op) {
+        continue;
+      }
+      op_ids.push_back(submit_op->GetOpId());
+      // Synchronous operations are completed before the end of
+      // the block that submits them.
+      if (submit_op->GetType() == trace::SubmitOp::ASYNC &&
+          !analyzed_exec_ops.count(submit_op->GetOpId())) {
+        ready = false;
+      }
+    }
+    if (!ready && !force) {
+      return;
+    }
+    AnalyzeBlockIncrementally(block, threshold);
+    StreamBlock(block);
+    // The operations of the block are not needed anymore.
+    for (auto const &op_id : op_ids) {
+      auto it = analyzed_exec_ops.find(op_id);
+      if (it == analyzed_exec_ops.end()) {
+        continue;
+      }
+      if (owns_records) {
+        delete it->second;
+      }
+      analyzed_exec_ops.erase(it);
+    }
+    pending_blocks.pop_front();
+    if (owns_records) {
+      delete block;
+    }
+  }
+}
+
+
+void Processor::StopOnlineAnalysis() {
+  // Operations that were never completed cannot hold back
+  // the analysis anymore.
+  AnalyzePendingBlocks(true);
+  // Operations that were never submitted.
+  if (owns_records) {
+    for (auto const &entry : analyzed_exec_ops) {
+      delete entry.second;
+    }
+  }
+  analyzed_exec_ops.clear();
+  debug::info("Processor") << "Online analysis is done ("
+    << collections << " collections)";
+  StopIncrementalAnalysis();
+}
+
+
+void Processor::Snapshot() {
+  if (!online) {
+    debug::warn("Processor")
+      << "Snapshots are only taken during online analysis";
+    return;
+  }
+  // Sealing the file accesses only rebuilds their store, so the analysis
+  // continues as if no snapshot had been taken. The dependency graph is
+  // dumped as is; its edges are pruned when its events are collected.
+  fs_analyzer->Seal();
+  for (auto const &pair_analyzer : analyzers) {
+    analyzer::Analyzer *analyzer_ptr = pair_analyzer.first;
+    std::string key;
+    if (analyzer_ptr == dep_analyzer) {
+      key = "dep_graph";
+    } else if (analyzer_ptr == fs_analyzer) {
+      key = "fs_accesses";
+    } else {
+      continue;
+    }
+    writer::OutWriter *out = InitSnapshotOut(key);
+    if (!out) {
+      continue;
+    }
+    debug::info(analyzer_ptr->GetName())
+      << "Dumping snapshot " << snapshots << " to " << out->ToString();
+    analyzer_ptr->DumpOutput(out);
+  }
+  snapshots++;
+}
+
+
+bool Processor::IsCollecting() const {
+  return get_gc_threshold(cli_args).has_value() && fault_detector &&
+    FindAnalyzer("DependencyInferenceAnalyzer") &&
+    FindAnalyzer("FSAnalyzer");
+}
+
+
+void Processor::AnalyzeTraces(const trace::Trace *trace) {
+  if (IsCollecting()) {
+    if (!trace || !trace->IsMultiProcess()) {
+      AnalyzeIncrementally(trace, get_gc_threshold(cli_args).value());
+      return;
+    }
+    // The MAIN blocks of other processes are not barriers, so the events
+    // of a process tree are never collectable.
+    debug::warn("Processor")
+      << "Traces of multiple processes are analyzed without collection";
+  }
+  for (auto const &pair_analyzer : analyzers) {
+    analyzer::Analyzer *analyzer_ptr = pair_analyzer.first;
+    writer::OutWriter *out = pair_analyzer.second;
+    RunAnalyzer(analyzer_ptr, out, trace);
+  }
+}
+
+
 void Processor::DetectFaults() {
 
   if (!fault_detector) {
@@ -176,6 +529,12 @@ void Processor::DetectFaults() {
   }
   debug::info(fault_detector->GetName())
     << "Detecting faults...";
+  if (online) {
+    // The faults among collected events have already been reported,
+    // so we report only the remaining ones.
+    fault_detector->Detect(std::map<std::string, void*>());
+    return;
+  }
   fault_detector->Detect();
 }
 
@@ -1,10 +1,15 @@
+#include <deque>
+#include <map>
 #include <optional>
+#include <set>
 #include <string>
 #include <vector>
 #include <utility>
 
 #include "Analyzer.h"
+#include "DependencyInferenceAnalyzer.h"
 #include "FaultDetector.h"
+#include "FSAnalyzer.h"
 #include "Table.h"
 #include "TraceGenerator.h"
 #include "OutWriter.h"
@@ -16,7 +21,7 @@ struct CLIArgs {
   std::vector<std::string> analyzers;
   std::optional<std::string> fault_detector;
   table::Table<std::string, std::string> cli_options;
-  bool dump_trace;
+  bool dump_trace = false;
   std::optional<std::string> output_trace;
 };
 
@@ -34,6 +39,55 @@ public:
 
   void DetectFaults();
 
+  /**
+   * Checks whether the trace is analyzed while it is being generated,
+   * i.e., whether the generator feeds the processor with every
+   * completed `execOp` and block.
+   */
+  bool IsOnline() const;
+
+  /**
+   * Prepares the analyzers for analyzing the given trace while it is
+   * being generated. Every analyzer is fed with the `execOp`s and
+   * blocks of the trace as they are completed.
+   *
+   * If `owns_records` is true, the processor deallocates every `execOp`
+   * and block once it is analyzed, so they must not be part of
+   * the trace.
+   *
+   * Note that the processor must be set up first.
+   */
+  void StartOnlineAnalysis(const trace::Trace *trace, bool owns_records);
+
+  /** Analyzes an `execOp` whose operations have been completed. */
+  void AnalyzeExecOp(const trace::ExecOp *exec_op);
+
+  /**
+   * Analyzes a completed block.
+   *
+   * Blocks are analyzed in the order they are given, but a block is
+   * held back until every asynchronous operation it submits has been
+   * analyzed. Whenever the events analyzed so far are collected,
+   * the races among them are reported immediately.
+   */
+  void AnalyzeBlock(const trace::Block *block);
+
+  /**
+   * Completes the online analysis of the trace, and dumps
+   * the output of analyzers (if requested).
+   */
+  void StopOnlineAnalysis();
+
+  /**
+   * Dumps the current output of the analyzers that run online without
+   * stopping the analysis, e.g., while a long-running program is being
+   * traced.
+   *
+   * The n-th snapshot of an output file is stored to
+   * `<file>.snapshot<n>`.
+   */
+  void Snapshot();
+
   void SetCLIArgs(CLIArgs cli_args_) {
     cli_args = cli_args_;
   }
@@ -44,10 +98,104 @@ private:
   std::vector<std::pair<analyzer::Analyzer*, writer::OutWriter*>> analyzers;
   /// Component used to detect faults.
   detector::FaultDetector *fault_detector;
+  /// The analyzers that are fed block by block when events are collected.
+  analyzer::DependencyInferenceAnalyzer *dep_analyzer;
+  analyzer::FSAnalyzer *fs_analyzer;
+  /// Whether faults are reported while the application is running.
+  bool online;
+  /// Number of times the analyzed events have been collected.
+  size_t collections;
+  /// Number of events in the dependency graph before the next attempt
+  /// to collect events.
+  size_t next_collection;
+  /// The id of the process whose trace is analyzed (if any).
+  std::optional<size_t> pid;
+  /// Number of snapshots taken during the online analysis.
+  size_t snapshots;
+  /// Completed blocks that wait for their operations (online analysis).
+  std::deque<const trace::Block*> pending_blocks;
+  /// Analyzed operations whose blocks have not been analyzed yet.
+  std::map<std::string, const trace::ExecOp*> analyzed_exec_ops;
+  /// Whether analyzed `execOp`s and blocks are deallocated (online
+  /// analysis).
+  bool owns_records;
 
   void InitAnalyzers(std::optional<size_t> pid);
 
   void InitFaultDetector();
+
+  /**
+   * Creates the writer of the next snapshot of the given output
+   * (e.g., "dep_graph"), or returns null if the output is not requested.
+   */
+  writer::OutWriter *InitSnapshotOut(const std::string &key) const;
+
+  /** Gets the first analyzer with the given name (if any). */
+  analyzer::Analyzer *FindAnalyzer(const std::string &name) const;
+
+  /**
+   * Runs the given analyzer on the trace and dumps its output
+   * (if requested).
+   */
+  void RunAnalyzer(analyzer::Analyzer *analyzer_ptr, writer::OutWriter *out,
+                   const trace::Trace *trace);
+
+  /**
+   * Checks whether events are collected once they happen before all
+   * the remaining ones.
+   */
+  bool IsCollecting() const;
+
+  /**
+   * Analyzes the blocks of the trace one by one. Whenever there are
+   * at least `threshold` events, the races of the events that happen
+   * before all the remaining ones are detected, and those events are
+   * dropped from the analyzers.
+   */
+  void AnalyzeIncrementally(const trace::Trace *trace, size_t threshold);
+
+  /**
+   * Prepares the analyzers that take part in race detection for
+   * analyzing the given trace block by block.
+   */
+  void StartIncrementalAnalysis(const trace::Trace *trace);
+
+  /**
+   * Analyzes the given block. If it is a MAIN block, the events that
+   * can be collected are dropped first, after their races are detected.
+   */
+  void AnalyzeBlockIncrementally(const trace::Block *block, size_t threshold);
+
+  /**
+   * Analyzes the pending blocks in order. If `force` is false, this
+   * stops at the first block that submits an asynchronous operation
+   * which has not been analyzed yet.
+   */
+  void AnalyzePendingBlocks(bool force);
+
+  /**
+   * Seals the analyzers that take part in race detection, and dumps
+   * their output (if requested).
+   */
+  void StopIncrementalAnalysis();
+
+  /**
+   * Runs the analyzers that do not take part in race detection
+   * on the whole trace.
+   */
+  void RunRemainingAnalyzers(const trace::Trace *trace);
+
+  /**
+   * Feeds the analyzers that do not take part in race detection with
+   * the given `execOp` (online analysis).
+   */
+  void StreamExecOp(const trace::ExecOp *exec_op);
+
+  /**
+   * Feeds the analyzers that do not take part in race detection with
+   * the given block (online analysis).
+   */
+  void StreamBlock(const trace::Block *block);
 };
 
 
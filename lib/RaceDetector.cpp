@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <experimental/filesystem>
 #include <map>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #include "Debug.h"
 #include "Operation.h"
@@ -19,101 +21,179 @@ namespace detector {
 void RaceDetector::Detect() {
   // First, get the detected faults.
   auto faults = GetFaults();
+  MergeFaults(faults, collected_faults);
   // Second, report the detected faults to the standard output.
   DumpFaults(faults);
 }
 
+void RaceDetector::CollectFaults(const std::set<std::string> &events,
+                                 bool report) {
+  faults_t new_faults;
+  for (auto const &fault_entry : GetFaults()) {
+    // The faults among the remaining events may be resolved later on,
+    // so only those that involve a collected event are kept.
+    if (!events.count(fault_entry.first.first) &&
+        !events.count(fault_entry.first.second)) {
+      continue;
+    }
+    auto it = collected_faults.find(fault_entry.first);
+    for (auto const &fault_desc : fault_entry.second) {
+      if (it == collected_faults.end() || !it->second.count(fault_desc)) {
+        new_faults[fault_entry.first].insert(fault_desc);
+      }
+    }
+  }
+  if (report) {
+    DumpFaults(new_faults);
+  }
+  MergeFaults(collected_faults, new_faults);
+}
+
+
 void RaceDetector::Detect(std::map<std::string, void*> gen_store) {
-  // Online analysis is not supported at the moment.
-};
-
-
-bool RaceDetector::HasConflict(const fs_access_t &acc1,
-                               const fs_access_t &acc2) {
-  switch (acc1.effect_type) {
-    case op::Hpath::CONSUMED:
-      return !op::Hpath::Consumes(acc2.effect_type);
-    case op::Hpath::PRODUCED:
-    case op::Hpath::EXPUNGED:
-      return true;
+  // The analyzers are fed with the completed parts of the trace,
+  // so the store of the generator is not needed here.
+  faults_t new_faults;
+  for (auto const &fault_entry : GetFaults()) {
+    auto it = collected_faults.find(fault_entry.first);
+    for (auto const &fault_desc : fault_entry.second) {
+      if (it == collected_faults.end() || !it->second.count(fault_desc)) {
+        new_faults[fault_entry.first].insert(fault_desc);
+      }
+    }
   }
+  // We report only the faults that have not been reported before.
+  DumpFaults(new_faults);
+  MergeFaults(collected_faults, new_faults);
 }
 
 
-bool RaceDetector::HappensBefore(string source, string target) const {
-  auto cache_it = cache_dfs.find(source);
-  optional<DependencyInferenceAnalyzer::EventInfo> source_info =
-    dep_graph.GetNodeInfo(source);
-  optional<DependencyInferenceAnalyzer::EventInfo> target_info =
-    dep_graph.GetNodeInfo(target);
+RaceDetector::fs_access_t RaceDetector::GetAccess(size_t i) const {
+  FSAccessStore::id_t event_id = fs_accesses.GetEventId(i);
+  return fs_access_t(
+      fs_accesses.GetEvent(event_id), fs_accesses.GetEffect(i),
+      fs_accesses.GetEventDebugInfo(event_id),
+      fs_accesses.GetOpName(fs_accesses.GetOpNameId(i)));
+}
 
-  if (!source_info.has_value() || !target_info.has_value()) {
-    return false;
-  }
 
-  if (source_info.value().node_obj.GetEventType() == Event::MAIN &&
-      target_info.value().node_obj.GetEventType() == Event::MAIN) {
-    return true;
+RaceDetector::faults_t RaceDetector::GetFaults() const {
+  ReachabilityIndex index(dep_graph, epochs, fs_accesses, threads);
+  vector<faults_t> thread_faults(threads);
+  switch (strategy) {
+    case PATH_CENTRIC:
+      utils::ParallelFor(fs_accesses.NumPaths(), threads, 64,
+                         [&](size_t worker, size_t p) {
+        DetectPath(thread_faults[worker], index, p);
+      });
+      break;
+    case EVENT_CENTRIC: {
+      EventFootprints footprints(fs_accesses);
+      utils::ParallelFor(fs_accesses.NumEvents(), threads, 16,
+                         [&](size_t worker, size_t event_id) {
+        DetectEvent(thread_faults[worker], index, footprints, event_id);
+      });
+      break;
+    }
   }
-  if (cache_it == cache_dfs.end()) {
-    set<string> visited = dep_graph.DFS(source); 
-    cache_dfs[source] = visited;
-    return visited.find(target) != visited.end(); 
-  } else {
-    return cache_it->second.find(target) != cache_it->second.end(); 
+  // Merge the faults found by every thread. Both the pairs of events
+  // and the fault descriptions are ordered, so the merged result
+  // is the same regardless of how paths were distributed.
+  faults_t faults = move(thread_faults[0]);
+  for (size_t i = 1; i < thread_faults.size(); i++) {
+    MergeFaults(faults, thread_faults[i]);
   }
+  return faults;
 }
 
 
-RaceDetector::faults_t RaceDetector::GetFaults() const {
-  faults_t faults;
-  fs_accesses_table_t::table_t table = fs_accesses.GetTable();
-  for (auto it = table.begin(); it != table.end(); it++) {
-    auto fs_access = *it;
-    fs::path p = fs_access.first;
-    // Get all combinations of file accesses.
-    auto acc_combs = utils::Get2Combinations(fs_access.second); 
-    for (auto const &access : acc_combs) {
-      auto first_access = access.first;
-      auto second_access = access.second;
-      event_info.AddEntry(first_access.event_id, first_access.debug_info);
-      event_info.AddEntry(second_access.event_id, second_access.debug_info);
-      if (first_access.event_id == second_access.event_id) {
-        // The fist and the second access refer to the same block,
-        // so we omit them.
+void RaceDetector::MergeFaults(faults_t &faults, const faults_t &other) {
+  for (auto &fault_entry : other) {
+    faults[fault_entry.first].insert(fault_entry.second.begin(),
+                                     fault_entry.second.end());
+  }
+}
+
+
+void RaceDetector::DetectPath(faults_t &faults, const ReachabilityIndex &index,
+                              FSAccessStore::id_t p) const {
+  // The accesses of every path are stored in a contiguous range.
+  // Two consumers never conflict, so we pair every producer or
+  // expunger with all the other accesses of this range.
+  // This makes a path with many readers and a few writers
+  // linear in the number of its accesses.
+  auto range = fs_accesses.GetPathRange(p);
+  for (size_t i = range.first; i < range.second; i++) {
+    if (op::Hpath::Consumes(fs_accesses.GetEffect(i))) {
+      continue;
+    }
+    for (size_t j = range.first; j < range.second; j++) {
+      if (j < i && !op::Hpath::Consumes(fs_accesses.GetEffect(j))) {
+        // We have already examined this pair of writers
+        // when we visited the j-th access.
         continue;
       }
-      if (!HasConflict(first_access, second_access)) {
-        // There is not any conflict between those file accesses,
-        // so we proceed to the next iteration.
+      if (fs_accesses.GetEventId(i) == fs_accesses.GetEventId(j)) {
+        // The fist and the second access refer to the same block,
+        // so we omit them.
         continue;
       }
+      // Preserve the order of the accesses in the store,
+      // so that the first event of the pair is always the smaller one.
+      size_t first = min(i, j), second = max(i, j);
+      AddFault(faults, index, p, first, second);
+    }
+  }
+}
 
-      // Check whether there is a dependency between the two blocks
-      // corresponding to those file accesses with regards to the
-      // dependency graph.
-      bool has_dep = HappensBefore(
-          first_access.event_id, second_access.event_id) ||
-        HappensBefore(second_access.event_id, first_access.event_id);
-
-      if (!has_dep) {
-        // There is not any dependency, so we've just found a fault.
-        auto pair_element = std::make_pair(
-            first_access.event_id, second_access.event_id);
-        faults_t::iterator it = faults.find(pair_element);
-        FaultDesc fault_desc = FaultDesc(
-            p.native(), first_access, second_access);
-        if (it == faults.end()) {
-          std::set<FaultDesc> fault_descs;
-          fault_descs.insert(fault_desc);
-          faults[pair_element] = fault_descs;
-        } else {
-          it->second.insert(fault_desc);
-        }
+
+void RaceDetector::DetectEvent(faults_t &faults,
+                               const ReachabilityIndex &index,
+                               const EventFootprints &footprints,
+                               FSAccessStore::id_t event_id) const {
+  vector<uint64_t> mask(footprints.GetWords());
+  for (size_t other = event_id + 1; other < fs_accesses.NumEvents();
+       other++) {
+    if (!footprints.HasWrites(event_id) && !footprints.HasWrites(other)) {
+      // Events that only consume paths never conflict.
+      continue;
+    }
+    if (index.Ordered(event_id, other)) {
+      continue;
+    }
+    if (!footprints.ConflictMask(event_id, other, mask.data())) {
+      continue;
+    }
+    // Expand every conflicting path into a fault. Event ids follow
+    // the order of the accesses of a path, so `event_id` always
+    // performs the first access.
+    for (size_t w = 0; w < mask.size(); w++) {
+      for (uint64_t bits = mask[w]; bits; bits &= bits - 1) {
+        FSAccessStore::id_t p = w * 64 + __builtin_ctzll(bits);
+        AddFault(faults, index, p,
+                 fs_accesses.FindAccess(p, event_id).value(),
+                 fs_accesses.FindAccess(p, other).value());
       }
     }
-  } 
-  return faults;
+  }
+}
+
+
+void RaceDetector::AddFault(faults_t &faults, const ReachabilityIndex &index,
+                            FSAccessStore::id_t p,
+                            size_t first, size_t second) const {
+  // Check whether there is a dependency between the two blocks
+  // corresponding to those file accesses with regards to the
+  // dependency graph.
+  FSAccessStore::id_t first_event = fs_accesses.GetEventId(first);
+  FSAccessStore::id_t second_event = fs_accesses.GetEventId(second);
+  if (!index.Ordered(first_event, second_event)) {
+    // There is not any dependency, so we've just found a fault.
+    faults[std::make_pair(fs_accesses.GetEvent(first_event),
+                          fs_accesses.GetEvent(second_event))].insert(
+        FaultDesc(fs_accesses.GetPath(p), GetAccess(first),
+                  GetAccess(second)));
+  }
 }
 
 
@@ -126,22 +206,13 @@ void RaceDetector::DumpFaults(const faults_t &faults) const {
   debug::msg() << "Number of data races: " << faults.size();
   for (auto const &fault_entry : faults) {
     auto block_pair = fault_entry.first;
-    optional<DebugInfo> debug_info1 = event_info.GetValue(block_pair.first);
-    optional<DebugInfo> debug_info2 = event_info.GetValue(block_pair.second);
-    string debug1 = "";
-    string debug2 = "";
-    if (debug_info1.has_value()) {
-      string debug_str = debug_info1.value().ToString();
-      debug1 = debug_str != "" ? debug_str : "empty";
-    } else {
-      debug1 = " !main";
-    }
-    if (debug_info2.has_value()) {
-      string debug_str = debug_info2.value().ToString();
-      debug2 = debug_str != "" ? debug_str : "empty";
-    } else {
-      debug2 = " !main";
-    }
+    // Every fault description of this pair of events carries
+    // the debug information of both events.
+    const FaultDesc &fault = *fault_entry.second.begin();
+    string debug1 = fault.fs_access1.debug_info.ToString();
+    string debug2 = fault.fs_access2.debug_info.ToString();
+    debug1 = debug1 != "" ? debug1 : "empty";
+    debug2 = debug2 != "" ? debug2 : "empty";
     debug::msg() << "* Event: "
       << block_pair.first << " (tags:" << debug1 << ") and Event: "
       << block_pair.second << " (tags:" << debug2 << "):";
@@ -2,13 +2,16 @@
 #define RACE_DETECTOR_H
 
 #include <map>
+#include <set>
 #include <unordered_map>
 #include <string>
 
 #include "DependencyInferenceAnalyzer.h"
+#include "EventFootprints.h"
 #include "FaultDetector.h"
 #include "FSAnalyzer.h"
 #include "Operation.h"
+#include "ReachabilityIndex.h"
 
 
 namespace op = operation;
@@ -24,7 +27,8 @@ class RaceDetector : public FaultDetector {
 public:
   // Some type aliases.
   using dep_graph_t = analyzer::DependencyInferenceAnalyzer::dep_graph_t;
-  using fs_accesses_table_t = analyzer::FSAnalyzer::fs_accesses_table_t;
+  using epochs_t = analyzer::DependencyInferenceAnalyzer::epochs_t;
+  using fs_access_store_t = analyzer::FSAccessStore;
   using fs_access_t = analyzer::FSAnalyzer::FSAccess;
 
   /**
@@ -58,19 +62,35 @@ public:
     std::string ToString() const;
   };
 
+  /** The strategies used to enumerate conflicting accesses. */
+  enum Strategy {
+    /// Pair the accesses of every path.
+    PATH_CENTRIC,
+    /// Compare the footprints of every pair of unordered events.
+    EVENT_CENTRIC
+  };
+
   // FIXME: Use hash map.
   using faults_t = std::map<std::pair<string, string>, std::set<FaultDesc>>;
 
   /**
    * Constructor of the `RaceDetector` class.
    *
-   * The arguments are const references of the outputs of
-   * the analyzers utilized by this fault detector.
+   * The first three arguments are const references of the outputs of
+   * the analyzers utilized by this fault detector. The remaining ones
+   * are the number of threads used to detect races, and the strategy
+   * used to enumerate conflicting accesses.
    */
-  RaceDetector(const fs_accesses_table_t &fs_accesses_,
-               const dep_graph_t &dep_graph_):
+  RaceDetector(const fs_access_store_t &fs_accesses_,
+               const dep_graph_t &dep_graph_,
+               const epochs_t &epochs_,
+               size_t threads_ = 1,
+               enum Strategy strategy_ = PATH_CENTRIC):
     fs_accesses(fs_accesses_),
-    dep_graph(dep_graph_) {  }
+    dep_graph(dep_graph_),
+    epochs(epochs_),
+    threads(threads_ > 0 ? threads_ : 1),
+    strategy(strategy_) {  }
 
   /** Gets the pretty name of this fault detector. */
   std::string GetName() const {
@@ -79,45 +99,86 @@ public:
 
   /** Checks whether this fault detector supports online analysis. */
   bool SupportOnlineAnalysis() const {
-    return false;
+    return true;
   }
 
   /** Detecting data races. */
   void Detect(void);
-  /** Detecting data races as the application runs. */
+  /**
+   * Detecting data races as the application runs.
+   *
+   * This reports the data races among the events analyzed so far,
+   * except for those that have already been reported.
+   */
   void Detect(std::map<std::string, void*> gen_store);
 
+  /**
+   * Detects the data races that involve the given events, and keeps
+   * them until the final report. If `report` is true, the data races
+   * that have not been reported before are also reported.
+   *
+   * This is used before the analyzers drop the given events, which
+   * happen before all the remaining ones.
+   */
+  void CollectFaults(const std::set<std::string> &events, bool report);
+
 private:
   /// File accesses per block.
-  const fs_accesses_table_t &fs_accesses;
+  const fs_access_store_t &fs_accesses;
   /// The dependency graph of events.
   const dep_graph_t &dep_graph;
-
-  /// Table that tracks debug information of each event.
-  /// Useful for fault reporting.
-  mutable table::Table<string, trace::DebugInfo> event_info;
-
-  mutable unordered_map<string, set<string>> cache_dfs;
+  /// The epochs of events with regards to the MAIN blocks.
+  const epochs_t &epochs;
+  /// Number of threads used to detect data races.
+  size_t threads;
+  /// Strategy used to enumerate conflicting accesses.
+  enum Strategy strategy;
+  /// Faults detected among events that have been collected.
+  faults_t collected_faults;
+
+  /** Adds the given faults to `faults`. */
+  static void MergeFaults(faults_t &faults, const faults_t &other);
 
   /**
    * Gets the list of faults by exploiting the dependency graph
    * and the table of file accesses per block.
+   *
+   * Depending on the strategy, either paths or events are examined
+   * independently by a pool of threads. Every thread collects its faults
+   * in its own buffer, and the buffers are merged at the end, so
+   * the result does not depend on the number of threads.
    */
   faults_t GetFaults() const;
+
+  /** Adds the faults found in the accesses of the given path. */
+  void DetectPath(faults_t &faults, const ReachabilityIndex &index,
+                  analyzer::FSAccessStore::id_t p) const;
+
+  /**
+   * Adds the faults between the given event and every subsequent event
+   * whose footprint conflicts with the footprint of the given event.
+   */
+  void DetectEvent(faults_t &faults, const ReachabilityIndex &index,
+                   const EventFootprints &footprints,
+                   analyzer::FSAccessStore::id_t event_id) const;
   
   /** Dumps reported faults to the standard output. */
   void DumpFaults(const faults_t &faults) const;
 
-  bool HappensBefore(string source, string target) const;
+  /**
+   * Reconstructs the i-th access of the store so that it can be
+   * attached to the description of a fault.
+   */
+  fs_access_t GetAccess(size_t i) const;
 
   /**
-   * Checks whether there is a conflict between the first file access
-   * and the second one.
-   *
-   * A conflict exist when two blocks access the same file, and at least
-   * one of them produces it or expunges it.
+   * Reports a fault on the path `p` between the accesses `first` and
+   * `second` of the store, unless the corresponding events are ordered
+   * by the dependency graph.
    */
-  static bool HasConflict(const fs_access_t &acc1, const fs_access_t &acc2);
+  void AddFault(faults_t &faults, const ReachabilityIndex &index,
+                analyzer::FSAccessStore::id_t p,
+                size_t first, size_t second) const;
 };
 
 
@@ -0,0 +1,222 @@
+#include <algorithm>
+
+#include "ReachabilityIndex.h"
+#include "Utils.h"
+
+
+namespace detector {
+
+
+ReachabilityIndex::ReachabilityIndex(
+    const dep_graph_t &dep_graph,
+    const epochs_t &epochs,
+    const analyzer::FSAccessStore &fs_accesses,
+    size_t threads) {
+  using analyzer::DependencyInferenceAnalyzer;
+  size_t nevents = fs_accesses.NumEvents();
+  vector<uint8_t> candidates = fs_accesses.GetConflictCandidates();
+  vector<id_t> slot_events;
+  slots.assign(nevents, NO_SLOT);
+  for (size_t i = 0; i < nevents; i++) {
+    if (candidates[i]) {
+      slots[i] = slot_events.size();
+      slot_events.push_back(i);
+    }
+  }
+  words = (slot_events.size() + 63) / 64;
+  epoch_in.assign(nevents, 0);
+  epoch_out.assign(nevents, DependencyInferenceAnalyzer::NO_EPOCH);
+  for (size_t i = 0; i < nevents; i++) {
+    auto it = epochs.find(fs_accesses.GetEvent(i));
+    if (it != epochs.end()) {
+      epoch_in[i] = it->second.in;
+      epoch_out[i] = it->second.out;
+    }
+  }
+  // The traversal works on the strongly connected components of the
+  // whole dependency graph, which form a DAG.
+  vector<string> node_ids;
+  vector<vector<uint32_t>> succs;
+  dep_graph.GetAdjacency(node_ids, succs);
+  size_t n = node_ids.size();
+  vector<id_t> node_slots(n, NO_SLOT);
+  for (size_t i = 0; i < n; i++) {
+    optional<id_t> event = fs_accesses.FindEvent(node_ids[i]);
+    if (event.has_value()) {
+      node_slots[i] = slots[event.value()];
+    }
+  }
+  // A node whose in and out epochs are equal is a barrier (or lies on
+  // a cycle with one). Every node that reaches a barrier is ordered
+  // with every node that the barrier reaches by their epochs, so
+  // reachability is not propagated through barriers.
+  vector<uint8_t> is_barrier(n, 0);
+  for (size_t i = 0; i < n; i++) {
+    auto it = epochs.find(node_ids[i]);
+    if (it != epochs.end() && it->second.in == it->second.out) {
+      is_barrier[i] = 1;
+    }
+  }
+
+  // We find the components with Tarjan's algorithm, which completes
+  // every component after all the components reachable from it. So
+  // the components are numbered in reverse topological order.
+  const size_t none = SIZE_MAX;
+  vector<size_t> index(n, none), lowlink(n, 0), node_comps(n, none);
+  vector<uint8_t> on_stack(n, 0);
+  vector<size_t> scc_stack;
+  vector<vector<size_t>> members;
+  size_t next_index = 0;
+  for (size_t root = 0; root < n; root++) {
+    if (index[root] != none) {
+      continue;
+    }
+    // Each frame is a node and the position of its next successor.
+    vector<pair<size_t, size_t>> frames = { { root, 0 } };
+    index[root] = lowlink[root] = next_index++;
+    scc_stack.push_back(root);
+    on_stack[root] = 1;
+    while (!frames.empty()) {
+      size_t node = frames.back().first;
+      size_t &pos = frames.back().second;
+      if (pos < succs[node].size()) {
+        size_t succ = succs[node][pos++];
+        if (index[succ] == none) {
+          index[succ] = lowlink[succ] = next_index++;
+          scc_stack.push_back(succ);
+          on_stack[succ] = 1;
+          frames.push_back({ succ, 0 });
+        } else if (on_stack[succ]) {
+          lowlink[node] = min(lowlink[node], index[succ]);
+        }
+        continue;
+      }
+      frames.pop_back();
+      if (!frames.empty()) {
+        size_t parent = frames.back().first;
+        lowlink[parent] = min(lowlink[parent], lowlink[node]);
+      }
+      if (lowlink[node] != index[node]) {
+        continue;
+      }
+      // The node is the root of a component, so we pop its members.
+      size_t comp = members.size();
+      members.emplace_back();
+      size_t member;
+      do {
+        member = scc_stack.back();
+        scc_stack.pop_back();
+        on_stack[member] = 0;
+        node_comps[member] = comp;
+        members.back().push_back(member);
+      } while (member != node);
+    }
+  }
+
+  // The successors of every component, its number of predecessors,
+  // and its level, i.e., the length of the longest path to a sink.
+  // The components of a level depend only on lower levels, so they
+  // are processed in parallel.
+  size_t ncomps = members.size();
+  vector<vector<size_t>> comp_succs(ncomps);
+  vector<size_t> pending_preds(ncomps, 0), levels(ncomps, 0);
+  vector<uint8_t> comp_barrier(ncomps, 0);
+  vector<vector<size_t>> level_comps;
+  for (size_t comp = 0; comp < ncomps; comp++) {
+    vector<size_t> &comp_succ = comp_succs[comp];
+    for (size_t m : members[comp]) {
+      comp_barrier[comp] |= is_barrier[m];
+      for (size_t succ : succs[m]) {
+        if (node_comps[succ] != comp) {
+          comp_succ.push_back(node_comps[succ]);
+        }
+      }
+    }
+    sort(comp_succ.begin(), comp_succ.end());
+    comp_succ.erase(unique(comp_succ.begin(), comp_succ.end()),
+                    comp_succ.end());
+    for (size_t succ : comp_succ) {
+      pending_preds[succ]++;
+      levels[comp] = max(levels[comp], levels[succ] + 1);
+    }
+    if (levels[comp] >= level_comps.size()) {
+      level_comps.resize(levels[comp] + 1);
+    }
+    level_comps[levels[comp]].push_back(comp);
+  }
+  succs.clear();
+  succs.shrink_to_fit();
+
+  // Every component with candidate events keeps its row in the index.
+  // The rows of the other components are only needed until all their
+  // predecessors have been processed.
+  size_t nslots = slot_events.size();
+  components.assign(nslots, NO_SLOT);
+  vector<size_t> comp_rows(ncomps, none);
+  size_t nrows = 0;
+  for (size_t comp = 0; comp < ncomps; comp++) {
+    for (size_t m : members[comp]) {
+      if (node_slots[m] != NO_SLOT) {
+        if (comp_rows[comp] == none) {
+          comp_rows[comp] = nrows++;
+        }
+        components[node_slots[m]] = comp_rows[comp];
+      }
+    }
+  }
+  // Candidate events that are not part of the dependency graph are not
+  // ordered with any other event, so they have rows on their own.
+  for (size_t slot = 0; slot < nslots; slot++) {
+    if (components[slot] == NO_SLOT) {
+      components[slot] = nrows++;
+    }
+  }
+  reach.assign(nrows * words, 0);
+  for (size_t slot = 0; slot < nslots; slot++) {
+    reach[components[slot] * words + (slot >> 6)] |=
+      (uint64_t) 1 << (slot & 63);
+  }
+  vector<vector<uint64_t>> temp_rows(ncomps);
+  auto get_row = [&](size_t comp) {
+    return comp_rows[comp] != none ? &reach[comp_rows[comp] * words] :
+      temp_rows[comp].data();
+  };
+  for (auto const &comps : level_comps) {
+    for (size_t comp : comps) {
+      if (comp_rows[comp] == none && pending_preds[comp] != 0 &&
+          !comp_barrier[comp]) {
+        temp_rows[comp].assign(words, 0);
+      }
+    }
+    utils::ParallelFor(comps.size(), threads, 64,
+                       [&](size_t, size_t i) {
+      size_t comp = comps[i];
+      if (comp_rows[comp] == none && temp_rows[comp].empty()) {
+        // No other component needs the row of this one.
+        return;
+      }
+      uint64_t *row = get_row(comp);
+      for (size_t succ : comp_succs[comp]) {
+        if (comp_barrier[succ]) {
+          continue;
+        }
+        const uint64_t *succ_row = get_row(succ);
+        for (size_t w = 0; w < words; w++) {
+          row[w] |= succ_row[w];
+        }
+      }
+    });
+    // The rows of successors whose predecessors are all complete
+    // are not needed anymore.
+    for (size_t comp : comps) {
+      for (size_t succ : comp_succs[comp]) {
+        if (--pending_preds[succ] == 0) {
+          vector<uint64_t>().swap(temp_rows[succ]);
+        }
+      }
+    }
+  }
+}
+
+
+} // namespace detector
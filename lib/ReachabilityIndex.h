@@ -0,0 +1,99 @@
+#ifndef REACHABILITY_INDEX_H
+#define REACHABILITY_INDEX_H
+
+#include <cstdint>
+#include <vector>
+
+#include "DependencyInferenceAnalyzer.h"
+#include "FSAccessStore.h"
+
+
+namespace detector {
+
+
+/**
+ * A read-only index that answers happens-before queries between
+ * the events that access the file system.
+ *
+ * Events separated by a barrier (i.e., a MAIN block) are ordered
+ * according to their epochs in O(1). For every event of the access
+ * store that takes part in a conflict, the index also keeps a bitset of
+ * the other such events that are reachable from it. Events without
+ * conflicting accesses (including all the events that never touch
+ * the file system) are never queried, so they are left out of
+ * the bitsets. Once built, the index can be queried by multiple threads
+ * without any synchronization.
+ */
+class ReachabilityIndex {
+public:
+  using dep_graph_t = analyzer::DependencyInferenceAnalyzer::dep_graph_t;
+  using epochs_t = analyzer::DependencyInferenceAnalyzer::epochs_t;
+  using id_t = analyzer::FSAccessStore::id_t;
+
+  /**
+   * Builds the index of the events found in `fs_accesses`.
+   *
+   * The bitsets are computed in a single pass over the strongly
+   * connected components of the dependency graph in reverse topological
+   * order: the bitset of a component is the union of its candidate
+   * events and the bitsets of its successors. The components that
+   * do not depend on each other are processed by the specified number
+   * of threads. The bitset of a component without candidate events is
+   * freed once all its predecessors have been processed. Reachability
+   * is not propagated through barriers, since the events before and
+   * after a barrier are ordered by their epochs.
+   */
+  ReachabilityIndex(const dep_graph_t &dep_graph,
+                    const epochs_t &epochs,
+                    const analyzer::FSAccessStore &fs_accesses,
+                    size_t threads);
+
+  /**
+   * Checks whether the source event happens before the target one.
+   *
+   * Note that the MAIN blocks of the main process are barriers, so they
+   * are ordered by their epochs, while the MAIN blocks of the other
+   * processes are ordered only through the dependency graph.
+   */
+  bool HappensBefore(id_t source, id_t target) const {
+    if (epoch_out[source] <= epoch_in[target]) {
+      // There is a barrier between the two events.
+      return true;
+    }
+    id_t source_slot = slots[source], target_slot = slots[target];
+    if (source_slot == NO_SLOT || target_slot == NO_SLOT) {
+      return false;
+    }
+    return (reach[components[source_slot] * words + (target_slot >> 6)] >>
+            (target_slot & 63)) & 1;
+  }
+
+  /** Checks whether the given events are ordered in any direction. */
+  bool Ordered(id_t event1, id_t event2) const {
+    return HappensBefore(event1, event2) || HappensBefore(event2, event1);
+  }
+
+private:
+  /// Indicates that an event is not part of the bitsets.
+  static constexpr id_t NO_SLOT = (id_t) -1;
+
+  /// The position of every event in the bitsets.
+  std::vector<id_t> slots;
+  /// The row of every slot. The events of a strongly connected
+  /// component reach the same events, so they share their row.
+  std::vector<id_t> components;
+  /// Number of 64-bit words in every row of the index.
+  size_t words;
+  /// The i-th row holds the events reachable from the slots
+  /// of the i-th row.
+  std::vector<uint64_t> reach;
+  /// The last barrier that happens before every event.
+  std::vector<size_t> epoch_in;
+  /// The first barrier that every event happens before.
+  std::vector<size_t> epoch_out;
+};
+
+
+} // namespace detector
+
+#endif
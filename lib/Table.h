@@ -23,19 +23,24 @@ class Table {
       table[key] = value;
     }
 
-    T2 PopEntry(const T1 &key) {
+    optional<T2> PopEntry(const T1 &key) {
+      optional<T2> val;
       typename table_t::iterator it = table.find(key);
       if (it != table.end()) {
-        T2 val = it->second;
+        val = it->second;
         table.erase(it);
-        return val;
       }
+      return val;
     }
 
     void RemoveEntry(const T1 &key) {
       PopEntry(key);
     }
 
+    void Clear() {
+      table.clear();
+    }
+
     optional<T2> GetValue(const T1 &key) const {
       optional<T2> val;
       typename table_t::const_iterator it = table.find(key);
@@ -63,6 +63,23 @@ void ExecOp::MarkLastOperationFailed() {
 }
 
 
+size_t ExecOp::RemoveOperations(
+    const function<bool(const Operation*)> &pred) {
+  size_t removed = 0;
+  vector<Operation*>::iterator it = operations.begin();
+  for (Operation *operation : operations) {
+    if (pred(operation)) {
+      delete operation;
+      removed++;
+    } else {
+      *it++ = operation;
+    }
+  }
+  operations.erase(it, operations.end());
+  return removed;
+}
+
+
 void ExecOp::ClearOperations() {
   for (Operation *operation : operations) {
     delete operation;
@@ -210,12 +227,37 @@ void Trace::ClearExecOps() {
 
 
 void Trace::PopBlock() {
+  delete ReleaseLastBlock();
+}
+
+
+Block *Trace::ReleaseLastBlock() {
   if (blocks.empty()) {
-    return;
+    return nullptr;
   }
-  vector<Block *>::iterator it = blocks.end() - 1;
-  delete *it;
-  blocks.erase(it);
+  Block *block = blocks.back();
+  blocks.pop_back();
+  return block;
+}
+
+
+ExecOp *Trace::ReleaseLastExecOp() {
+  if (exec_ops.empty()) {
+    return nullptr;
+  }
+  ExecOp *exec_op = exec_ops.back();
+  exec_ops.pop_back();
+  return exec_op;
+}
+
+
+size_t Trace::RemoveOperations(
+    const function<bool(const Operation*)> &pred) {
+  size_t removed = 0;
+  for (ExecOp *exec_op : exec_ops) {
+    removed += exec_op->RemoveOperations(pred);
+  }
+  return removed;
 }
 
 
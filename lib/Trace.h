@@ -2,6 +2,7 @@
 #define TRACE_H
 
 
+#include <functional>
 #include <iostream>
 #include <optional>
 #include <vector>
@@ -268,6 +269,12 @@ class ExecOp : public TraceNode {
     /** Marks the last inserted operation as failed. */
     void MarkLastOperationFailed();
 
+    /**
+     * Removes (and deallocates) the operations that satisfy the given
+     * predicate, and returns their number.
+     */
+    size_t RemoveOperations(const function<bool(const Operation*)> &pred);
+
     /** Getter for the `id` field. */
     string GetId() const {
       return id;
@@ -476,6 +483,20 @@ class Block : public TraceNode {
       return block_type == MAIN;
     }
 
+    /**
+     * Get the id of the process that executes the current block.
+     * This is absent when the block belongs to the main process
+     * of the trace.
+     */
+    optional<size_t> GetProcess() const {
+      return process;
+    }
+
+    /** Setter for the `process` field. */
+    void SetProcess(size_t process_) {
+      process = process_;
+    }
+
     /** Gets the last expression of the block and remove it. */
     void PopExpr();
 
@@ -508,6 +529,9 @@ class Block : public TraceNode {
 
     enum Type block_type;
 
+    /// Id of the process that executes the block (if it is not the main one).
+    optional<size_t> process;
+
     /// Clear the vector of expressions and deallocate memory properly.
     void ClearExprs();
 };
@@ -522,6 +546,18 @@ class Block : public TraceNode {
  */
 class Trace : public TraceNode {
   public:
+    /** A process of the program other than the main one. */
+    struct Process {
+      /// Id of the process.
+      size_t pid;
+      /// The working directory of the process when it starts.
+      string cwd;
+      /// Id of the block that creates the process (if known).
+      optional<string> creator;
+      /// Id of the block that waits for the process to terminate
+      /// (if any).
+      optional<string> joiner;
+    };
     
     /** Destruct the current trace. */
     ~Trace() {
@@ -551,6 +587,34 @@ class Trace : public TraceNode {
 
     void PopBlock();
 
+    /**
+     * Removes the last block from the trace without deallocating it,
+     * and returns it (if any). The caller takes ownership of the block.
+     */
+    Block *ReleaseLastBlock();
+
+    /**
+     * Removes the last `execOp` from the trace without deallocating it,
+     * and returns it (if any). The caller takes ownership of it.
+     */
+    ExecOp *ReleaseLastExecOp();
+
+    /** Get the last block of the trace (if any). */
+    const Block *GetLastBlock() const {
+      return blocks.empty() ? nullptr : blocks.back();
+    }
+
+    /** Get the last `execOp` primitive of the trace (if any). */
+    const ExecOp *GetLastExecOp() const {
+      return exec_ops.empty() ? nullptr : exec_ops.back();
+    }
+
+    /**
+     * Removes the operations of every `execOp` that satisfy the given
+     * predicate, and returns their number.
+     */
+    size_t RemoveOperations(const function<bool(const Operation*)> &pred);
+
     /**
      * Get the id of the main thread of the program associated with
      * the current trace.
@@ -577,6 +641,21 @@ class Trace : public TraceNode {
       cwd = cwd_;
     }
 
+    /** Add a process (other than the main one) to the current trace. */
+    void AddProcess(const Process &process) {
+      processes.push_back(process);
+    }
+
+    /** Get the processes of the trace other than the main one. */
+    const vector<Process> &GetProcesses() const {
+      return processes;
+    }
+
+    /** Checks whether the trace involves more than one process. */
+    bool IsMultiProcess() const {
+      return !processes.empty();
+    }
+
     /**
      * This method accepts an analyzer that is responsible for processing
      * the current trace.
@@ -590,6 +669,9 @@ class Trace : public TraceNode {
     /// Vector of execution blocks included in the current trace. */
     vector<Block*> blocks;
 
+    /// Vector of the processes other than the main one.
+    vector<Process> processes;
+
     /// Vector of `execOp` primitives included in the current trace. */
     vector<ExecOp*> exec_ops;
 
@@ -0,0 +1,249 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "Debug.h"
+#include "TraceRing.h"
+
+
+namespace trace_ring {
+
+
+static_assert(atomic<uint64_t>::is_always_lock_free,
+              "rings require lock-free 64-bit atomics");
+
+
+TraceRing *TraceRing::Create(const string &name) {
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    return nullptr;
+  }
+  if (ftruncate(fd, sizeof(Region)) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  void *addr = mmap(nullptr, sizeof(Region), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  // A new shared-memory object is zero-filled, so all rings are empty.
+  return new TraceRing(name, static_cast<Region*>(addr));
+}
+
+
+TraceRing *TraceRing::Attach(const string &name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Region)) {
+    // The producer has not sized the region yet.
+    close(fd);
+    return nullptr;
+  }
+  void *addr = mmap(nullptr, sizeof(Region), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+  return new TraceRing(name, static_cast<Region*>(addr));
+}
+
+
+TraceRing::~TraceRing() {
+  munmap(region, sizeof(Region));
+}
+
+
+void TraceRing::SetHeader(size_t pid, const string &cwd) {
+  region->pid = pid;
+  size_t size = min(cwd.size(), MAX_CWD - 1);
+  memcpy(region->cwd, cwd.data(), size);
+  region->cwd[size] = '\0';
+  region->ready.store(1, memory_order_release);
+}
+
+
+optional<size_t> TraceRing::AcquireRing() {
+  uint32_t ring = region->ring_count.load(memory_order_relaxed);
+  do {
+    if (ring >= MAX_RINGS) {
+      return {};
+    }
+  } while (!region->ring_count.compare_exchange_weak(
+        ring, ring + 1, memory_order_acq_rel));
+  return ring;
+}
+
+
+void TraceRing::CopyTo(Ring &ring, uint64_t offset, const void *src,
+                       size_t size) {
+  size_t start = offset % RING_SIZE;
+  size_t first = min(size, RING_SIZE - start);
+  memcpy(ring.data + start, src, first);
+  memcpy(ring.data, static_cast<const char*>(src) + first, size - first);
+}
+
+
+void TraceRing::CopyFrom(const Ring &ring, uint64_t offset, void *dst,
+                         size_t size) {
+  size_t start = offset % RING_SIZE;
+  size_t first = min(size, RING_SIZE - start);
+  memcpy(dst, ring.data + start, first);
+  memcpy(static_cast<char*>(dst) + first, ring.data, size - first);
+}
+
+
+bool TraceRing::IsConsumerGone() const {
+  if (region->detached.load(memory_order_acquire)) {
+    return true;
+  }
+  uint64_t consumer = region->consumer_pid.load(memory_order_acquire);
+  if (consumer == 0) {
+    return chrono::steady_clock::now() - created > ATTACH_TIMEOUT;
+  }
+  // The consumer may be killed before detaching.
+  return kill(consumer, 0) != 0 && errno != EPERM;
+}
+
+
+void TraceRing::Drop() {
+  region->dropped.fetch_add(1, memory_order_relaxed);
+  if (!dropping.exchange(true)) {
+    debug::warn("TraceRing")
+      << "No consumer reads " << name << ", so records are dropped";
+  }
+}
+
+
+bool TraceRing::Push(size_t ring_id, enum RecordType type,
+                     const string &payload) {
+  if (dropping.load(memory_order_relaxed)) {
+    // Records are never published after one is dropped, so that
+    // the consumer does not see a trace with holes.
+    Drop();
+    return false;
+  }
+  Ring &ring = region->rings[ring_id];
+  // A fragment never exceeds half of the ring, so that the producer
+  // does not need to wait for an empty ring.
+  const size_t max_fragment = RING_SIZE / 2 - sizeof(FragmentHeader);
+  size_t offset = 0;
+  do {
+    FragmentHeader header;
+    header.size = min(payload.size() - offset, max_fragment);
+    header.type = type;
+    header.last = offset + header.size == payload.size();
+    size_t size = sizeof(header) + header.size;
+    uint64_t head = ring.head.load(memory_order_relaxed);
+    while (head + size - ring.tail.load(memory_order_acquire) > RING_SIZE) {
+      // The ring is full, so we wait for the consumer (if any).
+      if (IsConsumerGone()) {
+        Drop();
+        return false;
+      }
+      this_thread::yield();
+    }
+    CopyTo(ring, head, &header, sizeof(header));
+    CopyTo(ring, head + sizeof(header), payload.data() + offset,
+           header.size);
+    ring.head.store(head + size, memory_order_release);
+    offset += header.size;
+  } while (offset < payload.size());
+  return true;
+}
+
+
+void TraceRing::Close() {
+  region->closed.store(1, memory_order_release);
+  size_t dropped = GetDropped();
+  if (dropped > 0) {
+    debug::warn("TraceRing") << dropped << " records were dropped";
+  }
+}
+
+
+bool TraceRing::IsReady() const {
+  return region->ready.load(memory_order_acquire);
+}
+
+
+bool TraceRing::IsClosed() const {
+  return region->closed.load(memory_order_acquire);
+}
+
+
+size_t TraceRing::GetPid() const {
+  return region->pid;
+}
+
+
+string TraceRing::GetCwd() const {
+  return string(region->cwd);
+}
+
+
+size_t TraceRing::GetRingCount() const {
+  return min((size_t) region->ring_count.load(memory_order_acquire),
+             MAX_RINGS);
+}
+
+
+size_t TraceRing::GetDropped() const {
+  return region->dropped.load(memory_order_relaxed);
+}
+
+
+void TraceRing::SetConsumer(size_t pid) {
+  region->consumer_pid.store(pid, memory_order_release);
+}
+
+
+void TraceRing::Detach() {
+  region->detached.store(1, memory_order_release);
+}
+
+
+bool TraceRing::Pop(size_t ring_id, enum RecordType &type,
+                    string &payload) {
+  Ring &ring = region->rings[ring_id];
+  uint64_t tail = ring.tail.load(memory_order_relaxed);
+  while (tail != ring.head.load(memory_order_acquire)) {
+    FragmentHeader header;
+    CopyFrom(ring, tail, &header, sizeof(header));
+    size_t start = partial[ring_id].size();
+    partial[ring_id].resize(start + header.size);
+    CopyFrom(ring, tail + sizeof(header), &partial[ring_id][start],
+             header.size);
+    tail += sizeof(header) + header.size;
+    ring.tail.store(tail, memory_order_release);
+    if (header.last) {
+      type = (enum RecordType) header.type;
+      payload.swap(partial[ring_id]);
+      partial[ring_id].clear();
+      return true;
+    }
+  }
+  return false;
+}
+
+
+void TraceRing::Unlink() {
+  shm_unlink(name.c_str());
+}
+
+
+} // namespace trace_ring
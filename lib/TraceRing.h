@@ -0,0 +1,192 @@
+#ifndef TRACE_RING_H
+#define TRACE_RING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+
+using namespace std;
+
+
+namespace trace_ring {
+
+
+/**
+ * A set of single-producer/single-consumer rings that live in POSIX
+ * shared memory, and carry trace records from an instrumented process
+ * to an analyzer that runs in another process.
+ *
+ * Every thread of the producer owns a ring, so rings need no locks:
+ * the producer only advances the head of a ring, and the consumer only
+ * advances its tail. Records are framed by a small header, and records
+ * that do not fit into a ring are split into fragments.
+ *
+ * When a ring is full, the producer waits for the consumer, so that
+ * no record is lost. The consumer publishes its process id once it
+ * attaches, and marks the region as detached when it stops reading.
+ * If the consumer detaches or dies, or if it does not attach within
+ * `ATTACH_TIMEOUT`, the producer stops waiting: the remaining records
+ * are dropped and counted, and a warning is printed once.
+ */
+class TraceRing {
+public:
+  /// The kinds of records carried by the rings.
+  enum RecordType : uint8_t {
+    EXEC_OP = 1,
+    BLOCK = 2
+  };
+
+  /// The maximum number of rings, i.e., of producer threads.
+  static constexpr size_t MAX_RINGS = 64;
+  /// The capacity of every ring in bytes.
+  static constexpr size_t RING_SIZE = 1 << 20;
+  /// The maximum length of the working directory of the producer.
+  static constexpr size_t MAX_CWD = 4096;
+  /// The time a producer with a full ring waits for the consumer
+  /// to attach.
+  static constexpr chrono::seconds ATTACH_TIMEOUT = chrono::seconds(10);
+
+  /**
+   * Creates a new shared-memory region with the given name, replacing
+   * any existing one.
+   */
+  static TraceRing *Create(const string &name);
+
+  /** Maps the existing shared-memory region with the given name. */
+  static TraceRing *Attach(const string &name);
+
+  /** Unmaps the region. */
+  ~TraceRing();
+
+  // -------- Producer side -----------------------------------------
+
+  /** Publishes the id and the working directory of the producer. */
+  void SetHeader(size_t pid, const string &cwd);
+
+  /** Hands out a new ring (if any is left). */
+  optional<size_t> AcquireRing();
+
+  /**
+   * Appends a record to the given ring. Returns false if the record
+   * is dropped, because there is no consumer to make room for it.
+   */
+  bool Push(size_t ring, enum RecordType type, const string &payload);
+
+  /**
+   * Marks that no more records will be published, and reports
+   * the number of dropped records (if any).
+   */
+  void Close();
+
+  // -------- Consumer side -----------------------------------------
+
+  /** Checks whether the producer has published its header. */
+  bool IsReady() const;
+
+  /** Checks whether the producer has finished. */
+  bool IsClosed() const;
+
+  /** Gets the id of the producer. */
+  size_t GetPid() const;
+
+  /** Gets the working directory of the producer. */
+  string GetCwd() const;
+
+  /** Gets the number of rings handed out so far. */
+  size_t GetRingCount() const;
+
+  /** Gets the number of records that the producer has dropped. */
+  size_t GetDropped() const;
+
+  /** Publishes the id of the consumer that reads the rings. */
+  void SetConsumer(size_t pid);
+
+  /**
+   * Marks that the consumer does not read the rings anymore, so that
+   * the producer does not wait for it.
+   */
+  void Detach();
+
+  /**
+   * Removes the next complete record from the given ring (if any).
+   *
+   * Fragments of a record are accumulated until the last one arrives.
+   */
+  bool Pop(size_t ring, enum RecordType &type, string &payload);
+
+  /** Removes the name of the region. */
+  void Unlink();
+
+private:
+  /// The header that precedes every fragment.
+  struct FragmentHeader {
+    uint32_t size;
+    uint8_t type;
+    uint8_t last;
+  };
+
+  /// A ring of bytes.
+  struct Ring {
+    /// Number of bytes written by the producer.
+    atomic<uint64_t> head;
+    /// Number of bytes consumed by the consumer.
+    atomic<uint64_t> tail;
+    char data[RING_SIZE];
+  };
+
+  /// The layout of the shared-memory region.
+  struct Region {
+    atomic<uint32_t> ready;
+    atomic<uint32_t> closed;
+    atomic<uint32_t> ring_count;
+    atomic<uint32_t> detached;
+    atomic<uint64_t> consumer_pid;
+    atomic<uint64_t> dropped;
+    uint64_t pid;
+    char cwd[MAX_CWD];
+    Ring rings[MAX_RINGS];
+  };
+
+  /// The name of the region.
+  string name;
+  /// The mapped region.
+  Region *region;
+  /// Fragments of records that have not been completed yet (consumer).
+  string partial[MAX_RINGS];
+  /// The time when the region was created (producer).
+  chrono::steady_clock::time_point created;
+  /// Indicates that the consumer is gone, so all records are dropped
+  /// (producer).
+  atomic<bool> dropping;
+
+  TraceRing(const string &name_, Region *region_):
+    name(name_),
+    region(region_),
+    created(chrono::steady_clock::now()),
+    dropping(false) {  }
+
+  /**
+   * Checks whether the consumer has detached or died, or whether it
+   * has not attached within `ATTACH_TIMEOUT`.
+   */
+  bool IsConsumerGone() const;
+
+  /** Counts a dropped record, and warns when the first one is dropped. */
+  void Drop();
+
+  /** Copies the given bytes to the ring, starting at the given offset. */
+  static void CopyTo(Ring &ring, uint64_t offset, const void *src,
+                     size_t size);
+
+  /** Copies bytes from the ring, starting at the given offset. */
+  static void CopyFrom(const Ring &ring, uint64_t offset, void *dst,
+                       size_t size);
+};
+
+
+} // namespace trace_ring
+
+#endif
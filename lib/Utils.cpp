@@ -1,8 +1,11 @@
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "Utils.h"
 
@@ -39,6 +42,42 @@ bool IsNumber(const std::string &str) {
 }
 
 
+void ParallelFor(size_t n, size_t workers, size_t chunk,
+                 const std::function<void(size_t, size_t)> &func) {
+  if (chunk == 0) {
+    chunk = 1;
+  }
+  if (workers <= 1 || n <= chunk) {
+    for (size_t i = 0; i < n; i++) {
+      func(0, i);
+    }
+    return;
+  }
+  std::atomic<size_t> next(0);
+  auto work = [&](size_t worker) {
+    while (true) {
+      size_t begin = next.fetch_add(chunk);
+      if (begin >= n) {
+        break;
+      }
+      size_t end = std::min(begin + chunk, n);
+      for (size_t i = begin; i < end; i++) {
+        func(worker, i);
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t worker = 1; worker < workers; worker++) {
+    threads.emplace_back(work, worker);
+  }
+  // The calling thread acts as the first worker.
+  work(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+
 void timer::Start() {
   start_time = std::chrono::high_resolution_clock::now();
 }
@@ -3,6 +3,7 @@
 
 #include <execinfo.h>
 #include <chrono>
+#include <functional>
 #include <iostream>
 #include <ostream>
 #include <utility>
@@ -31,6 +32,17 @@ std::vector<std::pair<T, T>> Get2Combinations(const C<T> &a) {
   return combs;
 }
 
+/**
+ * Calls `func(worker, i)` for every `i` in [0, n) using the given number
+ * of worker threads.
+ *
+ * Workers pull chunks of consecutive items from a shared counter, so
+ * that uneven items are balanced among them. When a single worker is
+ * requested, the items are processed by the calling thread.
+ */
+void ParallelFor(size_t n, size_t workers, size_t chunk,
+                 const std::function<void(size_t, size_t)> &func);
+
 /** Class that tracks the time interval between two timer periods. */
 class timer {
 public:
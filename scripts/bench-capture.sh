@@ -0,0 +1,79 @@
+#! /bin/bash
+#
+# Compares the capture backends of drfsracer (libc wrappers and
+# system call events) in terms of coverage and overhead.
+#
+# For every given node program, it reports the number of captured
+# operations per kind, and the average execution time (seconds) of
+# the program without instrumentation and with every backend.
+
+runs=5
+while getopts "d:f:n:" opt; do
+  case "$opt" in
+    d)  dynamo_dir=$(realpath $OPTARG)
+        ;;
+    f)  fsracer_dir=$(realpath $OPTARG)
+        ;;
+    n)  runs=$OPTARG
+        ;;
+  esac
+done
+shift $(($OPTIND - 1));
+
+if [ -z $dynamo_dir ]; then
+  echo "You have to specify the directory of DynamoRIO (option -d)"
+  exit 1
+fi
+
+if [ -z $fsracer_dir ]; then
+  echo "You have to specify the directory of FSracer targets (option -f)"
+  exit 1
+fi
+
+if [ $# -eq 0 ]; then
+  echo "Usage: $0 -d <dynamorio dir> -f <fsracer dir> [-n runs] <program.js>..."
+  exit 1
+fi
+
+out_dir=$(mktemp -d)
+trap "rm -rf $out_dir" EXIT
+
+
+function avg_time()
+{
+  local start end
+  start=$(date +%s.%N)
+  for i in $(seq 1 $runs); do
+    "$@" > /dev/null 2>&1
+  done
+  end=$(date +%s.%N)
+  echo "scale=3; ($end - $start) / $runs" | bc
+}
+
+
+function count_ops()
+{
+  local trace=$1
+  for kind in hpath hpathsym newFd delFd link rename symlink; do
+    printf "%s=%s " $kind $(grep -c "^$kind " $trace)
+  done
+}
+
+
+printf "%-30s %-8s %-8s %s\n" "program" "capture" "time" "operations"
+for program in "$@"; do
+  name=$(basename $program)
+  t=$(avg_time node $program)
+  printf "%-30s %-8s %-8s\n" $name "none" $t
+  for capture in libc syscall; do
+    drfsracer="$dynamo_dir/bin64/drrun \
+      -c $fsracer_dir/drfsracer/libdrfsracer.so \
+      -g node \
+      --capture $capture \
+      --output-trace $out_dir/$capture.trace"
+    t=$(avg_time $drfsracer -- node $program)
+    trace=$(ls $out_dir/$capture.trace* | head -1)
+    printf "%-30s %-8s %-8s %s\n" $name $capture $t "$(count_ops $trace)"
+    rm -f $out_dir/$capture.trace*
+  done
+done
@@ -0,0 +1,42 @@
+/*
+ * Creates a file from a child process, which then executes this program
+ * again to check the file. Its first attempt to execute a program fails.
+ * The parent removes the file once the child terminates, so the trace
+ * of the child spans two images of the same process.
+ */
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+#define TEST_FILE "exec.txt"
+
+
+int main(int argc, char **argv) {
+  struct stat buf;
+  if (argc > 1) {
+    return stat(TEST_FILE, &buf) != 0;
+  }
+  pid_t pid = fork();
+  if (pid < 0) {
+    return 1;
+  }
+  if (pid == 0) {
+    int fd = open(TEST_FILE, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (fd < 0) {
+      _exit(1);
+    }
+    close(fd);
+    execl("exec-missing", "exec-missing", (char *) NULL);
+    stat(TEST_FILE, &buf);
+    execl(argv[0], argv[0], "stat", (char *) NULL);
+    _exit(1);
+  }
+  int status;
+  if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0) {
+    return 1;
+  }
+  return unlink(TEST_FILE) != 0;
+}
@@ -0,0 +1,29 @@
+/*
+ * Creates a file, checks it from a child process, and removes it without
+ * waiting for the child, so the check races with the removal.
+ */
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+#define TEST_FILE "fs-ops-nowait.txt"
+
+
+int main(void) {
+  struct stat buf;
+  int fd = open(TEST_FILE, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+  if (fd < 0) {
+    return 1;
+  }
+  close(fd);
+  pid_t pid = fork();
+  if (pid < 0) {
+    return 1;
+  }
+  if (pid == 0) {
+    stat(TEST_FILE, &buf);
+    return 0;
+  }
+  return unlink(TEST_FILE) != 0;
+}
@@ -0,0 +1,29 @@
+/*
+ * Creates a file, checks it from a child process, and then removes it.
+ */
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+#define TEST_FILE "fs-ops.txt"
+
+
+int main(void) {
+  struct stat buf;
+  int fd = open(TEST_FILE, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+  if (fd < 0) {
+    return 1;
+  }
+  close(fd);
+  pid_t pid = fork();
+  if (pid < 0) {
+    return 1;
+  }
+  if (pid == 0) {
+    return stat(TEST_FILE, &buf) != 0;
+  }
+  waitpid(pid, NULL, 0);
+  return unlink(TEST_FILE) != 0;
+}
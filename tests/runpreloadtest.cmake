@@ -0,0 +1,82 @@
+if (NOT FSRACER)
+  message (FATAL_ERROR "Variable `FSRACER` must be defined")
+endif (NOT FSRACER)
+
+if (NOT PRELOAD_LIB)
+  message (FATAL_ERROR "Variable `PRELOAD_LIB` must be defined")
+endif (NOT PRELOAD_LIB)
+
+if (NOT TEST_CMD)
+  message (FATAL_ERROR "Variable `TEST_CMD` must be defined")
+endif (NOT TEST_CMD)
+
+if (NOT EXPECTED_FILE)
+  message (FATAL_ERROR "Variable `EXPECTED_FILE` must be defined")
+endif (NOT EXPECTED_FILE)
+
+get_filename_component(test_name ${TEST_CMD} NAME)
+# Every process of the program writes its trace to <prefix><pid>.
+set(trace_prefix "${CMAKE_CURRENT_BINARY_DIR}/${test_name}.trace.")
+file(GLOB old_traces "${trace_prefix}*")
+if (old_traces)
+  file(REMOVE ${old_traces})
+endif ()
+
+# Run the program with the library preloaded. Only the files of the
+# current directory are traced, so that the files that the loader and
+# libc open do not end up in the trace.
+execute_process(
+  COMMAND ${CMAKE_COMMAND} -E env
+    FSRACER_TRACE_FILE=${trace_prefix}
+    FSRACER_TRACE_INCLUDE=${CMAKE_CURRENT_BINARY_DIR}
+    LD_PRELOAD=${PRELOAD_LIB}
+    ${TEST_CMD}
+  RESULT_VARIABLE result
+)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "The program under test ${TEST_CMD} failed")
+endif ()
+
+# Merge the traces of all processes.
+file(GLOB traces "${trace_prefix}*")
+set(args "")
+foreach (trace ${traces})
+  list(APPEND args -i ${trace})
+endforeach ()
+execute_process(
+  COMMAND ${FSRACER} ${args}
+    --dep-graph-format=csv
+    --dump-dep-graph
+    --fs-accesses-format=csv
+    --dump-fs-accesses
+    --fault-detector=race
+    --dump-trace
+  OUTPUT_VARIABLE output
+  RESULT_VARIABLE result
+)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "fsracer failed to analyze the traces of ${TEST_CMD}")
+endif ()
+
+# Drop the progress messages, which include timings.
+string(REGEX REPLACE "[^\n]*Info\\[[^\n]*\n" "" output "${output}")
+string(REGEX REPLACE "\n" "." output_rep "${output}")
+
+# Process ids and file descriptors vary across runs, so they are
+# matched by placeholders.
+file(READ ${EXPECTED_FILE} pattern)
+string(REGEX REPLACE "([][+.*()^|$])" "\\\\\\1" pattern "${pattern}")
+string(REGEX REPLACE "@NUM@" "[0-9]+" pattern "${pattern}")
+string(REGEX REPLACE "@CURRENT_DIR@" ${CMAKE_CURRENT_BINARY_DIR} pattern
+  "${pattern}")
+string(REGEX REPLACE "\n" "." pattern "${pattern}")
+string(CONCAT pattern "^" "${pattern}" "$")
+string(REGEX MATCH "${pattern}" match "${output_rep}")
+
+if (NOT match)
+  file(WRITE ${test_name}.out "${output}")
+  file(WRITE ${test_name}.pattern "${pattern}")
+  message(SEND_ERROR
+    "Test ${test_name} does not produce the expected trace.\
+    View resulting output at ${test_name}.out.")
+endif (NOT match)
@@ -18,11 +18,23 @@ if (NOT FSRACER_ARGS)
   message (FATAL_ERROR "Variable `FSRACER_ARGS` must be defined")
 endif (NOT FSRACER_ARGS)
 
+# The way file operations are captured (libc or syscall).
+if (NOT CAPTURE)
+  set(CAPTURE "libc")
+endif (NOT CAPTURE)
+string(APPEND FSRACER_ARGS " --capture=${CAPTURE}")
+
 message("Testing with DynamoRIO file: ${DYNAMO_FILE}")
 message("Test Binary: ${TEST_CMD}")
+message("Capturing file operations at: ${CAPTURE}")
 
 # Determine the filename tha contains the expected output.
-string(REPLACE ".js" ".exp" filename ${TEST_FILE})
+# Every capture other than libc has its own expected files.
+if (CAPTURE STREQUAL "libc")
+  string(REPLACE ".js" ".exp" filename ${TEST_FILE})
+else ()
+  string(REPLACE ".js" ".${CAPTURE}.exp" filename ${TEST_FILE})
+endif ()
 # Get the absolute path of the file that holds the expected result.
 get_filename_component(expected_filename
   "${CMAKE_SOURCE_DIR}/../../tests/${TEST_SUITE}/${filename}"
@@ -154,11 +166,11 @@ if (EXISTS "${expected_filename}")
   string(REGEX MATCH ${pattern} match ${output_rep})
 
   if (NOT match)
-    file(WRITE ${TEST_FILE}.out ${output})
-    file(WRITE ${TEST_FILE}.pattern ${pattern})
+    file(WRITE ${TEST_FILE}.${CAPTURE}.out ${output})
+    file(WRITE ${TEST_FILE}.${CAPTURE}.pattern ${pattern})
     message(SEND_ERROR
       "Test ${TEST_FILE} does not produce the expected output.\
-      View resulting output at ${TEST_FILE}.out.")
+      View resulting output at ${TEST_FILE}.${CAPTURE}.out.")
 
   endif (NOT match)
 else ()
@@ -0,0 +1,65 @@
+if (NOT FSRACER)
+  message (FATAL_ERROR "Variable `FSRACER` must be defined")
+endif (NOT FSRACER)
+
+if (NOT TRACE_DIR)
+  message (FATAL_ERROR "Variable `TRACE_DIR` must be defined")
+endif (NOT TRACE_DIR)
+
+if (NOT TRACE_FILES)
+  message (FATAL_ERROR "Variable `TRACE_FILES` must be defined")
+endif (NOT TRACE_FILES)
+
+if (NOT EXPECTED_FILE)
+  message (FATAL_ERROR "Variable `EXPECTED_FILE` must be defined")
+endif (NOT EXPECTED_FILE)
+
+# The trace files are given as a ','-separated list, in the order
+# they are passed to fsracer.
+string(REPLACE "," ";" trace_files ${TRACE_FILES})
+set(args "")
+foreach (trace_file ${trace_files})
+  list(APPEND args -i ${TRACE_DIR}/${trace_file})
+endforeach ()
+
+# By default, every output of fsracer is compared.
+if (NOT FSRACER_ARGS)
+  string(CONCAT FSRACER_ARGS
+    "--dep-graph-format=csv "
+    "--dump-dep-graph "
+    "--fs-accesses-format=csv "
+    "--dump-fs-accesses "
+    "--fault-detector=race "
+    "--dump-trace"
+  )
+endif ()
+separate_arguments(fsracer_args UNIX_COMMAND ${FSRACER_ARGS})
+
+execute_process(
+  COMMAND ${FSRACER} ${args} ${fsracer_args}
+  OUTPUT_VARIABLE output
+  RESULT_VARIABLE result
+)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "fsracer failed to analyze ${TRACE_FILES}")
+endif ()
+
+# Drop the progress messages, which include timings.
+string(REGEX REPLACE "[^\n]*Info\\[[^\n]*\n" "" output "${output}")
+
+if (NOT TEST_NAME)
+  get_filename_component(TEST_NAME ${EXPECTED_FILE} NAME_WE)
+endif ()
+if (NOT EXISTS ${EXPECTED_FILE})
+  # If the file does not exist, we just create the expected file
+  # and pass the current test.
+  file(WRITE ${EXPECTED_FILE} "${output}")
+else ()
+  file(READ ${EXPECTED_FILE} expected)
+  if (NOT output STREQUAL expected)
+    file(WRITE ${TEST_NAME}.out "${output}")
+    message(SEND_ERROR
+      "Analyzing ${TRACE_FILES} does not produce the expected output.\
+      View resulting output at ${TEST_NAME}.out.")
+  endif ()
+endif ()
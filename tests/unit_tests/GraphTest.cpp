@@ -0,0 +1,203 @@
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "DependencyInferenceAnalyzer.h"
+#include "Graph.h"
+#include "UnitTest.h"
+
+
+using dep_graph_t = analyzer::DependencyInferenceAnalyzer::dep_graph_t;
+
+
+/** Prints the given graph in the given format. */
+static string Print(const dep_graph_t &g, enum graph::GraphFormat format) {
+  ostringstream os;
+  g.PrintGraph(format, os);
+  return os.str();
+}
+
+
+/**
+ * Checks that a graph is printed the same way before and after it is
+ * frozen, including the nodes and edges that are omitted.
+ */
+static void TestPrintFrozen() {
+  dep_graph_t g;
+  g.AddNode("MAIN_1", Event(Event::MAIN, 0));
+  g.AddNode("2", Event(Event::S, 0));
+  g.AddNode("3", Event(Event::W, 1));
+  g.AddNode("4", Event(Event::M, 0));
+  g.AddEdge("MAIN_1", "2", graph::CREATES);
+  g.AddEdge("MAIN_1", "3", graph::CREATES);
+  g.AddEdge("2", "3", graph::HAPPENS_BEFORE);
+  g.AddEdge("3", "4", graph::CREATES);
+  // This edge points to a node that is not part of the graph.
+  g.AddEdge("2", "5", graph::HAPPENS_BEFORE);
+  for (auto const &node : { "MAIN_1", "2", "3" }) {
+    g.AddNodeAttr(node, EXECUTED_ATTR);
+  }
+  string dot = Print(g, graph::DOT);
+  string csv = Print(g, graph::CSV);
+  CHECK_EQ(csv, "2,3,before\nMAIN_1,2,creates\nMAIN_1,3,creates\n");
+  // The node 4 is not executed, so it is omitted.
+  CHECK(dot.find("3->4") == string::npos);
+  CHECK(dot.find("2->3[label=\"before\"];") != string::npos);
+
+  g.Freeze();
+  CHECK(g.IsFrozen());
+  CHECK_EQ(Print(g, graph::DOT), dot);
+  CHECK_EQ(Print(g, graph::CSV), csv);
+}
+
+
+/** Gets the edges of the given graph in CSV format, ignoring attributes. */
+static string Edges(const dep_graph_t &g) {
+  dep_graph_t copy = g;
+  for (auto const &entry : g) {
+    copy.AddNodeAttr(entry.first, EXECUTED_ATTR);
+  }
+  return Print(copy, graph::CSV);
+}
+
+
+/** Reduces the given graph; only the given nodes are gone through. */
+static size_t Reduce(dep_graph_t &g, const set<string> &through) {
+  return g.TransitiveReduction(
+      [](const enum graph::EdgeLabel &label) {
+        return label == graph::HAPPENS_BEFORE;
+      },
+      [&through](const string &node_id) {
+        return through.find(node_id) != through.end();
+      });
+}
+
+
+/**
+ * Checks that the reachability among all nodes, and among the nodes
+ * that are gone through, is the same in both graphs.
+ */
+static void CheckSameReachability(const dep_graph_t &before,
+                                  const dep_graph_t &after,
+                                  const set<string> &through) {
+  auto visit = [&through](const string &node_id) {
+    return through.find(node_id) != through.end();
+  };
+  for (auto const &entry : before) {
+    CHECK(before.DFS(entry.first) == after.DFS(entry.first));
+    CHECK(before.DFS(entry.first, visit) == after.DFS(entry.first, visit));
+  }
+}
+
+
+/** Checks the transitive reduction of a DAG. */
+static void TestReduceDAG() {
+  dep_graph_t g;
+  for (auto const &node : { "1", "2", "3", "4" }) {
+    g.AddNode(node, Event(Event::S, 0));
+  }
+  g.AddEdge("1", "2", graph::HAPPENS_BEFORE);
+  g.AddEdge("2", "3", graph::HAPPENS_BEFORE);
+  g.AddEdge("3", "4", graph::HAPPENS_BEFORE);
+  // Both edges are implied by 1 -> 2 -> 3 -> 4.
+  g.AddEdge("1", "3", graph::HAPPENS_BEFORE);
+  g.AddEdge("1", "4", graph::HAPPENS_BEFORE);
+  dep_graph_t before = g;
+  set<string> all = { "1", "2", "3", "4" };
+  CHECK_EQ(Reduce(g, all), 2);
+  CHECK_EQ(Edges(g), "1,2,before\n2,3,before\n3,4,before\n");
+  CheckSameReachability(before, g, all);
+}
+
+
+/** Checks that creation edges are never removed. */
+static void TestReduceKeepsCreates() {
+  dep_graph_t g;
+  for (auto const &node : { "1", "2", "3" }) {
+    g.AddNode(node, Event(Event::S, 0));
+  }
+  g.AddEdge("1", "2", graph::HAPPENS_BEFORE);
+  g.AddEdge("2", "3", graph::HAPPENS_BEFORE);
+  g.AddEdge("1", "3", graph::CREATES);
+  CHECK_EQ(Reduce(g, { "1", "2", "3" }), 0);
+  CHECK_EQ(Edges(g), "1,2,before\n1,3,creates\n2,3,before\n");
+
+  // An edge with both labels loses only its happens-before label.
+  g.AddEdge("1", "3", graph::HAPPENS_BEFORE);
+  CHECK_EQ(Reduce(g, { "1", "2", "3" }), 1);
+  CHECK_EQ(Edges(g), "1,2,before\n1,3,creates\n2,3,before\n");
+}
+
+
+/**
+ * Checks that an edge is only implied by paths whose intermediate nodes
+ * are gone through (e.g., executed events).
+ */
+static void TestReduceThroughExecuted() {
+  dep_graph_t g;
+  for (auto const &node : { "1", "2", "3", "4", "5" }) {
+    g.AddNode(node, Event(Event::S, 0));
+  }
+  // The path 1 -> 2 -> 3 goes through a node that is not executed.
+  g.AddEdge("1", "2", graph::HAPPENS_BEFORE);
+  g.AddEdge("2", "3", graph::HAPPENS_BEFORE);
+  g.AddEdge("1", "3", graph::HAPPENS_BEFORE);
+  // The path 3 -> 4 -> 5 goes through executed nodes only.
+  g.AddEdge("3", "4", graph::HAPPENS_BEFORE);
+  g.AddEdge("4", "5", graph::HAPPENS_BEFORE);
+  g.AddEdge("3", "5", graph::HAPPENS_BEFORE);
+  dep_graph_t before = g;
+  set<string> executed = { "1", "3", "4", "5" };
+  CHECK_EQ(Reduce(g, executed), 1);
+  CHECK_EQ(Edges(g), "1,2,before\n1,3,before\n2,3,before\n"
+           "3,4,before\n4,5,before\n");
+  CheckSameReachability(before, g, executed);
+}
+
+
+/** Checks the transitive reduction of a graph with cycles. */
+static void TestReduceCycles() {
+  dep_graph_t g;
+  for (auto const &node : { "1", "2", "3", "4", "5", "6" }) {
+    g.AddNode(node, Event(Event::S, 0));
+  }
+  // The component {2, 3, 4} is a cycle with a chord.
+  g.AddEdge("2", "3", graph::HAPPENS_BEFORE);
+  g.AddEdge("3", "4", graph::HAPPENS_BEFORE);
+  g.AddEdge("4", "2", graph::HAPPENS_BEFORE);
+  g.AddEdge("2", "4", graph::HAPPENS_BEFORE);
+  // Several edges enter and leave the component.
+  g.AddEdge("1", "2", graph::HAPPENS_BEFORE);
+  g.AddEdge("1", "3", graph::HAPPENS_BEFORE);
+  g.AddEdge("3", "5", graph::HAPPENS_BEFORE);
+  g.AddEdge("4", "5", graph::CREATES);
+  g.AddEdge("5", "6", graph::HAPPENS_BEFORE);
+  g.AddEdge("2", "6", graph::HAPPENS_BEFORE);
+  dep_graph_t before = g;
+  set<string> all = { "1", "2", "3", "4", "5", "6" };
+  // The chord 2 -> 4, one of the edges from 1, the happens-before edge
+  // to 5 (since a creation edge to 5 exists), and the edge 2 -> 6
+  // are redundant.
+  CHECK_EQ(Reduce(g, all), 4);
+  CHECK_EQ(Edges(g), "1,2,before\n2,3,before\n3,4,before\n"
+           "4,2,before\n4,5,creates\n5,6,before\n");
+  CheckSameReachability(before, g, all);
+
+  // Two nodes that only form a cycle keep both edges.
+  dep_graph_t cycle;
+  cycle.AddNode("1", Event(Event::S, 0));
+  cycle.AddNode("2", Event(Event::S, 0));
+  cycle.AddEdge("1", "2", graph::HAPPENS_BEFORE);
+  cycle.AddEdge("2", "1", graph::HAPPENS_BEFORE);
+  CHECK_EQ(Reduce(cycle, { "1", "2" }), 0);
+}
+
+
+int main() {
+  TestPrintFrozen();
+  TestReduceDAG();
+  TestReduceKeepsCreates();
+  TestReduceThroughExecuted();
+  TestReduceCycles();
+  return unit_test::Report();
+}
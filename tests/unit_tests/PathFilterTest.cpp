@@ -0,0 +1,145 @@
+#include <string>
+
+#include "Operation.h"
+#include "PathFilter.h"
+#include "UnitTest.h"
+
+
+using path_filter::PathFilter;
+
+
+/** Creates a filter that traces only the paths that match the glob. */
+static PathFilter Include(const string &glob) {
+  PathFilter filter;
+  filter.AddInclude(glob);
+  return filter;
+}
+
+
+/** Checks that consecutive '**' match any number of components. */
+static void TestCollapseAny() {
+  PathFilter filter = Include("/a/**/**/b");
+  CHECK(filter.IsTraced("/a/b", "/"));
+  CHECK(filter.IsTraced("/a/x/b", "/"));
+  CHECK(filter.IsTraced("/a/x/y/z/b", "/"));
+  // Everything under a matched path is also matched.
+  CHECK(filter.IsTraced("/a/x/b/c", "/"));
+  CHECK(!filter.IsTraced("/a/x/c", "/"));
+  CHECK(!filter.IsTraced("/x/a/b", "/"));
+
+  PathFilter trailing = Include("/a/**");
+  CHECK(trailing.IsTraced("/a", "/"));
+  CHECK(trailing.IsTraced("/a/x/y", "/"));
+  CHECK(!trailing.IsTraced("/b", "/"));
+}
+
+
+/** Checks that relative globs match at any depth. */
+static void TestRelativeGlobs() {
+  PathFilter filter = Include("node_modules/*.js");
+  CHECK(filter.IsTraced("/node_modules/a.js", "/"));
+  CHECK(filter.IsTraced("/p/q/node_modules/a.js", "/"));
+  CHECK(filter.IsTraced("node_modules/a.js", "/p"));
+  CHECK(!filter.IsTraced("/p/node_modules2/a.js", "/"));
+  CHECK(!filter.IsTraced("/p/node_modules/a.ts", "/"));
+
+  // A single literal matches a component, not a substring of it.
+  PathFilter literal = Include("src");
+  CHECK(literal.IsTraced("/w/src/x", "/"));
+  CHECK(!literal.IsTraced("/w/srcs/x", "/"));
+}
+
+
+/** Checks the matching of '*' and '?', which requires backtracking. */
+static void TestWildcards() {
+  PathFilter filter = Include("/d/a*b*c");
+  CHECK(filter.IsTraced("/d/abc", "/"));
+  CHECK(filter.IsTraced("/d/aXbYbZc", "/"));
+  CHECK(filter.IsTraced("/d/abbbc", "/"));
+  CHECK(!filter.IsTraced("/d/acb", "/"));
+  CHECK(!filter.IsTraced("/d/abcd", "/"));
+
+  PathFilter suffix = Include("/d/*.tar.gz");
+  CHECK(suffix.IsTraced("/d/a.tar.tar.gz", "/"));
+  CHECK(suffix.IsTraced("/d/.tar.gz", "/"));
+  CHECK(!suffix.IsTraced("/d/a.tar.gz.bak", "/"));
+
+  PathFilter single = Include("/d/?.js");
+  CHECK(single.IsTraced("/d/x.js", "/"));
+  CHECK(!single.IsTraced("/d/.js", "/"));
+  CHECK(!single.IsTraced("/d/xy.js", "/"));
+
+  // Wildcards never match the separator.
+  PathFilter component = Include("/d/*/x");
+  CHECK(component.IsTraced("/d/a/x", "/"));
+  CHECK(!component.IsTraced("/d/a/b/x", "/"));
+}
+
+
+/** Checks that paths are normalized before they are matched. */
+static void TestNormalization() {
+  PathFilter filter = Include("/w/src");
+  CHECK(filter.IsTraced("../src/x", "/w/tmp"));
+  CHECK(filter.IsTraced("./src/x", "/w"));
+  CHECK(filter.IsTraced("/w/./lib/../src", "/"));
+  CHECK(filter.IsTraced("//w///src/", "/"));
+  CHECK(!filter.IsTraced("/w/src/../lib/y", "/"));
+  // '..' does not go above the root.
+  CHECK(filter.IsTraced("/../../w/src", "/"));
+  CHECK(filter.IsTraced("../../../w/src", "/a"));
+}
+
+
+/** Checks that exclude globs take precedence over include globs. */
+static void TestExcludePrecedence() {
+  PathFilter filter;
+  filter.AddInclude("/w");
+  filter.AddExclude("node_modules");
+  CHECK(filter.IsTraced("/w/a.js", "/"));
+  CHECK(!filter.IsTraced("/w/node_modules/a.js", "/"));
+  CHECK(!filter.IsTraced("/w/node_modules", "/"));
+  CHECK(!filter.IsTraced("/x/a.js", "/"));
+
+  // Without include globs, every path that is not excluded is traced.
+  PathFilter exclude_only;
+  exclude_only.AddExclude("/w/**/*.log");
+  CHECK(!exclude_only.IsEmpty());
+  CHECK(exclude_only.IsTraced("/x/a.js", "/"));
+  CHECK(!exclude_only.IsTraced("/w/a/b.log", "/"));
+  CHECK(!exclude_only.IsTraced("/w/b.log", "/"));
+}
+
+
+/** Checks the filtering of operations. */
+static void TestOperations() {
+  PathFilter filter = Include("/w");
+  CHECK(PathFilter().IsEmpty());
+  CHECK(!filter.IsEmpty());
+  // Paths relative to other dir file descriptors are unknown.
+  CHECK(filter.IsTraced(3, "a", "/x"));
+  CHECK(!filter.IsTraced(AT_FDCWD, "a", "/x"));
+
+  Hpath traced(AT_FDCWD, "a", Hpath::CONSUMED);
+  Hpath ignored(AT_FDCWD, "/x/a", Hpath::CONSUMED);
+  CHECK(filter.IsTraced(&traced, "/w"));
+  CHECK(!filter.IsTraced(&ignored, "/w"));
+  // Operations on many paths are kept if any path is traced.
+  Link link(AT_FDCWD, "/x/a", AT_FDCWD, "/w/a");
+  CHECK(filter.IsTraced(&link, "/"));
+  Rename rename(AT_FDCWD, "/x/a", AT_FDCWD, "/x/b");
+  CHECK(!filter.IsTraced(&rename, "/"));
+  // Operations without paths are always kept.
+  DelFd del_fd(3);
+  CHECK(filter.IsTraced(&del_fd, "/"));
+}
+
+
+int main() {
+  TestCollapseAny();
+  TestRelativeGlobs();
+  TestWildcards();
+  TestNormalization();
+  TestExcludePrecedence();
+  TestOperations();
+  return unit_test::Report();
+}
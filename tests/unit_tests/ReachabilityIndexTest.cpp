@@ -0,0 +1,247 @@
+#include <string>
+#include <vector>
+
+#include "DependencyInferenceAnalyzer.h"
+#include "FSAccessStore.h"
+#include "ReachabilityIndex.h"
+#include "UnitTest.h"
+
+
+using analyzer::DependencyInferenceAnalyzer;
+using analyzer::FSAccessStore;
+using detector::ReachabilityIndex;
+
+using dep_graph_t = DependencyInferenceAnalyzer::dep_graph_t;
+using epochs_t = DependencyInferenceAnalyzer::epochs_t;
+
+
+/**
+ * Builds a small dependency graph with two barriers. Before the second
+ * barrier, the candidate events are connected through a non-candidate
+ * event (3) and a cycle (5 <-> 6).
+ */
+static dep_graph_t BuildGraph() {
+  dep_graph_t g;
+  g.AddNode("MAIN_1", Event(Event::MAIN, 0));
+  g.AddNode("2", Event(Event::S, 0));
+  g.AddNode("3", Event(Event::W, 1));
+  g.AddNode("4", Event(Event::M, 0));
+  g.AddNode("5", Event(Event::EXT, 0));
+  g.AddNode("6", Event(Event::W, 2));
+  g.AddNode("7", Event(Event::S, 0));
+  g.AddNode("MAIN_8", Event(Event::MAIN, 0));
+  g.AddNode("9", Event(Event::S, 0));
+  g.AddNode("10", Event(Event::W, 1));
+  g.AddEdge("MAIN_1", "2", graph::CREATES);
+  g.AddEdge("MAIN_1", "3", graph::CREATES);
+  g.AddEdge("2", "4", graph::CREATES);
+  g.AddEdge("2", "3", graph::HAPPENS_BEFORE);
+  g.AddEdge("3", "5", graph::HAPPENS_BEFORE);
+  g.AddEdge("5", "6", graph::HAPPENS_BEFORE);
+  g.AddEdge("6", "5", graph::HAPPENS_BEFORE);
+  g.AddEdge("4", "7", graph::HAPPENS_BEFORE);
+  g.AddEdge("6", "MAIN_8", graph::HAPPENS_BEFORE);
+  g.AddEdge("7", "MAIN_8", graph::HAPPENS_BEFORE);
+  g.AddEdge("MAIN_8", "9", graph::CREATES);
+  g.AddEdge("MAIN_8", "10", graph::CREATES);
+  g.AddEdge("3", "10", graph::CREATES);
+  return g;
+}
+
+
+/** Builds the file accesses of the events of the graph above. */
+static FSAccessStore BuildAccesses() {
+  FSAccessStore store;
+  DebugInfo debug_info;
+  store.AddAccess("/a", "2", Hpath::PRODUCED, "open", debug_info);
+  store.AddAccess("/a", "4", Hpath::CONSUMED, "open", debug_info);
+  store.AddAccess("/a", "7", Hpath::CONSUMED, "stat", debug_info);
+  store.AddAccess("/a", "9", Hpath::CONSUMED, "stat", debug_info);
+  store.AddAccess("/b", "MAIN_1", Hpath::CONSUMED, "stat", debug_info);
+  store.AddAccess("/b", "5", Hpath::PRODUCED, "open", debug_info);
+  store.AddAccess("/b", "6", Hpath::CONSUMED, "open", debug_info);
+  store.AddAccess("/b", "10", Hpath::EXPUNGED, "unlink", debug_info);
+  // The following events do not take part in any conflict.
+  store.AddAccess("/c", "3", Hpath::PRODUCED, "open", debug_info);
+  store.AddAccess("/d", "MAIN_8", Hpath::CONSUMED, "stat", debug_info);
+  store.Seal();
+  return store;
+}
+
+
+/**
+ * Computes the epochs of every event by definition, i.e., the last
+ * barrier that reaches the event, and the first barrier that the event
+ * reaches.
+ */
+static epochs_t EpochsByDefinition(const dep_graph_t &g,
+                              const vector<string> &events,
+                              const vector<string> &barriers) {
+  epochs_t epochs;
+  for (auto const &event : events) {
+    DependencyInferenceAnalyzer::Epoch epoch = {
+      0, DependencyInferenceAnalyzer::NO_EPOCH };
+    for (size_t k = 1; k <= barriers.size(); k++) {
+      if (g.HasPath(barriers[k - 1], event)) {
+        epoch.in = k;
+      }
+      if (epoch.out == DependencyInferenceAnalyzer::NO_EPOCH &&
+          g.HasPath(event, barriers[k - 1])) {
+        epoch.out = k;
+      }
+    }
+    epochs[event] = epoch;
+  }
+  return epochs;
+}
+
+
+/**
+ * Checks that the index orders every pair of candidate events exactly
+ * like a plain DFS on the dependency graph.
+ */
+static void CheckAgainstDFS(const dep_graph_t &g, const epochs_t &epochs,
+                            const FSAccessStore &store, size_t threads) {
+  ReachabilityIndex index(g, epochs, store, threads);
+  vector<uint8_t> candidates = store.GetConflictCandidates();
+  size_t checked = 0;
+  for (FSAccessStore::id_t i = 0; i < store.NumEvents(); i++) {
+    for (FSAccessStore::id_t j = 0; j < store.NumEvents(); j++) {
+      if (i == j || !candidates[i] || !candidates[j]) {
+        continue;
+      }
+      const string &source = store.GetEvent(i);
+      const string &target = store.GetEvent(j);
+      bool is_main = g.GetNodeObj(source).value().GetEventType() ==
+        Event::MAIN && g.GetNodeObj(target).value().GetEventType() ==
+        Event::MAIN;
+      if (is_main) {
+        // The blocks of the main event are always ordered.
+        CHECK(index.HappensBefore(i, j));
+        continue;
+      }
+      bool expected = g.HasPath(source, target);
+      if (index.HappensBefore(i, j) != expected) {
+        std::cerr << source << " -> " << target << ": expected "
+          << expected << std::endl;
+      }
+      CHECK_EQ(index.HappensBefore(i, j), expected);
+      checked++;
+    }
+  }
+  // Every candidate pair but the main blocks is examined.
+  CHECK(checked > 0);
+}
+
+
+/**
+ * Builds a larger graph, where a chain of MAIN blocks creates events
+ * that are connected by random edges, including edges that go back
+ * (and form cycles) and edges that skip barriers. Every event accesses
+ * one of a few paths, so only some of them are candidates.
+ */
+static void TestRandomGraph() {
+  dep_graph_t g;
+  FSAccessStore store;
+  DebugInfo debug_info;
+  vector<string> barriers;
+  vector<string> nodes;
+  unsigned seed = 7;
+  auto rand = [&seed]() {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+  };
+  for (size_t k = 1; k <= 5; k++) {
+    string main_id = "MAIN_" + to_string(k);
+    g.AddNode(main_id, Event(Event::MAIN, 0));
+    for (auto const &node : nodes) {
+      if (g.GetNodeObj(node).value().GetEventType() != Event::MAIN) {
+        // The sinks and the rest of the events reach the new barrier.
+        g.AddEdge(node, main_id, graph::HAPPENS_BEFORE);
+      }
+    }
+    if (!barriers.empty()) {
+      g.AddEdge(barriers.back(), main_id, graph::HAPPENS_BEFORE);
+    }
+    barriers.push_back(main_id);
+    nodes.push_back(main_id);
+    size_t first = nodes.size();
+    for (size_t i = 0; i < 40; i++) {
+      string event_id = to_string(k * 100 + i);
+      g.AddNode(event_id, Event(Event::EXT, 0));
+      g.AddEdge(main_id, event_id, graph::CREATES);
+      nodes.push_back(event_id);
+      store.AddAccess("/" + to_string(rand() % 6), event_id,
+                      rand() % 3 ? Hpath::CONSUMED : Hpath::PRODUCED,
+                      "open", debug_info);
+    }
+    for (size_t i = 0; i < 60; i++) {
+      size_t a = first + rand() % 40, b = first + rand() % 40;
+      if (a < b || rand() % 8 == 0) {
+        g.AddEdge(nodes[a], nodes[b], graph::HAPPENS_BEFORE);
+      }
+    }
+  }
+  // Some edges go from an epoch to a later one without a barrier.
+  for (size_t i = 0; i < 20; i++) {
+    size_t a = rand() % nodes.size(), b = rand() % nodes.size();
+    if (a < b) {
+      g.AddEdge(nodes[a], nodes[b], graph::CREATES);
+    }
+  }
+  store.Seal();
+  epochs_t epochs = DependencyInferenceAnalyzer::ComputeEpochs(g, barriers);
+  CHECK(!epochs.empty());
+  CheckAgainstDFS(g, epochs_t(), store, 1);
+  CheckAgainstDFS(g, epochs, store, 1);
+  CheckAgainstDFS(g, epochs, store, 4);
+  g.Freeze();
+  CheckAgainstDFS(g, epochs, store, 3);
+}
+
+
+int main() {
+  vector<string> events = { "MAIN_1", "2", "3", "4", "5", "6", "7",
+                            "MAIN_8", "9", "10" };
+  vector<string> barriers = { "MAIN_1", "MAIN_8" };
+  dep_graph_t g = BuildGraph();
+  FSAccessStore store = BuildAccesses();
+
+  // The candidates are the events that access /a and /b.
+  vector<uint8_t> candidates = store.GetConflictCandidates();
+  CHECK(!candidates[store.FindEvent("3").value()]);
+  CHECK(!candidates[store.FindEvent("MAIN_8").value()]);
+  CHECK(candidates[store.FindEvent("2").value()]);
+  CHECK(candidates[store.FindEvent("10").value()]);
+
+  // The analyzer computes the epochs by traversing the graph from every
+  // barrier, and the result must agree with their definition.
+  epochs_t epochs = DependencyInferenceAnalyzer::ComputeEpochs(g, barriers);
+  epochs_t expected = EpochsByDefinition(g, events, barriers);
+  CHECK_EQ(epochs.size(), expected.size());
+  for (auto const &entry : expected) {
+    CHECK_EQ(epochs[entry.first].in, entry.second.in);
+    CHECK_EQ(epochs[entry.first].out, entry.second.out);
+  }
+  CHECK_EQ(epochs["2"].in, 1);
+  CHECK_EQ(epochs["2"].out, 2);
+  CHECK_EQ(epochs["10"].in, 2);
+  CHECK_EQ(epochs["10"].out, DependencyInferenceAnalyzer::NO_EPOCH);
+  // Barriers that are not totally ordered do not give any epochs.
+  CHECK(DependencyInferenceAnalyzer::ComputeEpochs(
+        g, { "MAIN_8", "MAIN_1" }).empty());
+
+  // Without epochs, every answer comes from the projected graph.
+  CheckAgainstDFS(g, epochs_t(), store, 1);
+  // With epochs, the traversals are pruned at the next barrier.
+  CheckAgainstDFS(g, epochs, store, 1);
+  CheckAgainstDFS(g, epochs, store, 4);
+
+  // The same holds for the compact representation of the graph.
+  g.Freeze();
+  CheckAgainstDFS(g, epochs_t(), store, 1);
+  CheckAgainstDFS(g, epochs, store, 2);
+
+  TestRandomGraph();
+  return unit_test::Report();
+}
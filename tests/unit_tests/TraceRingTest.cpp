@@ -0,0 +1,121 @@
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+
+#include "TraceRing.h"
+#include "UnitTest.h"
+
+
+using trace_ring::TraceRing;
+
+
+/// A record that takes more than a third of a ring.
+static const string LARGE_RECORD(TraceRing::RING_SIZE / 3, 'x');
+
+
+/** Gets the name of a region that is unique to this process. */
+static string RingName(const string &suffix) {
+  return "/fsracer-test-" + to_string(getpid()) + "-" + suffix;
+}
+
+
+/** Creates a region with the given suffix. */
+static TraceRing *CreateRing(const string &suffix) {
+  TraceRing *ring = TraceRing::Create(RingName(suffix));
+  CHECK(ring != nullptr);
+  return ring;
+}
+
+
+/** Pushes large records until one of them is dropped. */
+static size_t PushUntilDropped(TraceRing *ring, size_t ring_id) {
+  size_t pushed = 0;
+  while (pushed < 10 &&
+         ring->Push(ring_id, TraceRing::BLOCK, LARGE_RECORD)) {
+    pushed++;
+  }
+  return pushed;
+}
+
+
+/** Checks that every record reaches a consumer that keeps reading. */
+static void TestAliveConsumer() {
+  TraceRing *producer = CreateRing("alive");
+  TraceRing *consumer = TraceRing::Attach(RingName("alive"));
+  CHECK(consumer != nullptr);
+  consumer->SetConsumer(getpid());
+  size_t ring_id = producer->AcquireRing().value();
+  const size_t records = 20;
+  thread writer([&]() {
+    for (size_t i = 0; i < records; i++) {
+      CHECK(producer->Push(ring_id, TraceRing::BLOCK,
+                           LARGE_RECORD + to_string(i)));
+    }
+    producer->Close();
+  });
+  size_t read = 0;
+  enum TraceRing::RecordType type;
+  string payload;
+  while (read < records) {
+    if (consumer->Pop(ring_id, type, payload)) {
+      CHECK_EQ(payload, LARGE_RECORD + to_string(read));
+      read++;
+    }
+  }
+  writer.join();
+  CHECK_EQ(consumer->GetDropped(), 0);
+  consumer->Detach();
+  producer->Unlink();
+  delete consumer;
+  delete producer;
+}
+
+
+/**
+ * Checks that the producer drops records once the consumer has
+ * detached, instead of waiting for it.
+ */
+static void TestDetachedConsumer() {
+  TraceRing *ring = CreateRing("detached");
+  ring->SetConsumer(getpid());
+  ring->Detach();
+  size_t ring_id = ring->AcquireRing().value();
+  // The ring holds two large records, and the third one is dropped.
+  CHECK_EQ(PushUntilDropped(ring, ring_id), 2);
+  CHECK_EQ(ring->GetDropped(), 1);
+  // Once a record is dropped, no other record is published, even
+  // if there is room for it.
+  CHECK(!ring->Push(ring_id, TraceRing::EXEC_OP, "op"));
+  CHECK_EQ(ring->GetDropped(), 2);
+  ring->Unlink();
+  delete ring;
+}
+
+
+/**
+ * Checks that the producer drops records once the consumer dies
+ * without detaching.
+ */
+static void TestDeadConsumer() {
+  pid_t child = fork();
+  if (child == 0) {
+    _exit(0);
+  }
+  waitpid(child, nullptr, 0);
+  TraceRing *ring = CreateRing("dead");
+  ring->SetConsumer(child);
+  size_t ring_id = ring->AcquireRing().value();
+  CHECK_EQ(PushUntilDropped(ring, ring_id), 2);
+  CHECK_EQ(ring->GetDropped(), 1);
+  ring->Unlink();
+  delete ring;
+}
+
+
+int main() {
+  TestAliveConsumer();
+  TestDetachedConsumer();
+  TestDeadConsumer();
+  return unit_test::Report();
+}
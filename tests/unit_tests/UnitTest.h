@@ -0,0 +1,46 @@
+#ifndef UNIT_TEST_H
+#define UNIT_TEST_H
+
+#include <iostream>
+
+
+namespace unit_test {
+
+/// The number of failed checks.
+inline size_t failures = 0;
+
+/** Reports a failed check. */
+inline void Fail(const char *expr, const char *file, int line) {
+  std::cerr << file << ":" << line << ": check failed: " << expr
+    << std::endl;
+  failures++;
+}
+
+/**
+ * Gets the exit status of a unit test, and prints the number of
+ * failed checks (if any).
+ */
+inline int Report() {
+  if (failures > 0) {
+    std::cerr << failures << " check(s) failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace unit_test
+
+
+/// Checks that the given condition holds, and continues otherwise.
+#define CHECK(expr)                                                        \
+  do {                                                                     \
+    if (!(expr)) {                                                         \
+      unit_test::Fail(#expr, __FILE__, __LINE__);                          \
+    }                                                                      \
+  } while (false)
+
+/// Checks that the given values are equal.
+#define CHECK_EQ(lhs, rhs) CHECK((lhs) == (rhs))
+
+
+#endif
@@ -0,0 +1,43 @@
+#include "AccessCache.h"
+
+
+namespace trace_generator {
+
+
+bool AccessCache::IsRedundant(const ExecOp *exec_op, const string &path,
+                              enum Hpath::EffectType effect,
+                              bool follow_symlink, const string &op_name) {
+  if (exec_op != owner) {
+    Clear();
+    owner = exec_op;
+  }
+  if (effect == Hpath::EXPUNGED) {
+    // The path may be an alias of any recorded path.
+    Clear();
+    owner = exec_op;
+    return false;
+  }
+  Entry &entry = entries[hasher(path) % SIZE];
+  if (entry.valid &&
+      entry.effect == effect && entry.follow_symlink == follow_symlink &&
+      entry.path == path && entry.op_name == op_name) {
+    return true;
+  }
+  entry.valid = true;
+  entry.follow_symlink = follow_symlink;
+  entry.effect = effect;
+  entry.path = path;
+  entry.op_name = op_name;
+  return false;
+}
+
+
+void AccessCache::Clear() {
+  for (Entry &entry : entries) {
+    entry.valid = false;
+  }
+  owner = nullptr;
+}
+
+
+} // namespace trace_generator
@@ -0,0 +1,85 @@
+#ifndef ACCESS_CACHE_H
+#define ACCESS_CACHE_H
+
+#include <functional>
+#include <string>
+
+#include "Operation.h"
+#include "Trace.h"
+
+
+using namespace std;
+using namespace operation;
+using namespace trace;
+
+
+namespace trace_generator {
+
+/**
+ * A small per-thread cache of the paths that the current `execOp` of
+ * a thread has recently accessed.
+ *
+ * `FSAnalyzer` keeps a single access per (path, event), so an access
+ * that repeats the last access of the same path with the same effect
+ * and operation (e.g., a build tool that stats the same file many
+ * times) has no effect on the analysis. The cache detects such
+ * accesses, so that they never reach the trace.
+ *
+ * The cache only spans runs of accesses that neither remove nor
+ * rebind files, since such operations (e.g., `unlink`, `open`, `rename`)
+ * may change the file that a path refers to. The generator clears
+ * the cache whenever it records them.
+ *
+ * The cache is direct-mapped: every path occupies the slot of its hash,
+ * and evicts any other path with the same slot. An evicted path is
+ * simply recorded again.
+ */
+class AccessCache {
+  public:
+    /// The number of slots of the cache.
+    static constexpr size_t SIZE = 64;
+
+    /** Constructs an empty cache. */
+    AccessCache():
+      owner(nullptr) {  }
+
+    /**
+     * Checks whether the given access of the given `execOp` repeats
+     * the last recorded access of the same path. Otherwise, the access
+     * is recorded.
+     *
+     * Expunging a path is never redundant, and clears the cache.
+     */
+    bool IsRedundant(const ExecOp *exec_op, const string &path,
+                     enum Hpath::EffectType effect, bool follow_symlink,
+                     const string &op_name);
+
+    /**
+     * Forgets all the recorded accesses.
+     *
+     * This is used when the current `execOp` of the thread completes,
+     * or when an operation may change the file that a path refers to.
+     */
+    void Clear();
+
+  private:
+    /** A recorded access. */
+    struct Entry {
+      bool valid = false;
+      bool follow_symlink;
+      enum Hpath::EffectType effect;
+      string path;
+      string op_name;
+    };
+
+    /// The `execOp` that performs the recorded accesses.
+    const ExecOp *owner;
+    /// The slots of the cache.
+    Entry entries[SIZE];
+    hash<string> hasher;
+};
+
+
+} // namespace trace_generator
+
+#endif
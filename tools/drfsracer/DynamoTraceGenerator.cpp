@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <utility>
 
@@ -7,6 +8,7 @@
 #include "drsyms.h"
 
 
+#include "Debug.h"
 #include "DynamoTraceGenerator.h"
 
 #define CHECK_EXEC_OP                                \
@@ -26,140 +28,522 @@
   string new_path = (const char *) drwrap_get_arg(wrapctx, new_path_pos); \
 
 
+/// The state of a search for symbols in a debug symbol table.
+struct symbol_search {
+  /// The names of the functions we look for.
+  const unordered_set<string> *wanted;
+  /// The offsets of the functions found so far.
+  map<string, size_t> *found;
+};
+
+
 /**
- * This function retrieves the entry point a function.
- *
- * It looks up the entry point by symbol.
- * Initially, it lookups the dynamic symbol table through the invocation
- * of `dr_get_prc_address()`.
+ * This function is called for every symbol of a module, and records
+ * the offset of the symbol if it is one of the functions we look for.
  *
- * However, the documentation states, global functions and variables
- * in an executable are not exported by default in the dynamic symbol table.
- *
- * For that purpose, we use the "drsym" extension to locate symbols
- * by searcing the debug symbol table.
+ * Like `drsym_lookup_symbol()`, we keep the first symbol found when
+ * there are many symbols with the same name (e.g., overloads).
+ * The enumeration stops once all functions are found.
  */
-static app_pc
-get_pc_by_symbol(const module_data_t *mod, const char *symbol)
+static bool
+match_symbol(const char *name, size_t modoffs, void *data)
 {
-  if (mod == NULL || symbol == NULL)
-    return NULL;
-
-  // Try to find the symbol in the dynamic symbol table.
-  app_pc pc = (app_pc) dr_get_proc_address(mod->handle, symbol);
-  if (pc != NULL) {
-    return pc;
-  } else {
-    size_t offset;
-    // Search symbol by omitting its parameters' signature.
-    drsym_error_t err =
-        drsym_lookup_symbol(mod->full_path, symbol, &offset,
-                            DRSYM_DEMANGLE);
-    if (err == DRSYM_SUCCESS) {
-      pc = mod->start + offset;
-      return pc;
-    } else {
-      return NULL;
-    }
+  symbol_search *search = (symbol_search *) data;
+  if (name && search->wanted->count(name)) {
+    search->found->emplace(name, modoffs);
   }
+  return search->found->size() < search->wanted->size();
 }
 
 
 namespace trace_generator {
 
 
-void DynamoTraceGenerator::RegisterFunc(const module_data_t *mod,
-                                        string func_name,
-                                        pre_clb_t pre , post_clb_t post) {
-  app_pc towrap = get_pc_by_symbol(mod, func_name.c_str());
-  void *user_data  = this;
-  if (towrap != NULL) {
-    bool wrapped = drwrap_wrap_ex(towrap, pre, post, user_data,
-        DRWRAP_FLAGS_NONE|DRWRAP_CALLCONV_AMD64);
-    if (!wrapped) {
-      dr_fprintf(STDERR,
-          "FSRacer Error: Couldn't wrap the %s function\n", func_name);
-    } else {
-      // We now register the address of the function to the function registry.
-      // Each entry maps the address of the function to its name.
-      void *ptr = (void *) towrap;
-      string addr = utils::PtrToString(ptr);
-      this->AddFunc(addr, func_name);
+/// The index of the thread-local storage slot holding `ThreadState`.
+static int tls_idx = -1;
+/// The writer that drains the buffers of exiting threads.
+static TraceWriter *active_writer = nullptr;
+/// The states of the running threads, and the lock protecting them.
+static vector<ThreadState*> thread_states;
+static void *states_lock = nullptr;
+
+
+static void
+thread_init_event(void *drcontext)
+{
+  ThreadState *state = (ThreadState *) dr_thread_alloc(
+      drcontext, sizeof(ThreadState));
+  state->exec_op = nullptr;
+  state->open_path = nullptr;
+  state->fs_work_depth = 0;
+  state->trace_buf = new string();
+  state->buf_lock = dr_mutex_create();
+  state->ring = -1;
+  state->call_depth = 0;
+  state->pending_syscall = -1;
+  state->pending_dirfd = AT_FDCWD;
+  state->pending_path = new string();
+  state->pending_flags = 0;
+  state->pending_status = nullptr;
+  state->op_filtered = false;
+  state->accesses = new AccessCache();
+  drmgr_set_tls_field(drcontext, tls_idx, state);
+  dr_mutex_lock(states_lock);
+  thread_states.push_back(state);
+  dr_mutex_unlock(states_lock);
+}
+
+
+static void
+thread_exit_event(void *drcontext)
+{
+  ThreadState *state = (ThreadState *) drmgr_get_tls_field(
+      drcontext, tls_idx);
+  if (state) {
+    dr_mutex_lock(states_lock);
+    thread_states.erase(
+        remove(thread_states.begin(), thread_states.end(), state),
+        thread_states.end());
+    if (active_writer) {
+      active_writer->Flush(*state->trace_buf);
     }
+    dr_mutex_unlock(states_lock);
+    delete state->trace_buf;
+    dr_mutex_destroy(state->buf_lock);
+    delete state->pending_path;
+    delete state->accesses;
+    dr_thread_free(drcontext, state, sizeof(ThreadState));
+    drmgr_set_tls_field(drcontext, tls_idx, nullptr);
   }
 }
 
 
-void DynamoTraceGenerator::Setup(const module_data_t *mod) {
-  for (pair<string, pair<pre_clb_t, post_clb_t>> entry : GetWrappers()) {
-    string func_name = entry.first;
-    pair<pre_clb_t, post_clb_t> func_pair = entry.second;
-    RegisterFunc(mod, func_name, func_pair.first, func_pair.second);
+bool DynamoTraceGenerator::InitThreadStates() {
+  tls_idx = drmgr_register_tls_field();
+  if (tls_idx == -1) {
+    return false;
+  }
+  states_lock = dr_mutex_create();
+  return drmgr_register_thread_init_event(thread_init_event) &&
+    drmgr_register_thread_exit_event(thread_exit_event);
+}
+
+
+void DynamoTraceGenerator::ExitThreadStates() {
+  if (tls_idx == -1) {
+    return;
   }
+  drmgr_unregister_thread_init_event(thread_init_event);
+  drmgr_unregister_thread_exit_event(thread_exit_event);
+  drmgr_unregister_tls_field(tls_idx);
+  tls_idx = -1;
+  dr_mutex_destroy(states_lock);
+  states_lock = nullptr;
 }
 
 
-void DynamoTraceGenerator::AddToStore(string key, void *value) {
-  store[key] = value;
+ThreadState *DynamoTraceGenerator::GetThreadState(void *wrapctx) {
+  return GetDrThreadState(drwrap_get_drcontext(wrapctx));
 }
 
 
-void *DynamoTraceGenerator::GetStoreValue(const string &key) const {
-  map<string, void*>::const_iterator it;
-  it = store.find(key);
-  if (it == store.end()) {
+ThreadState *DynamoTraceGenerator::GetDrThreadState(void *drcontext) {
+  if (tls_idx == -1) {
     return nullptr;
-  } else {
-    return it->second;
   }
+  return (ThreadState *) drmgr_get_tls_field(drcontext, tls_idx);
 }
 
 
-void DynamoTraceGenerator::DeleteFromStore(const string &key) {
-  PopFromStore(key);
+
+void DynamoTraceGenerator::SetOnlineCallbacks(exec_op_clb_t exec_op_clb_,
+                                              block_clb_t block_clb_,
+                                              bool keep_trace_) {
+  if (!online_lock) {
+    online_lock = dr_mutex_create();
+  }
+  exec_op_clb = exec_op_clb_;
+  block_clb = block_clb_;
+  keep_trace = keep_trace_;
 }
 
 
-void *DynamoTraceGenerator::PopFromStore(const string &key) {
-  map<string, void*>::iterator it = store.find(key);
-  void *value = nullptr;
-  if (it != store.end()) {
-    value = it->second;
-    store.erase(it);
+void DynamoTraceGenerator::SetTraceWriter(TraceWriter *writer,
+                                          bool keep_trace_) {
+  trace_writer = writer;
+  keep_trace = keep_trace_;
+  active_writer = writer;
+  if (!block_buf_lock) {
+    block_buf_lock = dr_mutex_create();
   }
-  return value;
 }
 
 
-void DynamoTraceGenerator::PushFunction(const string func_name) {
-  call_stack.push(func_name);
+void DynamoTraceGenerator::SetTraceRing(trace_ring::TraceRing *ring,
+                                        bool keep_trace_) {
+  trace_ring = ring;
+  keep_trace = keep_trace_;
+  if (!ring_lock) {
+    ring_lock = dr_mutex_create();
+  }
 }
 
 
-void DynamoTraceGenerator::PopStack() {
-  if (!call_stack.empty()) {
-    call_stack.pop();
+void DynamoTraceGenerator::FlushTrace() {
+  if (!trace_writer) {
+    return;
+  }
+  dr_mutex_lock(block_buf_lock);
+  trace_writer->Flush(block_buf);
+  dr_mutex_unlock(block_buf_lock);
+  dr_mutex_lock(states_lock);
+  for (auto const &state : thread_states) {
+    dr_mutex_lock(state->buf_lock);
+    trace_writer->Flush(*state->trace_buf);
+    dr_mutex_unlock(state->buf_lock);
   }
+  dr_mutex_unlock(states_lock);
 }
 
 
-string DynamoTraceGenerator::TopStack() const {
-  return call_stack.top();
+void DynamoTraceGenerator::MaybeRotate() {
+  if (!trace_writer) {
+    return;
+  }
+  prologue.ForgetUnsubmittedOps();
+  // The first segment always starts with the first MAIN block.
+  if (!trace_writer->IsRotationPending() || GetMainBlockCount() == 0) {
+    return;
+  }
+  // No thread may complete an `execOp` until the new segment starts,
+  // so that the prologue agrees with what the segments hold.
+  dr_mutex_lock(states_lock);
+  dr_mutex_lock(block_buf_lock);
+  trace_writer->Flush(block_buf);
+  for (auto const &state : thread_states) {
+    dr_mutex_lock(state->buf_lock);
+    trace_writer->Flush(*state->trace_buf);
+  }
+  // The prologue re-creates the alive events in the last MAIN block,
+  // so that they precede the MAIN block that starts the segment,
+  // as they do in the whole trace.
+  if (!trace_writer->Rotate(prologue.ToString(GetMainBlockCount()))) {
+    debug::err(GetName()) << "Unable to open the next segment of "
+      << trace_writer->GetFilename();
+  }
+  for (auto const &state : thread_states) {
+    dr_mutex_unlock(state->buf_lock);
+  }
+  dr_mutex_unlock(block_buf_lock);
+  dr_mutex_unlock(states_lock);
+}
+
+
+void DynamoTraceGenerator::AddMainBlock() {
+  CompleteCurrentBlock();
+  // Segments of the trace file start at MAIN blocks.
+  MaybeRotate();
+  IncrMainBlockCount();
+  SetCurrentBlock(new Block(GetMainBlockCount(), Block::MAIN));
+  trace->AddBlock(GetCurrentBlock());
+}
+
+
+void DynamoTraceGenerator::PublishRecord(
+    ThreadState *state, enum trace_ring::TraceRing::RecordType type,
+    const string &record) {
+  if (state && state->ring == -1) {
+    optional<size_t> ring = trace_ring->AcquireRing();
+    // -2 marks a thread that uses the shared ring.
+    state->ring = ring.has_value() ? (int) ring.value() : -2;
+  }
+  if (state && state->ring >= 0) {
+    trace_ring->Push(state->ring, type, record);
+    return;
+  }
+  // There are more threads than rings, so the remaining threads
+  // share a ring.
+  dr_mutex_lock(ring_lock);
+  if (!shared_ring.has_value()) {
+    shared_ring = trace_ring->AcquireRing();
+  }
+  if (shared_ring.has_value()) {
+    trace_ring->Push(shared_ring.value(), type, record);
+  }
+  dr_mutex_unlock(ring_lock);
+}
+
+
+void DynamoTraceGenerator::CompleteExecOp(ThreadState *state) {
+  ExecOp *exec_op = state->exec_op;
+  state->exec_op = nullptr;
+  ForgetAccesses(state);
+  if (!exec_op) {
+    return;
+  }
+  if (trace_writer) {
+    dr_mutex_lock(state->buf_lock);
+    trace_writer->WriteExecOp(*state->trace_buf, exec_op);
+    prologue.AddExecOp(exec_op);
+    dr_mutex_unlock(state->buf_lock);
+  }
+  if (trace_ring) {
+    PublishRecord(state, trace_ring::TraceRing::EXEC_OP,
+                  TraceWriter::ExecOpToString(exec_op));
+  }
+  if (online_lock) {
+    // Operations are executed by the worker threads of the program,
+    // so we only queue the `execOp` here. Its consumer frees it
+    // (if it is not part of the trace).
+    dr_mutex_lock(online_lock);
+    completed_exec_ops.push_back(exec_op);
+    dr_mutex_unlock(online_lock);
+  } else if (DropsTrace()) {
+    // The `execOp` has not been added to the trace.
+    delete exec_op;
+  }
 }
 
 
-void DynamoTraceGenerator::AddFunc(string addr, string func_name) {
-  funcs[addr] = func_name;
+void DynamoTraceGenerator::CompleteCurrentBlock() {
+  if (!current_block) {
+    return;
+  }
+  if (trace_writer) {
+    dr_mutex_lock(block_buf_lock);
+    trace_writer->WriteBlock(block_buf, current_block);
+    prologue.AddBlock(current_block);
+    dr_mutex_unlock(block_buf_lock);
+  }
+  if (trace_ring) {
+    ThreadState *state = GetDrThreadState(dr_get_current_drcontext());
+    PublishRecord(state, trace_ring::TraceRing::BLOCK,
+                  TraceWriter::BlockToString(current_block));
+  }
+  if (online_lock) {
+    ConsumeExecOps();
+    if (DropsTrace()) {
+      // The consumer of the block frees it once it is analyzed.
+      trace->ReleaseLastBlock();
+    }
+    block_clb(current_block);
+  } else if (DropsTrace()) {
+    // The current block is always the last block of the trace.
+    trace->PopBlock();
+  }
+  current_block = nullptr;
 }
 
 
-string DynamoTraceGenerator::GetFuncName(const string &addr) const {
-  map<string, string>::const_iterator it = funcs.find(addr);
+void DynamoTraceGenerator::FlushExecOps() {
+  if (online_lock) {
+    ConsumeExecOps();
+  }
+}
+
 
-  if (it != funcs.end()) {
-    return it->second;
+void DynamoTraceGenerator::AddNewProc(ThreadState *state,
+                                      NewProc *new_proc) {
+  if (state->exec_op) {
+    state->exec_op->AddOperation(new_proc);
+    return;
+  }
+  if (!current_block) {
+    // The process is created before the first block of the program.
+    delete new_proc;
+    return;
+  }
+  AddSyncOp(state, new_proc);
+  if (current_block->IsMain()) {
+    AddMainBlock();
   }
-  return "";
+}
+
+
+void DynamoTraceGenerator::AddWaitProc(ThreadState *state,
+                                       WaitProc *wait_proc) {
+  if (state->exec_op) {
+    state->exec_op->AddOperation(wait_proc);
+    return;
+  }
+  if (!current_block) {
+    delete wait_proc;
+    return;
+  }
+  if (current_block->IsMain()) {
+    AddMainBlock();
+  }
+  AddSyncOp(state, wait_proc);
+}
+
+
+void DynamoTraceGenerator::AddSyncOp(ThreadState *state,
+                                     Operation *operation) {
+  IncrSyncOpCount();
+  string id = "sync_" + to_string(GetSyncOpCount());
+  SubmitOp *submit_op = new SubmitOp(id);
+  submit_op->AddDebugInfo(operation->GetActualOpName());
+  current_block->AddExpr(submit_op);
+  ExecOp *exec_op = new ExecOp(id);
+  exec_op->AddOperation(operation);
+  AddExecOp(exec_op);
+  state->exec_op = exec_op;
+  CompleteExecOp(state);
+}
+
+
+void DynamoTraceGenerator::ResetAfterFork(void *drcontext) {
+  // The other threads of the parent may hold locks at the time of
+  // the fork, and they never release them in the child.
+  states_lock = dr_mutex_create();
+  trace_lock = dr_mutex_create();
+  if (online_lock) {
+    online_lock = dr_mutex_create();
+  }
+  if (block_buf_lock) {
+    block_buf_lock = dr_mutex_create();
+  }
+  prologue.ResetAfterFork();
+  ThreadState *state = GetDrThreadState(drcontext);
+  thread_states.clear();
+  if (state) {
+    state->buf_lock = dr_mutex_create();
+    state->trace_buf->clear();
+    thread_states.push_back(state);
+  }
+  block_buf.clear();
+  if (DropsTrace()) {
+    for (auto const &exec_op : completed_exec_ops) {
+      delete exec_op;
+    }
+  }
+  completed_exec_ops.clear();
+}
+
+
+void DynamoTraceGenerator::ConsumeExecOps() {
+  vector<const ExecOp*> exec_ops;
+  dr_mutex_lock(online_lock);
+  exec_ops.swap(completed_exec_ops);
+  dr_mutex_unlock(online_lock);
+  for (auto const &exec_op : exec_ops) {
+    exec_op_clb(exec_op);
+  }
+}
+
+
+bool DynamoTraceGenerator::MaySearchSymbols(const module_data_t *mod) const {
+  if (!mod->full_path) {
+    return false;
+  }
+  if (symbol_modules.empty()) {
+    return true;
+  }
+  string path = mod->full_path;
+  for (auto const &module : symbol_modules) {
+    if (path.find(module) != string::npos) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+void DynamoTraceGenerator::RegisterFunc(string func_name, app_pc towrap,
+                                        pre_clb_t pre , post_clb_t post) {
+  void *user_data  = this;
+  bool wrapped = drwrap_wrap_ex(towrap, pre, post, user_data,
+      DRWRAP_FLAGS_NONE|DRWRAP_CALLCONV_AMD64);
+  if (!wrapped) {
+    dr_fprintf(STDERR,
+        "FSRacer Error: Couldn't wrap the %s function\n", func_name);
+  }
+}
+
+
+void DynamoTraceGenerator::Setup(const module_data_t *mod) {
+  if (!mod) {
+    return;
+  }
+  wrapper_t wrappers = GetWrappers();
+  string module_key = symbol_cache ?
+    SymbolCache::GetModuleKey(mod) : "";
+  map<string, size_t> offsets;
+  // Functions that are neither cached nor exported.
+  unordered_set<string> wanted;
+  // Functions that are exported, but not cached.
+  vector<string> exported;
+  for (auto const &entry : wrappers) {
+    const string &func_name = entry.first;
+    optional<size_t> offset;
+    if (symbol_cache &&
+        symbol_cache->Lookup(module_key, func_name, offset)) {
+      if (offset.has_value()) {
+        offsets[func_name] = offset.value();
+      }
+      continue;
+    }
+    // Try to find the symbol in the dynamic symbol table.
+    app_pc pc = (app_pc) dr_get_proc_address(mod->handle, func_name.c_str());
+    if (pc != NULL) {
+      offsets[func_name] = pc - mod->start;
+      exported.push_back(func_name);
+    } else {
+      wanted.insert(func_name);
+    }
+  }
+
+  // However, global functions of an executable are not exported by
+  // default, so we search the debug symbol table through the "drsym"
+  // extension. Instead of looking up every function separately
+  // (each lookup searches the whole table), we enumerate the symbols
+  // once, omitting their parameters' signature.
+  bool searched = false;
+  if (!wanted.empty() && MaySearchSymbols(mod)) {
+    map<string, size_t> found;
+    symbol_search search = { &wanted, &found };
+    // A module without debug symbols fails the same way every time,
+    // so its functions are cached as missing too.
+    drsym_enumerate_symbols(mod->full_path, match_symbol, &search,
+                            DRSYM_DEMANGLE);
+    offsets.insert(found.begin(), found.end());
+    searched = true;
+  }
+
+  if (symbol_cache) {
+    for (auto const &func_name : exported) {
+      symbol_cache->Add(module_key, func_name, offsets[func_name]);
+    }
+    for (auto const &func_name : wanted) {
+      auto it = offsets.find(func_name);
+      if (it != offsets.end()) {
+        symbol_cache->Add(module_key, func_name, it->second);
+      } else if (searched) {
+        // We also cache missing symbols, because most modules
+        // (e.g., libc) define none of the wrapped functions.
+        symbol_cache->Add(module_key, func_name, {});
+      }
+    }
+  }
+
+  for (auto const &entry : wrappers) {
+    auto it = offsets.find(entry.first);
+    if (it != offsets.end()) {
+      RegisterFunc(entry.first, mod->start + it->second,
+                   entry.second.first, entry.second.second);
+    }
+  }
+}
+
+
+void DynamoTraceGenerator::AddExecOp(ExecOp *exec_op) {
+  if (DropsTrace()) {
+    // The `execOp` is written and freed once it is completed.
+    return;
+  }
+  dr_mutex_lock(trace_lock);
+  trace->AddExecOp(exec_op);
+  dr_mutex_unlock(trace_lock);
 }
 
 
@@ -200,26 +584,31 @@ GetTraceGenerator(void **data)
 }
 
 
-void
-DefaultPre(void *wrapctx, OUT void **user_data)
+/**
+ * Records whether the next operation of the given thread is kept,
+ * and returns it.
+ *
+ * The status of a dropped operation must not be attributed to
+ * the previous operation of the `execOp`.
+ */
+static bool
+keep_operation(trace_generator::ThreadState *state, bool keep)
 {
-  // Push the name of the function we wrap onto the stack.
-  void *ptr = drwrap_get_func(wrapctx);
-  string addr = utils::PtrToString(ptr);
-  trace_generator::DynamoTraceGenerator *trace_gen = GetTraceGenerator(user_data);
-  string func_name = trace_gen->GetFuncName(addr);
-  if (func_name != "") {
-    trace_gen->PushFunction(func_name);
+  if (state) {
+    state->op_filtered = !keep;
   }
+  return keep;
 }
 
 
 void
 DefaultPost(void *wrapctx, void *user_data)
 {
-  trace_generator::DynamoTraceGenerator *trace_gen =
-    (trace_generator::DynamoTraceGenerator *) (user_data);
-  trace_gen->PopStack();
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  if (state) {
+    state->PopWrapper();
+  }
 }
 
 
@@ -228,6 +617,10 @@ EmitDelFd(void *wrapctx, OUT void **user_data, size_t fd_pos,
           exec_op_t get_exec_op, string op_name)
 {
   CHECK_EXEC_OP;
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  keep_operation(state, true);
+  trace_generator::DynamoTraceGenerator::ForgetAccesses(state);
   int fd = (int)(intptr_t) drwrap_get_arg(wrapctx, fd_pos);
   DelFd *delfd = new DelFd(fd);
   delfd->SetActualOpName(op_name);
@@ -244,6 +637,15 @@ EmitHpath(void *wrapctx, OUT void **user_data, size_t path_pos,
   trace_generator::DynamoTraceGenerator *generator = GetTraceGenerator(
       user_data);
   string path = (const char *) drwrap_get_arg(wrapctx, path_pos);
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  bool keep = !generator || (
+      generator->IsTraced(AT_FDCWD, path) &&
+      !generator->IsRedundant(state, AT_FDCWD, path, effect_type,
+                              follow_symlink, op_name));
+  if (!keep_operation(state, keep)) {
+    return;
+  }
   if (follow_symlink) {
     Hpath *hpath = new Hpath(AT_FDCWD, path, effect_type);
     hpath->SetActualOpName(op_name);
@@ -262,6 +664,14 @@ EmitLink(void *wrapctx, OUT void **user_data, size_t old_path_pos,
 {
   CHECK_EXEC_OP;
   MULTIPATH;
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  if (!keep_operation(state, !trace_gen ||
+                     trace_gen->IsTraced(AT_FDCWD, old_path) ||
+                     trace_gen->IsTraced(AT_FDCWD, new_path))) {
+    return;
+  }
+  trace_generator::DynamoTraceGenerator::ForgetAccesses(state);
   Link *link = new Link(AT_FDCWD, old_path, AT_FDCWD, new_path);
   link->SetActualOpName(op_name);
   exec_op->AddOperation(link);
@@ -274,6 +684,14 @@ EmitRename(void *wrapctx, OUT void **user_data, size_t old_path_pos,
 {
   CHECK_EXEC_OP;
   MULTIPATH;
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  if (!keep_operation(state, !trace_gen ||
+                     trace_gen->IsTraced(AT_FDCWD, old_path) ||
+                     trace_gen->IsTraced(AT_FDCWD, new_path))) {
+    return;
+  }
+  trace_generator::DynamoTraceGenerator::ForgetAccesses(state);
   Rename *rename = new Rename(AT_FDCWD, old_path, AT_FDCWD, new_path);
   rename->SetActualOpName(op_name);
   exec_op->AddOperation(rename);
@@ -286,6 +704,13 @@ EmitSymlink(void *wrapctx, OUT void **user_data, size_t old_path_pos,
 {
   CHECK_EXEC_OP;
   MULTIPATH;
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  if (!keep_operation(state, !trace_gen ||
+                     trace_gen->IsTraced(AT_FDCWD, new_path))) {
+    return;
+  }
+  trace_generator::DynamoTraceGenerator::ForgetAccesses(state);
   Symlink *symlink = new Symlink(AT_FDCWD, new_path, old_path);
   symlink->SetActualOpName(op_name);
   exec_op->AddOperation(symlink);
@@ -296,6 +721,11 @@ void MarkOperationStatus(void *wrapctx, void *user_data,
                          exec_op_post_t get_exec_op)
 {
   CHECK_EXEC_OP;
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  if (state && state->op_filtered) {
+    return;
+  }
   int ret_val = (int)(ptr_int_t) drwrap_get_retval(wrapctx);
   if (ret_val < 0) {
     exec_op->MarkLastOperationFailed();
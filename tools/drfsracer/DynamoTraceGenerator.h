@@ -1,19 +1,29 @@
 #ifndef GENERATOR_H
 #define GENERATOR_H
 
+#include <functional>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <utility>
-#include <stack>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
 
 #include "dr_api.h"
 #include "drmgr.h"
 #include "drwrap.h"
 #include "drsyms.h"
 
+#include "AccessCache.h"
+#include "PathFilter.h"
+#include "SegmentPrologue.h"
+#include "SymbolCache.h"
 #include "Utils.h"
 #include "Trace.h"
 #include "TraceGenerator.h"
+#include "TraceRing.h"
+#include "TraceWriter.h"
 
 
 using namespace trace;
@@ -28,6 +38,87 @@ using post_clb_t = void (*)(void *wrapctx, void *user_data);
 
 namespace trace_generator {
 
+
+/// The id of a wrapped function. Ids are assigned at compile time
+/// by the trace generators (see `generator_utils::DefaultPre`).
+using wrapper_id_t = uint16_t;
+/// The id that corresponds to no wrapped function.
+const wrapper_id_t NO_WRAPPER = 0;
+/// The maximum depth of wrapped functions recorded per thread.
+const size_t MAX_CALL_DEPTH = 64;
+
+
+/**
+ * The state of a thread of the traced program.
+ *
+ * Every thread owns its state through a thread-local storage slot,
+ * so wrappers that run on different threads never share it.
+ */
+struct ThreadState {
+  /// The `execOp` whose operations are currently performed by the thread.
+  ExecOp *exec_op;
+  /// The path passed to the `open` call that has not returned yet.
+  const char *open_path;
+  /// Number of `uv__fs_work` invocations in the call stack of the thread.
+  size_t fs_work_depth;
+  /// The trace entries written by the thread that have not been
+  /// drained to the trace file yet.
+  string *trace_buf;
+  /// Lock protecting `trace_buf`, which is also drained by other
+  /// threads (e.g., when the client is nudged).
+  void *buf_lock;
+  /// The shared-memory ring where the thread publishes the trace
+  /// (-1 if it has not been acquired yet).
+  int ring;
+  /// The system call whose result is needed once it returns
+  /// (-1 if none), along with its dir file descriptor and path.
+  int pending_syscall;
+  size_t pending_dirfd;
+  string *pending_path;
+  /// The flags of the pending system call that creates a process,
+  /// or the options of the pending `wait4`, along with the address
+  /// where it stores the status of the process.
+  uint64_t pending_flags;
+  const int *pending_status;
+  /// Whether the last operation of the thread was dropped (e.g., by
+  /// the path filter), so its status must not be recorded.
+  bool op_filtered;
+  /// The recent accesses of the `execOp` of the thread.
+  AccessCache *accesses;
+  /// The ids of the wrapped functions that the thread is executing.
+  wrapper_id_t call_stack[MAX_CALL_DEPTH];
+  /// Number of wrapped functions that the thread is executing;
+  /// this may exceed `MAX_CALL_DEPTH`.
+  size_t call_depth;
+
+  /** Pushes the given wrapped function onto the stack. */
+  void PushWrapper(wrapper_id_t id) {
+    if (call_depth < MAX_CALL_DEPTH) {
+      call_stack[call_depth] = id;
+    }
+    call_depth++;
+  }
+
+  /** Pops the top of the stack. */
+  void PopWrapper() {
+    if (call_depth > 0) {
+      call_depth--;
+    }
+  }
+
+  /**
+   * Gets the wrapped function at the top of the stack, or `NO_WRAPPER`
+   * if it is unknown.
+   */
+  wrapper_id_t TopWrapper() const {
+    if (call_depth == 0 || call_depth > MAX_CALL_DEPTH) {
+      return NO_WRAPPER;
+    }
+    return call_stack[call_depth - 1];
+  }
+};
+
+
 /**
  * This class represents a trace generator.
  *
@@ -39,13 +130,28 @@ class DynamoTraceGenerator : public TraceGenerator {
     /// This data structures hold the wrappers associated with
     /// every native function name.
     using wrapper_t = map<string, pair<pre_clb_t, post_clb_t>>;
+    /// Callbacks that consume the parts of the trace that have been
+    /// completed while the program is running.
+    using exec_op_clb_t = function<void(const ExecOp*)>;
+    using block_clb_t = function<void(const Block*)>;
 
     /** Default Constructor. */
     DynamoTraceGenerator():
       current_block(nullptr),
       event_count(0),
       sync_op_count(0),
-      main_block_count(0) {
+      main_block_count(0),
+      trace_lock(dr_mutex_create()),
+      online_lock(nullptr),
+      trace_writer(nullptr),
+      trace_ring(nullptr),
+      ring_lock(nullptr),
+      keep_trace(true),
+      block_buf_lock(nullptr),
+      symbol_cache(nullptr),
+      capture_syscalls(false),
+      path_filter(nullptr),
+      coalesce(true) {
       trace = new Trace();
     }
 
@@ -54,45 +160,151 @@ class DynamoTraceGenerator : public TraceGenerator {
       if (trace) {
         delete trace; 
       }
+      dr_mutex_destroy(trace_lock);
+      if (online_lock) {
+        dr_mutex_destroy(online_lock);
+      }
+      if (ring_lock) {
+        dr_mutex_destroy(ring_lock);
+      }
+      if (block_buf_lock) {
+        dr_mutex_destroy(block_buf_lock);
+      }
     }
 
-    // -------- Operations on the trace generators' store -------------
-    
-    /** Adds a new key-value entry to the store. */
-    void AddToStore(string key, void *value);
+    // -------- Streaming of the trace --------------------------------
 
-    /** Gets the value associated with the given key. */
-    void *GetStoreValue(const string &key) const;
+    /**
+     * Writes every `execOp` and block to the given writer as soon as
+     * they are completed.
+     *
+     * Unless `keep_trace` is true, the written parts are dropped from
+     * the trace, so that the memory of the generator does not grow with
+     * the length of the execution.
+     */
+    void SetTraceWriter(TraceWriter *writer, bool keep_trace_);
 
-    /** Deletes the given key from the store. */
-    void DeleteFromStore(const string &key);
+    /**
+     * Publishes every `execOp` and block to the given shared-memory
+     * rings as soon as they are completed, so that another process
+     * can analyze the trace while the program is running.
+     *
+     * As with `SetTraceWriter()`, the published parts are dropped from
+     * the trace unless `keep_trace` is true.
+     */
+    void SetTraceRing(trace_ring::TraceRing *ring, bool keep_trace_);
 
     /**
-     * Returns value associated with the given key,
-     * and then deletes the corresponding entry.
+     * Drains the buffers of all threads to the trace writer (if any).
+     *
+     * This is used when trace collection stops, or when the client
+     * is asked to flush the trace while the program is running.
      */
-    void *PopFromStore(const string &key);
+    void FlushTrace();
 
-    // -------- Operations on the functions' stack ----------------
-    
-    /** Pushes a new function onto the stack. */
-    void PushFunction(string func_name);
+    /**
+     * Continues the trace in a new segment, if the trace writer asks
+     * for it. Every buffer is drained to the current segment first,
+     * and the new segment starts with the prologue of the trace
+     * so far.
+     *
+     * This must be called right before a MAIN block starts, i.e.,
+     * when every block has been completed.
+     */
+    void MaybeRotate();
 
-    /** Pops the top value of the stack. */
-    void PopStack();
+    /**
+     * Completes the current block (if any), and starts a new MAIN
+     * block.
+     */
+    void AddMainBlock();
 
-    /** Gets the function corresponding to the top of the stack. */
-    string TopStack() const;
+    // -------- Per-thread state --------------------------------------
 
     /**
-     * Adds a new entry to the function information store.
+     * Registers the thread-local storage slot that holds the state of
+     * every thread, along with the events that allocate and free it.
      *
-     * It associates the given address with the given function name.
+     * This must be called after `drmgr` is initialized.
      */
-    void AddFunc(string addr, string func_name);
-    
-    /** Get the function name corresponding to the given address. */
-    string GetFuncName(const string &addr) const;
+    static bool InitThreadStates();
+
+    /** Unregisters the thread-local storage slot and its events. */
+    static void ExitThreadStates();
+
+    /**
+     * Gets the state of the thread that runs the given wrapper
+     * (if any).
+     */
+    static ThreadState *GetThreadState(void *wrapctx);
+
+    /** Gets the state of the thread with the given context (if any). */
+    static ThreadState *GetDrThreadState(void *drcontext);
+
+    // -------- Online consumption of the trace -----------------------
+
+    /**
+     * Feeds the given callbacks with every `execOp` and block of
+     * the trace, as soon as they are completed.
+     *
+     * Every `execOp` completed before a block is passed to
+     * the `execOp` callback before that block is passed to
+     * the block callback. Both callbacks are invoked by the thread
+     * that completes blocks.
+     *
+     * Unless `keep_trace` is true, the consumed parts are not added to
+     * the trace, and the consumer is responsible for deallocating them.
+     */
+    void SetOnlineCallbacks(exec_op_clb_t exec_op_clb,
+                            block_clb_t block_clb, bool keep_trace_);
+
+    /**
+     * Marks the `execOp` of the given thread as completed, and
+     * detaches it from the thread.
+     *
+     * This is safe to call from any thread.
+     */
+    void CompleteExecOp(ThreadState *state);
+
+    /**
+     * Marks the current block as completed (if any), and consumes
+     * it along with the completed `execOp`s.
+     */
+    void CompleteCurrentBlock();
+
+    /**
+     * Consumes the `execOp`s completed after the last block.
+     * This is used when trace collection stops.
+     */
+    void FlushExecOps();
+
+    /**
+     * Adds the given `newProc` on behalf of the given thread.
+     *
+     * If the thread executes an `execOp`, the process is created by
+     * that `execOp`. Otherwise, it is created by a new synchronous
+     * operation of the current block (if any). If that is a MAIN
+     * block, a new MAIN block follows the operation, since the new
+     * process runs concurrently with it.
+     */
+    void AddNewProc(ThreadState *state, NewProc *new_proc);
+
+    /**
+     * Adds the given `waitProc` on behalf of the given thread, just
+     * like `AddNewProc`. The operation of a MAIN block starts a new
+     * MAIN block, which happens after the terminated process.
+     */
+    void AddWaitProc(ThreadState *state, WaitProc *wait_proc);
+
+    /**
+     * Drops whatever the child of a `fork` inherits from the trace of
+     * its parent: the states of the threads that do not exist in
+     * the child, and the parts of the trace that have not been
+     * written yet.
+     *
+     * This must be called by the only thread of the child.
+     */
+    void ResetAfterFork(void *drcontext);
 
     /**
      * Aborts the trace collection and the execution of the program
@@ -104,6 +316,59 @@ class DynamoTraceGenerator : public TraceGenerator {
     /** Setups the wrapper functions defined by the trace collector. */
     void Setup(const module_data_t *mod);
 
+    /**
+     * Resolves the wrapped functions through the given cache,
+     * and stores every newly resolved function there.
+     */
+    void SetSymbolCache(SymbolCache *cache) {
+      symbol_cache = cache;
+    }
+
+    /**
+     * Restricts the search of debug symbols to the modules whose path
+     * contains any of the given strings. If no strings are given,
+     * all modules are searched.
+     *
+     * Note that exported functions are found in every module.
+     */
+    void SetSymbolModules(const vector<string> &modules) {
+      symbol_modules = modules;
+    }
+
+    /**
+     * Captures file operations through system call events instead of
+     * wrapping the corresponding libc functions.
+     *
+     * Unlike the libc wrappers, this observes the `*at` variants
+     * (e.g., `openat`, `renameat2`, `statx`) along with their actual
+     * dir file descriptors.
+     */
+    void SetCaptureSyscalls(bool capture_syscalls_) {
+      capture_syscalls = capture_syscalls_;
+    }
+
+    /** Checks whether file operations are captured at system calls. */
+    bool CapturesSyscalls() const {
+      return capture_syscalls;
+    }
+
+    /**
+     * Records only the operations on the paths that the given filter
+     * traces. Filtered operations are never allocated.
+     */
+    void SetPathFilter(const path_filter::PathFilter *filter) {
+      path_filter = filter && !filter->IsEmpty() ? filter : nullptr;
+    }
+
+    /**
+     * Checks whether the operations on the given path are recorded.
+     * Relative paths are resolved against the working directory of
+     * the trace.
+     */
+    bool IsTraced(size_t dirfd, const string &path) const {
+      return !path_filter || path_filter->IsTraced(dirfd, path, cwd);
+    }
+
     /** Start collecting traces. */
     virtual void Start() = 0;
 
@@ -126,6 +391,59 @@ class DynamoTraceGenerator : public TraceGenerator {
       return trace;
     }
 
+    /**
+     * Specifies whether an access that repeats the last access of
+     * the same path in the same `execOp` is dropped (see `AccessCache`).
+     */
+    void SetCoalesce(bool coalesce_) {
+      coalesce = coalesce_;
+    }
+
+    /**
+     * Checks whether the given access of the given thread is redundant,
+     * and records it otherwise.
+     *
+     * Only paths relative to the working directory are coalesced.
+     */
+    bool IsRedundant(ThreadState *state, size_t dirfd, const string &path,
+                     enum Hpath::EffectType effect, bool follow_symlink,
+                     const string &op_name) const {
+      if (!coalesce || !state) {
+        return false;
+      }
+      if (dirfd != AT_FDCWD) {
+        if (effect == Hpath::EXPUNGED) {
+          state->accesses->Clear();
+        }
+        return false;
+      }
+      return state->accesses->IsRedundant(state->exec_op, path, effect,
+                                          follow_symlink, op_name);
+    }
+
+    /**
+     * Forgets the recent accesses of the given thread, because it has
+     * performed an operation that may change the file of a path.
+     */
+    static void ForgetAccesses(ThreadState *state) {
+      if (state) {
+        state->accesses->Clear();
+      }
+    }
+
+    /** Sets the working directory of the traced program. */
+    void SetCwd(const string &cwd_) {
+      cwd = cwd_;
+      trace->SetCwd(cwd_);
+    }
+
+    /**
+     * Adds the given `execOp` to the trace.
+     *
+     * This is safe to call from any thread.
+     */
+    void AddExecOp(ExecOp *exec_op);
+
     /** Getter of the `current_block` field. */
     Block *GetCurrentBlock() {
       return current_block;
@@ -181,17 +499,78 @@ class DynamoTraceGenerator : public TraceGenerator {
     size_t sync_op_count;
 
     size_t main_block_count;
-    /// A key-value data structure used to store temporary
-    /// values during trace collection.
-    map<string, void*> store;
-    /// A callstack.
-    stack<string> call_stack;
-    /// A data structure that maps addresses to the function they point to.
-    map<string, string> funcs;
+    /// Lock protecting the `execOp`s of the trace.
+    void *trace_lock;
+
+    /// Lock protecting `completed_exec_ops`.
+    void *online_lock;
+    /// `execOp`s that have been completed, but not consumed yet.
+    vector<const ExecOp*> completed_exec_ops;
+    /// Writer used to stream the trace to a file.
+    TraceWriter *trace_writer;
+    /// Rings used to publish the trace to another process.
+    trace_ring::TraceRing *trace_ring;
+    /// The ring shared by the threads that found no free ring,
+    /// and the lock protecting it.
+    optional<size_t> shared_ring;
+    void *ring_lock;
+    /// Whether the parts of the trace are kept after they are written.
+    bool keep_trace;
+    /// The blocks written by the thread of the event loop that have not
+    /// been drained to the trace file yet, and the lock protecting them.
+    string block_buf;
+    void *block_buf_lock;
+    /// What the next segment of the trace file refers to from
+    /// the segments before it.
+    SegmentPrologue prologue;
+    /// Callbacks used to consume the completed parts of the trace.
+    exec_op_clb_t exec_op_clb;
+    block_clb_t block_clb;
+    /// Cache of resolved functions (if any).
+    SymbolCache *symbol_cache;
+    /// The modules whose debug symbols are searched (empty for all).
+    vector<string> symbol_modules;
+    /// Whether file operations are captured at system calls.
+    bool capture_syscalls;
+    /// The filter of the recorded paths (if any), and the working
+    /// directory that relative paths are resolved against.
+    const path_filter::PathFilter *path_filter;
+    string cwd;
+    /// Whether redundant accesses are dropped.
+    bool coalesce;
+
+    /** Passes the completed `execOp`s to the `execOp` callback. */
+    void ConsumeExecOps();
 
+    /**
+     * Adds a synchronous operation to the current block, which
+     * consists of the given operation and is completed right away.
+     */
+    void AddSyncOp(ThreadState *state, Operation *operation);
+
+    /**
+     * Publishes the given record to the ring of the given thread.
+     *
+     * Every thread publishes to its own ring, so that the `execOp`s
+     * performed by the thread of the event loop always precede
+     * the blocks that submit them.
+     */
+    void PublishRecord(ThreadState *state,
+                       enum trace_ring::TraceRing::RecordType type,
+                       const string &record);
+
+    /** Checks whether the completed parts of the trace are dropped. */
+    bool DropsTrace() const {
+      return (trace_writer || trace_ring || online_lock) && !keep_trace;
+    }
+
+    /// Wraps the function at the given address using the wrappers
     /// corresponding to the given name.
-    void RegisterFunc(const module_data_t *mod, string func_name,
-                      pre_clb_t pre, post_clb_t post);
+    void RegisterFunc(string func_name, app_pc towrap, pre_clb_t pre,
+                      post_clb_t post);
+
+    /** Checks whether the debug symbols of the given module are searched. */
+    bool MaySearchSymbols(const module_data_t *mod) const;
 
   protected:
     /// A utility to track trace collection time.
@@ -211,16 +590,31 @@ size_t GetCurrentThread(void *wrapctx);
 
 trace_generator::DynamoTraceGenerator *GetTraceGenerator(void **data);
 
-void DefaultPre(void *wrapctx, OUT void **user_data);
+/**
+ * Pushes the given wrapped function onto the stack of the current
+ * thread.
+ *
+ * The id is a template argument, so this does neither allocate
+ * nor look up anything.
+ */
+template<trace_generator::wrapper_id_t id>
+void DefaultPre(void *wrapctx, OUT void **user_data) {
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  if (state) {
+    state->PushWrapper(id);
+  }
+}
 
+/** Pops the top of the stack of the current thread. */
 void DefaultPost(void *wrapctx, void *user_data);
 
 
-template<typename Fn, Fn fn, typename... Args>
+template<typename Fn, Fn fn, trace_generator::wrapper_id_t id>
 void pre_wrap(void *wrapctx, OUT void **user_data) {
   // Call the actual wrapper
   fn(wrapctx, user_data);
-  DefaultPre(wrapctx, user_data);
+  DefaultPre<id>(wrapctx, user_data);
 }
 
 
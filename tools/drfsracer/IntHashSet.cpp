@@ -0,0 +1,48 @@
+#include "IntHashSet.h"
+
+
+namespace trace_generator {
+
+
+void IntHashSet::Insert(int value) {
+  if (value == EMPTY) {
+    has_empty = true;
+    return;
+  }
+  // We keep the load factor of the set below 1/2.
+  if ((size + 1) * 2 > slots.size()) {
+    Grow();
+  }
+  size_t mask = slots.size() - 1;
+  size_t i = GetHome(value);
+  while (slots[i] != EMPTY) {
+    if (slots[i] == value) {
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+  slots[i] = value;
+  size++;
+}
+
+
+void IntHashSet::Clear() {
+  slots.assign(INITIAL_CAPACITY, EMPTY);
+  size = 0;
+  has_empty = false;
+}
+
+
+void IntHashSet::Grow() {
+  vector<int> old_slots(slots.size() * 2, EMPTY);
+  old_slots.swap(slots);
+  size = 0;
+  for (int value : old_slots) {
+    if (value != EMPTY) {
+      Insert(value);
+    }
+  }
+}
+
+
+} // namespace trace_generator
@@ -0,0 +1,82 @@
+#ifndef INT_HASH_SET_H
+#define INT_HASH_SET_H
+
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+
+using namespace std;
+
+
+namespace trace_generator {
+
+
+/**
+ * A set of integers implemented as an open-addressing hash table with
+ * linear probing.
+ *
+ * Unlike `std::set`, a lookup does not chase pointers: it hashes
+ * the integer and scans a few adjacent slots of a flat array. Integers
+ * are never removed, so a slot is either empty or holds an integer.
+ *
+ * The set is not thread-safe.
+ */
+class IntHashSet {
+  public:
+    /** Constructs an empty set. */
+    IntHashSet():
+      slots(INITIAL_CAPACITY, EMPTY),
+      size(0),
+      has_empty(false) {  }
+
+    /** Adds the given integer to the set. */
+    void Insert(int value);
+
+    /** Checks whether the set contains the given integer. */
+    bool Contains(int value) const {
+      if (value == EMPTY) {
+        return has_empty;
+      }
+      size_t mask = slots.size() - 1;
+      for (size_t i = GetHome(value); ; i = (i + 1) & mask) {
+        if (slots[i] == value) {
+          return true;
+        }
+        if (slots[i] == EMPTY) {
+          return false;
+        }
+      }
+    }
+
+    /** Removes all the integers of the set. */
+    void Clear();
+
+  private:
+    /// The value that marks an empty slot. The set tracks this value
+    /// through the `has_empty` flag instead.
+    static constexpr int EMPTY = INT_MIN;
+    /// The initial number of slots.
+    static constexpr size_t INITIAL_CAPACITY = 64;
+
+    /// The slots of the set; their number is always a power of two.
+    vector<int> slots;
+    /// The number of occupied slots.
+    size_t size;
+    /// Whether the set contains `EMPTY`.
+    bool has_empty;
+
+    /** Gets the slot where the search for the given integer begins. */
+    size_t GetHome(int value) const {
+      uint32_t key = (uint32_t) value * 0x9e3779b1U;
+      return (key ^ (key >> 16)) & (slots.size() - 1);
+    }
+
+    /** Doubles the number of slots, and re-inserts every integer. */
+    void Grow();
+};
+
+
+} // namespace trace_generator
+
+#endif
@@ -1,5 +1,4 @@
 #include "assert.h"
-#include <set>
 #include <stack>
 
 #include "NodeGenerator.h"
@@ -7,13 +6,27 @@
 #include "DynamoTraceGenerator.h"
 
 
-#define NEW_TIMERWRAP "node::(anonymous namespace)::TimerWrap::New"
 #define WORKER_OFFSET 336
-#define PRE_WRAP(FUNC) pre_wrap<decltype(&FUNC), &FUNC>
+#define PRE_WRAP(FUNC, ID) pre_wrap<decltype(&FUNC), &FUNC, ID>
 
 
 using namespace generator_utils;
-using namespace generator_keys;
+
+
+/// The ids of the node functions that are tracked in the stack
+/// of wrapped functions.
+enum NodeWrapperId : trace_generator::wrapper_id_t {
+  NODE_START = trace_generator::NO_WRAPPER + 1,
+  PUSH_ASYNC_IDS,
+  POP_ASYNC_ID,
+  EMIT_ASYNC_INIT,
+  TIMERWRAP_NOW,
+  TIMERWRAP_NEW,
+  EMIT_PROMISE_RESOLVE,
+  PROMISEWRAP_NEW,
+  NEW_ASYNC_ID,
+  NEW_TICK_INFO
+};
 
 
 static inline void check_block(trace_generator::DynamoTraceGenerator *trace_gen,
@@ -30,6 +43,23 @@ static inline void check_block(trace_generator::DynamoTraceGenerator *trace_gen,
 }
 
 
+/** Gets the Node trace generator passed to a wrapper. */
+static inline trace_generator::NodeTraceGenerator *
+get_node_generator(void **user_data)
+{
+  return static_cast<trace_generator::NodeTraceGenerator*>(
+      GetTraceGenerator(user_data));
+}
+
+
+/** Gets the id of the `execOp` that corresponds to the given operation. */
+static string
+get_op_id(const trace_generator::PendingOp &op)
+{
+  return (op.async ? "async_" : "sync_") + to_string(op.number);
+}
+
+
 namespace node_utils {
 
 
@@ -37,7 +67,7 @@ void
 AddSubmitOp(void *wrapctx, OUT void **user_data, const string op_name,
             size_t async_pos)
 {
-  trace_generator::DynamoTraceGenerator *trace_gen = GetTraceGenerator(
+  trace_generator::NodeTraceGenerator *trace_gen = get_node_generator(
       user_data);
   // First, we get the pointer that refers to the `uv_fs_t` struct
   // of the libuv library.
@@ -47,22 +77,19 @@ AddSubmitOp(void *wrapctx, OUT void **user_data, const string op_name,
   void *ptr = drwrap_get_arg(wrapctx, 1);
   void *clb = drwrap_get_arg(wrapctx, async_pos);
 
-  string id;
-  size_t event_id = 0;
+  trace_generator::PendingOp op;
   if (clb == nullptr) {
     // This operation is synchronous.
     trace_gen->IncrSyncOpCount();
-    id = "sync_" + to_string(trace_gen->GetSyncOpCount());
+    op = { false, trace_gen->GetSyncOpCount() };
   } else {
-    int *event_ptr = (int *) trace_gen->PopFromStore(
-        FUNC_ARGS + "wrap_pre_emit_init");
-    if (!event_ptr) {
+    optional<size_t> event_id = trace_gen->PopLastEvent();
+    if (!event_id.has_value()) {
       return;
     }
-    event_id = *event_ptr;
-    id = "async_" + to_string(*event_ptr);
-    delete event_ptr;
+    op = { true, event_id.value() };
   }
+  string id = get_op_id(op);
   check_block(trace_gen, "Submit operation " + op_name);
   Block *current_block = trace_gen->GetCurrentBlock();
   // We use the address that this pointer points to as an indicator
@@ -74,10 +101,7 @@ AddSubmitOp(void *wrapctx, OUT void **user_data, const string op_name,
   // Note that at this point, the operation is not executed by libuv.
   // Instread, it just submits this operation to the worker pool
   // and it is going to be executed in the future.
-  string addr = utils::PtrToString(ptr);
-  string key = OPERATIONS + addr;
-  void *id_ptr = static_cast<void*>(new string(id));
-  trace_gen->AddToStore(key, (void *) id_ptr);
+  trace_gen->GetPendingOps().Add(ptr, op);
 
   // It's time to add the `submitOp` expression to the current block.
   SubmitOp *submit_op = nullptr;
@@ -86,7 +110,7 @@ AddSubmitOp(void *wrapctx, OUT void **user_data, const string op_name,
     // is synchronous.
     submit_op = new SubmitOp(id);
   } else {
-    submit_op = new SubmitOp(id, event_id);
+    submit_op = new SubmitOp(id, op.number);
   }
   size_t size = current_block->Size();
   // We set the debug information of the `newEvent` expression,
@@ -104,56 +128,20 @@ AddSubmitOp(void *wrapctx, OUT void **user_data, const string op_name,
 } // namespace node_utils
 
 
-static void
-add_to_set(trace_generator::DynamoTraceGenerator *trace_gen, int event_id,
-           string key)
-{
-  void *value = trace_gen->GetStoreValue(key);
-  if (!value) {
-    return;
-  }
-
-  set<int> *set_ptr = static_cast<set<int>*>(value);
-  set_ptr->insert(event_id);
-}
-
-
-static bool
-has_event_id(trace_generator::DynamoTraceGenerator *trace_gen, int event_id,
-             string key)
-{
-
-  void *value = trace_gen->GetStoreValue(key);
-  if (!value) {
-    return false;
-  }
-
-  set<int> *set_ptr = static_cast<set<int>*>(value);
-  set<int>::iterator it = set_ptr->find(event_id);
-  return !(it == set_ptr->end());
-}
-
-
 ExecOp *
 get_exec_op(void *wrapctx, OUT void **user_data)
 {
-
-  trace_generator::DynamoTraceGenerator *trace_gen =
-    GetTraceGenerator(user_data);
-  size_t thread_id = generator_utils::GetCurrentThread(wrapctx);
-  return (ExecOp *) trace_gen->GetStoreValue(
-      THREADS + to_string(thread_id));
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  return state ? state->exec_op : nullptr;
 }
 
 
 ExecOp *
 get_exec_op_post(void *wrapctx, void *user_data) {
-  
-  trace_generator::DynamoTraceGenerator *trace_gen =
-    (trace_generator::DynamoTraceGenerator *) user_data;
-  size_t thread_id = generator_utils::GetCurrentThread(wrapctx);
-  return (ExecOp *) trace_gen->GetStoreValue(
-      THREADS + to_string(thread_id));
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  return state ? state->exec_op : nullptr;
 }
 
 
@@ -234,12 +222,8 @@ wrap_pre_mkdir(void *wrapctx, OUT void **user_data)
 static void
 wrap_pre_open(void *wrapctx, OUT void **user_data)
 {
-  trace_generator::DynamoTraceGenerator *trace_gen =
-    GetTraceGenerator(user_data);
-  void *drcontext = drwrap_get_drcontext(wrapctx);
   char *path = (char *) drwrap_get_arg(wrapctx, 0);
   int flags = (int)(intptr_t) drwrap_get_arg(wrapctx, 1);
-
   // We get the two least significant bits of the flags value in order
   // to determine the mode of `open` (i.e., read-only, write-only,
   // read-write). 
@@ -253,36 +237,43 @@ wrap_pre_open(void *wrapctx, OUT void **user_data)
     EmitHpath(wrapctx, user_data, 0, Hpath::PRODUCED, true, get_exec_op,
               "open");
   }
-  size_t thread_id = generator_utils::GetCurrentThread(wrapctx);
-  // Create a key to store the argument (corresponding to the file path)
-  // passed in `open`. Use the current thread id, in case when another thread
-  // calls open, and its invocation interleaves the post callback of the
-  // current thread.
-  string key = FUNC_ARGS + "/" + to_string(thread_id) + "/open";
-  trace_gen->AddToStore(key, path);
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  trace_generator::DynamoTraceGenerator *trace_gen = GetTraceGenerator(
+      user_data);
+  if (!state || (trace_gen && !trace_gen->IsTraced(AT_FDCWD, path))) {
+    // If the path is not traced, neither is its file descriptor.
+    return;
+  }
+  // Keep the argument (corresponding to the file path) passed in `open`
+  // in the state of the current thread, since the file descriptor is
+  // known only in the post callback.
+  state->open_path = path;
 }
 
 
 static void
 wrap_post_open(void *wrapctx, void *user_data)
 {
-  trace_generator::DynamoTraceGenerator *trace_gen =
-    (trace_generator::DynamoTraceGenerator *) user_data;
-  string thread_id = to_string(generator_utils::GetCurrentThread(wrapctx));
-  string path = (const char *) trace_gen->PopFromStore(
-      FUNC_ARGS + "/" + thread_id + "/open");
-  int ret_val = (int)(ptr_int_t) drwrap_get_retval(wrapctx);
-  ExecOp *exec_op = (ExecOp *) trace_gen->GetStoreValue(
-      THREADS + thread_id);
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  if (!state || !state->open_path) {
+    return;
+  }
+  const char *path = state->open_path;
+  state->open_path = nullptr;
+  ExecOp *exec_op = state->exec_op;
   if (!exec_op) {
     return;
   }
+  int ret_val = (int)(ptr_int_t) drwrap_get_retval(wrapctx);
   NewFd *new_fd = new NewFd(AT_FDCWD, path, ret_val);
   new_fd->SetActualOpName("open");
   if (ret_val < 0) {
     new_fd->MarkFailed();
   }
   exec_op->AddOperation(new_fd);
+  trace_generator::DynamoTraceGenerator::ForgetAccesses(state);
 }
 
 
@@ -355,8 +346,16 @@ wrap_pre_utime(void *wrapctx, OUT void **user_data)
 static void
 wrap_pre_uv_fs_work(void *wrapctx, OUT void **user_data)
 {
-  trace_generator::DynamoTraceGenerator *trace_gen =
-    GetTraceGenerator(user_data);
+  trace_generator::NodeTraceGenerator *trace_gen =
+    get_node_generator(user_data);
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  if (!state) {
+    return;
+  }
+  // We increment the number of `uv__fs_work` invocations in the call
+  // stack of the current thread.
+  state->fs_work_depth++;
   // This is implementation specific.
   //
   // The argument of the `uv__fs_work` function is a pointer
@@ -369,84 +368,49 @@ wrap_pre_uv_fs_work(void *wrapctx, OUT void **user_data)
   // the argument of this function is a member.
   char *ptr = (char *) drwrap_get_arg(wrapctx, 0);
   void *uv_fs_t_ptr = ptr - WORKER_OFFSET;
-
-  // We convert address to a string and we use it
-  // as key to store value information about the execution of
-  // the current libuv operation.
+  // We use the address as the key of the submitted operation
+  // that is executed by the current libuv operation.
   //
   // Note that the address is unique for every *active* libuv
   // operation.
-  string addr = utils::PtrToString(uv_fs_t_ptr);
-
-  string thread_str = to_string(generator_utils::GetCurrentThread(wrapctx));
-  string key = FUNC_INVOCATIONS + thread_str + "/uv__fs_work";
-  // We get the number of `uv__fs_work` invocations in the current call
-  // stack.
-  int *work_count = (int *) trace_gen->GetStoreValue(key);
-  if (!work_count) {
-    // It's the first `uv__fs_work` invocation in the current call stack
-    // so we update the store.
-    work_count = new int(1);
-    trace_gen->AddToStore(key, (void *) work_count);
-  } else {
-    // We increment the number of invocations of `uv__fs_work` in the current
-    // call stack.
-    (*work_count)++;
-  }
-
-  // Now it's time to retrieve the pointer to the `ExecOp` objects.
-  // This object holds all the FStrace operations performed by
-  // the current `libuv` operation.
   //
   // Note tha we consider only the parent `uv__fs_work` invocation
   // that is actually called by Node.
-  key = OPERATIONS + addr;
-  void *value = trace_gen->PopFromStore(key);
-  if (!value) {
+  optional<trace_generator::PendingOp> op =
+    trace_gen->GetPendingOps().Pop(uv_fs_t_ptr);
+  if (!op.has_value()) {
     // Probably, this invocation is not the parent,
     // so we return.
     return;
   }
-  string *op_ptr = static_cast<string*>(value);
   // We create a new `ExecOp`, since its the first `uv__fs_work`
-  // invocation in the current call stack.
-  ExecOp *exec_op = new ExecOp(*op_ptr);
-  delete op_ptr;
-  
+  // invocation in the current call stack. This object holds all
+  // the FStrace operations performed by the current `libuv` operation.
+  ExecOp *exec_op = new ExecOp(get_op_id(op.value()));
+
   // We associate the current thread with the newly-created
   // `ExecOp` object.
-  trace_gen->AddToStore(THREADS + thread_str, (void *) exec_op);
+  state->exec_op = exec_op;
   // We add the `ExecOp` construct to the current trace.
-  trace_gen->GetTrace()->AddExecOp(exec_op);
+  trace_gen->AddExecOp(exec_op);
 }
 
 
 static void
 wrap_post_uv_fs_work(void *wrapctx, void *user_data)
 {
-
   trace_generator::DynamoTraceGenerator *trace_gen =
     (trace_generator::DynamoTraceGenerator *) user_data;
-  size_t thread_id = generator_utils::GetCurrentThread(wrapctx);
-  string thread_str = to_string(thread_id);
-
-  // We examine the store to see the number of
-  // 'uv__fs_work' invocations in the current call stack.
-  string key = FUNC_INVOCATIONS + thread_str + "/uv__fs_work";
-  int *work_count = (int *) trace_gen->GetStoreValue(key);
-  if (!work_count) {
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  if (!state || state->fs_work_depth == 0) {
     return;
   }
-
-  if (*work_count == 0 || *work_count == 1) {
-    // This means that only only one invocation of `uv__fs_work`
-    // appears in the stack. So after the call of this wrapper,
-    // there will be no invocation of `uv__fs_work` in the call stack.
-    //
-    // So, we free memory and delete the corresponding keys from the store.
-    delete work_count;
-    trace_gen->DeleteFromStore(key);
-    trace_gen->DeleteFromStore(THREADS + thread_str);
+  state->fs_work_depth--;
+  if (state->fs_work_depth == 0) {
+    // There is no invocation of `uv__fs_work` in the call stack anymore,
+    // so the operations of the current `ExecOp` have been completed.
+    trace_gen->CompleteExecOp(state);
   }
 }
 
@@ -587,8 +551,8 @@ wrap_pre_uv_fs_utime(void *wrapctx, OUT void **user_data)
 static void
 wrap_pre_emit_before(void *wrapctx, OUT void **user_data)
 {
-  trace_generator::DynamoTraceGenerator *trace_gen =
-    GetTraceGenerator(user_data);
+  trace_generator::NodeTraceGenerator *trace_gen =
+    get_node_generator(user_data);
   /* node::Environment::AsyncHooks::push_async_ids(double, double)
    *
    * Get the value of the second argument that is stored
@@ -615,11 +579,12 @@ wrap_pre_emit_before(void *wrapctx, OUT void **user_data)
       // This main block is empty, so there is not any reason
       // to keep it.
       trace_gen->GetTrace()->PopBlock();
+      trace_gen->SetCurrentBlock(nullptr);
     } 
   }
 
   int id = async_id;
-  if (has_event_id(trace_gen, async_id, PROMISE_SET)) {
+  if (trace_gen->IsPromise(async_id)) {
     // If `async_id` is a promise, we use that as the id
     // of the block.
     id = trigger_async_id;
@@ -631,7 +596,7 @@ wrap_pre_emit_before(void *wrapctx, OUT void **user_data)
     //
     // So we do it right now.
     //trace_gen->GetTrace()->AddBlock(trace_gen->GetCurrentBlock());
-    trace_gen->SetCurrentBlock(nullptr);
+    trace_gen->CompleteCurrentBlock();
   }
   // This hook occurs just before the execution of an event-related callback.
   trace_gen->SetCurrentBlock(new Block(id));
@@ -642,21 +607,11 @@ wrap_pre_emit_before(void *wrapctx, OUT void **user_data)
 }
 
 
-static void
-add_main_block(trace_generator::DynamoTraceGenerator *trace_gen)
-{
-  trace_gen->IncrMainBlockCount();
-  trace_gen->SetCurrentBlock(new Block(
-      trace_gen->GetMainBlockCount(), Block::MAIN));
-  trace_gen->GetTrace()->AddBlock(trace_gen->GetCurrentBlock());
-}
-
-
 static void
 wrap_pre_emit_after(void *wrapctx, OUT void **user_data)
 {
-  trace_generator::DynamoTraceGenerator *trace_gen =
-    GetTraceGenerator(user_data);
+  trace_generator::NodeTraceGenerator *trace_gen =
+    get_node_generator(user_data);
   dr_mcontext_t *ctx = drwrap_get_mcontext(wrapctx);
   int async_id = *(double *) ctx->ymm; // xmm0 register
 
@@ -669,23 +624,23 @@ wrap_pre_emit_after(void *wrapctx, OUT void **user_data)
   if (block_id == async_id) {
     // The current block id matches with the id of the block
     // we are going to close.
-    add_main_block(trace_gen);
+    trace_gen->AddMainBlock();
     return;
   }
 
-  if (has_event_id(trace_gen, async_id, PROMISE_SET)) {
+  if (trace_gen->IsPromise(async_id)) {
     // The id of the block we are going to close is promise-related.
     // We close it because we know that promise-related blocks are not
     // nested. XXX: revisit.
-    add_main_block(trace_gen);
+    trace_gen->AddMainBlock();
   }
 }
 
 
 inline static void
-add_new_event_expr(trace_generator::DynamoTraceGenerator *trace_gen,
+add_new_event_expr(trace_generator::NodeTraceGenerator *trace_gen,
                    size_t event_id, Event event, string debug_info,
-                   bool add_store)
+                   bool is_last_event)
 {
   if (!trace_gen) {
     return;
@@ -697,12 +652,9 @@ add_new_event_expr(trace_generator::DynamoTraceGenerator *trace_gen,
     new_event->AddDebugInfo(debug_info);
   }
   trace_gen->GetCurrentBlock()->AddExpr(new_event);
-  int *event_id_ptr = new int(event_id);
-  if (add_store) {
-    // We should add the freshly created event to the trace generator's store
-    // for later use.
-    trace_gen->AddToStore(FUNC_ARGS + "wrap_pre_emit_init",
-        (void *) event_id_ptr);
+  if (is_last_event) {
+    // We should record the freshly created event for later use.
+    trace_gen->SetLastEvent(event_id);
   }
 }
 
@@ -710,38 +662,35 @@ add_new_event_expr(trace_generator::DynamoTraceGenerator *trace_gen,
 static void
 wrap_pre_emit_init(void *wrapctx, OUT void **user_data)
 {
-  trace_generator::DynamoTraceGenerator *trace_gen =
-    GetTraceGenerator(user_data);
+  trace_generator::NodeTraceGenerator *trace_gen =
+    get_node_generator(user_data);
   dr_mcontext_t *ctx = drwrap_get_mcontext(wrapctx);
   int async_id = *(double *) ctx->ymm; // xmm0 register
   int trigger_async_id = *((double *) ctx->ymm + 8); // xmm1 register
   trace_gen->IncrEventCount();
 
-  string top_func = trace_gen->TopStack();
-  if (top_func == NEW_TIMERWRAP) {
+  trace_generator::ThreadState *state =
+    trace_generator::DynamoTraceGenerator::GetThreadState(wrapctx);
+  if (state && state->TopWrapper() == TIMERWRAP_NEW) {
     // This means that the created event is a timer wrapper.
     // So we create an event of type W 0.
     //
     // The execution order of the related callbacks follows the
     // order that appear in traces.
     //
-    // Note that we do not add the id of the event that correspond to
-    // timerwraps to the trace generator's store.
+    // Note that we do not record the id of the event that correspond to
+    // timerwraps as the last created event.
     add_new_event_expr(trace_gen, async_id, Event(Event::W, 0), "timerWrap",
                        false);
     return;
   }
 
-  bool *is_promise = (bool *) trace_gen->PopFromStore(PROMISE_EVENT);
-  if (is_promise && *is_promise) {
+  if (trace_gen->PopPromisePending()) {
     // This event we are going to create is a promise,
     // so we add the corresponding id to the set of promises.
-    add_to_set(trace_gen, async_id, PROMISE_SET);
-  }
-
-  if (is_promise) {
-    // Allocated at `wrap_pre_promise_wrap()`.
-    delete is_promise;
+    //
+    // The mark is set at `wrap_pre_promise_wrap()`.
+    trace_gen->AddPromise(async_id);
     // Since the current event resource is a promise,
     // we do not create a newEvent expression at this point.
     //
@@ -752,9 +701,9 @@ wrap_pre_emit_init(void *wrapctx, OUT void **user_data)
 
   // The default event is of type W 2.
   Event last_event = Event(Event::EXT, 0);
-  // Create a `newEvent` expression and add the id of the freshly-created
-  // event to the trace generator's store for later use (e.g., it's currently
-  // used by the `AddSubmitOp` function).
+  // Create a `newEvent` expression and record the id of the freshly-created
+  // event for later use (e.g., it's currently used by the `AddSubmitOp`
+  // function).
   add_new_event_expr(trace_gen, async_id, last_event, "", true);
   // We link the event with `trigger_async_id` with the event
   // with id related to `async_id`.
@@ -767,18 +716,15 @@ wrap_pre_emit_init(void *wrapctx, OUT void **user_data)
 static void
 wrap_pre_start(void *wrapctx, OUT void **user_data)
 {
-  trace_generator::DynamoTraceGenerator *trace_gen =
-    GetTraceGenerator(user_data);
+  trace_generator::NodeTraceGenerator *trace_gen =
+    get_node_generator(user_data);
+  // Promises and timers are tracked from this point on.
+  trace_gen->ClearEventSets();
   // This is the block corresponding to the execution of the top-level
   // code.
   //
   // We set the ID of this block to 1.
-  set<int> initial_set;
-  set<int> *promises = new set<int>(initial_set);
-  set<int> *timers = new set<int>(initial_set);
-  trace_gen->AddToStore(PROMISE_SET, (void *) promises);
-  trace_gen->AddToStore(TIMER_SET, (void *) timers);
-  add_main_block(trace_gen);
+  trace_gen->AddMainBlock();
   trace_gen->IncrEventCount();
 }
 
@@ -803,8 +749,8 @@ wrap_pre_new_tick_info(void *wrapctx, OUT void **user_data)
 static void
 wrap_pre_timerwrap(void *wrapctx, OUT void **user_data)
 {
-  trace_generator::DynamoTraceGenerator *trace_gen =
-    GetTraceGenerator(user_data);
+  trace_generator::NodeTraceGenerator *trace_gen =
+    get_node_generator(user_data);
   Event event = Event(Event::W, 1);
   check_block(trace_gen,
               "Create timerwrap " + to_string(trace_gen->GetEventCount()));
@@ -814,7 +760,7 @@ wrap_pre_timerwrap(void *wrapctx, OUT void **user_data)
                                              event);
   new_event->AddDebugInfo("setTimeout");
   trace_gen->GetCurrentBlock()->AddExpr(new_event);
-  add_to_set(trace_gen, trace_gen->GetEventCount(), TIMER_SET);
+  trace_gen->AddTimer(trace_gen->GetEventCount());
 }
 
 
@@ -871,10 +817,7 @@ wrap_pre_thenable(void *wrapctx, OUT void **user_data)
 static void
 wrap_pre_promise_wrap(void *wrapctx, OUT void **user_data)
 {
-  trace_generator::DynamoTraceGenerator *trace_gen =
-    GetTraceGenerator(user_data);
-  bool *is_promise = new bool(true);
-  trace_gen->AddToStore(PROMISE_EVENT, (void *) is_promise);
+  get_node_generator(user_data)->SetPromisePending();
 }
 
 
@@ -899,24 +842,26 @@ namespace trace_generator {
 DynamoTraceGenerator::wrapper_t NodeTraceGenerator::GetWrappers() const {
   wrapper_t wrappers;
 
-  // system calls
-  wrappers["access"]   = { wrap_pre_access, nullptr };
-  wrappers["chmod"]    = { wrap_pre_chmod, nullptr };
-  wrappers["chown"]    = { wrap_pre_chown, nullptr };
-  wrappers["open"]     = { wrap_pre_open, wrap_post_open };
-  wrappers["close"]    = { wrap_pre_close, wrap_post_status };
-  wrappers["lchown"]   = { wrap_pre_lchown, nullptr };
-  wrappers["link"]     = { wrap_pre_link, wrap_post_status };
-  wrappers["lstat"]    = { wrap_pre_lstat, nullptr };
-  wrappers["mkdir"]    = { wrap_pre_mkdir, wrap_post_status };
-  wrappers["readlink"] = { wrap_pre_readlink, nullptr };
-  wrappers["realpath"] = { wrap_pre_realpath, nullptr };
-  wrappers["rename"]   = { wrap_pre_rename, wrap_post_status };
-  wrappers["rmdir"]    = { wrap_pre_rmdir, wrap_post_status };
-  wrappers["stat"]     = { wrap_pre_stat, nullptr };
-  wrappers["symlink"]  = { wrap_pre_symlink, wrap_post_status };
-  wrappers["unlink"]   = { wrap_pre_unlink, wrap_post_status };
-  wrappers["utime"]    = { wrap_pre_utime, nullptr };
+  // system calls (unless they are captured by system call events)
+  if (!CapturesSyscalls()) {
+    wrappers["access"]   = { wrap_pre_access, nullptr };
+    wrappers["chmod"]    = { wrap_pre_chmod, nullptr };
+    wrappers["chown"]    = { wrap_pre_chown, nullptr };
+    wrappers["open"]     = { wrap_pre_open, wrap_post_open };
+    wrappers["close"]    = { wrap_pre_close, wrap_post_status };
+    wrappers["lchown"]   = { wrap_pre_lchown, nullptr };
+    wrappers["link"]     = { wrap_pre_link, wrap_post_status };
+    wrappers["lstat"]    = { wrap_pre_lstat, nullptr };
+    wrappers["mkdir"]    = { wrap_pre_mkdir, wrap_post_status };
+    wrappers["readlink"] = { wrap_pre_readlink, nullptr };
+    wrappers["realpath"] = { wrap_pre_realpath, nullptr };
+    wrappers["rename"]   = { wrap_pre_rename, wrap_post_status };
+    wrappers["rmdir"]    = { wrap_pre_rmdir, wrap_post_status };
+    wrappers["stat"]     = { wrap_pre_stat, nullptr };
+    wrappers["symlink"]  = { wrap_pre_symlink, wrap_post_status };
+    wrappers["unlink"]   = { wrap_pre_unlink, wrap_post_status };
+    wrappers["utime"]    = { wrap_pre_utime, nullptr };
+  }
 
   // libuv wrappers for libuv functions responsible for executing
   // FS operations.
@@ -943,16 +888,16 @@ DynamoTraceGenerator::wrapper_t NodeTraceGenerator::GetWrappers() const {
   wrappers["uv_fs_utime"]    = { wrap_pre_uv_fs_utime, nullptr };
 
   // Node wrappers
-  wrappers["node::Start"]                                   = { PRE_WRAP(wrap_pre_start), DefaultPost };
-  wrappers["node::Environment::AsyncHooks::push_async_ids"] = { PRE_WRAP(wrap_pre_emit_before), DefaultPost };
-  wrappers["node::Environment::AsyncHooks::pop_async_id"]   = { PRE_WRAP(wrap_pre_emit_after), DefaultPost };
-  wrappers["node::AsyncWrap::EmitAsyncInit"]                = { PRE_WRAP(wrap_pre_emit_init), DefaultPost };
-  wrappers["node::(anonymous namespace)::TimerWrap::Now"]   = { PRE_WRAP(wrap_pre_timerwrap), DefaultPost };
-  wrappers["node::(anonymous namespace)::TimerWrap::New"]   = { DefaultPre, DefaultPost };
-  wrappers["node::AsyncWrap::EmitPromiseResolve"]           = { PRE_WRAP(wrap_pre_promise_resolve), DefaultPost };
-  wrappers["node::PromiseWrap::New"]                        = { PRE_WRAP(wrap_pre_promise_wrap), DefaultPost };
-  wrappers["node::AsyncWrap::NewAsyncId"]                   = { PRE_WRAP(wrap_pre_new_async_id), DefaultPost };
-  wrappers["node::AsyncWrap::NewTickInfo"]                  = { PRE_WRAP(wrap_pre_new_tick_info), DefaultPost };
+  wrappers["node::Start"]                                   = { PRE_WRAP(wrap_pre_start, NODE_START), DefaultPost };
+  wrappers["node::Environment::AsyncHooks::push_async_ids"] = { PRE_WRAP(wrap_pre_emit_before, PUSH_ASYNC_IDS), DefaultPost };
+  wrappers["node::Environment::AsyncHooks::pop_async_id"]   = { PRE_WRAP(wrap_pre_emit_after, POP_ASYNC_ID), DefaultPost };
+  wrappers["node::AsyncWrap::EmitAsyncInit"]                = { PRE_WRAP(wrap_pre_emit_init, EMIT_ASYNC_INIT), DefaultPost };
+  wrappers["node::(anonymous namespace)::TimerWrap::Now"]   = { PRE_WRAP(wrap_pre_timerwrap, TIMERWRAP_NOW), DefaultPost };
+  wrappers["node::(anonymous namespace)::TimerWrap::New"]   = { DefaultPre<TIMERWRAP_NEW>, DefaultPost };
+  wrappers["node::AsyncWrap::EmitPromiseResolve"]           = { PRE_WRAP(wrap_pre_promise_resolve, EMIT_PROMISE_RESOLVE), DefaultPost };
+  wrappers["node::PromiseWrap::New"]                        = { PRE_WRAP(wrap_pre_promise_wrap, PROMISEWRAP_NEW), DefaultPost };
+  wrappers["node::AsyncWrap::NewAsyncId"]                   = { PRE_WRAP(wrap_pre_new_async_id, NEW_ASYNC_ID), DefaultPost };
+  wrappers["node::AsyncWrap::NewTickInfo"]                  = { PRE_WRAP(wrap_pre_new_tick_info, NEW_TICK_INFO), DefaultPost };
 
   // V8 wrappers
   wrappers["v8::internal::Factory::NewPromiseResolveThenableJobTask"] = { wrap_pre_thenable, nullptr };
@@ -967,20 +912,12 @@ void NodeTraceGenerator::Start() {
 
 void NodeTraceGenerator::Stop() {
   gen_time.Stop();
-  // We deallocate the set pointers holding all the timer-
-  // and promise-related events.
-  set<int> *set_ptr;
-  void *value = this->PopFromStore(PROMISE_SET);
-  if (value) {
-    set_ptr = static_cast<set<int>*>(value);
-    delete set_ptr;
-  }
-
-  value = this->PopFromStore(TIMER_SET);
-  if (value) {
-    set_ptr = static_cast<set<int>*>(value);
-    delete set_ptr;
-  }
+  // The last block is completed, every pending block is consumed
+  // by the online analysis (if any), and the remaining trace entries
+  // are drained to the trace file (if any).
+  CompleteCurrentBlock();
+  FlushExecOps();
+  FlushTrace();
 }
 
 
@@ -2,24 +2,15 @@
 #define NODE_GENERATOR_H
 
 #include <iostream>
+#include <optional>
 
 #include "DynamoTraceGenerator.h"
+#include "IntHashSet.h"
+#include "PendingOpTable.h"
 
 
 using namespace trace;
 
-namespace generator_keys {
-  const string FUNC_ARGS = "args/";
-  const string FUNC_INVOCATIONS = "func_invocations/";
-  const string THREADS = "threads/";
-  const string OPERATIONS = "operations/";
-  const string LAST_CREATED_EVENT = "last_created_event/";
-  const string PROMISE_SET = "promises/set";
-  const string PROMISE_EVENT = "promises/event";
-  const string TIMER_SET = "timers/set";
-}
-
-
 namespace node_utils {
   void AddSubmitOp(void *wrapctx, OUT void **user_data, const string name,
                    size_t async_pos);
@@ -31,6 +22,10 @@ namespace trace_generator {
 
 class NodeTraceGenerator : public trace_generator::DynamoTraceGenerator {
   public:
+    /** Default Constructor. */
+    NodeTraceGenerator():
+      promise_pending(false) {  }
+
     string GetName() const {
       return "NodeTrace";
     }
@@ -38,6 +33,85 @@ class NodeTraceGenerator : public trace_generator::DynamoTraceGenerator {
     wrapper_t GetWrappers() const;
     void Start();
     void Stop();
+
+    // -------- Bookkeeping of the wrappers ---------------------------
+    //
+    // Except for the pending operations, these are only accessed by
+    // the thread of the event loop, so they are not protected by
+    // a lock.
+
+    /** Records the last event created by `EmitAsyncInit`. */
+    void SetLastEvent(size_t event_id) {
+      last_event = event_id;
+    }
+
+    /**
+     * Returns the last event created by `EmitAsyncInit` (if any),
+     * and forgets it.
+     */
+    optional<size_t> PopLastEvent() {
+      optional<size_t> event_id = last_event;
+      last_event.reset();
+      return event_id;
+    }
+
+    /** Marks that the next event created by `EmitAsyncInit` is a promise. */
+    void SetPromisePending() {
+      promise_pending = true;
+    }
+
+    /**
+     * Checks whether the next event created by `EmitAsyncInit` is
+     * a promise, and clears the mark.
+     */
+    bool PopPromisePending() {
+      bool pending = promise_pending;
+      promise_pending = false;
+      return pending;
+    }
+
+    /**
+     * Gets the operations submitted to libuv that no worker thread
+     * has started executing yet, indexed by their `uv_fs_t` request.
+     *
+     * This is safe to use from any thread.
+     */
+    PendingOpTable &GetPendingOps() {
+      return pending_ops;
+    }
+
+    /** Records that the given event corresponds to a promise. */
+    void AddPromise(int event_id) {
+      promises.Insert(event_id);
+    }
+
+    /** Checks whether the given event corresponds to a promise. */
+    bool IsPromise(int event_id) const {
+      return promises.Contains(event_id);
+    }
+
+    /** Records that the given event corresponds to a timer. */
+    void AddTimer(int event_id) {
+      timers.Insert(event_id);
+    }
+
+    /** Forgets all the promise- and timer-related events. */
+    void ClearEventSets() {
+      promises.Clear();
+      timers.Clear();
+    }
+
+  private:
+    /// The last event created by `EmitAsyncInit` that has not been
+    /// associated with an fs operation yet.
+    optional<size_t> last_event;
+    /// Whether the next event created by `EmitAsyncInit` is a promise.
+    bool promise_pending;
+    /// The submitted operations that have not been executed yet.
+    PendingOpTable pending_ops;
+    /// The events that correspond to promises and timers.
+    IntHashSet promises;
+    IntHashSet timers;
 };
 
 
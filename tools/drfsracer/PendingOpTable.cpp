@@ -0,0 +1,108 @@
+#include "PendingOpTable.h"
+
+
+namespace trace_generator {
+
+
+PendingOpTable::~PendingOpTable() {
+  if (slots) {
+    dr_global_free(slots, capacity * sizeof(Slot));
+  }
+  dr_mutex_destroy(lock);
+}
+
+
+void PendingOpTable::Add(const void *req, PendingOp op) {
+  if (!req) {
+    return;
+  }
+  dr_mutex_lock(lock);
+  // We keep the load factor of the table below 1/2.
+  if ((size + 1) * 2 > capacity) {
+    Grow();
+  }
+  Insert(req, op);
+  dr_mutex_unlock(lock);
+}
+
+
+optional<PendingOp> PendingOpTable::Pop(const void *req) {
+  optional<PendingOp> op;
+  if (!req) {
+    return op;
+  }
+  dr_mutex_lock(lock);
+  if (size > 0) {
+    size_t i = GetHome(req);
+    while (slots[i].req && slots[i].req != req) {
+      i = (i + 1) & (capacity - 1);
+    }
+    if (slots[i].req) {
+      op = slots[i].op;
+      Remove(i);
+    }
+  }
+  dr_mutex_unlock(lock);
+  return op;
+}
+
+
+void PendingOpTable::Remove(size_t i) {
+  // We shift back the following entries of the cluster, so that
+  // no search stops at the freed slot too early.
+  size_t mask = capacity - 1;
+  size_t j = i;
+  while (true) {
+    j = (j + 1) & mask;
+    if (!slots[j].req) {
+      break;
+    }
+    size_t home = GetHome(slots[j].req);
+    // The entry stays if its home slot lies cyclically in (i, j].
+    bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+    if (!stays) {
+      slots[i] = slots[j];
+      i = j;
+    }
+  }
+  slots[i].req = nullptr;
+  size--;
+}
+
+
+void PendingOpTable::Insert(const void *req, PendingOp op) {
+  size_t mask = capacity - 1;
+  size_t i = GetHome(req);
+  while (slots[i].req && slots[i].req != req) {
+    i = (i + 1) & mask;
+  }
+  if (!slots[i].req) {
+    size++;
+  }
+  slots[i].req = req;
+  slots[i].op = op;
+}
+
+
+void PendingOpTable::Grow() {
+  Slot *old_slots = slots;
+  size_t old_capacity = capacity;
+  capacity = capacity ? capacity * 2 : INITIAL_CAPACITY;
+  slots = (Slot *) dr_global_alloc(capacity * sizeof(Slot));
+  for (size_t i = 0; i < capacity; i++) {
+    slots[i].req = nullptr;
+  }
+  size = 0;
+  if (!old_slots) {
+    return;
+  }
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old_slots[i].req) {
+      Insert(old_slots[i].req, old_slots[i].op);
+    }
+  }
+  dr_global_free(old_slots, old_capacity * sizeof(Slot));
+}
+
+
+} // namespace trace_generator
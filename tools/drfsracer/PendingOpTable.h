@@ -0,0 +1,105 @@
+#ifndef PENDING_OP_TABLE_H
+#define PENDING_OP_TABLE_H
+
+#include <cstdint>
+#include <optional>
+
+#include "dr_api.h"
+
+
+using namespace std;
+
+
+namespace trace_generator {
+
+
+/** An operation that has been submitted, but not executed yet. */
+struct PendingOp {
+  /// Whether the operation is asynchronous.
+  bool async;
+  /// The number of the operation, i.e., the id of its event if it is
+  /// asynchronous, or its sequence number otherwise.
+  size_t number;
+};
+
+
+/**
+ * A table that maps the requests of submitted operations (e.g.,
+ * the address of a `uv_fs_t` struct) to the operations themselves,
+ * until a worker thread starts executing them.
+ *
+ * The table is an open-addressing hash table with linear probing,
+ * whose slots are allocated through `dr_global_alloc()`. So, neither
+ * adding nor removing an entry allocates memory from the heap of
+ * the traced program, and the slots are only reallocated when
+ * the table grows.
+ *
+ * The table is shared by all threads, so every operation acquires
+ * a lock.
+ */
+class PendingOpTable {
+  public:
+    /** Constructs an empty table. */
+    PendingOpTable():
+      slots(nullptr),
+      capacity(0),
+      size(0),
+      lock(dr_mutex_create()) {  }
+
+    /** Deallocates the slots of the table. */
+    ~PendingOpTable();
+
+    /**
+     * Associates the given request with the given operation,
+     * replacing any previous operation of the request.
+     */
+    void Add(const void *req, PendingOp op);
+
+    /**
+     * Removes the operation associated with the given request
+     * and returns it (if any).
+     */
+    optional<PendingOp> Pop(const void *req);
+
+  private:
+    /** A slot of the table; a slot is empty if its request is null. */
+    struct Slot {
+      const void *req;
+      PendingOp op;
+    };
+
+    /// The initial number of slots.
+    static constexpr size_t INITIAL_CAPACITY = 64;
+
+    /// The slots of the table.
+    Slot *slots;
+    /// The number of slots (always a power of two).
+    size_t capacity;
+    /// The number of occupied slots.
+    size_t size;
+    /// Lock protecting the table.
+    void *lock;
+
+    /** Gets the slot where the search for the given request begins. */
+    size_t GetHome(const void *req) const {
+      uint64_t key = (uintptr_t) req;
+      // Requests are aligned, so we mix the higher bits in.
+      key ^= key >> 17;
+      key *= 0x9e3779b97f4a7c15ULL;
+      return (key >> 32) & (capacity - 1);
+    }
+
+    /** Doubles the number of slots, and re-inserts every entry. */
+    void Grow();
+
+    /** Inserts the given entry, given that there is a free slot. */
+    void Insert(const void *req, PendingOp op);
+
+    /** Frees the given occupied slot. */
+    void Remove(size_t i);
+};
+
+
+} // namespace trace_generator
+
+#endif
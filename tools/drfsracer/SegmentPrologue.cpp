@@ -0,0 +1,92 @@
+#include "SegmentPrologue.h"
+#include "TraceWriter.h"
+#include "Utils.h"
+
+
+namespace trace_generator {
+
+
+void SegmentPrologue::AddBlock(const Block *block) {
+  if (!block) {
+    return;
+  }
+  dr_mutex_lock(lock);
+  if (!block->IsMain()) {
+    auto it = event_seqs.find(block->GetBlockId());
+    if (it != event_seqs.end()) {
+      auto event = events.find(it->second);
+      enum Event::EventType type = event->second.second.GetEventType();
+      if (type == Event::S || type == Event::M) {
+        events.erase(event);
+        event_seqs.erase(it);
+      }
+    }
+  }
+  for (auto const &expr : block->GetExprs()) {
+    const NewEventExpr *new_event = dynamic_cast<const NewEventExpr*>(expr);
+    if (new_event) {
+      size_t event_id = new_event->GetEventId();
+      auto it = event_seqs.find(event_id);
+      if (it != event_seqs.end()) {
+        // The event is created again, so it moves to the end.
+        events.erase(it->second);
+      }
+      event_seqs[event_id] = next_seq;
+      events[next_seq++] = { event_id, new_event->GetEvent() };
+      continue;
+    }
+    const SubmitOp *submit_op = dynamic_cast<const SubmitOp*>(expr);
+    if (!submit_op || submit_op->GetType() != SubmitOp::ASYNC) {
+      continue;
+    }
+    string op_id = submit_op->GetOpId();
+    if (!completed_ops.erase(op_id)) {
+      pending_ops.insert_or_assign(op_id, *submit_op);
+    }
+  }
+  dr_mutex_unlock(lock);
+}
+
+
+void SegmentPrologue::AddExecOp(const ExecOp *exec_op) {
+  string op_id = exec_op->GetId();
+  // Synchronous operations are completed by the blocks that submit
+  // them.
+  if (!utils::StartsWith(op_id, "async_")) {
+    return;
+  }
+  dr_mutex_lock(lock);
+  if (!pending_ops.erase(op_id)) {
+    completed_ops.insert(op_id);
+  }
+  dr_mutex_unlock(lock);
+}
+
+
+void SegmentPrologue::ForgetUnsubmittedOps() {
+  dr_mutex_lock(lock);
+  completed_ops.clear();
+  dr_mutex_unlock(lock);
+}
+
+
+string SegmentPrologue::ToString(size_t main_block) const {
+  Block block(main_block, Block::MAIN);
+  dr_mutex_lock(lock);
+  for (auto const &entry : events) {
+    block.AddExpr(new NewEventExpr(entry.second.first, entry.second.second));
+  }
+  for (auto const &entry : pending_ops) {
+    block.AddExpr(new SubmitOp(entry.second));
+  }
+  dr_mutex_unlock(lock);
+  if (block.GetExprs().empty()) {
+    // Empty MAIN blocks are not dumped, but fsracer expects
+    // the prologue right after the header of a segment.
+    return "Begin MAIN " + to_string(main_block) + "\nEnd\n";
+  }
+  return TraceWriter::BlockToString(&block);
+}
+
+
+} // namespace trace_generator
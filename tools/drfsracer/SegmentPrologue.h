@@ -0,0 +1,99 @@
+#ifndef SEGMENT_PROLOGUE_H
+#define SEGMENT_PROLOGUE_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "dr_api.h"
+
+#include "Trace.h"
+
+
+using namespace trace;
+using namespace std;
+
+
+namespace trace_generator {
+
+
+/**
+ * This class keeps track of the parts of the trace that a segment
+ * refers to, although they are defined in earlier segments.
+ *
+ * A segment starts at a MAIN block, and it is preceded by a prologue:
+ * a MAIN block that re-creates (in their order of creation) the events
+ * that may still be executed, and submits again the asynchronous
+ * operations that have not been completed yet. So a segment can be
+ * analyzed on its own, while fsracer skips the prologue when it merges
+ * the segment with the ones before it.
+ *
+ * Events that are executed once (S and M) are dropped when they are
+ * executed, while W and external events (e.g., timers and sockets)
+ * may be executed many times, so they are kept.
+ *
+ * Blocks and `execOp`s are recorded by different threads, so every
+ * method acquires a lock.
+ */
+class SegmentPrologue {
+  public:
+    /** Constructs an empty prologue. */
+    SegmentPrologue():
+      next_seq(0),
+      lock(dr_mutex_create()) {  }
+
+    /** Destroys the lock. */
+    ~SegmentPrologue() {
+      dr_mutex_destroy(lock);
+    }
+
+    /**
+     * Records the events that the given block creates and executes,
+     * and the asynchronous operations that it submits.
+     */
+    void AddBlock(const Block *block);
+
+    /** Records that the given `execOp` is completed. */
+    void AddExecOp(const ExecOp *exec_op);
+
+    /**
+     * Forgets the completed operations that no block has submitted.
+     *
+     * This is called at the start of every MAIN block: by then, every
+     * block that submits an operation has been completed.
+     */
+    void ForgetUnsubmittedOps();
+
+    /** Serializes the prologue as the MAIN block with the given id. */
+    string ToString(size_t main_block) const;
+
+    /**
+     * Replaces the lock, which may be held by a thread that does not
+     * exist in the child of a `fork`.
+     */
+    void ResetAfterFork() {
+      lock = dr_mutex_create();
+    }
+
+  private:
+    /// The events that may be executed, indexed by their order of
+    /// creation, and the order of every event.
+    map<size_t, pair<size_t, Event>> events;
+    unordered_map<size_t, size_t> event_seqs;
+    /// The order of the next created event.
+    size_t next_seq;
+    /// The asynchronous operations that have been submitted but not
+    /// completed yet, as they are submitted.
+    map<string, SubmitOp> pending_ops;
+    /// The operations that have been completed before the blocks that
+    /// submit them.
+    set<string> completed_ops;
+    /// Lock protecting the fields above.
+    void *lock;
+};
+
+
+} // namespace trace_generator
+
+#endif
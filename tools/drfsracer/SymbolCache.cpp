@@ -0,0 +1,129 @@
+#include <sys/stat.h>
+#include <cstdlib>
+#include <sstream>
+
+#include "SymbolCache.h"
+
+
+namespace trace_generator {
+
+
+void SymbolCache::Load() {
+  file_t file = dr_open_file(filename.c_str(), DR_FILE_READ);
+  if (file == INVALID_FILE) {
+    return;
+  }
+  uint64_t size = 0;
+  string contents;
+  if (dr_file_size(file, &size)) {
+    contents.resize(size);
+    ssize_t read = dr_read_file(file, &contents[0], size);
+    contents.resize(read > 0 ? read : 0);
+  }
+  dr_close_file(file);
+
+  // Every line has the form: <module key>\t<symbol>\t<offset or ->.
+  istringstream in(contents);
+  string line;
+  dr_mutex_lock(lock);
+  while (getline(in, line)) {
+    size_t first = line.find('\t');
+    size_t second = line.find('\t', first + 1);
+    if (first == string::npos || second == string::npos) {
+      continue;
+    }
+    string value = line.substr(second + 1);
+    optional<size_t> offset;
+    if (value != "-") {
+      char *end = nullptr;
+      offset = strtoull(value.c_str(), &end, 16);
+      if (value.empty() || *end != '\0') {
+        continue;
+      }
+    }
+    entries[{ line.substr(0, first),
+              line.substr(first + 1, second - first - 1) }] = offset;
+  }
+  dr_mutex_unlock(lock);
+}
+
+
+bool SymbolCache::Save() {
+  dr_mutex_lock(lock);
+  if (!dirty) {
+    dr_mutex_unlock(lock);
+    return true;
+  }
+  ostringstream out;
+  for (auto const &entry : entries) {
+    out << entry.first.first << "\t" << entry.first.second << "\t";
+    if (entry.second.has_value()) {
+      out << hex << entry.second.value() << dec;
+    } else {
+      out << "-";
+    }
+    out << "\n";
+  }
+  dirty = false;
+  dr_mutex_unlock(lock);
+
+  // We write to a temporary file first, so that concurrent executions
+  // never read a partially written cache.
+  string contents = out.str();
+  string tmp = filename + "." + to_string(dr_get_process_id());
+  file_t file = dr_open_file(tmp.c_str(), DR_FILE_WRITE_OVERWRITE);
+  if (file == INVALID_FILE) {
+    return false;
+  }
+  bool ok = dr_write_file(file, contents.data(), contents.size()) ==
+    (ssize_t) contents.size();
+  dr_close_file(file);
+  return ok && dr_rename_file(tmp.c_str(), filename.c_str(), true);
+}
+
+
+string SymbolCache::GetModuleKey(const module_data_t *mod) {
+  if (!mod || !mod->full_path) {
+    return "";
+  }
+  struct stat st;
+  if (stat(mod->full_path, &st) != 0) {
+    return "";
+  }
+  string path = mod->full_path;
+  if (path.find('\t') != string::npos || path.find('\n') != string::npos) {
+    return "";
+  }
+  return path + ":" + to_string(st.st_mtime) + ":" + to_string(st.st_size);
+}
+
+
+bool SymbolCache::Lookup(const string &module_key, const string &symbol,
+                         optional<size_t> &offset) const {
+  if (module_key.empty()) {
+    return false;
+  }
+  dr_mutex_lock(lock);
+  auto it = entries.find({ module_key, symbol });
+  bool found = it != entries.end();
+  if (found) {
+    offset = it->second;
+  }
+  dr_mutex_unlock(lock);
+  return found;
+}
+
+
+void SymbolCache::Add(const string &module_key, const string &symbol,
+                      optional<size_t> offset) {
+  if (module_key.empty()) {
+    return;
+  }
+  dr_mutex_lock(lock);
+  entries[{ module_key, symbol }] = offset;
+  dirty = true;
+  dr_mutex_unlock(lock);
+}
+
+
+} // namespace trace_generator
@@ -0,0 +1,86 @@
+#ifndef SYMBOL_CACHE_H
+#define SYMBOL_CACHE_H
+
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "dr_api.h"
+
+
+using namespace std;
+
+
+namespace trace_generator {
+
+/**
+ * A cache of the offsets of the wrapped functions that persists
+ * across executions.
+ *
+ * Resolving symbols through debug information is slow for large
+ * binaries (e.g., node). The cache stores the offset of every looked
+ * up symbol (or its absence) per module, so that subsequent executions
+ * do not search the symbol tables at all.
+ *
+ * A module is identified by its path, modification time, and size,
+ * so an entry is never reused once the module is rebuilt.
+ */
+class SymbolCache {
+  public:
+    /** Constructs a cache stored in the given file. */
+    SymbolCache(const string &filename_):
+      filename(filename_),
+      lock(dr_mutex_create()),
+      dirty(false) {  }
+
+    ~SymbolCache() {
+      dr_mutex_destroy(lock);
+    }
+
+    /**
+     * Loads the entries of the file (if it exists).
+     *
+     * Malformed lines are ignored.
+     */
+    void Load();
+
+    /** Writes the entries to the file if new entries have been added. */
+    bool Save();
+
+    /**
+     * Gets the key that identifies the given module. The key is empty
+     * if the module cannot be identified; such modules are not cached.
+     */
+    static string GetModuleKey(const module_data_t *mod);
+
+    /**
+     * Looks up the given symbol of the given module.
+     *
+     * Returns false on a cache miss. Otherwise, `offset` holds
+     * the offset of the symbol, or nothing if the module does not
+     * define the symbol.
+     */
+    bool Lookup(const string &module_key, const string &symbol,
+                optional<size_t> &offset) const;
+
+    /** Adds the result of looking up the given symbol. */
+    void Add(const string &module_key, const string &symbol,
+             optional<size_t> offset);
+
+  private:
+    /// The file where the cache is stored.
+    string filename;
+    /// Maps a pair of module key and symbol to the offset of the symbol.
+    map<pair<string, string>, optional<size_t>> entries;
+    /// Lock protecting the entries, as modules may be loaded
+    /// by different threads.
+    void *lock;
+    /// Whether there are entries that have not been saved yet.
+    bool dirty;
+};
+
+
+} // namespace trace_generator
+
+#endif
@@ -0,0 +1,675 @@
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "dr_api.h"
+#include "drmgr.h"
+
+#include "SyscallCapture.h"
+
+
+// Note that we cannot include <fcntl.h>, because `Operation.h` defines
+// its own `AT_FDCWD`. These are the values of the Linux kernel.
+#define KERNEL_AT_FDCWD -100
+#define KERNEL_AT_SYMLINK_NOFOLLOW 0x100
+#define KERNEL_AT_SYMLINK_FOLLOW 0x400
+#define KERNEL_O_ACCMODE 3
+#define KERNEL_O_WRONLY 1
+#define KERNEL_O_CREAT 0100
+#define KERNEL_O_TRUNC 01000
+#define KERNEL_CLONE_VM 0x100
+#define KERNEL_CLONE_FS 0x200
+#define KERNEL_CLONE_FILES 0x400
+#define KERNEL_CLONE_VFORK 0x4000
+#define KERNEL_CLONE_THREAD 0x10000
+
+/// The maximum length of a path read from the memory of the program.
+#define MAX_PATH_LEN 4096
+#ifndef PAGE_SIZE
+#define PAGE_SIZE 4096
+#endif
+
+
+namespace trace_generator {
+
+
+static bool is_registered = false;
+/// The generator that decides which paths are traced.
+static DynamoTraceGenerator *generator = nullptr;
+/// Whether file operations are captured.
+static bool capture_files = false;
+
+
+static reg_t
+get_param(void *drcontext, int pos)
+{
+  return dr_syscall_get_param(drcontext, pos);
+}
+
+
+static size_t
+get_dirfd(void *drcontext, int pos)
+{
+  int dirfd = (int) get_param(drcontext, pos);
+  return dirfd == KERNEL_AT_FDCWD ? AT_FDCWD : dirfd;
+}
+
+
+/**
+ * Copies the path pointed to by the given argument of the system call.
+ *
+ * The memory is read safely, because the program may pass an invalid
+ * pointer (the system call then fails with `EFAULT`).
+ */
+static bool
+get_path(void *drcontext, int pos, string &path)
+{
+  const char *ptr = (const char *) get_param(drcontext, pos);
+  path.clear();
+  if (!ptr) {
+    return false;
+  }
+  char buf[256];
+  while (path.size() < MAX_PATH_LEN) {
+    // A chunk never crosses a page boundary, so a read only fails
+    // if the path itself is not readable.
+    const char *start = ptr + path.size();
+    size_t size = PAGE_SIZE - ((ptr_uint_t) start & (PAGE_SIZE - 1));
+    if (size > sizeof(buf)) {
+      size = sizeof(buf);
+    }
+    if (!dr_safe_read(start, size, buf, NULL)) {
+      return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+      if (buf[i] == '\0') {
+        // An empty path refers to the dir file descriptor itself
+        // (e.g., `AT_EMPTY_PATH`), so it does not access any path.
+        return !path.empty();
+      }
+      path.push_back(buf[i]);
+    }
+  }
+  return false;
+}
+
+
+static bool
+is_traced(size_t dirfd, const string &path)
+{
+  return !generator || generator->IsTraced(dirfd, path);
+}
+
+
+/**
+ * Adds an `hpath` (or `hpathsym`) to the `execOp` of the given thread,
+ * unless its path is not traced, or the access is redundant.
+ */
+static bool
+add_hpath(ThreadState *state, size_t dirfd, const string &path,
+          enum Hpath::EffectType effect_type, bool follow_symlink,
+          const string &op_name)
+{
+  if (!is_traced(dirfd, path) || (generator && generator->IsRedundant(
+          state, dirfd, path, effect_type, follow_symlink, op_name))) {
+    return false;
+  }
+  Operation *op = nullptr;
+  if (follow_symlink) {
+    op = new Hpath(dirfd, path, effect_type);
+  } else {
+    op = new HpathSym(dirfd, path, effect_type);
+  }
+  op->SetActualOpName(op_name);
+  state->exec_op->AddOperation(op);
+  return true;
+}
+
+
+/**
+ * Emits a single `hpath` (or `hpathsym`) for the path at the given
+ * position. If `dirfd_pos` is negative, the path is relative to
+ * the current working directory.
+ */
+static bool
+emit_hpath(void *drcontext, ThreadState *state, int dirfd_pos, int path_pos,
+           enum Hpath::EffectType effect_type, bool follow_symlink,
+           const string &op_name)
+{
+  string path;
+  if (!get_path(drcontext, path_pos, path)) {
+    return false;
+  }
+  size_t dirfd = dirfd_pos < 0 ? AT_FDCWD : get_dirfd(drcontext, dirfd_pos);
+  return add_hpath(state, dirfd, path, effect_type, follow_symlink,
+                   op_name);
+}
+
+
+/** Emits the operations of `open`-like system calls. */
+static bool
+emit_open(void *drcontext, ThreadState *state, int dirfd_pos, int path_pos,
+          int flags, const string &op_name)
+{
+  string &path = *state->pending_path;
+  if (!get_path(drcontext, path_pos, path)) {
+    return false;
+  }
+  size_t dirfd = dirfd_pos < 0 ? AT_FDCWD : get_dirfd(drcontext, dirfd_pos);
+  // Like the `open` wrapper, we only check the access mode.
+  enum Hpath::EffectType effect_type =
+    (flags & KERNEL_O_ACCMODE) == 0 ? Hpath::CONSUMED : Hpath::PRODUCED;
+  if (!is_traced(dirfd, path)) {
+    // If the path is not traced, neither is its file descriptor.
+    return false;
+  }
+  add_hpath(state, dirfd, path, effect_type, true, op_name);
+  // The file descriptor is known once the system call returns.
+  state->pending_dirfd = dirfd;
+  return true;
+}
+
+
+/** Emits the operations of `link`-like system calls. */
+static bool
+emit_link(void *drcontext, ThreadState *state, int old_dirfd_pos,
+          int old_path_pos, int new_dirfd_pos, int new_path_pos,
+          bool follow_symlink, const string &op_name)
+{
+  string old_path, new_path;
+  if (!get_path(drcontext, old_path_pos, old_path) ||
+      !get_path(drcontext, new_path_pos, new_path)) {
+    return false;
+  }
+  size_t old_dirfd = old_dirfd_pos < 0 ?
+    AT_FDCWD : get_dirfd(drcontext, old_dirfd_pos);
+  size_t new_dirfd = new_dirfd_pos < 0 ?
+    AT_FDCWD : get_dirfd(drcontext, new_dirfd_pos);
+  if (!is_traced(old_dirfd, old_path) && !is_traced(new_dirfd, new_path)) {
+    return false;
+  }
+  add_hpath(state, old_dirfd, old_path, Hpath::CONSUMED, follow_symlink,
+            op_name);
+  add_hpath(state, new_dirfd, new_path, Hpath::PRODUCED, false, op_name);
+  DynamoTraceGenerator::ForgetAccesses(state);
+  Link *link = new Link(old_dirfd, old_path, new_dirfd, new_path);
+  link->SetActualOpName(op_name);
+  state->exec_op->AddOperation(link);
+  return true;
+}
+
+
+/** Emits the operations of `rename`-like system calls. */
+static bool
+emit_rename(void *drcontext, ThreadState *state, int old_dirfd_pos,
+            int old_path_pos, int new_dirfd_pos, int new_path_pos,
+            const string &op_name)
+{
+  string old_path, new_path;
+  if (!get_path(drcontext, old_path_pos, old_path) ||
+      !get_path(drcontext, new_path_pos, new_path)) {
+    return false;
+  }
+  size_t old_dirfd = old_dirfd_pos < 0 ?
+    AT_FDCWD : get_dirfd(drcontext, old_dirfd_pos);
+  size_t new_dirfd = new_dirfd_pos < 0 ?
+    AT_FDCWD : get_dirfd(drcontext, new_dirfd_pos);
+  if (!is_traced(old_dirfd, old_path) && !is_traced(new_dirfd, new_path)) {
+    return false;
+  }
+  add_hpath(state, old_dirfd, old_path, Hpath::EXPUNGED, true, op_name);
+  add_hpath(state, new_dirfd, new_path, Hpath::PRODUCED, true, op_name);
+  DynamoTraceGenerator::ForgetAccesses(state);
+  Rename *rename = new Rename(old_dirfd, old_path, new_dirfd, new_path);
+  rename->SetActualOpName(op_name);
+  state->exec_op->AddOperation(rename);
+  return true;
+}
+
+
+/** Emits the operations of `symlink`-like system calls. */
+static bool
+emit_symlink(void *drcontext, ThreadState *state, int target_pos,
+             int new_dirfd_pos, int new_path_pos, const string &op_name)
+{
+  string target, new_path;
+  if (!get_path(drcontext, target_pos, target) ||
+      !get_path(drcontext, new_path_pos, new_path)) {
+    return false;
+  }
+  size_t new_dirfd = new_dirfd_pos < 0 ?
+    AT_FDCWD : get_dirfd(drcontext, new_dirfd_pos);
+  if (!is_traced(new_dirfd, new_path)) {
+    return false;
+  }
+  DynamoTraceGenerator::ForgetAccesses(state);
+  Symlink *symlink = new Symlink(new_dirfd, new_path, target);
+  symlink->SetActualOpName(op_name);
+  state->exec_op->AddOperation(symlink);
+  return true;
+}
+
+
+static bool
+follows(void *drcontext, int flags_pos)
+{
+  return !(get_param(drcontext, flags_pos) & KERNEL_AT_SYMLINK_NOFOLLOW);
+}
+
+
+/** Checks whether the given system call creates a process (or thread). */
+static bool
+is_clone(int sysnum)
+{
+  switch (sysnum) {
+    case SYS_clone:
+#ifdef SYS_clone3
+    case SYS_clone3:
+#endif
+#ifdef SYS_fork
+    case SYS_fork:
+#endif
+#ifdef SYS_vfork
+    case SYS_vfork:
+#endif
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+/**
+ * Gets the flags of the given system call that creates a process.
+ * `fork` and `vfork` have no flags, so we use their equivalent ones.
+ */
+static uint64_t
+get_clone_flags(void *drcontext, int sysnum)
+{
+  switch (sysnum) {
+    case SYS_clone:
+      return get_param(drcontext, 0);
+#ifdef SYS_clone3
+    case SYS_clone3: {
+      // The flags are the first field of `struct clone_args`.
+      uint64_t flags = 0;
+      const void *args = (const void *) get_param(drcontext, 0);
+      if (!args || !dr_safe_read(args, sizeof(flags), &flags, NULL)) {
+        return 0;
+      }
+      return flags;
+    }
+#endif
+#ifdef SYS_vfork
+    case SYS_vfork:
+      return KERNEL_CLONE_VM | KERNEL_CLONE_VFORK;
+#endif
+    default:
+      return 0;
+  }
+}
+
+
+/** Gets the name of the given system call that creates a process. */
+static string
+get_clone_name(int sysnum)
+{
+  switch (sysnum) {
+#ifdef SYS_fork
+    case SYS_fork:
+      return "fork";
+#endif
+#ifdef SYS_vfork
+    case SYS_vfork:
+      return "vfork";
+#endif
+    default:
+      return "clone";
+  }
+}
+
+
+/**
+ * Emits the `newProc` of a system call that has created the process
+ * with the given id.
+ */
+static void
+emit_new_proc(ThreadState *state, int sysnum, size_t pid)
+{
+  uint64_t flags = state->pending_flags;
+  enum NewProc::CloneMode clone_mode = NewProc::SHARE_NONE;
+  if ((flags & KERNEL_CLONE_FS) && (flags & KERNEL_CLONE_FILES)) {
+    clone_mode = NewProc::SHARE_BOTH;
+  } else if (flags & KERNEL_CLONE_FS) {
+    clone_mode = NewProc::SHARE_FS;
+  } else if (flags & KERNEL_CLONE_FILES) {
+    clone_mode = NewProc::SHARE_FD;
+  }
+  NewProc *new_proc = new NewProc(clone_mode);
+  new_proc->SetPID(pid);
+  new_proc->SetActualOpName(get_clone_name(sysnum));
+  generator->AddNewProc(state, new_proc);
+}
+
+
+/**
+ * Emits the `waitProc` of a `wait4` that has returned the process with
+ * the given id, if that process has terminated.
+ */
+static void
+emit_wait_proc(ThreadState *state, size_t pid)
+{
+  int status = 0;
+  if (state->pending_status) {
+    if (!dr_safe_read(state->pending_status, sizeof(status), &status,
+                      NULL)) {
+      return;
+    }
+    if (!WIFEXITED(status) && !WIFSIGNALED(status)) {
+      // The process has stopped or continued.
+      return;
+    }
+  } else if (state->pending_flags & (WUNTRACED | WCONTINUED)) {
+    // Without the status, we do not know whether it has terminated.
+    return;
+  }
+  WaitProc *wait_proc = new WaitProc(pid);
+  wait_proc->SetActualOpName("wait4");
+  generator->AddWaitProc(state, wait_proc);
+}
+
+
+static bool
+filter_syscall_event(void *drcontext, int sysnum)
+{
+  if (is_clone(sysnum) || sysnum == SYS_wait4) {
+    return true;
+  }
+  if (!capture_files) {
+    return false;
+  }
+  switch (sysnum) {
+    case SYS_access:
+    case SYS_faccessat:
+#ifdef SYS_faccessat2
+    case SYS_faccessat2:
+#endif
+    case SYS_chmod:
+    case SYS_fchmodat:
+    case SYS_chown:
+    case SYS_lchown:
+    case SYS_fchownat:
+    case SYS_open:
+    case SYS_openat:
+    case SYS_creat:
+    case SYS_close:
+    case SYS_link:
+    case SYS_linkat:
+    case SYS_stat:
+    case SYS_lstat:
+    case SYS_newfstatat:
+#ifdef SYS_statx
+    case SYS_statx:
+#endif
+    case SYS_mkdir:
+    case SYS_mkdirat:
+    case SYS_readlink:
+    case SYS_readlinkat:
+    case SYS_rename:
+    case SYS_renameat:
+#ifdef SYS_renameat2
+    case SYS_renameat2:
+#endif
+    case SYS_rmdir:
+    case SYS_symlink:
+    case SYS_symlinkat:
+    case SYS_unlink:
+    case SYS_unlinkat:
+    case SYS_utime:
+    case SYS_utimes:
+    case SYS_futimesat:
+    case SYS_utimensat:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+static bool
+pre_syscall_event(void *drcontext, int sysnum)
+{
+  ThreadState *state = DynamoTraceGenerator::GetDrThreadState(drcontext);
+  if (!state) {
+    return true;
+  }
+  if (is_clone(sysnum)) {
+    uint64_t flags = get_clone_flags(drcontext, sysnum);
+    // Threads belong to the process, so we only track new processes.
+    state->pending_flags = flags;
+    state->pending_syscall = flags & KERNEL_CLONE_THREAD ? -1 : sysnum;
+    return true;
+  }
+  if (sysnum == SYS_wait4) {
+    state->pending_status = (const int *) get_param(drcontext, 1);
+    state->pending_flags = get_param(drcontext, 2);
+    state->pending_syscall = sysnum;
+    return true;
+  }
+  // Operations are only recorded while the thread executes an `execOp`.
+  if (!state->exec_op) {
+    return true;
+  }
+  ExecOp *exec_op = state->exec_op;
+  // Whether the result of the system call is needed.
+  bool pending = false;
+  switch (sysnum) {
+    case SYS_access:
+      emit_hpath(drcontext, state, -1, 0, Hpath::CONSUMED, true, "access");
+      break;
+    case SYS_faccessat:
+#ifdef SYS_faccessat2
+    case SYS_faccessat2:
+#endif
+      emit_hpath(drcontext, state, 0, 1, Hpath::CONSUMED, true, "access");
+      break;
+    case SYS_chmod:
+      emit_hpath(drcontext, state, -1, 0, Hpath::CONSUMED, true, "chmod");
+      break;
+    case SYS_fchmodat:
+      emit_hpath(drcontext, state, 0, 1, Hpath::CONSUMED, true, "chmod");
+      break;
+    case SYS_chown:
+      emit_hpath(drcontext, state, -1, 0, Hpath::CONSUMED, true, "chown");
+      break;
+    case SYS_lchown:
+      emit_hpath(drcontext, state, -1, 0, Hpath::CONSUMED, false,
+                 "lchown");
+      break;
+    case SYS_fchownat:
+      emit_hpath(drcontext, state, 0, 1, Hpath::CONSUMED,
+                 follows(drcontext, 4), "chown");
+      break;
+    case SYS_open:
+      pending = emit_open(drcontext, state, -1, 0,
+                          (int) get_param(drcontext, 1), "open");
+      break;
+    case SYS_openat:
+      pending = emit_open(drcontext, state, 0, 1,
+                          (int) get_param(drcontext, 2), "open");
+      break;
+    case SYS_creat:
+      pending = emit_open(drcontext, state, -1, 0,
+                          KERNEL_O_CREAT | KERNEL_O_WRONLY | KERNEL_O_TRUNC,
+                          "open");
+      break;
+    case SYS_close: {
+      DelFd *del_fd = new DelFd((int) get_param(drcontext, 0));
+      del_fd->SetActualOpName("close");
+      exec_op->AddOperation(del_fd);
+      DynamoTraceGenerator::ForgetAccesses(state);
+      pending = true;
+      break;
+    }
+    case SYS_link:
+      pending = emit_link(drcontext, state, -1, 0, -1, 1, false, "link");
+      break;
+    case SYS_linkat:
+      pending = emit_link(
+          drcontext, state, 0, 1, 2, 3,
+          get_param(drcontext, 4) & KERNEL_AT_SYMLINK_FOLLOW, "link");
+      break;
+    case SYS_stat:
+      emit_hpath(drcontext, state, -1, 0, Hpath::CONSUMED, true, "stat");
+      break;
+    case SYS_lstat:
+      emit_hpath(drcontext, state, -1, 0, Hpath::CONSUMED, false, "lstat");
+      break;
+    case SYS_newfstatat:
+      emit_hpath(drcontext, state, 0, 1, Hpath::CONSUMED,
+                 follows(drcontext, 3), "stat");
+      break;
+#ifdef SYS_statx
+    case SYS_statx:
+      emit_hpath(drcontext, state, 0, 1, Hpath::CONSUMED,
+                 follows(drcontext, 2), "stat");
+      break;
+#endif
+    case SYS_mkdir:
+      pending = emit_hpath(drcontext, state, -1, 0, Hpath::PRODUCED, false,
+                           "mkdir");
+      break;
+    case SYS_mkdirat:
+      pending = emit_hpath(drcontext, state, 0, 1, Hpath::PRODUCED, false,
+                           "mkdir");
+      break;
+    case SYS_readlink:
+      emit_hpath(drcontext, state, -1, 0, Hpath::CONSUMED, true,
+                 "readlink");
+      break;
+    case SYS_readlinkat:
+      emit_hpath(drcontext, state, 0, 1, Hpath::CONSUMED, true,
+                 "readlink");
+      break;
+    case SYS_rename:
+      pending = emit_rename(drcontext, state, -1, 0, -1, 1, "rename");
+      break;
+    case SYS_renameat:
+#ifdef SYS_renameat2
+    case SYS_renameat2:
+#endif
+      pending = emit_rename(drcontext, state, 0, 1, 2, 3, "rename");
+      break;
+    case SYS_rmdir:
+      pending = emit_hpath(drcontext, state, -1, 0, Hpath::EXPUNGED, true,
+                           "rmdir");
+      break;
+    case SYS_symlink:
+      pending = emit_symlink(drcontext, state, 0, -1, 1, "symlink");
+      break;
+    case SYS_symlinkat:
+      pending = emit_symlink(drcontext, state, 0, 1, 2, "symlink");
+      break;
+    case SYS_unlink:
+      pending = emit_hpath(drcontext, state, -1, 0, Hpath::EXPUNGED, true,
+                           "unlink");
+      break;
+    case SYS_unlinkat:
+      // With `AT_REMOVEDIR`, this is equivalent to `rmdir`.
+      pending = emit_hpath(drcontext, state, 0, 1, Hpath::EXPUNGED, true,
+                           "unlink");
+      break;
+    case SYS_utime:
+    case SYS_utimes:
+      emit_hpath(drcontext, state, -1, 0, Hpath::CONSUMED, true, "utime");
+      break;
+    case SYS_futimesat:
+      emit_hpath(drcontext, state, 0, 1, Hpath::CONSUMED, true, "utime");
+      break;
+    case SYS_utimensat:
+      emit_hpath(drcontext, state, 0, 1, Hpath::CONSUMED,
+                 follows(drcontext, 3), "utime");
+      break;
+    default:
+      break;
+  }
+  state->pending_syscall = pending ? sysnum : -1;
+  // The system call is always executed.
+  return true;
+}
+
+
+static void
+post_syscall_event(void *drcontext, int sysnum)
+{
+  ThreadState *state = DynamoTraceGenerator::GetDrThreadState(drcontext);
+  if (!state || state->pending_syscall != sysnum) {
+    return;
+  }
+  state->pending_syscall = -1;
+  // On failure, system calls return a negated error number.
+  ptr_int_t ret_val = (ptr_int_t) dr_syscall_get_result(drcontext);
+  if (is_clone(sysnum)) {
+    // The child also returns from the system call (with zero), but
+    // only the parent knows the id of the new process.
+    if (ret_val > 0 && generator) {
+      emit_new_proc(state, sysnum, (size_t) ret_val);
+    }
+    return;
+  }
+  if (sysnum == SYS_wait4) {
+    // `WNOHANG` returns zero if no process has changed state.
+    if (ret_val > 0 && generator) {
+      emit_wait_proc(state, (size_t) ret_val);
+    }
+    return;
+  }
+  ExecOp *exec_op = state->exec_op;
+  if (!exec_op) {
+    return;
+  }
+  switch (sysnum) {
+    case SYS_open:
+    case SYS_openat:
+    case SYS_creat: {
+      NewFd *new_fd = new NewFd(state->pending_dirfd, *state->pending_path,
+                                (int) ret_val);
+      new_fd->SetActualOpName("open");
+      if (ret_val < 0) {
+        new_fd->MarkFailed();
+      }
+      exec_op->AddOperation(new_fd);
+      DynamoTraceGenerator::ForgetAccesses(state);
+      break;
+    }
+    default:
+      if (ret_val < 0) {
+        exec_op->MarkLastOperationFailed();
+      }
+      break;
+  }
+}
+
+
+bool SyscallCapture::Init(DynamoTraceGenerator *generator_,
+                          bool capture_files_) {
+  generator = generator_;
+  capture_files = capture_files_;
+  dr_register_filter_syscall_event(filter_syscall_event);
+  is_registered = drmgr_register_pre_syscall_event(pre_syscall_event) &&
+    drmgr_register_post_syscall_event(post_syscall_event);
+  return is_registered;
+}
+
+
+void SyscallCapture::Exit() {
+  if (!is_registered) {
+    return;
+  }
+  dr_unregister_filter_syscall_event(filter_syscall_event);
+  drmgr_unregister_pre_syscall_event(pre_syscall_event);
+  drmgr_unregister_post_syscall_event(post_syscall_event);
+  is_registered = false;
+}
+
+
+} // namespace trace_generator
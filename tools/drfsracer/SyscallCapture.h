@@ -0,0 +1,49 @@
+#ifndef SYSCALL_CAPTURE_H
+#define SYSCALL_CAPTURE_H
+
+#include "dr_api.h"
+#include "drmgr.h"
+
+#include "DynamoTraceGenerator.h"
+
+
+namespace trace_generator {
+
+/**
+ * Captures the file operations of the traced program at the level of
+ * system calls.
+ *
+ * This is an alternative to wrapping the libc functions that perform
+ * file operations. Every file system call that a thread performs while
+ * it executes an `execOp` is translated into the corresponding
+ * operations, which are appended to that `execOp`. Unlike the libc
+ * wrappers, this also covers the `*at` variants of system calls
+ * (e.g., `openat`, `unlinkat`, `statx`) that modern versions of libuv
+ * use, and keeps their actual dir file descriptors.
+ *
+ * Independently of how file operations are captured, the creation of
+ * processes (`fork`, `vfork`, `clone`, and `clone3`) is always
+ * captured here, so that every process of the program can be traced.
+ *
+ * This relies on the thread states of `DynamoTraceGenerator`.
+ */
+class SyscallCapture {
+  public:
+    /**
+     * Registers the events that filter and intercept system calls.
+     * File operations are only captured if `capture_files_` is true,
+     * and only the operations on the paths that the given generator
+     * traces are recorded.
+     *
+     * This must be called after `drmgr` is initialized.
+     */
+    static bool Init(DynamoTraceGenerator *generator_, bool capture_files_);
+
+    /** Unregisters the events of system calls. */
+    static void Exit();
+};
+
+
+} // namespace trace_generator
+
+#endif
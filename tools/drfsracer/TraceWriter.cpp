@@ -0,0 +1,129 @@
+#include "Analyzer.h"
+#include "TraceWriter.h"
+
+
+namespace trace_generator {
+
+
+TraceWriter::~TraceWriter() {
+  if (file != INVALID_FILE) {
+    dr_close_file(file);
+  }
+  dr_mutex_destroy(lock);
+}
+
+
+bool TraceWriter::Open(size_t pid_, const string &cwd_) {
+  pid = pid_;
+  cwd = cwd_;
+  dr_mutex_lock(lock);
+  bool opened = OpenSegment();
+  dr_mutex_unlock(lock);
+  return opened;
+}
+
+
+bool TraceWriter::Rotate(const string &prologue) {
+  dr_mutex_lock(lock);
+  if (file != INVALID_FILE) {
+    dr_close_file(file);
+  }
+  segment++;
+  rotation_pending = false;
+  bool opened = OpenSegment();
+  if (opened) {
+    WriteData(prologue.data(), prologue.size());
+    // Like the header, the prologue does not count towards the size
+    // of the segment, so that a large prologue does not end every
+    // segment right away.
+    segment_bytes = 0;
+  }
+  dr_mutex_unlock(lock);
+  return opened;
+}
+
+
+bool TraceWriter::OpenSegment() {
+  file = dr_open_file(GetSegmentFilename(segment).c_str(),
+                      DR_FILE_WRITE_OVERWRITE);
+  if (file == INVALID_FILE) {
+    return false;
+  }
+  string header = "!PID: " + to_string(pid) + "\n";
+  header += "!Working Directory: " + cwd + "\n";
+  if (segment > 0) {
+    header += "!Segment: " + to_string(segment) + "\n";
+  }
+  WriteData(header.data(), header.size());
+  // The header does not count towards the size of the segment.
+  segment_bytes = 0;
+  return true;
+}
+
+
+string TraceWriter::ExecOpToString(const ExecOp *exec_op) {
+  analyzer::DumpAnalyzer dump_analyzer;
+  dump_analyzer.AnalyzeExecOp(exec_op);
+  return dump_analyzer.GetTraceBuffer();
+}
+
+
+string TraceWriter::BlockToString(const Block *block) {
+  analyzer::DumpAnalyzer dump_analyzer;
+  dump_analyzer.AnalyzeBlock(block);
+  return dump_analyzer.GetTraceBuffer();
+}
+
+
+void TraceWriter::WriteExecOp(string &buf, const ExecOp *exec_op) {
+  buf += ExecOpToString(exec_op);
+  MaybeFlush(buf);
+}
+
+
+void TraceWriter::WriteBlock(string &buf, const Block *block) {
+  buf += BlockToString(block);
+  MaybeFlush(buf);
+}
+
+
+void TraceWriter::MaybeFlush(string &buf) {
+  if (buf.size() >= flush_threshold) {
+    Flush(buf);
+  }
+}
+
+
+void TraceWriter::Flush(string &buf) {
+  if (buf.empty()) {
+    return;
+  }
+  dr_mutex_lock(lock);
+  if (file == INVALID_FILE) {
+    dr_mutex_unlock(lock);
+    return;
+  }
+  WriteData(buf.data(), buf.size());
+  if (segment_size && segment_bytes >= segment_size) {
+    // The segment only ends at the next MAIN block.
+    rotation_pending = true;
+  }
+  dr_mutex_unlock(lock);
+  buf.clear();
+}
+
+
+void TraceWriter::WriteData(const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = dr_write_file(file, data, size);
+    if (written <= 0) {
+      break;
+    }
+    data += written;
+    size -= written;
+    segment_bytes += written;
+  }
+}
+
+
+} // namespace trace_generator
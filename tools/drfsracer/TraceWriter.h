@@ -0,0 +1,159 @@
+#ifndef TRACE_WRITER_H
+#define TRACE_WRITER_H
+
+#include <string>
+
+#include "dr_api.h"
+
+#include "Trace.h"
+
+
+using namespace trace;
+using namespace std;
+
+
+namespace trace_generator {
+
+/**
+ * This class writes a trace to a file while the trace is being
+ * generated.
+ *
+ * Every thread serializes the parts of the trace it completes into
+ * its own buffer. A buffer is drained to the file with a single write
+ * once it exceeds a threshold, so the file always consists of complete
+ * `execOp` and block definitions. If the traced program is killed,
+ * the file holds a prefix of the trace that can still be analyzed.
+ *
+ * Note that `execOp`s and blocks may be interleaved in the file.
+ *
+ * For long-running programs, the trace can be split into segments.
+ * Once the current segment exceeds a given size, or whenever it is asked
+ * to, the writer marks that a new segment is due. The trace generator
+ * starts it at the next MAIN block, after draining every buffer to
+ * the current segment. Every segment starts with the header of
+ * the trace, and every segment but the first one goes on with its
+ * number (`!Segment: <n>`) and a prologue that declares what it
+ * refers to from earlier segments (see `SegmentPrologue`).
+ * So a segment can be analyzed on its own,
+ * or merged with the segments before it (by repeating `--trace-file`
+ * of fsracer).
+ */
+class TraceWriter {
+  public:
+    /// The default size of a buffer before it is drained to the file.
+    static const size_t DEFAULT_FLUSH_THRESHOLD = 1 << 16;
+
+    /**
+     * Constructs a writer for the given file. If `segment_size_` is
+     * not zero, the trace is split into segments of about that many
+     * bytes.
+     */
+    TraceWriter(const string &filename_, size_t segment_size_ = 0,
+                size_t flush_threshold_ = DEFAULT_FLUSH_THRESHOLD):
+      filename(filename_),
+      file(INVALID_FILE),
+      lock(dr_mutex_create()),
+      flush_threshold(flush_threshold_),
+      pid(0),
+      segment(0),
+      segment_size(segment_size_),
+      segment_bytes(0),
+      rotation_pending(false) {  }
+
+    /** Closes the underlying file. */
+    ~TraceWriter();
+
+    /**
+     * Opens the file (truncating it), and writes the header of the trace,
+     * i.e., the process id and the working directory.
+     */
+    bool Open(size_t pid_, const string &cwd_);
+
+    /**
+     * Closes the current segment, and continues the trace in a new one,
+     * which starts with the given prologue. Buffers that have not been
+     * drained yet go to the new segment.
+     */
+    bool Rotate(const string &prologue);
+
+    /** Marks that the trace continues in a new segment. */
+    void RequestRotation() {
+      rotation_pending = true;
+    }
+
+    /** Checks whether the trace is due to continue in a new segment. */
+    bool IsRotationPending() const {
+      return rotation_pending;
+    }
+
+    /** Appends the given `execOp` to the given buffer. */
+    void WriteExecOp(string &buf, const ExecOp *exec_op);
+
+    /** Appends the given block to the given buffer. */
+    void WriteBlock(string &buf, const Block *block);
+
+    /** Serializes the given `execOp` in the format of trace files. */
+    static string ExecOpToString(const ExecOp *exec_op);
+
+    /** Serializes the given block in the format of trace files. */
+    static string BlockToString(const Block *block);
+
+    /** Drains the given buffer to the file. */
+    void Flush(string &buf);
+
+    /** Gets the name of the file. */
+    string GetFilename() const {
+      return filename;
+    }
+
+    /**
+     * Gets the name of the file of the given segment. The first segment
+     * is written to the file itself, and the n-th one to `<file>.<n>`.
+     */
+    string GetSegmentFilename(size_t segment_) const {
+      if (segment_ == 0) {
+        return filename;
+      }
+      return filename + "." + to_string(segment_);
+    }
+
+  private:
+    /// The name of the file.
+    string filename;
+    /// The file where the trace is written.
+    file_t file;
+    /// Lock that serializes the writes of different threads.
+    void *lock;
+    /// The size of a buffer before it is drained to the file.
+    size_t flush_threshold;
+    /// The header of every segment.
+    size_t pid;
+    string cwd;
+    /// The number of the current segment.
+    size_t segment;
+    /// The size of a segment before the writer moves to the next one
+    /// (zero if the trace is not split).
+    size_t segment_size;
+    /// The number of bytes written to the current segment.
+    size_t segment_bytes;
+    /// Whether the trace is due to continue in a new segment.
+    volatile bool rotation_pending;
+
+    /** Drains the given buffer if it exceeds the threshold. */
+    void MaybeFlush(string &buf);
+
+    /**
+     * Opens the file of the current segment, and writes the header
+     * (along with the number of the segment, if it is not the first).
+     * The caller must hold the lock.
+     */
+    bool OpenSegment();
+
+    /** Writes the given data to the file. The caller must hold the lock. */
+    void WriteData(const char *data, size_t size);
+};
+
+
+} // namespace trace_generator
+
+#endif
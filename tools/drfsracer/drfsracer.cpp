@@ -17,39 +17,220 @@
 #include "FSAnalyzer.h"
 #include "NodeGenerator.h"
 #include "OutWriter.h"
+#include "PathFilter.h"
 #include "Processor.h"
 #include "RaceDetector.h"
 #include "DynamoTraceGenerator.h"
+#include "SymbolCache.h"
+#include "SyscallCapture.h"
+#include "TraceRing.h"
 
 
 static trace_generator::DynamoTraceGenerator *trace_gen;
 static processor::Processor *trace_proc;
+static trace_generator::TraceWriter *trace_writer;
+/// The file where the trace is streamed (if any), and the size of
+/// its segments (zero if the trace is not split).
+static optional<string> trace_file;
+static size_t segment_size = 0;
+/// Lock that serializes the online analysis and the snapshots
+/// requested through nudges.
+static void *proc_lock;
+/// The rings where the trace is published, and their name (if any).
+static trace_ring::TraceRing *trace_ring_ptr;
+static optional<string> ring_name;
+/// The cache of resolved functions (if any).
+static trace_generator::SymbolCache *symbol_cache;
+/// Whether file operations are captured at system calls.
+static bool capture_syscalls = false;
+/// The filter that decides which paths are traced.
+static path_filter::PathFilter trace_filter;
+/// Whether the generated trace is needed after the end of execution.
+static bool keep_trace = true;
+/// Whether this is the child of a `fork` that has not called `exec`.
+/// Such a child only streams its own trace.
+static bool forked_child = false;
 bool module_loaded = false;
 
 
+/**
+ * The actions that can be requested while the program is running,
+ * through `drnudgeunix -pid <pid> -client <id> <action>`.
+ */
+enum nudge_action {
+  /// Drain the buffered parts of the trace to the trace file.
+  NUDGE_FLUSH = 1,
+  /// Dump the current output of the online analysis.
+  NUDGE_SNAPSHOT = 2,
+  /// Continue the trace in a new segment file, from the next MAIN
+  /// block on.
+  NUDGE_ROTATE = 3
+};
+
+
+static string
+get_current_directory()
+{
+  size_t buf_size = 100;
+  char *cwd_buf = (char *) dr_global_alloc(buf_size * sizeof(char));
+  // TODO: Maybe, we should call this function
+  // everytime we generate a trace that depends on
+  // the current working directory of the process.
+  dr_get_current_directory(cwd_buf, buf_size);
+  string cwd = cwd_buf; // copy it to a C++ string.
+  // Since we have copied the contents of the buffer,
+  // let's free memory.
+  dr_global_free(cwd_buf, buf_size);
+  return cwd;
+}
+
+
 static void
 module_load_event(void *drcontext, const module_data_t *mod, bool loaded)
 {
   trace_gen->Setup(mod);
   if (!module_loaded) {
     size_t pid = dr_get_thread_id(drcontext);
-
-    size_t buf_size = 100;
-    char *cwd_buf = (char *) dr_global_alloc(buf_size * sizeof(char));
-    // TODO: Maybe, we should call this function
-    // everytime we generate a trace that depends on
-    // the current working directory of the process.
-    dr_get_current_directory(cwd_buf, buf_size);
-    string cwd = cwd_buf; // copy it to a C++ string.
-    // Since we have copied the contents of the buffer,
-    // let's free memory.
-    dr_global_free(cwd_buf, buf_size);
+    string cwd = get_current_directory();
     trace_gen->GetTrace()->SetThreadId(pid);
-    trace_gen->GetTrace()->SetCwd(cwd);
+    trace_gen->SetCwd(cwd);
     module_loaded = true;
     trace_gen->Start();
     debug::info(trace_gen->GetName())
       << "PID " << pid << ", Start collecting trace...";
+    // It's useful to pass PID to the 'SetUp' function because we have
+    // to save files (if any specified by the user) based on the pid of
+    // the current process.
+    //
+    // This is needed in order to distinguish traces generated by different
+    // processes (e.g., parent and child processes).
+    trace_proc->Setup(pid);
+    if (trace_file.has_value()) {
+      // The trace is streamed to the file while it is being generated.
+      string filename = trace_file.value() + to_string(pid);
+      trace_writer = new trace_generator::TraceWriter(filename,
+                                                      segment_size);
+      if (!trace_writer->Open(pid, cwd)) {
+        debug::err(CMDLINE_PARSER_PACKAGE)
+          << "Unable to open trace file " << filename;
+        dr_exit_process(1);
+      }
+      trace_gen->SetTraceWriter(trace_writer, keep_trace);
+    }
+    if (ring_name.has_value()) {
+      // Another process analyzes the trace while it is being generated.
+      trace_ring_ptr = trace_ring::TraceRing::Create(ring_name.value());
+      if (!trace_ring_ptr) {
+        debug::err(CMDLINE_PARSER_PACKAGE)
+          << "Unable to create shared memory " << ring_name.value();
+        dr_exit_process(1);
+      }
+      trace_ring_ptr->SetHeader(pid, cwd);
+      trace_gen->SetTraceRing(trace_ring_ptr, keep_trace);
+    }
+    if (trace_proc->IsOnline()) {
+      // The processor consumes the trace while it is being generated.
+      // The processor frees every `execOp` and block once it analyzes
+      // them, unless they are kept in the trace.
+      trace_proc->StartOnlineAnalysis(trace_gen->GetTrace(), !keep_trace);
+      trace_gen->SetOnlineCallbacks(
+          [](const ExecOp *exec_op) {
+            if (forked_child) {
+              if (!keep_trace) {
+                delete exec_op;
+              }
+              return;
+            }
+            dr_mutex_lock(proc_lock);
+            trace_proc->AnalyzeExecOp(exec_op);
+            dr_mutex_unlock(proc_lock);
+          },
+          [](const Block *block) {
+            if (forked_child) {
+              if (!keep_trace) {
+                delete block;
+              }
+              return;
+            }
+            dr_mutex_lock(proc_lock);
+            trace_proc->AnalyzeBlock(block);
+            dr_mutex_unlock(proc_lock);
+          }, keep_trace);
+    }
+  }
+}
+
+
+static void
+event_fork_init(void *drcontext)
+{
+  // The child of a `fork` (that has not called `exec` yet) inherits
+  // the whole state of the client. Its trace starts from the current
+  // block of its parent, and `fsracer` links it with the `newProc`
+  // of the parent.
+  forked_child = true;
+  if (!trace_gen || !module_loaded) {
+    return;
+  }
+  trace_gen->ResetAfterFork(drcontext);
+  if (trace_ring_ptr) {
+    // The rings belong to the parent, so we only unmap them.
+    delete trace_ring_ptr;
+    trace_ring_ptr = nullptr;
+    trace_gen->SetTraceRing(nullptr, keep_trace);
+  }
+  if (trace_writer) {
+    size_t pid = dr_get_process_id();
+    string filename = trace_file.value() + to_string(pid);
+    trace_generator::TraceWriter *writer =
+      new trace_generator::TraceWriter(filename, segment_size);
+    if (!writer->Open(pid, get_current_directory())) {
+      debug::err(CMDLINE_PARSER_PACKAGE)
+        << "Unable to open trace file " << filename;
+      dr_exit_process(1);
+    }
+    trace_gen->SetTraceWriter(writer, keep_trace);
+    // This only closes the file descriptor of the child.
+    delete trace_writer;
+    trace_writer = writer;
+  }
+}
+
+
+static void
+event_nudge(void *drcontext, uint64 argument)
+{
+  if (!trace_gen || !module_loaded) {
+    return;
+  }
+  switch (argument) {
+    case NUDGE_FLUSH:
+      trace_gen->FlushTrace();
+      debug::info(trace_gen->GetName()) << "Trace flushed";
+      break;
+    case NUDGE_SNAPSHOT:
+      if (forked_child) {
+        break;
+      }
+      dr_mutex_lock(proc_lock);
+      trace_proc->Snapshot();
+      dr_mutex_unlock(proc_lock);
+      break;
+    case NUDGE_ROTATE:
+      if (!trace_writer) {
+        debug::warn(CMDLINE_PARSER_PACKAGE)
+          << "There is no trace file to rotate";
+        break;
+      }
+      // The current segment gets every part of the trace completed
+      // until the next MAIN block, where the new segment starts.
+      trace_writer->RequestRotation();
+      debug::info(trace_gen->GetName())
+        << "The next segment starts at the next MAIN block";
+      break;
+    default:
+      debug::warn(CMDLINE_PARSER_PACKAGE)
+        << "Unknown nudge action " << argument;
   }
 }
 
@@ -62,6 +243,9 @@ stop_trace_gen()
     return;
   }
   trace_gen->Stop();
+  if (trace_ring_ptr) {
+    trace_ring_ptr->Close();
+  }
   if (!trace_gen->HasFailed()) {
     debug::info(trace_gen->GetName()) << "Trace collected in "
       << trace_gen->GetTraceGenerationTime() << " seconds";
@@ -83,30 +267,45 @@ clear_fsracer_setup()
   if (trace_gen) {
     delete trace_gen;
   }
+  if (trace_writer) {
+    delete trace_writer;
+  }
+  if (trace_ring_ptr) {
+    delete trace_ring_ptr;
+  }
+  if (symbol_cache) {
+    delete symbol_cache;
+  }
 }
 
 
 static void
 event_exit(void)
 {
+  dr_unregister_nudge_event(event_nudge);
+  dr_unregister_fork_init_event(event_fork_init);
   // Traces collected. Stop trace generator.
   stop_trace_gen();
-  if (trace_gen && !trace_gen->HasFailed()) {
-    void *drcontext = dr_get_current_drcontext();
-    // It's useful to pass PID to the 'SetUp' function because we have
-    // to save files (if any specified by the user) based on the pid of
-    // the current process.
-    //
-    // This is needed in order to distinguish traces generated by different
-    // processes (e.g., parent and child processes).
-    optional<size_t> pid = dr_get_thread_id(drcontext);
-    trace_proc->Setup(pid);
-    trace_proc->AnalyzeTraces(trace_gen->GetTrace());
+  if (symbol_cache && !forked_child && !symbol_cache->Save()) {
+    debug::warn(CMDLINE_PARSER_PACKAGE)
+      << "Unable to save symbol cache";
+  }
+  // The analysis of a forked child would overwrite that of its parent.
+  if (trace_gen && !trace_gen->HasFailed() && !forked_child) {
+    if (trace_proc->IsOnline()) {
+      trace_proc->StopOnlineAnalysis();
+    } else {
+      trace_proc->AnalyzeTraces(trace_gen->GetTrace());
+    }
     trace_proc->DetectFaults();
   }
   // Deallocate memory and clear things.
   clear_fsracer_setup();
 
+  dr_mutex_destroy(proc_lock);
+
+  trace_generator::SyscallCapture::Exit();
+  trace_generator::DynamoTraceGenerator::ExitThreadStates();
   drwrap_exit();
   drmgr_exit();
   drsym_exit();
@@ -148,12 +347,37 @@ process_args(gengetopt_args_info &args_info)
       << "are mutually exclusive";
   }
 
+  if (args_info.gc_threshold_given && args_info.gc_threshold_arg < 0) {
+    debug::err(CMDLINE_PARSER_PACKAGE)
+      << "option '--gc-threshold' expects a non-negative number";
+    dr_exit_process(1);
+  }
+
+  if (args_info.segment_size_given) {
+    if (!args_info.output_trace_given) {
+      debug::err(CMDLINE_PARSER_PACKAGE)
+        << "option '--segment-size' requires '--output-trace'";
+      dr_exit_process(1);
+    }
+    if (args_info.segment_size_arg <= 0) {
+      debug::err(CMDLINE_PARSER_PACKAGE)
+        << "option '--segment-size' expects a positive number";
+      dr_exit_process(1);
+    }
+    segment_size = args_info.segment_size_arg;
+  }
+
   processor::CLIArgs args;
   if (args_info.dump_trace_given) {
     args.dump_trace = true;
   }
   if (args_info.output_trace_given) {
-    args.output_trace = args_info.output_trace_arg;
+    // Unlike the trace dumped to the standard output, this trace
+    // is written while the program is running.
+    trace_file = args_info.output_trace_arg;
+  }
+  if (args_info.publish_given) {
+    ring_name = args_info.publish_arg;
   }
   if (args_info.analyzer_given) {
     for (int i = 0; i < args_info.analyzer_given; i++) {
@@ -175,6 +399,15 @@ process_args(gengetopt_args_info &args_info)
     }
   }
 
+  if (args_info.gc_threshold_given) {
+    args.cli_options.AddEntry("gc_threshold",
+                              to_string(args_info.gc_threshold_arg));
+  }
+
+  if (args_info.online_given) {
+    args.cli_options.AddEntry("online", "true");
+  }
+
   if (args_info.dep_graph_format_given) {
     args.cli_options.AddEntry("dep_graph_format",
                               args_info.dep_graph_format_arg);
@@ -203,8 +436,41 @@ process_args(gengetopt_args_info &args_info)
                               args_info.output_fs_accesses_arg);
   }
 
+  // The trace is only needed after the end of execution if
+  // it is either analyzed or dumped to the standard output. During
+  // online analysis, all analyzers consume the trace as it is generated.
+  bool online = args_info.online_given && args_info.fault_detector_given;
+  keep_trace = !online && (args.dump_trace || !args.analyzers.empty());
+
   trace_gen = init_trace_generator(args_info);
   trace_proc = new processor::Processor(args);
+  if (args_info.symbol_cache_given) {
+    symbol_cache = new trace_generator::SymbolCache(
+        args_info.symbol_cache_arg);
+    symbol_cache->Load();
+    trace_gen->SetSymbolCache(symbol_cache);
+  }
+  if (string(args_info.capture_arg) == "syscall") {
+    capture_syscalls = true;
+    trace_gen->SetCaptureSyscalls(true);
+  }
+  if (args_info.symbol_module_given) {
+    vector<string> modules;
+    for (unsigned i = 0; i < args_info.symbol_module_given; i++) {
+      modules.push_back(args_info.symbol_module_arg[i]);
+    }
+    trace_gen->SetSymbolModules(modules);
+  }
+  for (unsigned i = 0; i < args_info.trace_include_given; i++) {
+    trace_filter.AddInclude(args_info.trace_include_arg[i]);
+  }
+  for (unsigned i = 0; i < args_info.trace_exclude_given; i++) {
+    trace_filter.AddExclude(args_info.trace_exclude_arg[i]);
+  }
+  trace_gen->SetPathFilter(&trace_filter);
+  if (args_info.no_coalesce_given) {
+    trace_gen->SetCoalesce(false);
+  }
 }
 
 
@@ -252,6 +518,20 @@ dr_client_main(client_id_t client_id, int argc, const char **argv)
   drmgr_init();
   drwrap_init();
   drsym_init(0);
+  if (!trace_generator::DynamoTraceGenerator::InitThreadStates()) {
+    debug::err(CMDLINE_PARSER_PACKAGE)
+      << "Unable to allocate thread-local storage";
+    dr_exit_process(1);
+  }
+  // The creation of processes is always captured at system calls.
+  if (!trace_generator::SyscallCapture::Init(trace_gen, capture_syscalls)) {
+    debug::err(CMDLINE_PARSER_PACKAGE)
+      << "Unable to register system call events";
+    dr_exit_process(1);
+  }
+  proc_lock = dr_mutex_create();
   dr_register_exit_event(event_exit);
+  dr_register_fork_init_event(event_fork_init);
+  dr_register_nudge_event(event_nudge, client_id);
   drmgr_register_module_load_event(module_load_event);
 }
@@ -1,5 +1,8 @@
+#include <algorithm>
+#include <cctype>
 #include <cstring>
 #include <fstream>
+#include <set>
 #include <sstream>
 
 #include "TraceGeneratorDriver.hpp"
@@ -25,9 +28,17 @@ void AddOperationDebugInfo(operation::Operation *op,
 
 
 TraceGeneratorDriver::TraceGeneratorDriver(std::string file_):
-  file(file_),
+  TraceGeneratorDriver(std::vector<std::string>{ file_ }) {  }
+
+
+TraceGeneratorDriver::TraceGeneratorDriver(std::vector<std::string> files_):
+  files(files_),
   lexer(nullptr),
-  parser(nullptr) {
+  parser(nullptr),
+  current_offsets({ 0, 0 }),
+  max_event_id(0),
+  max_sync_op(0),
+  skip_prologue(false) {
     trace_f = new trace::Trace();
   }
 
@@ -48,22 +59,287 @@ TraceGeneratorDriver::~TraceGeneratorDriver() {
 
 
 void TraceGeneratorDriver::Start() {
+  if (files.size() > 1 && !OrderFiles()) {
+    return;
+  }
+  for (auto const &file : files) {
+    std::ifstream in_file (file);
+    if (!in_file.good()) {
+      std::stringstream ss;
+      ss << strerror(errno);
+      AddError(utils::err::TRACE_ERROR, "Error while opening file "
+          + file + ": " + ss.str(), "");
+      return;
+    }
+    Parse(in_file);
+    if (HasFailed()) {
+      return;
+    }
+  }
+  LinkProcesses();
+}
+
+
+std::optional<TraceGeneratorDriver::TraceFileInfo>
+TraceGeneratorDriver::ScanFile(const std::string &file) {
   std::ifstream in_file (file);
   if (!in_file.good()) {
     std::stringstream ss;
     ss << strerror(errno);
     AddError(utils::err::TRACE_ERROR, "Error while opening file "
         + file + ": " + ss.str(), "");
-    return;
+    return std::nullopt;
+  }
+  TraceFileInfo info = { file, 0, 0, {} };
+  bool has_header = false;
+  std::string line;
+  while (std::getline(in_file, line)) {
+    std::istringstream tokens (line);
+    std::string token;
+    tokens >> token;
+    if (token == "!PID:" && !has_header) {
+      has_header = static_cast<bool>(tokens >> info.pid);
+    } else if (token == "!Segment:") {
+      tokens >> info.segment;
+    } else if (token == "newProc") {
+      if (line.find("!failed") != std::string::npos) {
+        // The process was not created.
+        continue;
+      }
+      tokens >> token;
+      if (token == "FS" || token == "FD" || token == "FS|FD") {
+        tokens >> token;
+      }
+      if (!token.empty() &&
+          std::all_of(token.begin(), token.end(), ::isdigit)) {
+        info.children.push_back(std::stoul(token));
+      }
+    }
+  }
+  if (!has_header) {
+    AddError(utils::err::TRACE_ERROR, "The trace file " + file
+        + " has no header", "");
+    return std::nullopt;
+  }
+  return info;
+}
+
+
+bool TraceGeneratorDriver::OrderFiles() {
+  // The files of every process, in the order they were given.
+  std::vector<size_t> pids;
+  std::map<size_t, std::vector<TraceFileInfo>> proc_files;
+  // The process that creates every process.
+  std::map<size_t, size_t> parents;
+  for (auto const &file : files) {
+    std::optional<TraceFileInfo> info = ScanFile(file);
+    if (!info.has_value()) {
+      return false;
+    }
+    if (proc_files.find(info->pid) == proc_files.end()) {
+      pids.push_back(info->pid);
+    }
+    for (auto const &child : info->children) {
+      auto it = parents.find(child);
+      if (it != parents.end() && it->second != info->pid) {
+        AddError(utils::err::TRACE_ERROR, "The process "
+            + std::to_string(child) + " is created by both "
+            + std::to_string(it->second) + " and "
+            + std::to_string(info->pid), "");
+        return false;
+      }
+      parents[child] = info->pid;
+    }
+    proc_files[info->pid].push_back(info.value());
+  }
+  for (auto &entry : proc_files) {
+    std::stable_sort(entry.second.begin(), entry.second.end(),
+                     [](const TraceFileInfo &a, const TraceFileInfo &b) {
+                       return a.segment < b.segment;
+                     });
+  }
+  std::vector<size_t> roots;
+  for (auto const &pid : pids) {
+    if (parents.find(pid) == parents.end()) {
+      roots.push_back(pid);
+    }
+  }
+  if (roots.size() != 1) {
+    AddError(utils::err::TRACE_ERROR, "The traces do not form a process"
+        " tree: " + std::to_string(roots.size())
+        + " of the processes are not created by any other", "");
+    return false;
+  }
+  // Visit the process tree in breadth-first order, so that every
+  // process comes after the process that creates it.
+  std::vector<std::string> ordered;
+  std::vector<size_t> queue = { roots[0] };
+  std::set<size_t> visited = { roots[0] };
+  for (size_t i = 0; i < queue.size(); i++) {
+    for (auto const &info : proc_files[queue[i]]) {
+      ordered.push_back(info.file);
+      for (auto const &child : info.children) {
+        if (proc_files.find(child) != proc_files.end() &&
+            visited.insert(child).second) {
+          queue.push_back(child);
+        }
+      }
+    }
   }
-  lexer = new TraceLexer(&in_file);
+  if (queue.size() != pids.size()) {
+    AddError(utils::err::TRACE_ERROR, "The traces do not form a process"
+        " tree: some processes are created by each other", "");
+    return false;
+  }
+  files = ordered;
+  return true;
+}
+
+
+void TraceGeneratorDriver::Parse(std::istream &in) {
+  if (lexer) {
+    delete lexer;
+  }
+  if (parser) {
+    delete parser;
+  }
+  lexer = new TraceLexer(&in);
   parser = new TraceParser(*lexer, *this);
   parser->parse();
-  return;
 }
 
 
 void TraceGeneratorDriver::Stop() {  }
 
 
+void TraceGeneratorDriver::SetHeader(size_t pid, const std::string &cwd,
+                                     size_t segment) {
+  auto last = last_segments.find(pid);
+  skip_prologue = segment > 0 && last != last_segments.end() &&
+    last->second + 1 == segment;
+  last_segments[pid] = segment;
+  if (!main_pid.has_value()) {
+    main_pid = pid;
+    trace_f->SetThreadId(pid);
+    trace_f->SetCwd(cwd);
+    offsets[pid] = current_offsets;
+  }
+  if (pid == main_pid.value()) {
+    process = std::nullopt;
+    current_offsets = offsets[pid];
+    return;
+  }
+  process = pid;
+  auto it = offsets.find(pid);
+  if (it != offsets.end()) {
+    // This is another segment of a trace that we have already seen.
+    current_offsets = it->second;
+    return;
+  }
+  current_offsets = { max_event_id, max_sync_op };
+  offsets[pid] = current_offsets;
+  processes.push_back({ pid, cwd, std::nullopt, std::nullopt });
+}
+
+
+size_t TraceGeneratorDriver::ToEventId(const std::string &id) {
+  size_t event_id = std::stoul(id) + current_offsets.event;
+  max_event_id = std::max(max_event_id, event_id);
+  return event_id;
+}
+
+
+std::string TraceGeneratorDriver::ToOpId(const std::string &id) {
+  // Operation ids have the form `sync_<number>` or `async_<event id>`.
+  size_t pos = id.find('_');
+  std::string prefix = id.substr(0, pos + 1);
+  size_t number = std::stoul(id.substr(pos + 1));
+  if (utils::StartsWith(prefix, "async_")) {
+    number += current_offsets.event;
+    max_event_id = std::max(max_event_id, number);
+  } else {
+    number += current_offsets.sync_op;
+    max_sync_op = std::max(max_sync_op, number);
+  }
+  return prefix + std::to_string(number);
+}
+
+
+void TraceGeneratorDriver::AddBlock(trace::Block *block) {
+  if (skip_prologue) {
+    // The blocks before this segment already define everything
+    // in the prologue.
+    skip_prologue = false;
+    delete block;
+    return;
+  }
+  if (process.has_value()) {
+    block->SetProcess(process.value());
+  }
+  trace_f->AddBlock(block);
+}
+
+
+void TraceGeneratorDriver::LinkProcesses() {
+  if (processes.empty()) {
+    return;
+  }
+  // A process is created by the operation that includes the
+  // corresponding `newProc`, and it is joined by the operation that
+  // includes the corresponding `waitProc`.
+  std::map<size_t, std::string> creating_ops;
+  std::map<size_t, std::string> joining_ops;
+  for (auto const &exec_op : trace_f->GetExecOps()) {
+    for (auto const &op : exec_op->GetOperations()) {
+      if (op->isFailed()) {
+        continue;
+      }
+      const operation::NewProc *new_proc =
+        dynamic_cast<const operation::NewProc*>(op);
+      if (new_proc) {
+        creating_ops[new_proc->GetPID()] = exec_op->GetId();
+      }
+      const operation::WaitProc *wait_proc =
+        dynamic_cast<const operation::WaitProc*>(op);
+      if (wait_proc) {
+        joining_ops.emplace(wait_proc->GetPID(), exec_op->GetId());
+      }
+    }
+  }
+  std::map<std::string, std::string> submitters;
+  for (auto const &block : trace_f->GetBlocks()) {
+    for (auto const &expr : block->GetExprs()) {
+      const trace::SubmitOp *submit_op =
+        dynamic_cast<const trace::SubmitOp*>(expr);
+      if (submit_op) {
+        submitters[submit_op->GetOpId()] = block->GetPrettyBlockId();
+      }
+    }
+  }
+  auto block_of = [&submitters](
+      const std::map<size_t, std::string> &ops,
+      size_t pid) -> std::optional<std::string> {
+    auto op = ops.find(pid);
+    if (op == ops.end()) {
+      return std::nullopt;
+    }
+    std::string op_id = op->second;
+    if (utils::StartsWith(op_id, "async_")) {
+      // Asynchronous operations are executed by their own event.
+      return utils::GetRightSubstr(op_id, "_");
+    }
+    auto submitter = submitters.find(op_id);
+    if (submitter != submitters.end()) {
+      return submitter->second;
+    }
+    return std::nullopt;
+  };
+  for (auto &proc : processes) {
+    proc.creator = block_of(creating_ops, proc.pid);
+    proc.joiner = block_of(joining_ops, proc.pid);
+    trace_f->AddProcess(proc);
+  }
+}
+
+
 } // namespace fstrace
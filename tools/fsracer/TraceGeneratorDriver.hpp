@@ -1,6 +1,9 @@
 #ifndef DRIVER_H
 #define DRIVER_H
 
+#include <istream>
+#include <map>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -24,12 +27,27 @@ class TraceGeneratorDriver : public trace_generator::TraceGenerator {
 
 public:
   TraceGeneratorDriver(std::string file_);
+  /**
+   * Constructs a driver that merges the traces of the given files.
+   *
+   * The files are the traces of a process tree, and they can be given
+   * in any order: the main process is the one that no other process
+   * creates. A trace that is split into segments is given as multiple
+   * files, which are parsed in the order of the segments.
+   */
+  TraceGeneratorDriver(std::vector<std::string> files_);
   ~TraceGeneratorDriver();
 
   void Start();
 
   void Stop();
 
+  /**
+   * Parses the trace definitions read from the given stream, and
+   * appends them to the trace.
+   */
+  void Parse(std::istream &in);
+
   std::string GetName() const {
     return "TraceParser";
   }
@@ -41,12 +59,98 @@ public:
   friend class TraceParser;
 
 private:
-  std::string file;
+  /** The offsets added to the ids found in the trace of a process. */
+  struct IdOffsets {
+    /// The offset of event and block ids.
+    size_t event;
+    /// The offset of the numbers of synchronous operations.
+    size_t sync_op;
+  };
+
+  /** The process and the created processes found in a trace file. */
+  struct TraceFileInfo {
+    /// The name of the file.
+    std::string file;
+    /// The process whose trace is in the file.
+    size_t pid;
+    /// The number of the segment of the trace in the file.
+    size_t segment;
+    /// The processes that are created in the file, in order.
+    std::vector<size_t> children;
+  };
+
+  std::vector<std::string> files;
   TraceLexer *lexer;
   TraceParser *parser;
 
   std::vector<trace::Expr*> exprs;
   std::vector<operation::Operation*> opers;
+
+  /// The id of the main process, i.e., the process of the first trace.
+  std::optional<size_t> main_pid;
+  /// The process whose trace is parsed (absent for the main process).
+  std::optional<size_t> process;
+  /// The offsets of the ids of the process whose trace is parsed.
+  IdOffsets current_offsets;
+  /// The offsets of the ids of every process.
+  std::map<size_t, IdOffsets> offsets;
+  /// The last segment parsed for every process.
+  std::map<size_t, size_t> last_segments;
+  /// Whether the next block is the prologue of a segment that follows
+  /// the last parsed segment of its process, so it is dropped.
+  bool skip_prologue;
+  /// The greatest event (or block) id found so far.
+  size_t max_event_id;
+  /// The greatest number of synchronous operation found so far.
+  size_t max_sync_op;
+  /// The processes other than the main one.
+  std::vector<trace::Trace::Process> processes;
+
+  /**
+   * Reads the header and the `newProc` operations of the given file,
+   * without parsing the whole trace.
+   */
+  std::optional<TraceFileInfo> ScanFile(const std::string &file);
+
+  /**
+   * Orders the files so that the trace of every process is parsed
+   * after the trace of the process that creates it. The files of each
+   * process are kept together, in the order of their segments.
+   *
+   * It fails if the traces do not form a single process tree.
+   */
+  bool OrderFiles();
+
+  /**
+   * Sets the process whose trace is parsed, based on the header
+   * of a trace.
+   *
+   * Processes other than the main one get offsets that are greater
+   * than all the ids found so far, so that their events and operations
+   * never clash with those of other processes.
+   *
+   * A segment other than the first one starts with a prologue that
+   * declares what it refers to from the segments before it. The
+   * prologue is dropped if the previous segment of the process has
+   * just been parsed; otherwise, the segment is analyzed as if it
+   * were the start of the trace.
+   */
+  void SetHeader(size_t pid, const std::string &cwd, size_t segment);
+
+  /** Converts the given event (or block) id of the parsed trace. */
+  size_t ToEventId(const std::string &id);
+
+  /** Converts the given operation id of the parsed trace. */
+  std::string ToOpId(const std::string &id);
+
+  /** Adds the given block of the parsed trace. */
+  void AddBlock(trace::Block *block);
+
+  /**
+   * Adds the processes other than the main one to the trace, along
+   * with the blocks that create them and the blocks that wait for them.
+   */
+  void LinkProcesses();
 };
 
 
@@ -50,6 +50,7 @@
 %token <std::string>
   PID           "!PID"
   CWD           "!Working Directory"
+  SEGMENT       "!Segment"
   OP            "Operation"
   DO            "Do"
   DONE          "Done"
@@ -59,6 +60,11 @@
   DELFD         "delFd"
   RENAME        "rename"
   SYMLINK       "symlink"
+  NEWPROC       "newProc"
+  WAITPROC      "waitProc"
+  SHARE_FS      "FS"
+  SHARE_FD      "FD"
+  SHARE_BOTH    "FS|FD"
   ATFDCWD       "AT_FDCWD"
   BEGIN_BLOCK   "Begin"
   MAIN          "Main"
@@ -82,6 +88,7 @@
 
 %type <int> dirfd
 %type <operation::Hpath::EffectType> effect_type
+%type <operation::NewProc::CloneMode> clone_mode
 %type <trace::Event> event_type
 %type <std::vector<std::string>> meta_vars
 
@@ -89,24 +96,37 @@
 
 %%
 
-program : stats PID COLON NUMBER CWD COLON IDENTIFIER op_defs block_defs {
-          driver.trace_f->SetThreadId(std::stoi($4));
-          driver.trace_f->SetCwd($7);
-        }
-        | stats PID COLON NUMBER CWD COLON IDENTIFIER {
-          driver.trace_f->SetThreadId(std::stoi($4));
-          driver.trace_f->SetCwd($7);
-        }
+program : stats header defs {  }
+        | stats header {  }
+        | header defs {  }
+        | header {  }
         ;
 
 
-op_defs : op_def {  }
-        | op_defs op_def {  }
-        ;
+/* Every segment of a trace but the first one is numbered. */
+header : PID COLON NUMBER CWD COLON IDENTIFIER {
+         driver.SetHeader(std::stoi($3), $6, 0);
+       }
+       | PID COLON NUMBER CWD COLON IDENTIFIER SEGMENT COLON NUMBER {
+         driver.SetHeader(std::stoi($3), $6, std::stoul($9));
+       }
+       ;
+
+
+/* Traces that are streamed while the program is running do not
+   include statistics, and interleave operations with blocks. */
+defs : def {  }
+     | defs def {  }
+     ;
+
+
+def : op_def {  }
+    | block_def {  }
+    ;
 
 
 op_def : OP OPID DO operations DONE {
-         trace::ExecOp *exec_op = new trace::ExecOp($2);
+         trace::ExecOp *exec_op = new trace::ExecOp(driver.ToOpId($2));
          for (auto const &op_entry : driver.opers) {
            exec_op->AddOperation(op_entry);
          }
@@ -114,7 +134,7 @@ op_def : OP OPID DO operations DONE {
          driver.opers.clear();
        }
        | OP OPID DO DONE {
-         driver.trace_f->AddExecOp(new trace::ExecOp($2));
+         driver.trace_f->AddExecOp(new trace::ExecOp(driver.ToOpId($2)));
          driver.opers.clear();
        }
        ;
@@ -167,6 +187,25 @@ oper : HPATH dirfd IDENTIFIER effect_type meta_vars {
        AddOperationDebugInfo(symlink, $5);
        driver.opers.push_back(symlink);
      }
+     | NEWPROC clone_mode NUMBER meta_vars {
+       operation::NewProc *new_proc = new operation::NewProc($2);
+       new_proc->SetPID(std::stoi($3));
+       AddOperationDebugInfo(new_proc, $4);
+       driver.opers.push_back(new_proc);
+     }
+     | NEWPROC NUMBER meta_vars {
+       operation::NewProc *new_proc = new operation::NewProc(
+           operation::NewProc::SHARE_NONE);
+       new_proc->SetPID(std::stoi($2));
+       AddOperationDebugInfo(new_proc, $3);
+       driver.opers.push_back(new_proc);
+     }
+     | WAITPROC NUMBER meta_vars {
+       operation::WaitProc *wait_proc = new operation::WaitProc(
+           std::stoi($2));
+       AddOperationDebugInfo(wait_proc, $3);
+       driver.opers.push_back(wait_proc);
+     }
      ;
 
 
@@ -175,36 +214,43 @@ dirfd : ATFDCWD { $$ = AT_FDCWD; }
       ;
 
 
+clone_mode : SHARE_FS { $$ = operation::NewProc::SHARE_FS; }
+           | SHARE_FD { $$ = operation::NewProc::SHARE_FD; }
+           | SHARE_BOTH { $$ = operation::NewProc::SHARE_BOTH; }
+           ;
+
+
 effect_type : CONSUMED { $$ = operation::Hpath::CONSUMED; }
             | PRODUCED { $$ = operation::Hpath::PRODUCED; }
             | EXPUNGED { $$ = operation::Hpath::EXPUNGED; }
             ;
 
 
-block_defs : block_def { }
-           | block_defs block_def { }
-           ;
-
-
 block_def : BEGIN_BLOCK MAIN NUMBER exprs END_BLOCK {
             trace::Block *block = new trace::Block(
-              std::stoi($3), trace::Block::MAIN);
+              driver.ToEventId($3), trace::Block::MAIN);
             for (auto const &expr_entry : driver.exprs) {
               block->AddExpr(expr_entry);
             }
-            driver.trace_f->AddBlock(block);
+            driver.AddBlock(block);
+            driver.exprs.clear();
+          }
+          | BEGIN_BLOCK MAIN NUMBER END_BLOCK {
+            /* The prologue of a segment may be empty. */
+            driver.AddBlock(new trace::Block(
+              driver.ToEventId($3), trace::Block::MAIN));
             driver.exprs.clear();
           }
           | BEGIN_BLOCK NUMBER exprs END_BLOCK {
-            trace::Block *block = new trace::Block(std::stoi($2));
+            trace::Block *block = new trace::Block(driver.ToEventId($2));
             for (auto const &expr_entry : driver.exprs) {
               block->AddExpr(expr_entry);
             }
-            driver.trace_f->AddBlock(block);
+            driver.AddBlock(block);
             driver.exprs.clear();
           }
           | BEGIN_BLOCK NUMBER END_BLOCK {
-            driver.trace_f->AddBlock(new trace::Block(std::stoi($2)));
+            driver.AddBlock(new trace::Block(driver.ToEventId($2)));
             driver.exprs.clear();
           }
           ;
@@ -217,31 +263,33 @@ exprs : expr {  }
 
 expr : NEW_EVENT NUMBER event_type meta_vars {
        trace::NewEventExpr *new_event = new trace::NewEventExpr(
-           std::stoi($2), $3);
+           driver.ToEventId($2), $3);
        for (auto const &debug_info : $4) {
          new_event->AddDebugInfo(debug_info);
        }
        driver.exprs.push_back(new_event);
      }
      | NEW_EVENT NUMBER event_type {
-       driver.exprs.push_back(new trace::NewEventExpr(std::stoi($2), $3));
+       driver.exprs.push_back(new trace::NewEventExpr(
+           driver.ToEventId($2), $3));
      }
      | LINK NUMBER NUMBER {
        driver.exprs.push_back(new trace::LinkExpr(
-           std::stoi($2), std::stoi($3)));
+           driver.ToEventId($2), driver.ToEventId($3)));
      }
      | TRIGGER NUMBER {
-       driver.exprs.push_back(new trace::Trigger(std::stoi($2)));
+       driver.exprs.push_back(new trace::Trigger(driver.ToEventId($2)));
      }
      | SUBMIT_OP OPID SYNC meta_vars {
-       trace::SubmitOp *submit_op = new trace::SubmitOp($2);
+       trace::SubmitOp *submit_op = new trace::SubmitOp(driver.ToOpId($2));
        for (auto const &debug_info : $4) {
          submit_op->AddDebugInfo(debug_info);
        }
        driver.exprs.push_back(submit_op);
      }
      | SUBMIT_OP OPID NUMBER ASYNC meta_vars {
-       trace::SubmitOp *submit_op = new trace::SubmitOp($2, std::stoi($3));
+       trace::SubmitOp *submit_op = new trace::SubmitOp(
+           driver.ToOpId($2), driver.ToEventId($3));
        for (auto const &debug_info : $5) {
          submit_op->AddDebugInfo(debug_info);
        }
@@ -0,0 +1,80 @@
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sstream>
+
+#include "Debug.h"
+#include "TraceRingReader.hpp"
+
+
+namespace fstrace {
+
+
+TraceRingReader::TraceRingReader(TraceGeneratorDriver &driver_,
+                                 trace_ring::TraceRing *ring_):
+  driver(driver_),
+  ring(ring_) {
+  header = "!PID: " + std::to_string(ring->GetPid()) + "\n" +
+    "!Working Directory: " + ring->GetCwd() + "\n";
+  driver.GetTrace()->SetThreadId(ring->GetPid());
+  driver.GetTrace()->SetCwd(ring->GetCwd());
+  ring->SetConsumer(getpid());
+}
+
+
+void TraceRingReader::Read(exec_op_clb_t exec_op_clb,
+                           block_clb_t block_clb) {
+  // The loop ends either when the producer is done or when a record
+  // cannot be parsed. In both cases, we detach from the rings.
+  while (!driver.HasFailed()) {
+    // We check whether the producer has finished before reading,
+    // so that no record published before closing the rings is missed.
+    bool closed = ring->IsClosed() || !IsProducerAlive();
+    if (ReadAvailable(exec_op_clb, block_clb) == 0) {
+      if (closed) {
+        break;
+      }
+      usleep(POLL_INTERVAL_US);
+    }
+  }
+  ring->Detach();
+  size_t dropped = ring->GetDropped();
+  if (dropped > 0) {
+    debug::warn("TraceRingReader")
+      << "The producer dropped " << dropped << " records";
+  }
+}
+
+
+size_t TraceRingReader::ReadAvailable(exec_op_clb_t &exec_op_clb,
+                                      block_clb_t &block_clb) {
+  size_t count = 0;
+  enum trace_ring::TraceRing::RecordType type;
+  std::string payload;
+  for (size_t i = 0; i < ring->GetRingCount(); i++) {
+    while (ring->Pop(i, type, payload)) {
+      std::istringstream in(header + payload);
+      driver.Parse(in);
+      if (driver.HasFailed()) {
+        return count;
+      }
+      trace::Trace *trace = driver.GetTrace();
+      if (type == trace_ring::TraceRing::EXEC_OP) {
+        exec_op_clb(trace->GetLastExecOp());
+      } else {
+        block_clb(trace->GetLastBlock());
+      }
+      count++;
+    }
+  }
+  return count;
+}
+
+
+bool TraceRingReader::IsProducerAlive() const {
+  // The producer may be killed before closing the rings.
+  return kill(ring->GetPid(), 0) == 0 || errno == EPERM;
+}
+
+
+} // namespace fstrace
@@ -0,0 +1,69 @@
+#ifndef TRACE_RING_READER_H
+#define TRACE_RING_READER_H
+
+#include <functional>
+#include <string>
+
+#include "Trace.h"
+#include "TraceGeneratorDriver.hpp"
+#include "TraceRing.h"
+
+
+namespace fstrace {
+
+
+/**
+ * Consumes the trace that a running program publishes to
+ * shared-memory rings (see `drfsracer --publish`).
+ *
+ * Every record is parsed into the trace of the given driver, and
+ * is then passed to the corresponding callback.
+ */
+class TraceRingReader {
+public:
+  using exec_op_clb_t = std::function<void(const trace::ExecOp*)>;
+  using block_clb_t = std::function<void(const trace::Block*)>;
+
+  /// Time to wait when all rings are empty.
+  static const unsigned POLL_INTERVAL_US = 1000;
+
+  /**
+   * Constructs a reader of the given rings, and publishes the id of
+   * the current process as their consumer. The header of the trace
+   * of the driver is set, so that the trace can be analyzed before
+   * any record is read.
+   */
+  TraceRingReader(TraceGeneratorDriver &driver_,
+                  trace_ring::TraceRing *ring_);
+
+  /**
+   * Reads records until the producer closes the rings (or dies),
+   * and all rings are empty, or until a record cannot be parsed.
+   * In any case, the reader detaches from the rings once it returns,
+   * so that the producer does not wait for it.
+   */
+  void Read(exec_op_clb_t exec_op_clb, block_clb_t block_clb);
+
+private:
+  /// The driver that parses the records.
+  TraceGeneratorDriver &driver;
+  /// The rings of the producer.
+  trace_ring::TraceRing *ring;
+  /// The header prepended to every record, so that it forms a trace.
+  std::string header;
+
+  /**
+   * Reads all the available records of every ring, and returns
+   * the number of records read.
+   */
+  size_t ReadAvailable(exec_op_clb_t &exec_op_clb, block_clb_t &block_clb);
+
+  /** Checks whether the producer is still running. */
+  bool IsProducerAlive() const;
+};
+
+
+} // namespace fstrace
+
+
+#endif
@@ -6,14 +6,27 @@
 #include "fsracer_cli.h"
 
 #include "Debug.h"
+#include "PathFilter.h"
 #include "Processor.h"
 #include "TraceGeneratorDriver.hpp"
+#include "TraceRing.h"
+#include "TraceRingReader.hpp"
 
 
+/// The filter that decides which paths of the trace are analyzed.
+static path_filter::PathFilter trace_filter;
+
 
 static void
 process_args(gengetopt_args_info &args_info, processor::Processor &trace_proc)
 {
+  if ((args_info.trace_file_given > 0) == (args_info.attach_given > 0)) {
+    debug::err(CMDLINE_PARSER_PACKAGE)
+      << "exactly one of the options '--trace-file' and '--attach'"
+      << " is required";
+    exit(EXIT_FAILURE);
+  }
+
   if (args_info.dump_trace_given && args_info.output_trace_given) {
     debug::err(CMDLINE_PARSER_PACKAGE)
       << "options '--dump-trace' and '--output-trace' are mutually exclusive";
@@ -33,6 +46,18 @@ process_args(gengetopt_args_info &args_info, processor::Processor &trace_proc)
       << "are mutually exclusive";
   }
 
+  if (args_info.detector_threads_given && args_info.detector_threads_arg < 1) {
+    debug::err(CMDLINE_PARSER_PACKAGE)
+      << "option '--detector-threads' expects a positive number";
+    exit(EXIT_FAILURE);
+  }
+
+  if (args_info.gc_threshold_given && args_info.gc_threshold_arg < 0) {
+    debug::err(CMDLINE_PARSER_PACKAGE)
+      << "option '--gc-threshold' expects a non-negative number";
+    exit(EXIT_FAILURE);
+  }
+
   processor::CLIArgs args;
   if (args_info.dump_trace_given) {
     args.dump_trace = true;
@@ -60,6 +85,32 @@ process_args(gengetopt_args_info &args_info, processor::Processor &trace_proc)
     }
   }
 
+  if (args_info.detector_threads_given) {
+    args.cli_options.AddEntry("detector_threads",
+                              to_string(args_info.detector_threads_arg));
+  }
+
+  if (args_info.race_strategy_given) {
+    args.cli_options.AddEntry("race_strategy", args_info.race_strategy_arg);
+  }
+
+  if (args_info.gc_threshold_given) {
+    args.cli_options.AddEntry("gc_threshold",
+                              to_string(args_info.gc_threshold_arg));
+  }
+
+  if (args_info.attach_given && args_info.fault_detector_given) {
+    // The trace is analyzed while the program is running.
+    args.cli_options.AddEntry("online", "true");
+  }
+
+  for (unsigned i = 0; i < args_info.trace_include_given; i++) {
+    trace_filter.AddInclude(args_info.trace_include_arg[i]);
+  }
+  for (unsigned i = 0; i < args_info.trace_exclude_given; i++) {
+    trace_filter.AddExclude(args_info.trace_exclude_arg[i]);
+  }
+
   if (args_info.dep_graph_format_given) {
     args.cli_options.AddEntry("dep_graph_format",
                               args_info.dep_graph_format_arg);
@@ -101,6 +152,87 @@ sig_handler(int signo)
 }
 
 
+/**
+ * Removes the operations on paths that are not traced, before
+ * the trace is analyzed.
+ */
+static void
+filter_trace(trace::Trace *trace)
+{
+  if (trace_filter.IsEmpty()) {
+    return;
+  }
+  string cwd = trace->GetCwd();
+  size_t removed = trace->RemoveOperations(
+      [&cwd](const operation::Operation *op) {
+        return !trace_filter.IsTraced(op, cwd);
+      });
+  debug::info("PathFilter") << "Removed " << removed << " operations";
+}
+
+
+static int
+attach(const string &name, processor::Processor &trace_proc)
+{
+  // The traced program may not have started yet, so we wait until
+  // it creates the shared memory and publishes its header.
+  trace_ring::TraceRing *ring = nullptr;
+  while (!(ring = trace_ring::TraceRing::Attach(name)) || !ring->IsReady()) {
+    if (ring) {
+      delete ring;
+      ring = nullptr;
+    }
+    usleep(fstrace::TraceRingReader::POLL_INTERVAL_US);
+  }
+  debug::info("TraceRingReader")
+    << "Attached to PID " << ring->GetPid() << " through " << name;
+  fstrace::TraceGeneratorDriver trace_gen (name);
+  fstrace::TraceRingReader reader(trace_gen, ring);
+  optional<size_t> pid;
+  trace_proc.Setup(pid);
+  bool online = trace_proc.IsOnline();
+  if (online && !trace_filter.IsEmpty()) {
+    // Operations are analyzed as soon as they are read, so paths
+    // can only be filtered by the producer.
+    debug::warn(CMDLINE_PARSER_PACKAGE)
+      << "'--trace-include' and '--trace-exclude' are ignored in online "
+      << "analysis; pass them to 'drfsracer' instead";
+  }
+  if (online) {
+    // Every record is moved out of the trace once it is read, and
+    // the processor frees it once it analyzes it.
+    trace_proc.StartOnlineAnalysis(trace_gen.GetTrace(), true);
+  }
+  reader.Read(
+      [&](const trace::ExecOp *exec_op) {
+        if (online) {
+          trace_gen.GetTrace()->ReleaseLastExecOp();
+          trace_proc.AnalyzeExecOp(exec_op);
+        }
+      },
+      [&](const trace::Block *block) {
+        if (online) {
+          trace_gen.GetTrace()->ReleaseLastBlock();
+          trace_proc.AnalyzeBlock(block);
+        }
+      });
+  ring->Unlink();
+  delete ring;
+  if (trace_gen.HasFailed()) {
+    debug::err(trace_gen.GetName()) << trace_gen.GetErr();
+    exit(EXIT_FAILURE);
+  }
+  if (online) {
+    trace_proc.StopOnlineAnalysis();
+  } else {
+    filter_trace(trace_gen.GetTrace());
+    trace_proc.AnalyzeTraces(trace_gen.GetTrace());
+  }
+  trace_proc.DetectFaults();
+  return 0;
+}
+
+
 int
 main(int argc, char **argv)
 {
@@ -116,7 +248,18 @@ main(int argc, char **argv)
     exit(EXIT_FAILURE);
   }
   process_args(args_info, trace_proc);
-  fstrace::TraceGeneratorDriver trace_gen (args_info.trace_file_arg);
+  if (args_info.attach_given) {
+    string name = args_info.attach_arg;
+    cmdline_parser_free(&args_info);
+    return attach(name, trace_proc);
+  }
+  // The files are the traces (or segments of traces) of a process tree,
+  // and the driver parses them starting from the main process.
+  vector<string> trace_files;
+  for (unsigned i = 0; i < args_info.trace_file_given; i++) {
+    trace_files.push_back(args_info.trace_file_arg[i]);
+  }
+  fstrace::TraceGeneratorDriver trace_gen (trace_files);
   cmdline_parser_free(&args_info);
 
   trace_gen.Start();
@@ -127,8 +270,8 @@ main(int argc, char **argv)
 
   optional<size_t> pid;
   trace_proc.Setup(pid);
+  filter_trace(trace_gen.GetTrace());
   trace_proc.AnalyzeTraces(trace_gen.GetTrace());
   trace_proc.DetectFaults();
   return 0;
 }
-
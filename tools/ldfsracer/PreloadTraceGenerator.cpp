@@ -0,0 +1,266 @@
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <new>
+
+#include "PreloadTraceGenerator.h"
+
+
+using namespace trace;
+
+
+namespace trace_generator {
+
+
+/// The buffer of the calling thread (if any).
+static thread_local ThreadBuffer *thread_buf = nullptr;
+
+
+void PreloadTraceGenerator::Start() {
+  char buf[PATH_MAX];
+  if (getcwd(buf, PATH_MAX)) {
+    cwd = buf;
+  }
+  if (!OpenTraceFile()) {
+    return;
+  }
+  stopped = false;
+}
+
+
+void PreloadTraceGenerator::Stop() {
+  if (stopped.exchange(true)) {
+    return;
+  }
+  vector<pair<size_t, const char*>> submits;
+  vector<size_t> starts;
+  {
+    lock_guard<mutex> threads_guard(threads_lock);
+    submits.swap(released_submits);
+    starts.swap(block_starts);
+    for (ThreadBuffer *buf : thread_buffers) {
+      lock_guard<mutex> buf_guard(buf->lock);
+      Flush(buf->trace_buf);
+      submits.insert(submits.end(), buf->submits.begin(), buf->submits.end());
+      buf->submits.clear();
+    }
+  }
+  WriteMainBlocks(submits, starts);
+  lock_guard<mutex> file_guard(file_lock);
+  if (file) {
+    fclose(file);
+    file = nullptr;
+  }
+}
+
+
+string PreloadTraceGenerator::GetSegmentState() const {
+  return to_string(pid) + ":" + to_string(segment + 1) + ":" +
+    to_string(op_count) + ":" + to_string(main_blocks);
+}
+
+
+bool PreloadTraceGenerator::ContinueTrace(const string &segment_state) {
+  size_t state_pid, next_segment, ops, blocks;
+  if (sscanf(segment_state.c_str(), "%zu:%zu:%zu:%zu", &state_pid,
+             &next_segment, &ops, &blocks) != 4 ||
+      state_pid != (size_t) getpid()) {
+    return false;
+  }
+  segment = next_segment;
+  op_count = ops;
+  main_blocks = blocks;
+  Start();
+  return true;
+}
+
+
+bool PreloadTraceGenerator::IsTracedProcess() const {
+  return (size_t) getpid() == pid;
+}
+
+
+bool PreloadTraceGenerator::IsTraceFd(int fd) const {
+  return file && fileno(file) == fd;
+}
+
+
+size_t PreloadTraceGenerator::AddExecOp(const char *op_name,
+                                        const vector<Operation*> &operations) {
+  size_t op_number = ++op_count;
+  ExecOp exec_op("sync_" + to_string(op_number));
+  for (Operation *operation : operations) {
+    exec_op.AddOperation(operation);
+  }
+  ThreadBuffer *buf = GetThreadBuffer();
+  lock_guard<mutex> buf_guard(buf->lock);
+  buf->trace_buf += exec_op.ToString() + "\n";
+  buf->submits.push_back({ op_number, op_name });
+  if (buf->trace_buf.size() >= FLUSH_THRESHOLD) {
+    Flush(buf->trace_buf);
+  }
+  return op_number;
+}
+
+
+void PreloadTraceGenerator::StartMainBlock(size_t op_number) {
+  lock_guard<mutex> threads_guard(threads_lock);
+  block_starts.push_back(op_number);
+}
+
+
+void PreloadTraceGenerator::ReleaseThreadBuffer() {
+  ThreadBuffer *buf = thread_buf;
+  if (!buf) {
+    return;
+  }
+  {
+    lock_guard<mutex> threads_guard(threads_lock);
+    auto it = find(thread_buffers.begin(), thread_buffers.end(), buf);
+    if (it != thread_buffers.end()) {
+      thread_buffers.erase(it);
+      Flush(buf->trace_buf);
+      released_submits.insert(released_submits.end(), buf->submits.begin(),
+                              buf->submits.end());
+    }
+  }
+  thread_buf = nullptr;
+  delete buf;
+}
+
+
+void PreloadTraceGenerator::PrepareFork() {
+  threads_lock.lock();
+  file_lock.lock();
+}
+
+
+void PreloadTraceGenerator::ResumeParent() {
+  file_lock.unlock();
+  threads_lock.unlock();
+}
+
+
+void PreloadTraceGenerator::ResumeChild() {
+  // The other threads of the parent do not exist in the child,
+  // so we drop their buffers.
+  for (ThreadBuffer *buf : thread_buffers) {
+    if (buf != thread_buf) {
+      delete buf;
+    }
+  }
+  thread_buffers.clear();
+  released_submits.clear();
+  block_starts.clear();
+  if (thread_buf) {
+    // The buffer may be locked by the parent at the time of the fork.
+    new (&thread_buf->lock) mutex();
+    thread_buf->trace_buf.clear();
+    thread_buf->submits.clear();
+    thread_buffers.push_back(thread_buf);
+  }
+  if (file) {
+    fclose(file);
+    file = nullptr;
+  }
+  op_count = 0;
+  segment = 0;
+  main_blocks = 0;
+  file_lock.unlock();
+  threads_lock.unlock();
+  if (stopped) {
+    return;
+  }
+  if (!OpenTraceFile()) {
+    stopped = true;
+  }
+}
+
+
+ThreadBuffer *PreloadTraceGenerator::GetThreadBuffer() {
+  if (thread_buf) {
+    return thread_buf;
+  }
+  thread_buf = new ThreadBuffer();
+  lock_guard<mutex> threads_guard(threads_lock);
+  thread_buffers.push_back(thread_buf);
+  return thread_buf;
+}
+
+
+bool PreloadTraceGenerator::OpenTraceFile() {
+  pid = getpid();
+  string filename = trace_file + to_string(pid);
+  if (segment > 0) {
+    filename += "." + to_string(segment);
+  }
+  // We open the file through stdio, whose calls are not interposed.
+  file = fopen(filename.c_str(), "we");
+  if (!file) {
+    AddError(utils::err::RUNTIME, "Cannot open trace file " + filename,
+             GetName());
+    return false;
+  }
+  string header = "!PID: " + to_string(pid) + "\n";
+  header += "!Working Directory: " + cwd + "\n";
+  if (segment > 0) {
+    // Every operation of the previous segments has been completed,
+    // so the prologue is an empty MAIN block, which fsracer drops
+    // when it merges the segments.
+    header += "!Segment: " + to_string(segment) + "\n";
+    header += "Begin MAIN " + to_string(MAIN_BLOCK + main_blocks - 1) +
+      "\nEnd\n";
+  }
+  Flush(header);
+  return true;
+}
+
+
+void PreloadTraceGenerator::Flush(string &buf) {
+  if (buf.empty()) {
+    return;
+  }
+  lock_guard<mutex> file_guard(file_lock);
+  if (file) {
+    // The data is already buffered, so we write it right away.
+    fwrite(buf.data(), 1, buf.size(), file);
+    fflush(file);
+  }
+  buf.clear();
+}
+
+
+void PreloadTraceGenerator::WriteMainBlocks(
+    vector<pair<size_t, const char*>> &submits, vector<size_t> &starts) {
+  if (submits.empty()) {
+    return;
+  }
+  sort(submits.begin(), submits.end());
+  sort(starts.begin(), starts.end());
+  size_t main_block = MAIN_BLOCK + main_blocks;
+  auto start = starts.begin();
+  string buf = "Begin MAIN " + to_string(main_block) + "\n";
+  for (auto const &submit : submits) {
+    bool new_block = false;
+    while (start != starts.end() && submit.first >= *start) {
+      ++start;
+      new_block = true;
+    }
+    // The blocks that do not submit any operation are omitted.
+    if (new_block && submit != submits.front()) {
+      buf += "End\nBegin MAIN " + to_string(++main_block) + "\n";
+    }
+    SubmitOp submit_op("sync_" + to_string(submit.first));
+    submit_op.AddDebugInfo(submit.second);
+    buf += submit_op.ToString() + "\n";
+    if (buf.size() >= FLUSH_THRESHOLD) {
+      Flush(buf);
+    }
+  }
+  buf += "End\n";
+  Flush(buf);
+  main_blocks = main_block - MAIN_BLOCK + 1;
+}
+
+
+} // namespace trace_generator
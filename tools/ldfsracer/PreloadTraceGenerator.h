@@ -0,0 +1,224 @@
+#ifndef PRELOAD_TRACE_GENERATOR_H
+#define PRELOAD_TRACE_GENERATOR_H
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Operation.h"
+#include "PathFilter.h"
+#include "TraceGenerator.h"
+
+
+using namespace std;
+using namespace operation;
+
+
+namespace trace_generator {
+
+
+/** The parts of the trace written by a thread that are not drained yet. */
+struct ThreadBuffer {
+  /// The `execOp`s performed by the thread.
+  string trace_buf;
+  /// The number and the name of every operation that the thread
+  /// has performed.
+  vector<pair<size_t, const char*>> submits;
+  /// Lock protecting the buffer, which is also drained by the thread
+  /// that stops trace collection.
+  mutex lock;
+};
+
+
+/**
+ * A trace generator that runs inside the traced program, which loads it
+ * through `LD_PRELOAD`.
+ *
+ * Unlike `DynamoTraceGenerator`, this generator does not translate
+ * the program. It only sees the libc functions that perform file
+ * operations, and it knows nothing about the event loop of the program
+ * (if any). So a process executes a sequence of MAIN blocks, which
+ * submit every operation of the process as a synchronous `execOp`,
+ * in the order that the operations are performed. A new MAIN block
+ * starts after the process creates another process, and when it waits
+ * for another process, so that the other process is ordered with
+ * the operations around these points.
+ *
+ * Every thread writes its `execOp`s to its own buffer, and the MAIN
+ * blocks are written once trace collection stops. The trace of a process
+ * is streamed to the file `<trace file><pid>`.
+ *
+ * Trace collection stops when the process executes a new image, which
+ * continues the trace in the next segment, i.e., the file
+ * `<trace file><pid>.<segment>`. A segment starts with an empty
+ * prologue, and it continues the numbering of the operations and
+ * the MAIN blocks of the segment before it.
+ */
+class PreloadTraceGenerator : public TraceGenerator {
+  public:
+    /**
+     * Constructs a generator that streams the trace to the given file,
+     * and records only the operations on the paths that the given filter
+     * traces.
+     */
+    PreloadTraceGenerator(string trace_file_,
+                          const path_filter::PathFilter *path_filter_):
+      trace_file(trace_file_),
+      path_filter(path_filter_ && !path_filter_->IsEmpty() ?
+                  path_filter_ : nullptr),
+      pid(0),
+      segment(0),
+      main_blocks(0),
+      file(nullptr),
+      op_count(0),
+      stopped(true) {
+        trace_f = nullptr;
+      }
+
+    std::string GetName() const {
+      return "PreloadTrace";
+    }
+
+    /** Opens the trace file of the process and starts recording. */
+    void Start();
+
+    /**
+     * Stops recording, drains the buffers of all threads, and writes
+     * the MAIN blocks of the process.
+     */
+    void Stop();
+
+    /**
+     * Gets the state that the next segment of the trace continues
+     * from. This is used once recording stops.
+     */
+    string GetSegmentState() const;
+
+    /**
+     * Starts recording the next segment of the trace, which continues
+     * from the given state. It returns false if the state is invalid,
+     * or it belongs to another process.
+     */
+    bool ContinueTrace(const string &segment_state);
+
+    /** Checks whether operations are recorded. */
+    bool IsRecording() const {
+      return !stopped;
+    }
+
+    /**
+     * Checks whether the operations on the given path are recorded.
+     * Relative paths are resolved against the working directory of
+     * the trace.
+     */
+    bool IsTraced(size_t dirfd, const string &path) const {
+      return !path_filter || path_filter->IsTraced(dirfd, path, cwd);
+    }
+
+    /**
+     * Checks whether the calling process is the one whose trace is
+     * collected. It is not, e.g., in the child of `vfork`, which shares
+     * the memory of its parent.
+     */
+    bool IsTracedProcess() const;
+
+    /** Checks whether the given file descriptor refers to the trace file. */
+    bool IsTraceFd(int fd) const;
+
+    /**
+     * Records an `execOp` that consists of the given operations on
+     * behalf of the calling thread, and returns its number. The
+     * operations are deallocated.
+     */
+    size_t AddExecOp(const char *op_name,
+                     const vector<Operation*> &operations);
+
+    /**
+     * Starts a new MAIN block, which submits the operation with the
+     * given number and the ones that follow it.
+     */
+    void StartMainBlock(size_t op_number);
+
+    /**
+     * Drains the buffer of the calling thread, which is about to exit,
+     * and deallocates it.
+     */
+    void ReleaseThreadBuffer();
+
+    /**
+     * Acquires the locks of the generator before the program forks,
+     * so that no other thread holds them in the child.
+     */
+    void PrepareFork();
+
+    /** Releases the locks of the generator in the parent of a fork. */
+    void ResumeParent();
+
+    /**
+     * Releases the locks of the generator in the child of a fork, and
+     * starts a new trace for the child.
+     *
+     * The child only keeps the buffer of the thread that forks, without
+     * the parts of the trace that its parent has not written yet.
+     */
+    void ResumeChild();
+
+  private:
+    /// Threshold (in bytes) for draining the buffer of a thread.
+    static constexpr size_t FLUSH_THRESHOLD = 1 << 16;
+
+    /// The prefix of the trace file; the id of the process follows.
+    string trace_file;
+    /// The filter of the recorded paths (if any).
+    const path_filter::PathFilter *path_filter;
+    /// The id and the working directory of the process.
+    size_t pid;
+    string cwd;
+    /// The segment of the trace that is written, and the number of
+    /// MAIN blocks that the previous segments hold.
+    size_t segment;
+    size_t main_blocks;
+    /// The trace file, and the lock protecting it.
+    FILE *file;
+    mutex file_lock;
+    /// The number of recorded operations.
+    atomic<size_t> op_count;
+    /// Whether recording has stopped.
+    atomic<bool> stopped;
+    /// The buffers of the running threads, and the lock protecting them.
+    vector<ThreadBuffer*> thread_buffers;
+    mutex threads_lock;
+    /// The operations of the threads that have exited.
+    vector<pair<size_t, const char*>> released_submits;
+    /// The number of the first operation of every MAIN block after
+    /// the first one (protected by `threads_lock`).
+    vector<size_t> block_starts;
+
+    /** Gets the buffer of the calling thread, allocating it if needed. */
+    ThreadBuffer *GetThreadBuffer();
+
+    /**
+     * Opens the trace file of the process, and writes its header
+     * (and the prologue of a segment).
+     */
+    bool OpenTraceFile();
+
+    /** Writes the given data to the trace file, and clears it. */
+    void Flush(string &buf);
+
+    /**
+     * Writes the MAIN blocks that submit the given operations, in
+     * the order they are performed. Every block starts at the given
+     * operation numbers.
+     */
+    void WriteMainBlocks(vector<pair<size_t, const char*>> &submits,
+                         vector<size_t> &starts);
+};
+
+
+} // namespace trace_generator
+
+#endif
@@ -0,0 +1,1142 @@
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "Debug.h"
+#include "PathFilter.h"
+#include "PreloadTraceGenerator.h"
+
+
+// Note that we cannot include <fcntl.h>, because `Operation.h` defines
+// its own `AT_FDCWD`. These are the values of the Linux kernel.
+#define KERNEL_AT_FDCWD -100
+#define KERNEL_AT_SYMLINK_NOFOLLOW 0x100
+#define KERNEL_AT_SYMLINK_FOLLOW 0x400
+#define KERNEL_O_ACCMODE 3
+#define KERNEL_O_WRONLY 1
+#define KERNEL_O_CREAT 0100
+#define KERNEL_O_TRUNC 01000
+#define KERNEL_O_TMPFILE 020200000
+
+/// The environment variables that configure trace collection.
+#define TRACE_FILE_ENV "FSRACER_TRACE_FILE"
+#define TRACE_INCLUDE_ENV "FSRACER_TRACE_INCLUDE"
+#define TRACE_EXCLUDE_ENV "FSRACER_TRACE_EXCLUDE"
+/// The environment variable that passes the state of the trace to
+/// the image that a process executes.
+#define TRACE_SEGMENT_ENV "FSRACER_TRACE_SEGMENT"
+
+
+using namespace std;
+using namespace trace_generator;
+
+
+// These functions are declared in <fcntl.h>, or they are not declared
+// by recent versions of glibc, which still export them for programs
+// linked against older versions.
+extern "C" {
+int open(const char *path, int flags, ...);
+int open64(const char *path, int flags, ...);
+int openat(int dirfd, const char *path, int flags, ...);
+int openat64(int dirfd, const char *path, int flags, ...);
+int creat(const char *path, mode_t mode);
+int creat64(const char *path, mode_t mode);
+int __open_2(const char *path, int flags);
+int __open64_2(const char *path, int flags);
+int __openat_2(int dirfd, const char *path, int flags);
+int __openat64_2(int dirfd, const char *path, int flags);
+int __xstat(int ver, const char *path, struct stat *buf) noexcept;
+int __xstat64(int ver, const char *path, struct stat64 *buf) noexcept;
+int __lxstat(int ver, const char *path, struct stat *buf) noexcept;
+int __lxstat64(int ver, const char *path, struct stat64 *buf) noexcept;
+int __fxstatat(int ver, int dirfd, const char *path, struct stat *buf,
+               int flags) noexcept;
+int __fxstatat64(int ver, int dirfd, const char *path, struct stat64 *buf,
+                 int flags) noexcept;
+}
+
+
+/// Looks up the next definition of the given function, i.e., the one
+/// that the program would call without the preloaded library.
+#define REAL(name) \
+  static auto real_##name = (decltype(&name)) dlsym(RTLD_NEXT, #name)
+
+
+/// The generator of the trace (if the trace is collected).
+static PreloadTraceGenerator *generator = nullptr;
+/// The paths that are traced.
+static path_filter::PathFilter *trace_filter = nullptr;
+/// Whether the calling thread is already inside a wrapper, e.g.,
+/// because the libc function calls another interposed function.
+static thread_local bool in_wrapper = false;
+
+
+/**
+ * Marks the calling thread as being inside a wrapper, while this object
+ * lives.
+ *
+ * It also preserves `errno` for the program, which expects the value
+ * set by the libc function, and not by the generator.
+ */
+class WrapperScope {
+  public:
+    WrapperScope():
+      nested(in_wrapper),
+      has_errno(false),
+      saved_errno(0) {
+        in_wrapper = true;
+      }
+
+    ~WrapperScope() {
+      in_wrapper = nested;
+      if (has_errno) {
+        errno = saved_errno;
+      }
+    }
+
+    /** Checks whether the operations of the wrapper are recorded. */
+    bool IsRecording() const {
+      return !nested && generator && generator->IsRecording();
+    }
+
+    /** Saves the `errno` set by the libc function. */
+    void SaveErrno() {
+      has_errno = true;
+      saved_errno = errno;
+    }
+
+  private:
+    /// Whether the thread was already inside a wrapper.
+    bool nested;
+    /// Whether `errno` is restored, and its value.
+    bool has_errno;
+    int saved_errno;
+};
+
+
+/**
+ * Stops recording while the process executes a new image, and gets
+ * the environment of the new image, which continues the trace of
+ * the process in the next segment.
+ *
+ * If the execution fails, this object restarts recording in the next
+ * segment when it is destroyed.
+ */
+class ExecScope {
+  public:
+    ExecScope(const WrapperScope &scope, char *const envp[]):
+      traced(scope.IsRecording() && generator->IsTracedProcess()),
+      envp(envp) {
+        if (!traced) {
+          return;
+        }
+        generator->Stop();
+        segment_state = generator->GetSegmentState();
+        segment_var = string(TRACE_SEGMENT_ENV "=") + segment_state;
+        size_t prefix_len = strlen(TRACE_SEGMENT_ENV "=");
+        for (size_t i = 0; envp && envp[i]; i++) {
+          if (strncmp(envp[i], segment_var.c_str(), prefix_len) != 0) {
+            env.push_back(envp[i]);
+          }
+        }
+        env.push_back(const_cast<char*>(segment_var.c_str()));
+        env.push_back(nullptr);
+      }
+
+    ~ExecScope() {
+      if (traced) {
+        generator->ContinueTrace(segment_state);
+      }
+    }
+
+    /** Gets the environment of the new image. */
+    char *const *GetEnv() const {
+      return traced ? env.data() : envp;
+    }
+
+  private:
+    /// Whether the process is traced.
+    bool traced;
+    /// The environment that the program passes.
+    char *const *envp;
+    /// The state of the trace, and the variable that holds it.
+    string segment_state;
+    string segment_var;
+    /// The environment of the new image.
+    vector<char*> env;
+};
+
+
+/**
+ * Collects the arguments of an `execl`-like function, which end with
+ * a null pointer.
+ */
+static vector<char*>
+get_exec_args(const char *arg, va_list *args)
+{
+  vector<char*> argv = { const_cast<char*>(arg) };
+  while (argv.back()) {
+    argv.push_back(va_arg(*args, char*));
+  }
+  return argv;
+}
+
+
+/** Drains the buffer of a thread of the program when it exits. */
+struct ThreadExit {
+  ~ThreadExit() {
+    if (generator) {
+      generator->ReleaseThreadBuffer();
+    }
+  }
+};
+
+
+static thread_local ThreadExit thread_exit;
+
+
+static size_t
+to_dirfd(int dirfd)
+{
+  return dirfd == KERNEL_AT_FDCWD ? AT_FDCWD : dirfd;
+}
+
+
+static bool
+follows(int flags)
+{
+  return !(flags & KERNEL_AT_SYMLINK_NOFOLLOW);
+}
+
+
+static bool
+is_traced(int dirfd, const char *path)
+{
+  // An empty path refers to the dir file descriptor itself
+  // (e.g., `AT_EMPTY_PATH`), so it does not access any path.
+  return path && *path && generator->IsTraced(to_dirfd(dirfd), path);
+}
+
+
+/**
+ * Records an `execOp` that consists of the given operations, and returns
+ * its number (or zero if there is no operation).
+ */
+static size_t
+record(const char *op_name, const vector<Operation*> &operations,
+       bool failed)
+{
+  if (operations.empty()) {
+    return 0;
+  }
+  if (failed) {
+    operations.back()->MarkFailed();
+  }
+  // The first access of a thread-local object registers its destructor.
+  (void) &thread_exit;
+  return generator->AddExecOp(op_name, operations);
+}
+
+
+/**
+ * Creates an `hpath` (or `hpathsym`) for the given path, unless its path
+ * is not traced.
+ */
+static void
+add_hpath(vector<Operation*> &operations, int dirfd, const char *path,
+          enum Hpath::EffectType effect_type, bool follow_symlink,
+          const char *op_name)
+{
+  if (!is_traced(dirfd, path)) {
+    return;
+  }
+  Operation *op = nullptr;
+  if (follow_symlink) {
+    op = new Hpath(to_dirfd(dirfd), path, effect_type);
+  } else {
+    op = new HpathSym(to_dirfd(dirfd), path, effect_type);
+  }
+  op->SetActualOpName(op_name);
+  operations.push_back(op);
+}
+
+
+/** Records a single `hpath` (or `hpathsym`). */
+static void
+emit_hpath(int dirfd, const char *path, enum Hpath::EffectType effect_type,
+           bool follow_symlink, bool failed, const char *op_name)
+{
+  vector<Operation*> operations;
+  add_hpath(operations, dirfd, path, effect_type, follow_symlink, op_name);
+  record(op_name, operations, failed);
+}
+
+
+/** Records the operations of `open`-like functions. */
+static void
+emit_open(int dirfd, const char *path, int flags, int ret_val,
+          const char *op_name)
+{
+  if (!is_traced(dirfd, path)) {
+    // If the path is not traced, neither is its file descriptor.
+    return;
+  }
+  vector<Operation*> operations;
+  // Like the `open` wrapper of drfsracer, we only check the access mode.
+  enum Hpath::EffectType effect_type =
+    (flags & KERNEL_O_ACCMODE) == 0 ? Hpath::CONSUMED : Hpath::PRODUCED;
+  add_hpath(operations, dirfd, path, effect_type, true, op_name);
+  NewFd *new_fd = new NewFd(to_dirfd(dirfd), path, ret_val);
+  new_fd->SetActualOpName(op_name);
+  operations.push_back(new_fd);
+  record(op_name, operations, ret_val < 0);
+}
+
+
+/** Records the operations of `link`-like functions. */
+static void
+emit_link(int old_dirfd, const char *old_path, int new_dirfd,
+          const char *new_path, bool follow_symlink, bool failed,
+          const char *op_name)
+{
+  if (!old_path || !new_path ||
+      (!is_traced(old_dirfd, old_path) && !is_traced(new_dirfd, new_path))) {
+    return;
+  }
+  vector<Operation*> operations;
+  add_hpath(operations, old_dirfd, old_path, Hpath::CONSUMED, follow_symlink,
+            op_name);
+  add_hpath(operations, new_dirfd, new_path, Hpath::PRODUCED, false,
+            op_name);
+  Link *link = new Link(to_dirfd(old_dirfd), old_path, to_dirfd(new_dirfd),
+                        new_path);
+  link->SetActualOpName(op_name);
+  operations.push_back(link);
+  record(op_name, operations, failed);
+}
+
+
+/** Records the operations of `rename`-like functions. */
+static void
+emit_rename(int old_dirfd, const char *old_path, int new_dirfd,
+            const char *new_path, bool failed, const char *op_name)
+{
+  if (!old_path || !new_path ||
+      (!is_traced(old_dirfd, old_path) && !is_traced(new_dirfd, new_path))) {
+    return;
+  }
+  vector<Operation*> operations;
+  add_hpath(operations, old_dirfd, old_path, Hpath::EXPUNGED, true, op_name);
+  add_hpath(operations, new_dirfd, new_path, Hpath::PRODUCED, true, op_name);
+  Rename *rename = new Rename(to_dirfd(old_dirfd), old_path,
+                              to_dirfd(new_dirfd), new_path);
+  rename->SetActualOpName(op_name);
+  operations.push_back(rename);
+  record(op_name, operations, failed);
+}
+
+
+/** Records the operations of `symlink`-like functions. */
+static void
+emit_symlink(const char *target, int new_dirfd, const char *new_path,
+             bool failed, const char *op_name)
+{
+  if (!target || !is_traced(new_dirfd, new_path)) {
+    return;
+  }
+  Symlink *symlink = new Symlink(to_dirfd(new_dirfd), new_path, target);
+  symlink->SetActualOpName(op_name);
+  record(op_name, { symlink }, failed);
+}
+
+
+/** Records the creation of a process that shares nothing with its parent. */
+static void
+emit_new_proc(pid_t pid, const char *op_name)
+{
+  NewProc *new_proc = new NewProc(NewProc::SHARE_NONE);
+  new_proc->SetPID(pid);
+  new_proc->SetActualOpName(op_name);
+  size_t op_number = record(op_name, { new_proc }, false);
+  // The new process runs concurrently with the operations that follow.
+  generator->StartMainBlock(op_number + 1);
+}
+
+
+/**
+ * Records that the process waits for the termination of the given
+ * process, if the given status says that it has terminated.
+ */
+static void
+emit_wait_proc(pid_t pid, int status, const char *op_name)
+{
+  if (pid <= 0 || !(WIFEXITED(status) || WIFSIGNALED(status))) {
+    return;
+  }
+  WaitProc *wait_proc = new WaitProc(pid);
+  wait_proc->SetActualOpName(op_name);
+  size_t op_number = record(op_name, { wait_proc }, false);
+  // The operations that follow happen after the terminated process.
+  generator->StartMainBlock(op_number);
+}
+
+
+/** Gets the mode argument of `open`-like functions, if they have one. */
+#define GET_MODE(flags, mode) \
+  mode_t mode = 0; \
+  if ((flags & KERNEL_O_CREAT) || \
+      (flags & KERNEL_O_TMPFILE) == KERNEL_O_TMPFILE) { \
+    va_list args; \
+    va_start(args, flags); \
+    mode = va_arg(args, mode_t); \
+    va_end(args); \
+  }
+
+
+/// Defines a wrapper of an `open`-like function without a dir file
+/// descriptor.
+#define WRAP_OPEN(name) \
+  extern "C" int \
+  name(const char *path, int flags, ...) \
+  { \
+    REAL(name); \
+    GET_MODE(flags, mode); \
+    WrapperScope scope; \
+    int ret_val = real_##name(path, flags, mode); \
+    if (scope.IsRecording()) { \
+      scope.SaveErrno(); \
+      emit_open(KERNEL_AT_FDCWD, path, flags, ret_val, "open"); \
+    } \
+    return ret_val; \
+  }
+
+
+/// Defines a wrapper of an `open`-like function with a dir file
+/// descriptor.
+#define WRAP_OPENAT(name) \
+  extern "C" int \
+  name(int dirfd, const char *path, int flags, ...) \
+  { \
+    REAL(name); \
+    GET_MODE(flags, mode); \
+    WrapperScope scope; \
+    int ret_val = real_##name(dirfd, path, flags, mode); \
+    if (scope.IsRecording()) { \
+      scope.SaveErrno(); \
+      emit_open(dirfd, path, flags, ret_val, "open"); \
+    } \
+    return ret_val; \
+  }
+
+
+/// Defines a wrapper of `creat`.
+#define WRAP_CREAT(name) \
+  extern "C" int \
+  name(const char *path, mode_t mode) \
+  { \
+    REAL(name); \
+    WrapperScope scope; \
+    int ret_val = real_##name(path, mode); \
+    if (scope.IsRecording()) { \
+      scope.SaveErrno(); \
+      emit_open(KERNEL_AT_FDCWD, path, \
+                KERNEL_O_CREAT | KERNEL_O_WRONLY | KERNEL_O_TRUNC, \
+                ret_val, "creat"); \
+    } \
+    return ret_val; \
+  }
+
+
+/// Defines a wrapper of the fortified `open`, which has no mode.
+#define WRAP_OPEN_2(name) \
+  extern "C" int \
+  name(const char *path, int flags) \
+  { \
+    REAL(name); \
+    WrapperScope scope; \
+    int ret_val = real_##name(path, flags); \
+    if (scope.IsRecording()) { \
+      scope.SaveErrno(); \
+      emit_open(KERNEL_AT_FDCWD, path, flags, ret_val, "open"); \
+    } \
+    return ret_val; \
+  }
+
+
+/// Defines a wrapper of the fortified `openat`, which has no mode.
+#define WRAP_OPENAT_2(name) \
+  extern "C" int \
+  name(int dirfd, const char *path, int flags) \
+  { \
+    REAL(name); \
+    WrapperScope scope; \
+    int ret_val = real_##name(dirfd, path, flags); \
+    if (scope.IsRecording()) { \
+      scope.SaveErrno(); \
+      emit_open(dirfd, path, flags, ret_val, "open"); \
+    } \
+    return ret_val; \
+  }
+
+
+/// Defines a wrapper of a `stat`-like function.
+#define WRAP_STAT(name, stat_type, follow_symlink, op_name) \
+  extern "C" int \
+  name(const char *path, struct stat_type *buf) noexcept \
+  { \
+    REAL(name); \
+    WrapperScope scope; \
+    int ret_val = real_##name(path, buf); \
+    if (scope.IsRecording()) { \
+      scope.SaveErrno(); \
+      emit_hpath(KERNEL_AT_FDCWD, path, Hpath::CONSUMED, follow_symlink, \
+                 false, op_name); \
+    } \
+    return ret_val; \
+  }
+
+
+/// Defines a wrapper of an `fstatat`-like function.
+#define WRAP_FSTATAT(name, stat_type) \
+  extern "C" int \
+  name(int dirfd, const char *path, struct stat_type *buf, \
+       int flags) noexcept \
+  { \
+    REAL(name); \
+    WrapperScope scope; \
+    int ret_val = real_##name(dirfd, path, buf, flags); \
+    if (scope.IsRecording()) { \
+      scope.SaveErrno(); \
+      emit_hpath(dirfd, path, Hpath::CONSUMED, follows(flags), false, \
+                 "stat"); \
+    } \
+    return ret_val; \
+  }
+
+
+/// Defines a wrapper of a versioned `stat`-like function of older glibc.
+#define WRAP_XSTAT(name, stat_type, follow_symlink, op_name) \
+  extern "C" int \
+  name(int ver, const char *path, struct stat_type *buf) noexcept \
+  { \
+    REAL(name); \
+    WrapperScope scope; \
+    int ret_val = real_##name(ver, path, buf); \
+    if (scope.IsRecording()) { \
+      scope.SaveErrno(); \
+      emit_hpath(KERNEL_AT_FDCWD, path, Hpath::CONSUMED, follow_symlink, \
+                 false, op_name); \
+    } \
+    return ret_val; \
+  }
+
+
+/// Defines a wrapper of a versioned `fstatat`-like function of older glibc.
+#define WRAP_FXSTATAT(name, stat_type) \
+  extern "C" int \
+  name(int ver, int dirfd, const char *path, struct stat_type *buf, \
+       int flags) noexcept \
+  { \
+    REAL(name); \
+    WrapperScope scope; \
+    int ret_val = real_##name(ver, dirfd, path, buf, flags); \
+    if (scope.IsRecording()) { \
+      scope.SaveErrno(); \
+      emit_hpath(dirfd, path, Hpath::CONSUMED, follows(flags), false, \
+                 "stat"); \
+    } \
+    return ret_val; \
+  }
+
+
+WRAP_OPEN(open)
+WRAP_OPEN(open64)
+WRAP_OPENAT(openat)
+WRAP_OPENAT(openat64)
+WRAP_CREAT(creat)
+WRAP_CREAT(creat64)
+WRAP_OPEN_2(__open_2)
+WRAP_OPEN_2(__open64_2)
+WRAP_OPENAT_2(__openat_2)
+WRAP_OPENAT_2(__openat64_2)
+
+WRAP_STAT(stat, stat, true, "stat")
+WRAP_STAT(stat64, stat64, true, "stat")
+WRAP_STAT(lstat, stat, false, "lstat")
+WRAP_STAT(lstat64, stat64, false, "lstat")
+WRAP_FSTATAT(fstatat, stat)
+WRAP_FSTATAT(fstatat64, stat64)
+WRAP_XSTAT(__xstat, stat, true, "stat")
+WRAP_XSTAT(__xstat64, stat64, true, "stat")
+WRAP_XSTAT(__lxstat, stat, false, "lstat")
+WRAP_XSTAT(__lxstat64, stat64, false, "lstat")
+WRAP_FXSTATAT(__fxstatat, stat)
+WRAP_FXSTATAT(__fxstatat64, stat64)
+
+
+extern "C" int
+statx(int dirfd, const char *path, int flags, unsigned int mask,
+      struct statx *buf) noexcept
+{
+  REAL(statx);
+  WrapperScope scope;
+  int ret_val = real_statx(dirfd, path, flags, mask, buf);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_hpath(dirfd, path, Hpath::CONSUMED, follows(flags), false, "stat");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+rename(const char *old_path, const char *new_path) noexcept
+{
+  REAL(rename);
+  WrapperScope scope;
+  int ret_val = real_rename(old_path, new_path);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_rename(KERNEL_AT_FDCWD, old_path, KERNEL_AT_FDCWD, new_path,
+                ret_val < 0, "rename");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+renameat(int old_dirfd, const char *old_path, int new_dirfd,
+         const char *new_path) noexcept
+{
+  REAL(renameat);
+  WrapperScope scope;
+  int ret_val = real_renameat(old_dirfd, old_path, new_dirfd, new_path);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_rename(old_dirfd, old_path, new_dirfd, new_path, ret_val < 0,
+                "rename");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+renameat2(int old_dirfd, const char *old_path, int new_dirfd,
+          const char *new_path, unsigned int flags) noexcept
+{
+  REAL(renameat2);
+  WrapperScope scope;
+  int ret_val = real_renameat2(old_dirfd, old_path, new_dirfd, new_path,
+                               flags);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_rename(old_dirfd, old_path, new_dirfd, new_path, ret_val < 0,
+                "rename");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+unlink(const char *path) noexcept
+{
+  REAL(unlink);
+  WrapperScope scope;
+  int ret_val = real_unlink(path);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_hpath(KERNEL_AT_FDCWD, path, Hpath::EXPUNGED, true, ret_val < 0,
+               "unlink");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+unlinkat(int dirfd, const char *path, int flags) noexcept
+{
+  REAL(unlinkat);
+  WrapperScope scope;
+  int ret_val = real_unlinkat(dirfd, path, flags);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    // With `AT_REMOVEDIR`, this is equivalent to `rmdir`.
+    emit_hpath(dirfd, path, Hpath::EXPUNGED, true, ret_val < 0, "unlink");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+rmdir(const char *path) noexcept
+{
+  REAL(rmdir);
+  WrapperScope scope;
+  int ret_val = real_rmdir(path);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_hpath(KERNEL_AT_FDCWD, path, Hpath::EXPUNGED, true, ret_val < 0,
+               "rmdir");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+mkdir(const char *path, mode_t mode) noexcept
+{
+  REAL(mkdir);
+  WrapperScope scope;
+  int ret_val = real_mkdir(path, mode);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_hpath(KERNEL_AT_FDCWD, path, Hpath::PRODUCED, false, ret_val < 0,
+               "mkdir");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+mkdirat(int dirfd, const char *path, mode_t mode) noexcept
+{
+  REAL(mkdirat);
+  WrapperScope scope;
+  int ret_val = real_mkdirat(dirfd, path, mode);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_hpath(dirfd, path, Hpath::PRODUCED, false, ret_val < 0, "mkdir");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+link(const char *old_path, const char *new_path) noexcept
+{
+  REAL(link);
+  WrapperScope scope;
+  int ret_val = real_link(old_path, new_path);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_link(KERNEL_AT_FDCWD, old_path, KERNEL_AT_FDCWD, new_path, false,
+              ret_val < 0, "link");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+linkat(int old_dirfd, const char *old_path, int new_dirfd,
+       const char *new_path, int flags) noexcept
+{
+  REAL(linkat);
+  WrapperScope scope;
+  int ret_val = real_linkat(old_dirfd, old_path, new_dirfd, new_path, flags);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_link(old_dirfd, old_path, new_dirfd, new_path,
+              flags & KERNEL_AT_SYMLINK_FOLLOW, ret_val < 0, "link");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+symlink(const char *target, const char *new_path) noexcept
+{
+  REAL(symlink);
+  WrapperScope scope;
+  int ret_val = real_symlink(target, new_path);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_symlink(target, KERNEL_AT_FDCWD, new_path, ret_val < 0, "symlink");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+symlinkat(const char *target, int new_dirfd, const char *new_path) noexcept
+{
+  REAL(symlinkat);
+  WrapperScope scope;
+  int ret_val = real_symlinkat(target, new_dirfd, new_path);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_symlink(target, new_dirfd, new_path, ret_val < 0, "symlink");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+close(int fd)
+{
+  REAL(close);
+  WrapperScope scope;
+  if (scope.IsRecording() && generator->IsTraceFd(fd)) {
+    // Some programs close every file descriptor that they inherit,
+    // so we pretend that the trace file is closed.
+    return 0;
+  }
+  int ret_val = real_close(fd);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    DelFd *del_fd = new DelFd(fd);
+    del_fd->SetActualOpName("close");
+    record("close", { del_fd }, ret_val < 0);
+  }
+  return ret_val;
+}
+
+
+/// Defines a wrapper of `fopen`, which opens the file through internal
+/// functions of glibc.
+#define WRAP_FOPEN(name) \
+  extern "C" FILE * \
+  name(const char *path, const char *mode) \
+  { \
+    REAL(name); \
+    WrapperScope scope; \
+    FILE *stream = real_##name(path, mode); \
+    if (scope.IsRecording()) { \
+      scope.SaveErrno(); \
+      bool read_only = mode && mode[0] == 'r' && !strchr(mode, '+'); \
+      emit_open(KERNEL_AT_FDCWD, path, read_only ? 0 : KERNEL_O_WRONLY, \
+                stream ? fileno(stream) : -1, "fopen"); \
+    } \
+    return stream; \
+  }
+
+
+WRAP_FOPEN(fopen)
+WRAP_FOPEN(fopen64)
+
+
+extern "C" int
+fclose(FILE *stream)
+{
+  REAL(fclose);
+  WrapperScope scope;
+  int fd = scope.IsRecording() && stream ? fileno(stream) : -1;
+  int ret_val = real_fclose(stream);
+  if (fd >= 0) {
+    scope.SaveErrno();
+    DelFd *del_fd = new DelFd(fd);
+    del_fd->SetActualOpName("fclose");
+    record("fclose", { del_fd }, ret_val != 0);
+  }
+  return ret_val;
+}
+
+
+extern "C" pid_t
+fork() noexcept
+{
+  REAL(fork);
+  WrapperScope scope;
+  pid_t ret_val = real_fork();
+  // Only the parent knows the id of the new process.
+  if (ret_val > 0 && scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_new_proc(ret_val, "fork");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+posix_spawn(pid_t *pid, const char *path,
+            const posix_spawn_file_actions_t *file_actions,
+            const posix_spawnattr_t *attrp, char *const argv[],
+            char *const envp[]) noexcept
+{
+  REAL(posix_spawn);
+  WrapperScope scope;
+  int ret_val = real_posix_spawn(pid, path, file_actions, attrp, argv, envp);
+  if (ret_val == 0 && pid && scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_new_proc(*pid, "posix_spawn");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+posix_spawnp(pid_t *pid, const char *file,
+             const posix_spawn_file_actions_t *file_actions,
+             const posix_spawnattr_t *attrp, char *const argv[],
+             char *const envp[]) noexcept
+{
+  REAL(posix_spawnp);
+  WrapperScope scope;
+  int ret_val = real_posix_spawnp(pid, file, file_actions, attrp, argv, envp);
+  if (ret_val == 0 && pid && scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_new_proc(*pid, "posix_spawn");
+  }
+  return ret_val;
+}
+
+
+extern "C" pid_t
+wait(int *status)
+{
+  REAL(wait);
+  WrapperScope scope;
+  int local_status = 0;
+  pid_t ret_val = real_wait(status ? status : &local_status);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_wait_proc(ret_val, status ? *status : local_status, "wait");
+  }
+  return ret_val;
+}
+
+
+extern "C" pid_t
+waitpid(pid_t pid, int *status, int options)
+{
+  REAL(waitpid);
+  WrapperScope scope;
+  int local_status = 0;
+  pid_t ret_val = real_waitpid(pid, status ? status : &local_status,
+                               options);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_wait_proc(ret_val, status ? *status : local_status, "waitpid");
+  }
+  return ret_val;
+}
+
+
+extern "C" pid_t
+wait4(pid_t pid, int *status, int options, struct rusage *usage) noexcept
+{
+  REAL(wait4);
+  WrapperScope scope;
+  int local_status = 0;
+  pid_t ret_val = real_wait4(pid, status ? status : &local_status, options,
+                             usage);
+  if (scope.IsRecording()) {
+    scope.SaveErrno();
+    emit_wait_proc(ret_val, status ? *status : local_status, "wait4");
+  }
+  return ret_val;
+}
+
+
+extern "C" int
+execve(const char *path, char *const argv[], char *const envp[]) noexcept
+{
+  REAL(execve);
+  WrapperScope scope;
+  ExecScope exec_scope(scope, envp);
+  int ret_val = real_execve(path, argv, exec_scope.GetEnv());
+  scope.SaveErrno();
+  return ret_val;
+}
+
+
+extern "C" int
+execvpe(const char *file, char *const argv[], char *const envp[]) noexcept
+{
+  REAL(execvpe);
+  WrapperScope scope;
+  ExecScope exec_scope(scope, envp);
+  int ret_val = real_execvpe(file, argv, exec_scope.GetEnv());
+  scope.SaveErrno();
+  return ret_val;
+}
+
+
+extern "C" int
+fexecve(int fd, char *const argv[], char *const envp[]) noexcept
+{
+  REAL(fexecve);
+  WrapperScope scope;
+  ExecScope exec_scope(scope, envp);
+  int ret_val = real_fexecve(fd, argv, exec_scope.GetEnv());
+  scope.SaveErrno();
+  return ret_val;
+}
+
+
+// The other functions of the exec family call `execve` and `execvpe`
+// inside libc, so they are wrapped through them.
+extern "C" int
+execv(const char *path, char *const argv[]) noexcept
+{
+  return execve(path, argv, environ);
+}
+
+
+extern "C" int
+execvp(const char *file, char *const argv[]) noexcept
+{
+  return execvpe(file, argv, environ);
+}
+
+
+extern "C" int
+execl(const char *path, const char *arg, ...) noexcept
+{
+  va_list args;
+  va_start(args, arg);
+  vector<char*> argv = get_exec_args(arg, &args);
+  va_end(args);
+  return execve(path, argv.data(), environ);
+}
+
+
+extern "C" int
+execlp(const char *file, const char *arg, ...) noexcept
+{
+  va_list args;
+  va_start(args, arg);
+  vector<char*> argv = get_exec_args(arg, &args);
+  va_end(args);
+  return execvpe(file, argv.data(), environ);
+}
+
+
+extern "C" int
+execle(const char *path, const char *arg, ...) noexcept
+{
+  va_list args;
+  va_start(args, arg);
+  vector<char*> argv = get_exec_args(arg, &args);
+  char *const *envp = va_arg(args, char *const *);
+  va_end(args);
+  return execve(path, argv.data(), envp);
+}
+
+
+/// Defines a wrapper of a function that terminates the process without
+/// running the destructors of the program (and of this library).
+#define WRAP_EXIT(name, ...) \
+  extern "C" void \
+  name(int status) __VA_ARGS__ \
+  { \
+    REAL(name); \
+    if (generator && generator->IsTracedProcess()) { \
+      in_wrapper = true; \
+      generator->Stop(); \
+    } \
+    real_##name(status); \
+    __builtin_unreachable(); \
+  }
+
+
+WRAP_EXIT(_exit)
+WRAP_EXIT(_Exit, noexcept)
+
+
+static void
+prepare_fork()
+{
+  generator->PrepareFork();
+}
+
+
+static void
+resume_parent()
+{
+  generator->ResumeParent();
+}
+
+
+static void
+resume_child()
+{
+  generator->ResumeChild();
+}
+
+
+/** Adds the ':'-separated globs of the given environment variable. */
+static void
+add_globs(const char *env, bool include)
+{
+  const char *value = getenv(env);
+  if (!value) {
+    return;
+  }
+  string globs = value;
+  size_t start = 0;
+  while (start <= globs.size()) {
+    size_t end = globs.find(':', start);
+    if (end == string::npos) {
+      end = globs.size();
+    }
+    string glob = globs.substr(start, end - start);
+    if (!glob.empty()) {
+      if (include) {
+        trace_filter->AddInclude(glob);
+      } else {
+        trace_filter->AddExclude(glob);
+      }
+    }
+    start = end + 1;
+  }
+}
+
+
+__attribute__((constructor)) static void
+ldfsracer_init()
+{
+  const char *trace_file = getenv(TRACE_FILE_ENV);
+  if (!trace_file || !*trace_file) {
+    return;
+  }
+  WrapperScope scope;
+  trace_filter = new path_filter::PathFilter();
+  add_globs(TRACE_INCLUDE_ENV, true);
+  add_globs(TRACE_EXCLUDE_ENV, false);
+  // The generator and the filter are never deallocated, because
+  // the threads of the program may outlive this library.
+  PreloadTraceGenerator *trace_gen = new PreloadTraceGenerator(
+      trace_file, trace_filter);
+  // The process may continue its trace from the image that executes
+  // this one, but its children start their own traces.
+  const char *segment_state = getenv(TRACE_SEGMENT_ENV);
+  string state = segment_state ? segment_state : "";
+  unsetenv(TRACE_SEGMENT_ENV);
+  if (!trace_gen->ContinueTrace(state)) {
+    trace_gen->Start();
+  }
+  if (trace_gen->HasFailed()) {
+    debug::err(trace_gen->GetName())
+      << "Trace collection aborted: "
+      << trace_gen->GetErr();
+    return;
+  }
+  generator = trace_gen;
+  pthread_atfork(prepare_fork, resume_parent, resume_child);
+}
+
+
+__attribute__((destructor)) static void
+ldfsracer_exit()
+{
+  if (!generator) {
+    return;
+  }
+  WrapperScope scope;
+  generator->Stop();
+  if (generator->HasFailed()) {
+    debug::err(generator->GetName())
+      << "Trace collection aborted: "
+      << generator->GetErr();
+  }
+}